@@ -20,19 +20,18 @@
 #include "zlib.h"
 #include "sieb.h"
 
+/*
+ * Registered as a "critical" native (note the '!' in the signature below):
+ * the VM passes the array contents directly and no JNIEnv, so this must
+ * not call back into the VM.  The Java code has already range-checked
+ * "off" and "len".
+ */
 JNIEXPORT jlong JNICALL
 Java_java_util_zip_Adler32_updateImpl (JNIEnv * env, jobject recv,
-                                       jbyteArray buf, int off, int len,
+                                       jbyte * b, int off, int len,
                                        jlong crc)
 {
-  jbyte* b = (*env)->GetPrimitiveArrayCritical (env, buf, NULL);
-  if (b == NULL) {
-    return 0;
-  }
-  jlong result = (jlong) adler32 ((uLong) crc, (Bytef *) (b + off), (uInt) len);
-  (*env)->ReleasePrimitiveArrayCritical (env, buf, b, JNI_ABORT);
-
-  return result;
+  return (jlong) adler32 ((uLong) crc, (Bytef *) (b + off), (uInt) len);
 }
 
 JNIEXPORT jlong JNICALL
@@ -49,8 +48,8 @@ Java_java_util_zip_Adler32_updateByteImpl (JNIEnv * env, jobject recv,
  */
 static JNINativeMethod gMethods[] = {
     /* name, signature, funcPtr */
-    { "updateImpl", "([BIIJ)J",     Java_java_util_zip_Adler32_updateImpl },
-    { "updateByteImpl", "(IJ)J",     Java_java_util_zip_Adler32_updateByteImpl },
+    { "updateImpl", "!([BIIJ)J",    Java_java_util_zip_Adler32_updateImpl },
+    { "updateByteImpl", "!(IJ)J",     Java_java_util_zip_Adler32_updateByteImpl },
 };
 int register_java_util_zip_Adler32(JNIEnv* env)
 {
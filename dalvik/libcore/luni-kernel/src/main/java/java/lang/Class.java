@@ -289,6 +289,11 @@ public final class Class<T> implements Serializable, AnnotatedElement, GenericDe
      */
     @SuppressWarnings("unchecked")
     public <A extends Annotation> A getAnnotation(Class<A> annotationClass) {
+        // cheap check that doesn't create any annotation instances
+        if (!isAnnotationPresent(annotationClass)) {
+            return null;
+        }
+
         Annotation[] list = getAnnotations();
         for (int i = 0; i < list.length; i++) {
             if (annotationClass.isInstance(list[i])) {
@@ -1290,9 +1295,34 @@ public final class Class<T> implements Serializable, AnnotatedElement, GenericDe
      *         annotated with {@code annotationClass}; {@code false} otherwise.
      */
     public boolean isAnnotationPresent(Class<? extends Annotation> annotationClass) {
-        return getAnnotation(annotationClass) != null;
+        if (annotationClass == null) {
+            throw new NullPointerException();
+        }
+
+        if (isDeclaredAnnotationPresent(annotationClass)) {
+            return true;
+        }
+
+        /* same rules as getAnnotations() */
+        if (annotationClass.isDeclaredAnnotationPresent(Inherited.class)) {
+            for (Class<?> sup = getSuperclass(); sup != null;
+                    sup = sup.getSuperclass()) {
+                if (sup.isDeclaredAnnotationPresent(annotationClass)) {
+                    return true;
+                }
+            }
+        }
+
+        return false;
     }
 
+    /*
+     * Returns true if the annotation is declared directly on this class,
+     * without creating any annotation instances.
+     */
+    native private boolean isDeclaredAnnotationPresent(
+            Class<? extends Annotation> annotationClass);
+
     /**
      * Indicates whether the class represented by this {@code Class} is
      * anonymously declared.
@@ -221,6 +221,17 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
     native private Annotation[] getDeclaredAnnotations(Class declaringClass,
         int slot);
 
+    @Override
+    public boolean isAnnotationPresent(
+            Class<? extends Annotation> annotationType) {
+        if (annotationType == null) {
+            throw new NullPointerException();
+        }
+        return isAnnotationPresent(declaringClass, slot, annotationType);
+    }
+    native private boolean isAnnotationPresent(Class declaringClass, int slot,
+            Class annotationType);
+
     /**
      * Returns an array of arrays that represent the annotations of the formal
      * parameters of this constructor. If there are no parameters on this
@@ -198,6 +198,17 @@ public final class Field extends AccessibleObject implements Member {
 
     native private Annotation[] getDeclaredAnnotations(Class declaringClass, int slot);
 
+    @Override
+    public boolean isAnnotationPresent(
+            Class<? extends Annotation> annotationType) {
+        if (annotationType == null) {
+            throw new NullPointerException();
+        }
+        return isAnnotationPresent(declaringClass, slot, annotationType);
+    }
+    native private boolean isAnnotationPresent(Class declaringClass, int slot,
+            Class annotationType);
+
     /**
      * Indicates whether or not the specified {@code object} is equal to this
      * field. To be equal, the specified object must be an instance of
@@ -250,6 +250,17 @@ public final class Method extends AccessibleObject implements GenericDeclaration
     native private Annotation[] getDeclaredAnnotations(Class declaringClass,
         int slot);
 
+    @Override
+    public boolean isAnnotationPresent(
+            Class<? extends Annotation> annotationType) {
+        if (annotationType == null) {
+            throw new NullPointerException();
+        }
+        return isAnnotationPresent(declaringClass, slot, annotationType);
+    }
+    native private boolean isAnnotationPresent(Class declaringClass, int slot,
+            Class annotationType);
+
     private static final Annotation[] NO_ANNOTATIONS = new Annotation[0];
 
     /**
@@ -652,6 +652,13 @@ abstract class AbstractStringBuilder {
         if (count == 0) {
             return ""; //$NON-NLS-1$
         }
+        // BEGIN android-changed
+        // Latin-1 text gets its own compact byte[] and leaves the buffer alone
+        byte[] bytes = String.compress(value, 0, count);
+        if (bytes != null) {
+            return new String(0, count, bytes);
+        }
+        // END android-changed
         // Optimize String sharing for more performance
         int wasted = value.length - count;
         if (wasted >= 256
@@ -76,6 +76,31 @@ class CaseMapper {
         return newValue != null ? new String(0, newCount, newValue) : s;
     }
     
+    /**
+     * Implements String.toLowerCase for a Latin-1 string. Outside Turkish and Azeri, the lowercase
+     * of a Latin-1 char is another Latin-1 char, so the result stays one byte per char.
+     */
+    public static String toLowerCase(Locale locale, String s, byte[] value, int offset, int count) {
+        String languageCode = locale.getLanguage();
+        if (languageCode.equals("tr") || languageCode.equals("az")) {
+            return toLowerCase(locale, s, s.toCharArray(), 0, count);
+        }
+
+        byte[] newValue = null;
+        for (int i = offset, end = offset + count; i < end; ++i) {
+            char ch = (char) (value[i] & 0xff);
+            char newCh = Character.toLowerCase(ch);
+            if (newValue == null && ch != newCh) {
+                newValue = new byte[count];
+                System.arraycopy(value, offset, newValue, 0, i - offset);
+            }
+            if (newValue != null) {
+                newValue[i - offset] = (byte) newCh;
+            }
+        }
+        return newValue != null ? new String(0, count, newValue) : s;
+    }
+
     private static boolean followedBy(char[] value, int offset, int count, int index, char ch) {
         return index + 1 < offset + count && value[index + 1] == ch;
     }
@@ -42,7 +42,9 @@ import org.apache.harmony.luni.util.PriviAction;
  * An immutable sequence of characters/code units ({@code char}s). A
  * {@code String} is represented by array of UTF-16 values, such that
  * Unicode supplementary characters (code points) are stored/encoded as
- * surrogate pairs via Unicode code units ({@code char}).
+ * surrogate pairs via Unicode code units ({@code char}). A string whose
+ * characters all fit in ISO-8859-1 (Latin-1) is stored one byte per
+ * character instead.
  *
  * @see StringBuffer
  * @see StringBuilder
@@ -93,9 +95,23 @@ public final class String implements Serializable, Comparable<String>,
      */
     public static final Comparator<String> CASE_INSENSITIVE_ORDER = new CaseInsensitiveComparator();
 
-    private static final char[] ascii;
+    // BEGIN android-changed
+    /*
+     * Values of "coder".  A LATIN1 string holds one char per byte in a
+     * byte[]; a UTF16 string holds its chars in a char[].  Only LATIN1 is a
+     * promise: a UTF16 string can still hold nothing but Latin-1 chars,
+     * e.g. a substring of one that doesn't.  The VM knows these values.
+     */
+    static final byte LATIN1 = 0;
+
+    static final byte UTF16 = 1;
 
-    private final char[] value;
+    private static final byte[] latin1;
+
+    /*
+     * A byte[] if coder is LATIN1, a char[] if it's UTF16.
+     */
+    private final Object value;
 
     private final int offset;
 
@@ -103,14 +119,17 @@ public final class String implements Serializable, Comparable<String>,
 
     private int hashCode;
 
+    private final byte coder;
+    // END android-changed
+
     private static Charset DefaultCharset;
 
     private static Charset lastCharset;
 
     static {
-        ascii = new char[128];
-        for (int i = 0; i < ascii.length; i++) {
-            ascii[i] = (char) i;
+        latin1 = new byte[256];
+        for (int i = 0; i < latin1.length; i++) {
+            latin1[i] = (byte) i;
         }
     }
 
@@ -118,9 +137,10 @@ public final class String implements Serializable, Comparable<String>,
      * Creates an empty string.
      */
     public String() {
-        value = new char[0];
+        value = new byte[0];
         offset = 0;
         count = 0;
+        coder = LATIN1;
     }
 
     /*
@@ -129,10 +149,20 @@ public final class String implements Serializable, Comparable<String>,
     @SuppressWarnings("unused")
     private String(String s, char c) {
         offset = 0;
-        value = new char[s.count + 1];
         count = s.count + 1;
-        System.arraycopy(s.value, s.offset, value, 0, s.count);
-        value[s.count] = c;
+        if (s.coder == LATIN1 && c <= 0xff) {
+            byte[] bytes = new byte[count];
+            System.arraycopy(s.value, s.offset, bytes, 0, s.count);
+            bytes[s.count] = (byte) c;
+            value = bytes;
+            coder = LATIN1;
+        } else {
+            char[] chars = new char[count];
+            s._getChars(0, s.count, chars, 0);
+            chars[s.count] = c;
+            value = chars;
+            coder = UTF16;
+        }
     }
 
     /**
@@ -189,15 +219,16 @@ public final class String implements Serializable, Comparable<String>,
         if (start >= 0 && 0 <= length && length <= data.length - start) {
             offset = 0;
             Charset charset = defaultCharset();
-            int result;
             CharBuffer cb = charset
                     .decode(ByteBuffer.wrap(data, start, length));
-            if ((result = cb.length()) > 0) {
-                value = cb.array();
-                count = result;
+            count = cb.length();
+            byte[] bytes = compress(cb.array(), 0, count);
+            if (bytes != null) {
+                value = bytes;
+                coder = LATIN1;
             } else {
-                count = 0;
-                value = new char[0];
+                value = cb.array();
+                coder = UTF16;
             }
         } else {
             throw new StringIndexOutOfBoundsException();
@@ -230,11 +261,20 @@ public final class String implements Serializable, Comparable<String>,
             // start + length could overflow, start/length maybe MaxInt
             if (start >= 0 && 0 <= length && length <= data.length - start) {
                 offset = 0;
-                value = new char[length];
                 count = length;
-                high <<= 8;
-                for (int i = 0; i < count; i++) {
-                    value[i] = (char) (high + (data[start++] & 0xff));
+                if ((high & 0xff) == 0) {
+                    byte[] bytes = new byte[length];
+                    System.arraycopy(data, start, bytes, 0, length);
+                    value = bytes;
+                    coder = LATIN1;
+                } else {
+                    char[] chars = new char[length];
+                    high <<= 8;
+                    for (int i = 0; i < count; i++) {
+                        chars[i] = (char) (high + (data[start++] & 0xff));
+                    }
+                    value = chars;
+                    coder = UTF16;
                 }
             } else {
                 throw new StringIndexOutOfBoundsException();
@@ -275,11 +315,11 @@ public final class String implements Serializable, Comparable<String>,
             // Special-case ISO-88589-1 and UTF 8 decoding
             if (encoding.equalsIgnoreCase("ISO-8859-1") ||
                 encoding.equalsIgnoreCase("ISO8859_1")) {
-                value = new char[length];
+                byte[] bytes = new byte[length];
+                System.arraycopy(data, start, bytes, 0, length);
+                value = bytes;
                 count = length;
-                for (int i = 0; i < count; i++) {
-                    value[i] = (char) (data[start++] & 0xff);
-                }
+                coder = LATIN1;
                 return;
             } else if ("utf8".equals(encoding) ||
                        "utf-8".equals(encoding) ||
@@ -385,14 +425,21 @@ public final class String implements Serializable, Comparable<String>,
 
                 // Reallocate the array to fit the contents
                 count = s;
-                value = new char[s];
-                System.arraycopy(v, 0, value, 0, s);
+                byte[] bytes = compress(v, 0, s);
+                if (bytes != null) {
+                    value = bytes;
+                    coder = LATIN1;
+                } else {
+                    char[] chars = new char[s];
+                    System.arraycopy(v, 0, chars, 0, s);
+                    value = chars;
+                    coder = UTF16;
+                }
                 return;
             }
             // END android-added
             Charset charset = getCharset(encoding);
 
-            int result;
             CharBuffer cb;
             try {
                 cb = charset.decode(ByteBuffer.wrap(data, start, length));
@@ -401,12 +448,14 @@ public final class String implements Serializable, Comparable<String>,
                 // behavior is unspecified for invalid array
                 cb = CharBuffer.wrap("\u003f".toCharArray()); //$NON-NLS-1$
             }
-            if ((result = cb.length()) > 0) {
-                value = cb.array();
-                count = result;
+            count = cb.length();
+            byte[] bytes = compress(cb.array(), 0, count);
+            if (bytes != null) {
+                value = bytes;
+                coder = LATIN1;
             } else {
-                count = 0;
-                value = new char[0];
+                value = cb.array();
+                coder = UTF16;
             }
         } else {
             throw new StringIndexOutOfBoundsException();
@@ -465,22 +514,61 @@ public final class String implements Serializable, Comparable<String>,
         // start + length could overflow, start/length maybe MaxInt
         if (start >= 0 && 0 <= length && length <= data.length - start) {
             offset = 0;
-            value = new char[length];
             count = length;
-            System.arraycopy(data, start, value, 0, count);
+            byte[] bytes = compress(data, start, length);
+            if (bytes != null) {
+                value = bytes;
+                coder = LATIN1;
+            } else {
+                char[] chars = new char[length];
+                System.arraycopy(data, start, chars, 0, length);
+                value = chars;
+                coder = UTF16;
+            }
         } else {
             throw new StringIndexOutOfBoundsException();
         }
     }
 
     /*
-     * Internal version of string constructor. Does not range check, null check,
-     * or copy the character array.
+     * Internal version of string constructor. Does not range check or null
+     * check.  The character array is shared unless all of the characters
+     * are Latin-1, in which case they're copied into a byte[].
      */
     String(int start, int length, char[] data) {
+        byte[] bytes = compress(data, start, length);
+        if (bytes != null) {
+            value = bytes;
+            offset = 0;
+            coder = LATIN1;
+        } else {
+            value = data;
+            offset = start;
+            coder = UTF16;
+        }
+        count = length;
+    }
+
+    /*
+     * Internal version of string constructor for Latin-1 data. Does not range
+     * check, null check, or copy the byte array.
+     */
+    String(int start, int length, byte[] data) {
         value = data;
         offset = start;
         count = length;
+        coder = LATIN1;
+    }
+
+    /*
+     * Internal version of string constructor that takes the array as it's
+     * stored: a byte[] if "coder" is LATIN1, a char[] if it's UTF16.
+     */
+    private String(int start, int length, Object data, byte coder) {
+        value = data;
+        offset = start;
+        count = length;
+        this.coder = coder;
     }
 
     /**
@@ -493,6 +581,7 @@ public final class String implements Serializable, Comparable<String>,
         value = string.value;
         offset = string.offset;
         count = string.count;
+        coder = string.coder;
     }
 
     /*
@@ -500,17 +589,7 @@ public final class String implements Serializable, Comparable<String>,
      */
     @SuppressWarnings( { "unused", "nls" })
     private String(String s1, String s2) {
-        if (s1 == null) {
-            s1 = "null";
-        }
-        if (s2 == null) {
-            s2 = "null";
-        }
-        count = s1.count + s2.count;
-        value = new char[count];
-        offset = 0;
-        System.arraycopy(s1.value, s1.offset, value, 0, s1.count);
-        System.arraycopy(s2.value, s2.offset, value, s1.count, s2.count);
+        this(valueOf(s1).concat(valueOf(s2)));
     }
 
     /*
@@ -518,22 +597,7 @@ public final class String implements Serializable, Comparable<String>,
      */
     @SuppressWarnings( { "unused", "nls" })
     private String(String s1, String s2, String s3) {
-        if (s1 == null) {
-            s1 = "null";
-        }
-        if (s2 == null) {
-            s2 = "null";
-        }
-        if (s3 == null) {
-            s3 = "null";
-        }
-        count = s1.count + s2.count + s3.count;
-        value = new char[count];
-        offset = 0;
-        System.arraycopy(s1.value, s1.offset, value, 0, s1.count);
-        System.arraycopy(s2.value, s2.offset, value, s1.count, s2.count);
-        System.arraycopy(s3.value, s3.offset, value, s1.count + s2.count,
-                s3.count);
+        this(valueOf(s1).concat(valueOf(s2)).concat(valueOf(s3)));
     }
 
     /**
@@ -546,8 +610,15 @@ public final class String implements Serializable, Comparable<String>,
     public String(StringBuffer stringbuffer) {
         offset = 0;
         synchronized (stringbuffer) {
-            value = stringbuffer.shareValue();
             count = stringbuffer.length();
+            byte[] bytes = compress(stringbuffer.getValue(), 0, count);
+            if (bytes != null) {
+                value = bytes;
+                coder = LATIN1;
+            } else {
+                value = stringbuffer.shareValue();
+                coder = UTF16;
+            }
         }
     }
 
@@ -581,13 +652,21 @@ public final class String implements Serializable, Comparable<String>,
             throw new IndexOutOfBoundsException();
         }
         this.offset = 0;
-        this.value = new char[count * 2];
+        char[] chars = new char[count * 2];
         int end = offset + count;
         int c = 0;
         for (int i = offset; i < end; i++) {
-            c += Character.toChars(codePoints[i], this.value, c);
+            c += Character.toChars(codePoints[i], chars, c);
         }
         this.count = c;
+        byte[] bytes = compress(chars, 0, c);
+        if (bytes != null) {
+            this.value = bytes;
+            this.coder = LATIN1;
+        } else {
+            this.value = chars;
+            this.coder = UTF16;
+        }
     }
 
     /**
@@ -606,8 +685,16 @@ public final class String implements Serializable, Comparable<String>,
         }
         this.offset = 0;
         this.count = sb.length();
-        this.value = new char[this.count];
-        sb.getChars(0, this.count, this.value, 0);
+        byte[] bytes = compress(sb.getValue(), 0, this.count);
+        if (bytes != null) {
+            this.value = bytes;
+            this.coder = LATIN1;
+        } else {
+            char[] chars = new char[this.count];
+            sb.getChars(0, this.count, chars, 0);
+            this.value = chars;
+            this.coder = UTF16;
+        }
     }
 
     /*
@@ -615,16 +702,7 @@ public final class String implements Serializable, Comparable<String>,
      */
     @SuppressWarnings("unused")
     private String(String s1, int v1) {
-        if (s1 == null) {
-            s1 = "null"; //$NON-NLS-1$
-        }
-        String s2 = String.valueOf(v1);
-        int len = s1.count + s2.count;
-        value = new char[len];
-        offset = 0;
-        System.arraycopy(s1.value, s1.offset, value, 0, s1.count);
-        System.arraycopy(s2.value, s2.offset, value, s1.count, s2.count);
-        count = len;
+        this(valueOf(s1).concat(valueOf(v1)));
     }
 
     /**
@@ -638,11 +716,46 @@ public final class String implements Serializable, Comparable<String>,
      */
     public char charAt(int index) {
         if (0 <= index && index < count) {
-            return value[offset + index];
+            if (coder == LATIN1) {
+                return (char) (((byte[]) value)[offset + index] & 0xff);
+            }
+            return ((char[]) value)[offset + index];
         }
         throw new StringIndexOutOfBoundsException();
     }
 
+    // BEGIN android-added
+    /*
+     * Returns the char at "index" of "data", which is a byte[] if "coder" is
+     * LATIN1 and a char[] if it's UTF16.  No range check, and "index"
+     * already includes the string's offset.
+     */
+    private static char charAt(Object data, byte coder, int index) {
+        if (coder == LATIN1) {
+            return (char) (((byte[]) data)[index] & 0xff);
+        }
+        return ((char[]) data)[index];
+    }
+
+    /*
+     * Returns the chars data[start, start + length) narrowed to a new byte[],
+     * or null if any of them doesn't fit in a byte.
+     */
+    static byte[] compress(char[] data, int start, int length) {
+        int end = start + length;
+        for (int i = start; i < end; i++) {
+            if (data[i] > 0xff) {
+                return null;
+            }
+        }
+        byte[] bytes = new byte[length];
+        for (int i = 0; i < length; i++) {
+            bytes[i] = (byte) data[start + i];
+        }
+        return bytes;
+    }
+    // END android-added
+
     // Optimized for ASCII
     private char compareValue(char ch) {
         if (ch < 128) {
@@ -678,10 +791,28 @@ public final class String implements Serializable, Comparable<String>,
         // Code adapted from K&R, pg 101
         int o1 = offset, o2 = string.offset, result;
         int end = offset + (count < string.count ? count : string.count);
-        char[] target = string.value;
-        while (o1 < end) {
-            if ((result = value[o1++] - target[o2++]) != 0) {
-                return result;
+        if (coder == LATIN1 && string.coder == LATIN1) {
+            byte[] value1 = (byte[]) value;
+            byte[] target = (byte[]) string.value;
+            while (o1 < end) {
+                if ((result = (value1[o1++] & 0xff) - (target[o2++] & 0xff)) != 0) {
+                    return result;
+                }
+            }
+        } else if (coder == UTF16 && string.coder == UTF16) {
+            char[] value1 = (char[]) value;
+            char[] target = (char[]) string.value;
+            while (o1 < end) {
+                if ((result = value1[o1++] - target[o2++]) != 0) {
+                    return result;
+                }
+            }
+        } else {
+            while (o1 < end) {
+                if ((result = charAt(value, coder, o1++)
+                        - charAt(string.value, string.coder, o2++)) != 0) {
+                    return result;
+                }
             }
         }
         return count - string.count;
@@ -711,9 +842,9 @@ public final class String implements Serializable, Comparable<String>,
         int o1 = offset, o2 = string.offset, result;
         int end = offset + (count < string.count ? count : string.count);
         char c1, c2;
-        char[] target = string.value;
         while (o1 < end) {
-            if ((c1 = value[o1++]) == (c2 = target[o2++])) {
+            if ((c1 = charAt(value, coder, o1++))
+                    == (c2 = charAt(string.value, string.coder, o2++))) {
                 continue;
             }
             c1 = compareValue(c1);
@@ -735,11 +866,18 @@ public final class String implements Serializable, Comparable<String>,
      */
     public String concat(String string) {
         if (string.count > 0 && count > 0) {
-            char[] buffer = new char[count + string.count];
-            System.arraycopy(value, offset, buffer, 0, count);
-            System.arraycopy(string.value, string.offset, buffer, count,
-                    string.count);
-            return new String(0, buffer.length, buffer);
+            int length = count + string.count;
+            if (coder == LATIN1 && string.coder == LATIN1) {
+                byte[] buffer = new byte[length];
+                System.arraycopy(value, offset, buffer, 0, count);
+                System.arraycopy(string.value, string.offset, buffer, count,
+                        string.count);
+                return new String(0, length, buffer);
+            }
+            char[] buffer = new char[length];
+            _getChars(0, count, buffer, 0);
+            string._getChars(0, string.count, buffer, count);
+            return new String(0, length, buffer, UTF16);
         }
         return count == 0 ? string : this;
     }
@@ -846,11 +984,28 @@ public final class String implements Serializable, Comparable<String>,
             // inline 'return regionMatches(0, s, 0, count)'
             // omitting unnecessary bounds checks
             int o1 = offset, o2 = s.offset;
-            char[] value1 = value;
-            char[] value2 = s.value;
-            for (int i = 0; i < count; ++i) {
-                if (value1[o1 + i] != value2[o2 + i]) {
-                    return false;
+            if (coder == LATIN1 && s.coder == LATIN1) {
+                byte[] value1 = (byte[]) value;
+                byte[] value2 = (byte[]) s.value;
+                for (int i = 0; i < count; ++i) {
+                    if (value1[o1 + i] != value2[o2 + i]) {
+                        return false;
+                    }
+                }
+            } else if (coder == UTF16 && s.coder == UTF16) {
+                char[] value1 = (char[]) value;
+                char[] value2 = (char[]) s.value;
+                for (int i = 0; i < count; ++i) {
+                    if (value1[o1 + i] != value2[o2 + i]) {
+                        return false;
+                    }
+                }
+            } else {
+                for (int i = 0; i < count; ++i) {
+                    if (charAt(value, coder, o1 + i)
+                            != charAt(s.value, s.coder, o2 + i)) {
+                        return false;
+                    }
                 }
             }
             return true;
@@ -879,9 +1034,9 @@ public final class String implements Serializable, Comparable<String>,
         int o1 = offset, o2 = string.offset;
         int end = offset + count;
         char c1, c2;
-        char[] target = string.value;
         while (o1 < end) {
-            if ((c1 = value[o1++]) != (c2 = target[o2++])
+            if ((c1 = charAt(value, coder, o1++))
+                    != (c2 = charAt(string.value, string.coder, o2++))
                     && Character.toUpperCase(c1) != Character.toUpperCase(c2)
                     // Required for unicode that we test both cases
                     && Character.toLowerCase(c1) != Character.toLowerCase(c2)) {
@@ -900,11 +1055,7 @@ public final class String implements Serializable, Comparable<String>,
      * @return the byte array encoding of this string.
      */
     public byte[] getBytes() {
-        ByteBuffer buffer = defaultCharset().encode(
-                CharBuffer.wrap(this.value, this.offset, this.count));
-        byte[] bytes = new byte[buffer.limit()];
-        buffer.get(bytes);
-        return bytes;
+        return encode(defaultCharset());
     }
 
     /**
@@ -932,7 +1083,7 @@ public final class String implements Serializable, Comparable<String>,
             end += offset;
             try {
                 for (int i = offset + start; i < end; i++) {
-                    data[index++] = (byte) value[i];
+                    data[index++] = (byte) charAt(value, coder, i);
                 }
             } catch (ArrayIndexOutOfBoundsException e) {
                 throw new StringIndexOutOfBoundsException();
@@ -952,12 +1103,32 @@ public final class String implements Serializable, Comparable<String>,
      *             if the encoding is not supported.
      */
     public byte[] getBytes(String encoding) throws UnsupportedEncodingException {
-        ByteBuffer buffer = getCharset(encoding).encode(
-                CharBuffer.wrap(this.value, this.offset, this.count));
+        return encode(getCharset(encoding));
+    }
+
+    // BEGIN android-added
+    /*
+     * Encodes this string with "charset".  A Latin-1 string's bytes are
+     * already its ISO-8859-1 encoding.
+     */
+    private byte[] encode(Charset charset) {
+        CharBuffer chars;
+        if (coder == LATIN1) {
+            if (charset.name().equals("ISO-8859-1")) { //$NON-NLS-1$
+                byte[] bytes = new byte[count];
+                System.arraycopy(value, offset, bytes, 0, count);
+                return bytes;
+            }
+            chars = CharBuffer.wrap(toCharArray());
+        } else {
+            chars = CharBuffer.wrap((char[]) value, offset, count);
+        }
+        ByteBuffer buffer = charset.encode(chars);
         byte[] bytes = new byte[buffer.limit()];
         buffer.get(bytes);
         return bytes;
     }
+    // END android-added
 
     private Charset getCharset(final String encoding)
             throws UnsupportedEncodingException {
@@ -1000,7 +1171,7 @@ public final class String implements Serializable, Comparable<String>,
         // NOTE last character not copied!
         // Fast range check.
         if (0 <= start && start <= end && end <= count) {
-            System.arraycopy(value, start + offset, buffer, index, end - start);
+            _getChars(start, end, buffer, index);
         } else {
             throw new StringIndexOutOfBoundsException();
         }
@@ -1014,7 +1185,18 @@ public final class String implements Serializable, Comparable<String>,
      */
     void _getChars(int start, int end, char[] buffer, int index) {
         // NOTE last character not copied!
-        System.arraycopy(value, start + offset, buffer, index, end - start);
+        if (coder == UTF16) {
+            System.arraycopy(value, start + offset, buffer, index, end - start);
+            return;
+        }
+        int length = end - start;
+        if (index < 0 || length > buffer.length - index) {
+            throw new ArrayIndexOutOfBoundsException();
+        }
+        byte[] bytes = (byte[]) value;
+        for (int i = start + offset, last = end + offset; i < last; i++) {
+            buffer[index++] = (char) (bytes[i] & 0xff);
+        }
     }
     // END android-added
 
@@ -1026,11 +1208,20 @@ public final class String implements Serializable, Comparable<String>,
             int multiplier = 1;
             int _offset = offset;
             int _count = count;
-            char[] _value = value;
-            for (int i = _offset + _count - 1; i >= _offset; i--) {
-                hash += _value[i] * multiplier;
-                int shifted = multiplier << 5;
-                multiplier = shifted - multiplier;
+            if (coder == LATIN1) {
+                byte[] _value = (byte[]) value;
+                for (int i = _offset + _count - 1; i >= _offset; i--) {
+                    hash += (_value[i] & 0xff) * multiplier;
+                    int shifted = multiplier << 5;
+                    multiplier = shifted - multiplier;
+                }
+            } else {
+                char[] _value = (char[]) value;
+                for (int i = _offset + _count - 1; i >= _offset; i--) {
+                    hash += _value[i] * multiplier;
+                    int shifted = multiplier << 5;
+                    multiplier = shifted - multiplier;
+                }
             }
             hashCode = hash;
         }
@@ -1050,18 +1241,7 @@ public final class String implements Serializable, Comparable<String>,
      */
     public int indexOf(int c) {
         // BEGIN android-changed
-        int _count = count;
-        if (0 < _count) {
-            int _offset = offset;
-            int last = _offset + _count;
-            char[] _value = value;
-            for (int i = _offset; i < last; i++) {
-                if (_value[i] == c) {
-                    return i - _offset;
-                }
-            }
-        }
-        return -1;
+        return indexOf(c, 0);
         // END android-changed
     }
 
@@ -1086,10 +1266,23 @@ public final class String implements Serializable, Comparable<String>,
             }
             int _offset = offset;
             int last = _offset + count;
-            char[] _value = value;
-            for (int i = _offset + start; i < last; i++) {
-                if (_value[i] == c) {
-                    return i - _offset;
+            if (coder == LATIN1) {
+                if (c < 0 || c > 0xff) {
+                    return -1;
+                }
+                byte b = (byte) c;
+                byte[] _value = (byte[]) value;
+                for (int i = _offset + start; i < last; i++) {
+                    if (_value[i] == b) {
+                        return i - _offset;
+                    }
+                }
+            } else {
+                char[] _value = (char[]) value;
+                for (int i = _offset + start; i < last; i++) {
+                    if (_value[i] == c) {
+                        return i - _offset;
+                    }
                 }
             }
         }
@@ -1118,9 +1311,10 @@ public final class String implements Serializable, Comparable<String>,
             if (subCount > _count) {
                 return -1;
             }
-            char[] target = string.value;
+            Object target = string.value;
+            byte targetCoder = string.coder;
             int subOffset = string.offset;
-            char firstChar = target[subOffset];
+            char firstChar = charAt(target, targetCoder, subOffset);
             int end = subOffset + subCount;
             while (true) {
                 int i = indexOf(firstChar, start);
@@ -1128,8 +1322,8 @@ public final class String implements Serializable, Comparable<String>,
                     return -1; // handles subCount > count || start >= count
                 }
                 int o1 = offset + i, o2 = subOffset;
-                char[] _value = value;
-                while (++o2 < end && _value[++o1] == target[o2]) {
+                while (++o2 < end && charAt(value, coder, ++o1)
+                        == charAt(target, targetCoder, o2)) {
                     // Intentionally empty
                 }
                 if (o2 == end) {
@@ -1167,9 +1361,10 @@ public final class String implements Serializable, Comparable<String>,
             if (subCount + start > _count) {
                 return -1;
             }
-            char[] target = subString.value;
+            Object target = subString.value;
+            byte targetCoder = subString.coder;
             int subOffset = subString.offset;
-            char firstChar = target[subOffset];
+            char firstChar = charAt(target, targetCoder, subOffset);
             int end = subOffset + subCount;
             while (true) {
                 int i = indexOf(firstChar, start);
@@ -1177,8 +1372,8 @@ public final class String implements Serializable, Comparable<String>,
                     return -1; // handles subCount > count || start >= count
                 }
                 int o1 = offset + i, o2 = subOffset;
-                char[] _value = value;
-                while (++o2 < end && _value[++o1] == target[o2]) {
+                while (++o2 < end && charAt(value, coder, ++o1)
+                        == charAt(target, targetCoder, o2)) {
                     // Intentionally empty
                 }
                 if (o2 == end) {
@@ -1213,15 +1408,7 @@ public final class String implements Serializable, Comparable<String>,
      */
     public int lastIndexOf(int c) {
         // BEGIN android-changed
-        int _count = count;
-        int _offset = offset;
-        char[] _value = value;
-        for (int i = _offset + _count - 1; i >= _offset; --i) {
-            if (_value[i] == c) {
-                return i - _offset;
-            }
-        }
-        return -1;
+        return lastIndexOf(c, count - 1);
         // END android-changed
     }
 
@@ -1241,14 +1428,27 @@ public final class String implements Serializable, Comparable<String>,
         // BEGIN android-changed
         int _count = count;
         int _offset = offset;
-        char[] _value = value;
         if (start >= 0) {
             if (start >= _count) {
                 start = _count - 1;
             }
-            for (int i = _offset + start; i >= _offset; --i) {
-                if (_value[i] == c) {
-                    return i - _offset;
+            if (coder == LATIN1) {
+                if (c < 0 || c > 0xff) {
+                    return -1;
+                }
+                byte b = (byte) c;
+                byte[] _value = (byte[]) value;
+                for (int i = _offset + start; i >= _offset; --i) {
+                    if (_value[i] == b) {
+                        return i - _offset;
+                    }
+                }
+            } else {
+                char[] _value = (char[]) value;
+                for (int i = _offset + start; i >= _offset; --i) {
+                    if (_value[i] == c) {
+                        return i - _offset;
+                    }
                 }
             }
         }
@@ -1295,9 +1495,10 @@ public final class String implements Serializable, Comparable<String>,
                     start = count - subCount;
                 }
                 // count and subCount are both >= 1
-                char[] target = subString.value;
+                Object target = subString.value;
+                byte targetCoder = subString.coder;
                 int subOffset = subString.offset;
-                char firstChar = target[subOffset];
+                char firstChar = charAt(target, targetCoder, subOffset);
                 int end = subOffset + subCount;
                 while (true) {
                     int i = lastIndexOf(firstChar, start);
@@ -1305,7 +1506,8 @@ public final class String implements Serializable, Comparable<String>,
                         return -1;
                     }
                     int o1 = offset + i, o2 = subOffset;
-                    while (++o2 < end && value[++o1] == target[o2]) {
+                    while (++o2 < end && charAt(value, coder, ++o1)
+                            == charAt(target, targetCoder, o2)) {
                         // Intentionally empty
                     }
                     if (o2 == end) {
@@ -1361,11 +1563,28 @@ public final class String implements Serializable, Comparable<String>,
         }
         int o1 = offset + thisStart, o2 = string.offset + start;
         // BEGIN android-changed
-        char[] value1 = value;
-        char[] value2 = string.value;
-        for (int i = 0; i < length; ++i) {
-            if (value1[o1 + i] != value2[o2 + i]) {
-                return false;
+        if (coder == LATIN1 && string.coder == LATIN1) {
+            byte[] value1 = (byte[]) value;
+            byte[] value2 = (byte[]) string.value;
+            for (int i = 0; i < length; ++i) {
+                if (value1[o1 + i] != value2[o2 + i]) {
+                    return false;
+                }
+            }
+        } else if (coder == UTF16 && string.coder == UTF16) {
+            char[] value1 = (char[]) value;
+            char[] value2 = (char[]) string.value;
+            for (int i = 0; i < length; ++i) {
+                if (value1[o1 + i] != value2[o2 + i]) {
+                    return false;
+                }
+            }
+        } else {
+            for (int i = 0; i < length; ++i) {
+                if (charAt(value, coder, o1 + i)
+                        != charAt(string.value, string.coder, o2 + i)) {
+                    return false;
+                }
             }
         }
         // END android-changed
@@ -1410,9 +1629,9 @@ public final class String implements Serializable, Comparable<String>,
             start += string.offset;
             int end = thisStart + length;
             char c1, c2;
-            char[] target = string.value;
             while (thisStart < end) {
-                if ((c1 = value[thisStart++]) != (c2 = target[start++])
+                if ((c1 = charAt(value, coder, thisStart++))
+                        != (c2 = charAt(string.value, string.coder, start++))
                         && Character.toUpperCase(c1) != Character.toUpperCase(c2)
                         // Required for unicode that we test both cases
                         && Character.toLowerCase(c1) != Character.toLowerCase(c2)) {
@@ -1436,29 +1655,32 @@ public final class String implements Serializable, Comparable<String>,
      */
     public String replace(char oldChar, char newChar) {
         // BEGIN endroid-changed
-        char[] buffer = value;
-        int _offset = offset;
         int _count = count;
+        int idx = indexOf(oldChar, 0);
+        if (idx == -1) {
+            return this;
+        }
 
-        int idx = _offset;
-        int last = _offset + _count;
-        boolean copied = false;
-        while (idx < last) {
-            if (buffer[idx] == oldChar) {
-                if (!copied) {
-                    char[] newBuffer = new char[_count];
-                    System.arraycopy(buffer, _offset, newBuffer, 0, _count);
-                    buffer = newBuffer;
-                    idx -= _offset;
-                    last -= _offset;
-                    copied = true;
+        if (coder == LATIN1 && newChar <= 0xff) {
+            byte[] buffer = new byte[_count];
+            System.arraycopy(value, offset, buffer, 0, _count);
+            byte oldByte = (byte) oldChar;
+            byte newByte = (byte) newChar;
+            for (; idx < _count; idx++) {
+                if (buffer[idx] == oldByte) {
+                    buffer[idx] = newByte;
                 }
-                buffer[idx] = newChar;
             }
-            idx++;
+            return new String(0, _count, buffer);
         }
 
-        return copied ? new String(0, count, buffer) : this;
+        char[] buffer = toCharArray();
+        for (; idx < _count; idx++) {
+            if (buffer[idx] == oldChar) {
+                buffer[idx] = newChar;
+            }
+        }
+        return new String(0, _count, buffer);
         // END android-changed
     }
     
@@ -1493,12 +1715,12 @@ public final class String implements Serializable, Comparable<String>,
         int tl = target.length();
         int tail = 0;
         do {
-            buffer.append(value, offset + tail, index - tail);
+            buffer.append(this, tail, index);
             buffer.append(rs);
             tail = index + tl;
         } while ((index = indexOf(ts, tail)) != -1);
         //append trailing chars
-        buffer.append(value, offset + tail, count - tail);
+        buffer.append(this, tail, count);
 
         return buffer.toString();
     }
@@ -1550,7 +1772,7 @@ public final class String implements Serializable, Comparable<String>,
             return this;
         }
         if (0 <= start && start <= count) {
-            return new String(offset + start, count - start, value);
+            return new String(offset + start, count - start, value, coder);
         }
         throw new StringIndexOutOfBoundsException(start);
     }
@@ -1574,7 +1796,7 @@ public final class String implements Serializable, Comparable<String>,
         // NOTE last character not copied!
         // Fast range check.
         if (0 <= start && start <= end && end <= count) {
-            return new String(offset + start, end - start, value);
+            return new String(offset + start, end - start, value, coder);
         }
         throw new StringIndexOutOfBoundsException();
     }
@@ -1586,7 +1808,7 @@ public final class String implements Serializable, Comparable<String>,
      */
     public char[] toCharArray() {
         char[] buffer = new char[count];
-        System.arraycopy(value, offset, buffer, 0, count);
+        _getChars(0, count, buffer, 0);
         return buffer;
     }
 
@@ -1596,7 +1818,7 @@ public final class String implements Serializable, Comparable<String>,
      * @return a new lowercase string, or {@code this} if it's already all-lowercase.
      */
     public String toLowerCase() {
-        return CaseMapper.toLowerCase(Locale.getDefault(), this, value, offset, count);
+        return toLowerCase(Locale.getDefault());
     }
 
     /**
@@ -1615,7 +1837,10 @@ public final class String implements Serializable, Comparable<String>,
      * @return a new lowercase string, or {@code this} if it's already all-lowercase.
      */
     public String toLowerCase(Locale locale) {
-        return CaseMapper.toLowerCase(locale, this, value, offset, count);
+        if (coder == LATIN1) {
+            return CaseMapper.toLowerCase(locale, this, (byte[]) value, offset, count);
+        }
+        return CaseMapper.toLowerCase(locale, this, (char[]) value, offset, count);
     }
 
     /**
@@ -1642,7 +1867,7 @@ public final class String implements Serializable, Comparable<String>,
     // BEGIN android-note
     // put this in a helper class so that it's only initialized on demand?
     // END android-note
-    private static final char[] upperValues = "SS\u0000\u02bcN\u0000J\u030c\u0000\u0399\u0308\u0301\u03a5\u0308\u0301\u0535\u0552\u0000H\u0331\u0000T\u0308\u0000W\u030a\u0000Y\u030a\u0000A\u02be\u0000\u03a5\u0313\u0000\u03a5\u0313\u0300\u03a5\u0313\u0301\u03a5\u0313\u0342\u1f08\u0399\u0000\u1f09\u0399\u0000\u1f0a\u0399\u0000\u1f0b\u0399\u0000\u1f0c\u0399\u0000\u1f0d\u0399\u0000\u1f0e\u0399\u0000\u1f0f\u0399\u0000\u1f08\u0399\u0000\u1f09\u0399\u0000\u1f0a\u0399\u0000\u1f0b\u0399\u0000\u1f0c\u0399\u0000\u1f0d\u0399\u0000\u1f0e\u0399\u0000\u1f0f\u0399\u0000\u1f28\u0399\u0000\u1f29\u0399\u0000\u1f2a\u0399\u0000\u1f2b\u0399\u0000\u1f2c\u0399\u0000\u1f2d\u0399\u0000\u1f2e\u0399\u0000\u1f2f\u0399\u0000\u1f28\u0399\u0000\u1f29\u0399\u0000\u1f2a\u0399\u0000\u1f2b\u0399\u0000\u1f2c\u0399\u0000\u1f2d\u0399\u0000\u1f2e\u0399\u0000\u1f2f\u0399\u0000\u1f68\u0399\u0000\u1f69\u0399\u0000\u1f6a\u0399\u0000\u1f6b\u0399\u0000\u1f6c\u0399\u0000\u1f6d\u0399\u0000\u1f6e\u0399\u0000\u1f6f\u0399\u0000\u1f68\u0399\u0000\u1f69\u0399\u0000\u1f6a\u0399\u0000\u1f6b\u0399\u0000\u1f6c\u0399\u0000\u1f6d\u0399\u0000\u1f6e\u0399\u0000\u1f6f\u0399\u0000\u1fba\u0399\u0000\u0391\u0399\u0000\u0386\u0399\u0000\u0391\u0342\u0000\u0391\u0342\u0399\u0391\u0399\u0000\u1fca\u0399\u0000\u0397\u0399\u0000\u0389\u0399\u0000\u0397\u0342\u0000\u0397\u0342\u0399\u0397\u0399\u0000\u0399\u0308\u0300\u0399\u0308\u0301\u0399\u0342\u0000\u0399\u0308\u0342\u03a5\u0308\u0300\u03a5\u0308\u0301\u03a1\u0313\u0000\u03a5\u0342\u0000\u03a5\u0308\u0342\u1ffa\u0399\u0000\u03a9\u0399\u0000\u038f\u0399\u0000\u03a9\u0342\u0000\u03a9\u0342\u0399\u03a9\u0399\u0000FF\u0000FI\u0000FL\u0000FFIFFLST\u0000ST\u0000\u0544\u0546\u0000\u0544\u0535\u0000\u0544\u053b\u0000\u054e\u0546\u0000\u0544\u053d\u0000".value; //$NON-NLS-1$
+    private static final char[] upperValues = "SS\u0000\u02bcN\u0000J\u030c\u0000\u0399\u0308\u0301\u03a5\u0308\u0301\u0535\u0552\u0000H\u0331\u0000T\u0308\u0000W\u030a\u0000Y\u030a\u0000A\u02be\u0000\u03a5\u0313\u0000\u03a5\u0313\u0300\u03a5\u0313\u0301\u03a5\u0313\u0342\u1f08\u0399\u0000\u1f09\u0399\u0000\u1f0a\u0399\u0000\u1f0b\u0399\u0000\u1f0c\u0399\u0000\u1f0d\u0399\u0000\u1f0e\u0399\u0000\u1f0f\u0399\u0000\u1f08\u0399\u0000\u1f09\u0399\u0000\u1f0a\u0399\u0000\u1f0b\u0399\u0000\u1f0c\u0399\u0000\u1f0d\u0399\u0000\u1f0e\u0399\u0000\u1f0f\u0399\u0000\u1f28\u0399\u0000\u1f29\u0399\u0000\u1f2a\u0399\u0000\u1f2b\u0399\u0000\u1f2c\u0399\u0000\u1f2d\u0399\u0000\u1f2e\u0399\u0000\u1f2f\u0399\u0000\u1f28\u0399\u0000\u1f29\u0399\u0000\u1f2a\u0399\u0000\u1f2b\u0399\u0000\u1f2c\u0399\u0000\u1f2d\u0399\u0000\u1f2e\u0399\u0000\u1f2f\u0399\u0000\u1f68\u0399\u0000\u1f69\u0399\u0000\u1f6a\u0399\u0000\u1f6b\u0399\u0000\u1f6c\u0399\u0000\u1f6d\u0399\u0000\u1f6e\u0399\u0000\u1f6f\u0399\u0000\u1f68\u0399\u0000\u1f69\u0399\u0000\u1f6a\u0399\u0000\u1f6b\u0399\u0000\u1f6c\u0399\u0000\u1f6d\u0399\u0000\u1f6e\u0399\u0000\u1f6f\u0399\u0000\u1fba\u0399\u0000\u0391\u0399\u0000\u0386\u0399\u0000\u0391\u0342\u0000\u0391\u0342\u0399\u0391\u0399\u0000\u1fca\u0399\u0000\u0397\u0399\u0000\u0389\u0399\u0000\u0397\u0342\u0000\u0397\u0342\u0399\u0397\u0399\u0000\u0399\u0308\u0300\u0399\u0308\u0301\u0399\u0342\u0000\u0399\u0308\u0342\u03a5\u0308\u0300\u03a5\u0308\u0301\u03a1\u0313\u0000\u03a5\u0342\u0000\u03a5\u0308\u0342\u1ffa\u0399\u0000\u03a9\u0399\u0000\u038f\u0399\u0000\u03a9\u0342\u0000\u03a9\u0342\u0399\u03a9\u0399\u0000FF\u0000FI\u0000FL\u0000FFIFFLST\u0000ST\u0000\u0544\u0546\u0000\u0544\u0535\u0000\u0544\u053b\u0000\u054e\u0546\u0000\u0544\u053d\u0000".toCharArray(); //$NON-NLS-1$
 
     /**
      * Return the index of the specified character into the upperValues table.
@@ -1686,7 +1911,7 @@ public final class String implements Serializable, Comparable<String>,
                 if (ch <= 0x1e9a) {
                     index = 6 + ch - 0x1e96;
                 } else if (ch >= 0x1f50 && ch <= 0x1ffc) {
-                    index = "\u000b\u0000\f\u0000\r\u0000\u000e\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u000f\u0010\u0011\u0012\u0013\u0014\u0015\u0016\u0017\u0018\u0019\u001a\u001b\u001c\u001d\u001e\u001f !\"#$%&'()*+,-./0123456789:;<=>\u0000\u0000?@A\u0000BC\u0000\u0000\u0000\u0000D\u0000\u0000\u0000\u0000\u0000EFG\u0000HI\u0000\u0000\u0000\u0000J\u0000\u0000\u0000\u0000\u0000KL\u0000\u0000MN\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000OPQ\u0000RS\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000TUV\u0000WX\u0000\u0000\u0000\u0000Y".value[ch - 0x1f50]; //$NON-NLS-1$
+                    index = "\u000b\u0000\f\u0000\r\u0000\u000e\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u000f\u0010\u0011\u0012\u0013\u0014\u0015\u0016\u0017\u0018\u0019\u001a\u001b\u001c\u001d\u001e\u001f !\"#$%&'()*+,-./0123456789:;<=>\u0000\u0000?@A\u0000BC\u0000\u0000\u0000\u0000D\u0000\u0000\u0000\u0000\u0000EFG\u0000HI\u0000\u0000\u0000\u0000J\u0000\u0000\u0000\u0000\u0000KL\u0000\u0000MN\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000OPQ\u0000RS\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000\u0000TUV\u0000WX\u0000\u0000\u0000\u0000Y".charAt(ch - 0x1f50); //$NON-NLS-1$
                     if (index == 0) {
                         index = -1;
                     }
@@ -1719,7 +1944,7 @@ public final class String implements Serializable, Comparable<String>,
         char[] output = null;
         int i = 0;
         for (int o = offset, end = offset + count; o < end; o++) {
-            char ch = value[o];
+            char ch = charAt(value, coder, o);
             int index = upperIndex(ch);
             if (index == -1) {
                 if (output != null && i >= output.length) {
@@ -1734,7 +1959,7 @@ public final class String implements Serializable, Comparable<String>,
                     if (output == null) {
                         output = new char[count];
                         i = o - offset;
-                        System.arraycopy(value, offset, output, 0, i);
+                        _getChars(0, i, output, 0);
                     }
                     output[i++] = upch;
                 } else if (output != null) {
@@ -1746,7 +1971,7 @@ public final class String implements Serializable, Comparable<String>,
                 if (output == null) {
                     output = new char[count + (count / 6) + 2];
                     i = o - offset;
-                    System.arraycopy(value, offset, output, 0, i);
+                    _getChars(0, i, output, 0);
                 } else if (i + (val3 == 0 ? 1 : 2) >= output.length) {
                     char[] newoutput = new char[output.length + (count / 6) + 3];
                     System.arraycopy(output, 0, newoutput, 0, output.length);
@@ -1780,16 +2005,16 @@ public final class String implements Serializable, Comparable<String>,
     public String trim() {
         int start = offset, last = offset + count - 1;
         int end = last;
-        while ((start <= end) && (value[start] <= ' ')) {
+        while ((start <= end) && (charAt(value, coder, start) <= ' ')) {
             start++;
         }
-        while ((end >= start) && (value[end] <= ' ')) {
+        while ((end >= start) && (charAt(value, coder, end) <= ' ')) {
             end--;
         }
         if (start == offset && end == last) {
             return this;
         }
-        return new String(start, end - start + 1, value);
+        return new String(start, end - start + 1, value, coder);
     }
 
     /**
@@ -1838,10 +2063,10 @@ public final class String implements Serializable, Comparable<String>,
      */
     public static String valueOf(char value) {
         String s;
-        if (value < 128) {
-            s = new String(value, 1, ascii);
+        if (value <= 0xff) {
+            s = new String(value, 1, latin1);
         } else {
-            s = new String(0, 1, new char[] { value });
+            s = new String(0, 1, new char[] { value }, UTF16);
         }
         s.hashCode = value;
         return s;
@@ -1936,8 +2161,13 @@ public final class String implements Serializable, Comparable<String>,
             if (count != size) {
                 return false;
             }
-            return regionMatches(0, new String(0, size, strbuf.getValue()), 0,
-                    size);
+            char[] chars = strbuf.getValue();
+            for (int i = 0; i < size; i++) {
+                if (charAt(value, coder, offset + i) != chars[i]) {
+                    return false;
+                }
+            }
+            return true;
         }
     }
 
@@ -2103,8 +2333,11 @@ public final class String implements Serializable, Comparable<String>,
         if (index < 0 || index >= count) {
             throw new IndexOutOfBoundsException();
         }
+        if (coder == LATIN1) {
+            return charAt(index);
+        }
         int s = index + offset;
-        return Character.codePointAt(value, s, offset + count);
+        return Character.codePointAt((char[]) value, s, offset + count);
     }
 
     /**
@@ -2124,8 +2357,11 @@ public final class String implements Serializable, Comparable<String>,
         if (index < 1 || index > count) {
             throw new IndexOutOfBoundsException();
         }
+        if (coder == LATIN1) {
+            return charAt(index - 1);
+        }
         int s = index + offset;
-        return Character.codePointBefore(value, s);
+        return Character.codePointBefore((char[]) value, s);
     }
 
     /**
@@ -2148,8 +2384,11 @@ public final class String implements Serializable, Comparable<String>,
         if (beginIndex < 0 || endIndex > count || beginIndex > endIndex) {
             throw new IndexOutOfBoundsException();
         }
+        if (coder == LATIN1) {
+            return endIndex - beginIndex;
+        }
         int s = beginIndex + offset;
-        return Character.codePointCount(value, s, endIndex - beginIndex);
+        return Character.codePointCount((char[]) value, s, endIndex - beginIndex);
     }
 
     /**
@@ -2185,8 +2424,15 @@ public final class String implements Serializable, Comparable<String>,
      * @since 1.5
      */
     public int offsetByCodePoints(int index, int codePointOffset) {
+        if (coder == LATIN1) {
+            int r = index + codePointOffset;
+            if (index < 0 || index > count || r < 0 || r > count) {
+                throw new IndexOutOfBoundsException();
+            }
+            return r;
+        }
         int s = index + offset;
-        int r = Character.offsetByCodePoints(value, offset, count, s,
+        int r = Character.offsetByCodePoints((char[]) value, offset, count, s,
                 codePointOffset);
         return r - offset;
     }
@@ -2266,21 +2512,25 @@ public final class String implements Serializable, Comparable<String>,
     @SuppressWarnings("unused")
     private static int indexOf(String haystackString, String needleString,
             int cache, int md2, char lastChar) {
-        char[] haystack = haystackString.value;
+        Object haystack = haystackString.value;
+        byte haystackCoder = haystackString.coder;
         int haystackOffset = haystackString.offset;
         int haystackLength = haystackString.count;
-        char[] needle = needleString.value;
+        Object needle = needleString.value;
+        byte needleCoder = needleString.coder;
         int needleOffset = needleString.offset;
         int needleLength = needleString.count;
         int needleLengthMinus1 = needleLength - 1;
         int haystackEnd = haystackOffset + haystackLength;
         outer_loop: for (int i = haystackOffset + needleLengthMinus1; i < haystackEnd;) {
-            if (lastChar == haystack[i]) {
+            char ch = charAt(haystack, haystackCoder, i);
+            if (lastChar == ch) {
                 for (int j = 0; j < needleLengthMinus1; ++j) {
-                    if (needle[j + needleOffset] != haystack[i + j
-                            - needleLengthMinus1]) {
+                    if (charAt(needle, needleCoder, j + needleOffset)
+                            != charAt(haystack, haystackCoder,
+                                    i + j - needleLengthMinus1)) {
                         int skip = 1;
-                        if ((cache & (1 << haystack[i])) == 0) {
+                        if ((cache & (1 << ch)) == 0) {
                             skip += j;
                         }
                         i += Math.max(md2, skip);
@@ -2290,7 +2540,7 @@ public final class String implements Serializable, Comparable<String>,
                 return i - needleLengthMinus1 - haystackOffset;
             }
 
-            if ((cache & (1 << haystack[i])) == 0) {
+            if ((cache & (1 << ch)) == 0) {
                 i += needleLengthMinus1;
             }
             i++;
@@ -293,6 +293,32 @@ const char* dexStringAndSizeById(const DexFile* pDexFile, u4 idx,
     return (const char*) ptr;
 }
 
+/*
+ * Compute the java.lang.String hash code of a modified UTF-8 string.
+ */
+static u4 computeUtf16HashFromUtf8(const char* utf8Str)
+{
+    u4 hash = 0;
+
+    while (*utf8Str != '\0')
+        hash = hash * 31 + dexGetUtf16FromUtf8(&utf8Str);
+
+    return hash;
+}
+
+/* Return the java.lang.String hash code of the string with the specified
+ * string_id index, from the precomputed table if the file has one. */
+u4 dexGetStringHash(const DexFile* pDexFile, u4 idx)
+{
+    const DexStringHashes* pHashes = pDexFile->pStringHashes;
+
+    if (pHashes != NULL) {
+        assert(idx < (u4) pHashes->numEntries);
+        return pHashes->hash[idx];
+    }
+    return computeUtf16HashFromUtf8(dexStringById(pDexFile, idx));
+}
+
 /*
  * Format an SHA-1 digest for printing.  tmpBuf must be able to hold at
  * least kSHA1DigestOutputLen bytes.
@@ -462,6 +488,38 @@ DexClassLookup* dexCreateClassLookup(DexFile* pDexFile)
 }
 
 
+/*
+ * Create the string hash table.
+ *
+ * Returns newly-allocated storage.
+ */
+DexStringHashes* dexCreateStringHashes(const DexFile* pDexFile)
+{
+    DexStringHashes* pHashes;
+    int allocSize;
+    int i, numEntries;
+
+    assert(pDexFile != NULL);
+
+    numEntries = pDexFile->pHeader->stringIdsSize;
+    allocSize = offsetof(DexStringHashes, hash)
+                    + numEntries * sizeof(pHashes->hash[0]);
+
+    pHashes = (DexStringHashes*) calloc(1, allocSize);
+    if (pHashes == NULL)
+        return NULL;
+    pHashes->size = allocSize;
+    pHashes->numEntries = numEntries;
+
+    for (i = 0; i < numEntries; i++)
+        pHashes->hash[i] = computeUtf16HashFromUtf8(dexStringById(pDexFile, i));
+
+    LOGV("String hashes: strings=%d alloc=%d\n", numEntries, allocSize);
+
+    return pHashes;
+}
+
+
 /*
  * Set up the basic raw data pointers of a DexFile. This function isn't
  * meant for general use.
@@ -653,6 +711,10 @@ static bool parseAuxData(const u1* data, DexFile* pDexFile)
             LOGV("+++ found register maps, size=%u\n", size);
             pDexFile->pRegisterMapPool = data;
             break;
+        case kDexChunkStringHashes:
+            LOGV("+++ found string hashes, size=%u\n", size);
+            pDexFile->pStringHashes = (const DexStringHashes*) data;
+            break;
         default:
             LOGI("Unknown chunk 0x%08x (%c%c%c%c), size=%d in aux data area\n",
                 *pAux,
@@ -743,6 +805,14 @@ DexFile* dexFileParse(const u1* data, size_t length, int flags)
     dexFileSetupBasicPointers(pDexFile, data);
     pHeader = pDexFile->pHeader;
 
+    if (pDexFile->pStringHashes != NULL &&
+        pDexFile->pStringHashes->numEntries != (int) pHeader->stringIdsSize)
+    {
+        LOGW("Ignoring string hashes: %d entries, expected %d\n",
+            pDexFile->pStringHashes->numEntries, pHeader->stringIdsSize);
+        pDexFile->pStringHashes = NULL;
+    }
+
     magic = pHeader->magic;
     if (memcmp(magic, DEX_MAGIC, 4) != 0) {
         /* not expected */
@@ -53,7 +53,7 @@
 
 /* same, but for optimized DEX header */
 #define DEX_OPT_MAGIC   "dey\n"
-#define DEX_OPT_MAGIC_VERS  "036\0"
+#define DEX_OPT_MAGIC_VERS  "037\0"
 
 #define DEX_DEP_MAGIC   "deps"
 
@@ -165,6 +165,7 @@ enum {
 enum {
     kDexChunkClassLookup            = 0x434c4b50,   /* CLKP */
     kDexChunkRegisterMaps           = 0x524d4150,   /* RMAP */
+    kDexChunkStringHashes           = 0x53545248,   /* STRH */
 
     kDexChunkReducingIndexMap       = 0x5249584d,   /* RIXM */
     kDexChunkExpandingIndexMap      = 0x4549584d,   /* EIXM */
@@ -442,6 +443,20 @@ typedef struct DexClassLookup {
     } table[1];
 } DexClassLookup;
 
+/*
+ * String hash codes, indexed by string_id.  Each is the value that
+ * java.lang.String.hashCode() returns for that string, so the VM can look
+ * a string constant up in the intern table without decoding it first.
+ *
+ * Like the class lookup table, this is computed at DEX optimization time
+ * and embedded in the file.
+ */
+typedef struct DexStringHashes {
+    int     size;                       // total size, including "size"
+    int     numEntries;                 // always == stringIdsSize
+    u4      hash[1];
+} DexStringHashes;
+
 /*
  * Map constant pool indices from one form to another.  Some or all of these
  * may be NULL.
@@ -524,6 +539,7 @@ typedef struct DexFile {
     const DexClassLookup* pClassLookup;
     DexIndexMap         indexMap;
     const void*         pRegisterMapPool;       // RegisterMapClassPool
+    const DexStringHashes* pStringHashes;
 
     /* points to start of DEX file data */
     const u1*           baseAddr;
@@ -577,6 +593,11 @@ void dexFileFree(DexFile* pDexFile);
  */
 DexClassLookup* dexCreateClassLookup(DexFile* pDexFile);
 
+/*
+ * Create string hash table.
+ */
+DexStringHashes* dexCreateStringHashes(const DexFile* pDexFile);
+
 /*
  * Find a class definition by descriptor.
  */
@@ -625,6 +646,10 @@ DEX_INLINE const char* dexStringById(const DexFile* pDexFile, u4 idx) {
 const char* dexStringAndSizeById(const DexFile* pDexFile, u4 idx,
         u4* utf16Size);
 
+/* Return the java.lang.String hash code of the string with the specified
+ * string_id index, from the precomputed table if the file has one. */
+u4 dexGetStringHash(const DexFile* pDexFile, u4 idx);
+
 /* return the TypeId with the specified index */
 DEX_INLINE const DexTypeId* dexGetTypeId(const DexFile* pDexFile, u4 idx) {
     assert(idx < pDexFile->pHeader->typeIdsSize);
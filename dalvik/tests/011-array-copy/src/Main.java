@@ -37,5 +37,55 @@ public class Main {
         catch (ArrayStoreException ase) {
             System.out.println("caught ArrayStoreException (expected)");
         }
+        System.out.println("partial copy: " + stringArray[3] + " "
+            + (stringArray[4] == objectArray[4]));
+
+        testOverlap(5);
+        testOverlap(100);
+    }
+
+    /*
+     * Shift within a single array in both directions.  Short and long
+     * copies take different paths.
+     */
+    static void testOverlap(int len) {
+        byte[] bytes = new byte[len + 2];
+        char[] chars = new char[len + 2];
+        int[] ints = new int[len + 2];
+        long[] longs = new long[len + 2];
+        Object[] objs = new Object[len + 2];
+        for (int i = 0; i < len + 2; i++) {
+            bytes[i] = (byte) i;
+            chars[i] = (char) i;
+            ints[i] = i;
+            longs[i] = i;
+            objs[i] = Integer.valueOf(i);
+        }
+
+        /* move right by two, then back left by one */
+        System.arraycopy(bytes, 0, bytes, 2, len);
+        System.arraycopy(chars, 0, chars, 2, len);
+        System.arraycopy(ints, 0, ints, 2, len);
+        System.arraycopy(longs, 0, longs, 2, len);
+        System.arraycopy(objs, 0, objs, 2, len);
+        System.arraycopy(bytes, 2, bytes, 1, len);
+        System.arraycopy(chars, 2, chars, 1, len);
+        System.arraycopy(ints, 2, ints, 1, len);
+        System.arraycopy(longs, 2, longs, 1, len);
+        System.arraycopy(objs, 2, objs, 1, len);
+
+        boolean ok = true;
+        for (int i = 1; i <= len; i++) {
+            int expect = i - 1;
+            if (bytes[i] != (byte) expect || chars[i] != expect ||
+                ints[i] != expect || longs[i] != expect ||
+                !objs[i].equals(Integer.valueOf(expect)))
+            {
+                System.out.println("mismatch at " + i);
+                ok = false;
+                break;
+            }
+        }
+        System.out.println("overlap " + len + ": " + (ok ? "ok" : "FAILED"));
     }
 }
@@ -30,5 +30,64 @@ public class Main {
         } else {
             System.out.println("bad!");
         }
+
+        /* a constant resolved after the same string was interned */
+        System.out.println("literal: " + (a == "foobar"));
+        String s = new StringBuilder("caf").append('\u00e9').toString();
+        System.out.println("non-ASCII: " + (s.intern() == "caf\u00e9"));
+        s = new StringBuilder("a").append('\u0000').append('b').toString();
+        System.out.println("embedded NUL: " + (s.intern() == "a\u0000b"));
+
+        testThreads();
+
+        /* interned constants have to survive GC */
+        System.gc();
+        System.out.println("after gc: " +
+            (new String("foobar").intern() == "foobar"));
+    }
+
+    static final int THREADS = 4;
+    static final int STRINGS = 5000;
+
+    /*
+     * Intern the same set of strings from several threads at once; they
+     * all have to get the same objects back.
+     */
+    static void testThreads() {
+        final String[][] results = new String[THREADS][];
+        Thread[] threads = new Thread[THREADS];
+
+        for (int t = 0; t < THREADS; t++) {
+            final int id = t;
+            threads[t] = new Thread() {
+                public void run() {
+                    String[] mine = new String[STRINGS];
+                    for (int i = 0; i < STRINGS; i++) {
+                        int n = (i * 7 + id * 1237) % STRINGS;
+                        mine[n] = ("str" + n).intern();
+                    }
+                    results[id] = mine;
+                }
+            };
+            threads[t].start();
+        }
+        for (int t = 0; t < THREADS; t++) {
+            try {
+                threads[t].join();
+            } catch (InterruptedException ie) {
+                throw new RuntimeException(ie);
+            }
+        }
+
+        boolean same = true;
+        for (int i = 0; i < STRINGS; i++) {
+            for (int t = 1; t < THREADS; t++) {
+                if (results[t][i] != results[0][i])
+                    same = false;
+            }
+            if (!results[0][i].equals("str" + i))
+                same = false;
+        }
+        System.out.println("threads: " + same);
     }
 }
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+    static class CheapException extends RuntimeException {
+        CheapException(String msg) {
+            super(msg);
+        }
+    }
+
+    static final CheapException PREALLOCATED = new CheapException("reused");
+
+    /*
+     * The "run" script runs this three times: once normally, once with
+     * -Xstacktracedepth ("depth"), and once with -Xnostacktrace naming
+     * NumberFormatException ("notrace").
+     */
+    static public void main(String[] args) throws Exception {
+        boolean timing = false;
+        String mode = "full";
+
+        for (String arg : args) {
+            if (arg.equals("--timing"))
+                timing = true;
+            else
+                mode = arg;
+        }
+
+        if (mode.equals("depth"))
+            checkTraceDepth();
+        else if (mode.equals("notrace"))
+            checkNoTrace();
+        else
+            run(timing);
+    }
+
+    static public void run(boolean timing) {
+        long time0 = System.nanoTime();
+        int count1 = throwAtDepth(20000, 2, false);
+        long time1 = System.nanoTime();
+        int count2 = throwAtDepth(20000, 50, false);
+        long time2 = System.nanoTime();
+        int count3 = throwAtDepth(20000, 50, true);
+        long time3 = System.nanoTime();
+
+        System.out.println("shallow: caught " + count1 + " exceptions");
+        System.out.println("deep: caught " + count2 + " exceptions");
+        System.out.println("reused: caught " + count3 + " exceptions");
+
+        checkTrace();
+
+        if (timing) {
+            System.out.printf("shallow: %.3g usec per throw\n",
+                (time1 - time0) / (double) count1 / 1000);
+            System.out.printf("deep: %.3g usec per throw\n",
+                (time2 - time1) / (double) count2 / 1000);
+            System.out.printf("reused: %.3g usec per throw\n",
+                (time3 - time2) / (double) count3 / 1000);
+        }
+    }
+
+    /*
+     * Throw and catch "iters" exceptions, each one created "depth" calls
+     * down.  With "reuse" set no new exception is constructed, which gives
+     * the cost of the unwind alone.
+     */
+    static public int throwAtDepth(int iters, int depth, boolean reuse) {
+        int caught = 0;
+        for (int i = 0; i < iters; i++) {
+            try {
+                recurse(depth, reuse);
+            } catch (CheapException ce) {
+                caught++;
+            }
+        }
+        return caught;
+    }
+
+    static private void recurse(int depth, boolean reuse) {
+        if (depth > 0) {
+            recurse(depth - 1, reuse);
+        } else if (reuse) {
+            throw PREALLOCATED;
+        } else {
+            throw new CheapException("depth");
+        }
+    }
+
+    /*
+     * Make sure the trace still materializes correctly on demand.  This
+     * only holds when the test runs without -Xnostacktrace.
+     */
+    static private void checkTrace() {
+        try {
+            recurse(3, false);
+        } catch (CheapException ce) {
+            StackTraceElement[] trace = ce.getStackTrace();
+            if (trace.length == 0 ||
+                    !trace[0].getMethodName().equals("recurse")) {
+                System.out.println("trace is wrong");
+                return;
+            }
+        }
+        System.out.println("trace ok");
+    }
+
+    /*
+     * Run with -Xstacktracedepth:4.  The trace keeps the innermost frames.
+     */
+    static private void checkTraceDepth() {
+        try {
+            recurse(10, false);
+        } catch (CheapException ce) {
+            StackTraceElement[] trace = ce.getStackTrace();
+            System.out.println("depth limit: " + trace.length +
+                " frames, top is " + trace[0].getMethodName());
+        }
+    }
+
+    /*
+     * Run with -Xnostacktrace:java.lang.NumberFormatException.  Only that
+     * class loses its trace; its superclass keeps one.
+     */
+    static private void checkNoTrace() {
+        int parseFrames = -1;
+        int otherFrames = -1;
+
+        try {
+            Integer.parseInt("not a number");
+        } catch (NumberFormatException nfe) {
+            parseFrames = nfe.getStackTrace().length;
+        }
+        try {
+            throw new IllegalArgumentException("not suppressed");
+        } catch (IllegalArgumentException iae) {
+            otherFrames = iae.getStackTrace().length;
+        }
+
+        System.out.println("no trace: NumberFormatException has " +
+            parseFrames + " frames, IllegalArgumentException has " +
+            (otherFrames > 0 ? "a trace" : "no trace"));
+    }
+}
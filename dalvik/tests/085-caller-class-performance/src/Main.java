@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+    static class Target {
+    }
+
+    static final String NAME = "Main$Target";
+    static final int ITERS = 50000;
+
+    static public void main(String[] args) throws Exception {
+        boolean timing = (args.length >= 1) && args[0].equals("--timing");
+        run(timing);
+    }
+
+    static public void run(boolean timing) throws Exception {
+        ClassLoader loader = Main.class.getClassLoader();
+
+        /* warm up, so the first-time class lookup isn't counted */
+        forNameCaller(100);
+        forNameLoader(100, loader);
+
+        long time0 = System.nanoTime();
+        int count1 = forNameCaller(ITERS);
+        long time1 = System.nanoTime();
+        int count2 = forNameLoader(ITERS, loader);
+        long time2 = System.nanoTime();
+
+        System.out.println("forName: found " + NAME + " " + count1 + " times");
+        System.out.println("forName with loader: found " + NAME + " "
+            + count2 + " times");
+
+        checkLoader();
+
+        if (timing) {
+            System.out.printf("forName: %.3g usec per call\n",
+                (time1 - time0) / (double) count1 / 1000);
+            System.out.printf("forName with loader: %.3g usec per call\n",
+                (time2 - time1) / (double) count2 / 1000);
+            System.out.printf("caller lookup: %.3g usec per call\n",
+                ((time1 - time0) - (time2 - time1)) / (double) ITERS / 1000);
+        }
+    }
+
+    /*
+     * Class.forName(String) has to find the class loader of its caller.
+     */
+    static public int forNameCaller(int iters) throws Exception {
+        int found = 0;
+        for (int i = 0; i < iters; i++) {
+            if (Class.forName(NAME) == Target.class)
+                found++;
+        }
+        return found;
+    }
+
+    /*
+     * Same lookup with the loader supplied, so no stack walk is needed.
+     */
+    static public int forNameLoader(int iters, ClassLoader loader)
+            throws Exception {
+        int found = 0;
+        for (int i = 0; i < iters; i++) {
+            if (Class.forName(NAME, true, loader) == Target.class)
+                found++;
+        }
+        return found;
+    }
+
+    /*
+     * Make sure the caller lookup still sees through reflection.
+     */
+    static public void checkLoader() throws Exception {
+        Object result = Main.class.getMethod("findTarget", (Class[]) null)
+            .invoke(null, (Object[]) null);
+        if (result == Target.class)
+            System.out.println("loader ok");
+        else
+            System.out.println("loader FAILED: " + result);
+    }
+
+    static public Class findTarget() throws Exception {
+        return Class.forName(NAME);
+    }
+}
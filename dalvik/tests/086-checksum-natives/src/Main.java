@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.util.zip.Adler32;
+import java.util.zip.CRC32;
+import java.util.zip.Checksum;
+
+public class Main {
+    static final int ITERS = 1000;
+
+    static public void main(String[] args) throws Exception {
+        boolean timing = (args.length >= 1) && args[0].equals("--timing");
+        run(timing);
+    }
+
+    static public void run(boolean timing) {
+        byte[] digits = "123456789".getBytes();
+
+        System.out.println("crc32: " + check(new CRC32(), digits));
+        System.out.println("adler32: " + check(new Adler32(), digits));
+
+        byte[] buf = new byte[4096];
+        for (int i = 0; i < buf.length; i++)
+            buf[i] = (byte) i;
+
+        long time0 = System.nanoTime();
+        long crc = loop(new CRC32(), buf);
+        long time1 = System.nanoTime();
+        long adler = loop(new Adler32(), buf);
+        long time2 = System.nanoTime();
+
+        System.out.println("crc32 loop: " + Long.toHexString(crc));
+        System.out.println("adler32 loop: " + Long.toHexString(adler));
+
+        try {
+            new CRC32().update(buf, buf.length - 1, 2);
+            System.out.println("no exception");
+        } catch (ArrayIndexOutOfBoundsException aioobe) {
+            System.out.println("caught AIOOBE");
+        }
+
+        if (timing) {
+            System.out.println("CRC32 small updates: "
+                + ((time1 - time0) / ITERS) + "ns per 4K buffer");
+            System.out.println("Adler32 small updates: "
+                + ((time2 - time1) / ITERS) + "ns per 4K buffer");
+        }
+    }
+
+    /*
+     * Returns the checksums of the whole array, of "345" at an offset, and
+     * of a single byte.
+     */
+    static String check(Checksum sum, byte[] digits) {
+        StringBuilder sb = new StringBuilder();
+
+        sum.update(digits, 0, digits.length);
+        sb.append(Long.toHexString(sum.getValue()));
+        sum.reset();
+        sum.update(digits, 2, 3);
+        sb.append(' ').append(Long.toHexString(sum.getValue()));
+        sum.reset();
+        sum.update('A');
+        sb.append(' ').append(Long.toHexString(sum.getValue()));
+        return sb.toString();
+    }
+
+    /*
+     * Feed the buffer through in 64-byte pieces, so the per-call overhead
+     * shows up in the timing.
+     */
+    static long loop(Checksum sum, byte[] buf) {
+        for (int i = 0; i < ITERS; i++) {
+            for (int off = 0; off < buf.length; off += 64)
+                sum.update(buf, off, 64);
+        }
+        return sum.getValue();
+    }
+}
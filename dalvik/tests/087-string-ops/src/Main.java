@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+    static final String FOX = "the quick brown fox jumps over the lazy dog";
+    static final int ITERS = 100000;
+
+    static public void main(String[] args) {
+        boolean timing = (args.length >= 1) && args[0].equals("--timing");
+
+        checkSearch();
+        checkLong();
+        checkHash();
+        checkIgnoreCase();
+
+        if (timing)
+            runTimings();
+    }
+
+    static void checkSearch() {
+        System.out.println("indexOf(String): "
+            + FOX.indexOf("fox") + " "
+            + FOX.indexOf("the", 1) + " "
+            + FOX.indexOf("cat") + " "
+            + FOX.indexOf("") + " "
+            + FOX.indexOf("", 50));
+
+        System.out.println("lastIndexOf(int): "
+            + FOX.lastIndexOf('o') + " "
+            + FOX.lastIndexOf('o', 40) + " "
+            + FOX.lastIndexOf('q', -1) + " "
+            + FOX.lastIndexOf('t') + " "
+            + FOX.lastIndexOf(0x10000 + 't'));
+    }
+
+    /*
+     * Strings long enough to exercise the wide comparison loops, with the
+     * interesting character away from the ends.
+     */
+    static void checkLong() {
+        char[] chars = new char[100];
+        for (int i = 0; i < chars.length; i++)
+            chars[i] = 'x';
+        String allX = new String(chars);
+        chars[77] = 'y';
+        String withY = new String(chars);
+        chars[77] = 'x';
+        chars[50] = 'a';
+        String withA = new String(chars);
+        /* same contents as allX, but a substring of a larger array */
+        String sub = ("z" + allX + "z").substring(1, 101);
+
+        System.out.println("long: "
+            + withY.indexOf('y') + " "
+            + withY.lastIndexOf('x') + " "
+            + allX.compareTo(withA) + " "
+            + withA.compareTo(allX) + " "
+            + allX.equals(sub) + " "
+            + allX.equals(withY));
+    }
+
+    static void checkHash() {
+        String abc = new String(new char[] { 'a', 'b', 'c' });
+        String fox = new String(FOX.toCharArray());
+
+        System.out.println("hashCode: "
+            + abc.hashCode() + " "
+            + (fox.hashCode() == slowHash(FOX)) + " "
+            + (fox.hashCode() == fox.hashCode()));
+    }
+
+    static int slowHash(String str) {
+        int hash = 0;
+        for (int i = 0; i < str.length(); i++)
+            hash = hash * 31 + str.charAt(i);
+        return hash;
+    }
+
+    static void checkIgnoreCase() {
+        System.out.println("equalsIgnoreCase: "
+            + "Hello World".equalsIgnoreCase("hELLO wORLD") + " "
+            + "abc".equalsIgnoreCase("abd") + " "
+            + "\u00e9t\u00e9".equalsIgnoreCase("\u00c9T\u00c9") + " "
+            + "a[".equalsIgnoreCase("A{") + " "
+            + "abc".equalsIgnoreCase(null) + " "
+            + "abc".equalsIgnoreCase("abcd") + " "
+            + FOX.equalsIgnoreCase(FOX.toUpperCase()));
+    }
+
+    static void runTimings() {
+        String longStr = FOX + FOX + FOX + FOX;
+        String longCopy = new String(longStr.toCharArray());
+        String upper = longStr.toUpperCase();
+        int sum = 0;
+
+        long start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += longStr.equals(longCopy) ? 1 : 0;
+        report("equals, 172 chars", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += longStr.compareTo(longCopy);
+        report("compareTo, 172 chars", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += longStr.indexOf('!');
+        report("indexOf(int), miss", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += longStr.lastIndexOf('!');
+        report("lastIndexOf(int), miss", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += longStr.indexOf("lazy cat");
+        report("indexOf(String), miss", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += longStr.hashCode();
+        report("hashCode, cached", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += longStr.equalsIgnoreCase(upper) ? 1 : 0;
+        report("equalsIgnoreCase, 172 chars", start);
+
+        /* keep the loops from being optimized away */
+        if (sum == 42)
+            System.out.println("unlikely");
+    }
+
+    static void report(String what, long start) {
+        long elapsed = System.nanoTime() - start;
+        System.out.println(what + ": " + (elapsed / ITERS) + "ns");
+    }
+}
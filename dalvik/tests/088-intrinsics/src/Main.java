@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+    static final int ITERS = 1000000;
+
+    static public void main(String[] args) {
+        boolean timing = (args.length >= 1) && args[0].equals("--timing");
+
+        check();
+        if (timing)
+            runTimings();
+    }
+
+    static void check() {
+        Object obj = new Object();
+
+        System.out.println("getClass: "
+            + "abc".getClass().getName() + " "
+            + new int[0].getClass().getName() + " "
+            + (obj.getClass() == Object.class));
+
+        System.out.println("currentThread: "
+            + (Thread.currentThread() == Thread.currentThread()));
+
+        System.out.println("identityHashCode: "
+            + System.identityHashCode(null) + " "
+            + (System.identityHashCode(obj) == obj.hashCode()));
+
+        long t0 = System.nanoTime();
+        long t1 = System.nanoTime();
+        System.out.println("nanoTime: " + (t1 >= t0));
+
+        float nanF = Float.intBitsToFloat(0xffc00001);
+        System.out.println("float: "
+            + Float.floatToIntBits(1.0f) + " "
+            + Float.floatToIntBits(nanF) + " "
+            + Float.floatToRawIntBits(nanF) + " "
+            + (Float.intBitsToFloat(0x3f800000) == 1.0f));
+
+        double nanD = Double.longBitsToDouble(0x7ff8000000000001L);
+        System.out.println("double: "
+            + Double.doubleToLongBits(1.0) + " "
+            + Double.doubleToLongBits(nanD) + " "
+            + Double.doubleToRawLongBits(nanD) + " "
+            + (Double.longBitsToDouble(0x3ff0000000000000L) == 1.0));
+    }
+
+    static void runTimings() {
+        Object obj = new Object();
+        long sum = 0;
+
+        long start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += (obj.getClass() == Object.class) ? 1 : 0;
+        report("getClass", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += (Thread.currentThread() != null) ? 1 : 0;
+        report("currentThread", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += System.identityHashCode(obj);
+        report("identityHashCode", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += System.nanoTime();
+        report("nanoTime", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += Float.floatToIntBits((float) i);
+        report("floatToIntBits", start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < ITERS; i++)
+            sum += Double.doubleToLongBits((double) i);
+        report("doubleToLongBits", start);
+
+        /* keep the loops from being optimized away */
+        if (sum == 42)
+            System.out.println("unlikely");
+    }
+
+    static void report(String what, long start) {
+        long elapsed = System.nanoTime() - start;
+        System.out.println(what + ": " + (elapsed / ITERS) + "ns");
+    }
+}
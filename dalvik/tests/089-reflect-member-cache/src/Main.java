@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.lang.reflect.AccessibleObject;
+import java.lang.reflect.Constructor;
+import java.lang.reflect.Field;
+import java.lang.reflect.Member;
+import java.lang.reflect.Method;
+import java.util.Arrays;
+
+public class Main {
+    static class Target {
+        public int publicField;
+        private String privateField;
+        static long staticField;
+
+        public Target() {}
+        private Target(int i) {}
+
+        public void publicMethod(int a, String b) {}
+        private int privateMethod() throws java.io.IOException { return 0; }
+        static void staticMethod() {}
+    }
+
+    /* only ever reflected on by the threads in checkConcurrent */
+    static class Fresh {
+        public int a, b, c;
+        private int d;
+        public Fresh() {}
+        public void m1() {}
+        public void m2(Object o) {}
+        private void m3() {}
+    }
+
+    public static void main(String[] args) throws Exception {
+        checkRepeated();
+        checkPublicOnly();
+        checkCopies();
+        checkConcurrent();
+    }
+
+    /*
+     * Names of the members, sorted so the output doesn't depend on the
+     * order the VM returns them in.
+     */
+    static String names(Member[] members) {
+        String[] names = new String[members.length];
+        for (int i = 0; i < members.length; i++) {
+            if (members[i] instanceof Method) {
+                names[i] = members[i].getName() +
+                    Arrays.toString(((Method) members[i]).getParameterTypes());
+            } else if (members[i] instanceof Constructor) {
+                names[i] = "<init>" + Arrays.toString(
+                    ((Constructor) members[i]).getParameterTypes());
+            } else {
+                names[i] = members[i].getName();
+            }
+        }
+        Arrays.sort(names);
+        return Arrays.toString(names);
+    }
+
+    /*
+     * The same members come back every time, including across a GC.
+     */
+    static void checkRepeated() {
+        Class c = Target.class;
+        String fields = names(c.getDeclaredFields());
+        String methods = names(c.getDeclaredMethods());
+        String ctors = names(c.getDeclaredConstructors());
+
+        System.out.println("fields: " + fields);
+        System.out.println("methods: " + methods);
+        System.out.println("ctors: " + ctors);
+
+        boolean same = true;
+        for (int i = 0; i < 100; i++) {
+            if (i == 50)
+                System.gc();
+            same &= fields.equals(names(c.getDeclaredFields()));
+            same &= methods.equals(names(c.getDeclaredMethods()));
+            same &= ctors.equals(names(c.getDeclaredConstructors()));
+        }
+        System.out.println("repeated: " + (same ? "same" : "DIFFERENT"));
+    }
+
+    /*
+     * The public-only variants are filtered from the same cache.
+     */
+    static void checkPublicOnly() {
+        Class c = Target.class;
+        /* warm the cache with the full set first */
+        c.getDeclaredFields();
+        c.getDeclaredMethods();
+        c.getDeclaredConstructors();
+
+        Field[] fields = c.getFields();
+        System.out.println("public fields: " + names(fields));
+        System.out.println("public ctors: " + names(c.getConstructors()));
+
+        try {
+            c.getMethod("publicMethod", int.class, String.class);
+            System.out.println("getMethod public: found");
+        } catch (NoSuchMethodException nsme) {
+            System.out.println("getMethod public: NOT FOUND");
+        }
+        try {
+            c.getMethod("privateMethod");
+            System.out.println("getMethod private: FOUND");
+        } catch (NoSuchMethodException nsme) {
+            System.out.println("getMethod private: not found");
+        }
+    }
+
+    /*
+     * Each call returns fresh objects, so setAccessible() on one result
+     * must not show up in the next.
+     */
+    static void checkCopies() throws Exception {
+        Class c = Target.class;
+        Field[] f1 = c.getDeclaredFields();
+        Field[] f2 = c.getDeclaredFields();
+        boolean distinct = (f1 != f2);
+        for (int i = 0; i < f1.length; i++) {
+            distinct &= (f1[i] != f2[i]) && f1[i].equals(f2[i]);
+        }
+        System.out.println("fresh objects: " + (distinct ? "yes" : "NO"));
+
+        Method priv = c.getDeclaredMethod("privateMethod");
+        priv.setAccessible(true);
+        Method again = c.getDeclaredMethod("privateMethod");
+        System.out.println("accessible leaked: " + again.isAccessible());
+
+        Class[] params = c.getDeclaredMethod("publicMethod",
+            int.class, String.class).getParameterTypes();
+        params[0] = Object.class;
+        params = c.getDeclaredMethod("publicMethod",
+            int.class, String.class).getParameterTypes();
+        System.out.println("params after change: " + Arrays.toString(params));
+
+        Class[] exceptions = priv.getExceptionTypes();
+        exceptions[0] = null;
+        System.out.println("exceptions after change: " +
+            Arrays.toString(again.getExceptionTypes()));
+
+        Target t = new Target();
+        Field pf = c.getDeclaredField("privateField");
+        pf.setAccessible(true);
+        pf.set(t, "hello");
+        System.out.println("privateField: " + pf.get(t));
+    }
+
+    /*
+     * Threads racing to fill the cache must all see the full set.
+     */
+    static void checkConcurrent() throws Exception {
+        final int THREADS = 8;
+        final String[] results = new String[THREADS];
+        final Object lock = new Object();
+        final int[] ready = new int[1];
+        Thread[] threads = new Thread[THREADS];
+
+        for (int i = 0; i < THREADS; i++) {
+            final int id = i;
+            threads[i] = new Thread() {
+                public void run() {
+                    synchronized (lock) {
+                        ready[0]++;
+                        lock.notifyAll();
+                        while (ready[0] < THREADS) {
+                            try {
+                                lock.wait();
+                            } catch (InterruptedException ie) {
+                            }
+                        }
+                    }
+                    results[id] = names(Fresh.class.getDeclaredMethods()) +
+                        names(Fresh.class.getDeclaredFields()) +
+                        names(Fresh.class.getDeclaredConstructors());
+                }
+            };
+            threads[i].start();
+        }
+        for (int i = 0; i < THREADS; i++)
+            threads[i].join();
+
+        boolean same = true;
+        for (int i = 1; i < THREADS; i++)
+            same &= results[0].equals(results[i]);
+        System.out.println("concurrent: " + (same ? "same" : "DIFFERENT"));
+        System.out.println(results[0]);
+    }
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.lang.annotation.Annotation;
+import java.lang.annotation.Inherited;
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+import java.lang.reflect.AnnotatedElement;
+import java.lang.reflect.Constructor;
+import java.lang.reflect.Field;
+import java.lang.reflect.Method;
+
+public class Main {
+    @Retention(RetentionPolicy.RUNTIME)
+    @interface Marker {}
+
+    @Retention(RetentionPolicy.RUNTIME)
+    @Inherited
+    @interface Tag { String value(); }
+
+    @Retention(RetentionPolicy.CLASS)
+    @interface Invisible {}
+
+    @Tag("base")
+    static class Base {}
+
+    @Marker
+    static class Target extends Base {
+        @Marker @Invisible public int markedField;
+        public int plainField;
+
+        @Tag("ctor") public Target() {}
+        public Target(int i) {}
+
+        @Marker @Tag("method") public void annotated() {}
+        public void plain() {}
+    }
+
+    /* only ever looked at by the threads in checkConcurrent */
+    @Tag("fresh")
+    static class Fresh {
+        @Marker public int f;
+        @Tag("m") public void m() {}
+    }
+
+    /* only ever looked at by checkSupertype */
+    static class Cold {
+        @Marker public void m() {}
+    }
+
+    public static void main(String[] args) throws Exception {
+        Class c = Target.class;
+        AnnotatedElement[] elements = {
+            c,
+            c.getConstructor(),
+            c.getConstructor(int.class),
+            c.getMethod("annotated"),
+            c.getMethod("plain"),
+            c.getField("markedField"),
+            c.getField("plainField"),
+        };
+
+        for (int i = 0; i < elements.length; i++)
+            System.out.println(describe(elements[i]));
+
+        checkRepeated(elements);
+        checkPresent(elements);
+        checkSupertype(Cold.class.getMethod("m"));
+        checkCopies(c.getMethod("annotated"));
+        checkConcurrent();
+    }
+
+    /*
+     * Annotation types and values, in a form that doesn't depend on the
+     * order the VM returns them in.
+     */
+    static String describe(AnnotatedElement element) {
+        Annotation[] annos = element.getAnnotations();
+        boolean marker = false;
+        String tag = null;
+
+        for (int i = 0; i < annos.length; i++) {
+            if (annos[i] instanceof Marker)
+                marker = true;
+            else if (annos[i] instanceof Tag)
+                tag = ((Tag) annos[i]).value();
+            else
+                return "unexpected " + annos[i];
+        }
+        return annos.length + " marker=" + marker + " tag=" + tag;
+    }
+
+    /*
+     * The same annotations come back every time, including across a GC.
+     */
+    static void checkRepeated(AnnotatedElement[] elements) {
+        String[] first = new String[elements.length];
+        for (int i = 0; i < elements.length; i++)
+            first[i] = describe(elements[i]);
+
+        boolean same = true;
+        for (int iter = 0; iter < 200; iter++) {
+            if (iter == 100)
+                System.gc();
+            for (int i = 0; i < elements.length; i++)
+                same &= first[i].equals(describe(elements[i]));
+        }
+        System.out.println("repeated: " + (same ? "same" : "DIFFERENT"));
+    }
+
+    /*
+     * isAnnotationPresent must agree with getAnnotation, before and after
+     * the annotations have been decoded.
+     */
+    static void checkPresent(AnnotatedElement[] elements) {
+        boolean agree = true;
+        for (int i = 0; i < elements.length; i++) {
+            for (int j = 0; j < 2; j++) {
+                agree &= elements[i].isAnnotationPresent(Marker.class) ==
+                    (elements[i].getAnnotation(Marker.class) != null);
+                agree &= elements[i].isAnnotationPresent(Tag.class) ==
+                    (elements[i].getAnnotation(Tag.class) != null);
+                agree &= !elements[i].isAnnotationPresent(Invisible.class);
+            }
+        }
+        System.out.println("present agrees: " + agree);
+
+        /* @Inherited annotations come from the superclass */
+        System.out.println("Base Tag: " + Base.class.isAnnotationPresent(Tag.class));
+        System.out.println("Base Marker: " +
+            Base.class.isAnnotationPresent(Marker.class));
+        System.out.println("Target inherits Tag: " +
+            Target.class.isAnnotationPresent(Tag.class) + " " +
+            Target.class.getAnnotation(Tag.class).value());
+        System.out.println("Target declared: " +
+            Target.class.getDeclaredAnnotations().length);
+    }
+
+    /*
+     * Only the annotation's own type counts as present, whether or not its
+     * annotations have been decoded yet.
+     */
+    static void checkSupertype(Method method) {
+        boolean cold = method.isAnnotationPresent(Annotation.class);
+        method.getAnnotations();
+        boolean warm = method.isAnnotationPresent(Annotation.class);
+        System.out.println("Annotation present: " + cold + " " + warm +
+            ", Marker present: " + method.isAnnotationPresent(Marker.class));
+    }
+
+    /*
+     * Changing a returned array must not change the next one.
+     */
+    static void checkCopies(Method method) {
+        Annotation[] a1 = method.getDeclaredAnnotations();
+        Annotation[] a2 = method.getDeclaredAnnotations();
+        boolean shared = true;
+        for (int i = 0; i < a1.length; i++)
+            shared &= a1[i].equals(a2[i]);
+
+        System.out.println("fresh array: " + (a1 != a2) +
+            ", equal contents: " + shared);
+
+        a1[0] = null;
+        a1 = method.getDeclaredAnnotations();
+        System.out.println("after change: " + a1.length + " " +
+            (a1[0] != null));
+    }
+
+    /*
+     * Threads racing to decode the same annotations must all see them.
+     */
+    static void checkConcurrent() throws Exception {
+        final int THREADS = 8;
+        final String[] results = new String[THREADS];
+        final Object lock = new Object();
+        final int[] ready = new int[1];
+        Thread[] threads = new Thread[THREADS];
+
+        for (int i = 0; i < THREADS; i++) {
+            final int id = i;
+            threads[i] = new Thread() {
+                public void run() {
+                    synchronized (lock) {
+                        ready[0]++;
+                        lock.notifyAll();
+                        while (ready[0] < THREADS) {
+                            try {
+                                lock.wait();
+                            } catch (InterruptedException ie) {
+                            }
+                        }
+                    }
+                    try {
+                        Class c = Fresh.class;
+                        results[id] = describe(c) + " / " +
+                            describe(c.getField("f")) + " / " +
+                            describe(c.getMethod("m"));
+                    } catch (Exception ex) {
+                        results[id] = ex.toString();
+                    }
+                }
+            };
+            threads[i].start();
+        }
+        for (int i = 0; i < THREADS; i++)
+            threads[i].join();
+
+        boolean same = true;
+        for (int i = 1; i < THREADS; i++)
+            same &= results[0].equals(results[i]);
+        System.out.println("concurrent: " + (same ? "same" : "DIFFERENT"));
+        System.out.println(results[0]);
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.util.ArrayList;
+
+/**
+ * Build Strings while a GC is running with deduplication on.
+ */
+public class Main {
+    static final int LENGTH = 64;
+    static final int ROUNDS = 200;
+
+    static volatile boolean done;
+
+    /*
+     * Finished, hashed Strings of LENGTH chars: k 'x's and then NULs.
+     * That's what the array of a String of 'x's looks like while its
+     * constructor is part way through filling it in.
+     */
+    static String[] templates = new String[LENGTH];
+
+    public static void main(String[] args) throws Exception {
+        for (int k = 0; k < LENGTH; k++) {
+            templates[k] = new String(templateChars(k));
+            templates[k].hashCode();
+        }
+
+        Thread gc = new Thread() {
+            public void run() {
+                while (!done) {
+                    System.gc();
+                    Thread.yield();
+                }
+            }
+        };
+        gc.start();
+
+        char[] chars = new char[LENGTH];
+        byte[] bytes = new byte[LENGTH];
+        for (int i = 0; i < LENGTH; i++) {
+            chars[i] = 'x';
+            bytes[i] = (byte) 'x';
+        }
+        String expected = new String(chars);
+
+        ArrayList<String> fromChars = new ArrayList<String>();
+        ArrayList<String> fromHibyte = new ArrayList<String>();
+        ArrayList<String> fromLatin1 = new ArrayList<String>();
+        ArrayList<String> fromUtf8 = new ArrayList<String>();
+        try {
+            for (int i = 0; i < ROUNDS; i++) {
+                fromChars.add(new String(chars));
+                fromHibyte.add(new String(bytes, 0, 0, LENGTH));
+                fromLatin1.add(new String(bytes, 0, LENGTH, "ISO-8859-1"));
+                fromUtf8.add(new String(bytes, "UTF-8"));
+            }
+        } finally {
+            done = true;
+            gc.join();
+        }
+        System.gc();
+
+        check("char[]", fromChars, expected);
+        check("byte[] hibyte", fromHibyte, expected);
+        check("byte[] ISO-8859-1", fromLatin1, expected);
+        check("byte[] UTF-8", fromUtf8, expected);
+
+        boolean ok = true;
+        for (int k = 0; k < LENGTH; k++) {
+            if (!sameChars(templates[k], templateChars(k))
+                    || templates[k].hashCode() != hash(templates[k])) {
+                System.out.println("templates: " + k + " changed");
+                ok = false;
+            }
+        }
+        if (ok)
+            System.out.println("templates: ok");
+
+        /* the ones that were built should still compare equal */
+        ok = true;
+        for (int i = 0; i < ROUNDS; i++) {
+            String s = fromLatin1.get(i);
+            if (!s.equals(fromChars.get(i)) || !s.equals(fromUtf8.get(i))) {
+                System.out.println("shared: " + i + " differs");
+                ok = false;
+                break;
+            }
+        }
+        if (ok)
+            System.out.println("shared: ok");
+    }
+
+    static char[] templateChars(int k) {
+        char[] chars = new char[LENGTH];
+        for (int i = 0; i < k; i++)
+            chars[i] = 'x';
+        return chars;
+    }
+
+    static void check(String what, ArrayList<String> strings,
+            String expected) {
+        char[] expectedChars = expected.toCharArray();
+        int expectedHash = hash(expected);
+
+        for (int i = 0; i < strings.size(); i++) {
+            String s = strings.get(i);
+            if (!sameChars(s, expectedChars)) {
+                System.out.println(what + ": " + i + " has the wrong chars");
+                return;
+            }
+            if (s.hashCode() != expectedHash) {
+                System.out.println(what + ": " + i + " has the wrong hash");
+                return;
+            }
+        }
+        System.out.println(what + ": ok");
+    }
+
+    static boolean sameChars(String s, char[] chars) {
+        if (s.length() != chars.length)
+            return false;
+        for (int i = 0; i < chars.length; i++) {
+            if (s.charAt(i) != chars[i])
+                return false;
+        }
+        return true;
+    }
+
+    /* String.hashCode(), without the cached value */
+    static int hash(String s) {
+        int h = 0;
+        for (int i = 0; i < s.length(); i++)
+            h = 31 * h + s.charAt(i);
+        return h;
+    }
+}
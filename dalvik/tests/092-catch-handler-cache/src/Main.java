@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Throw exceptions of several classes through the same try blocks and
+ * check which handler catches each one.
+ */
+public class Main {
+    static class BaseException extends Exception {}
+    static class MidException extends BaseException {}
+    static class LeafException extends MidException {}
+    static class OtherException extends RuntimeException {}
+
+    static final int ITERATIONS = 1000;
+
+    /* what we throw, in the order we cycle through them */
+    static final String[] KINDS = {
+        "none", "leaf", "mid", "base", "other", "npe", "error",
+        "leaf-rethrown",
+    };
+
+    static int finallyCount;
+
+    public static void main(String[] args) {
+        String[] firstResult = new String[KINDS.length];
+        int[] sameCount = new int[KINDS.length];
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            for (int k = 0; k < KINDS.length; k++) {
+                String result;
+                try {
+                    result = route(k);
+                } catch (Error err) {
+                    result = "caller";
+                }
+
+                if (firstResult[k] == null)
+                    firstResult[k] = result;
+                if (result.equals(firstResult[k]))
+                    sameCount[k]++;
+            }
+        }
+
+        for (int k = 0; k < KINDS.length; k++) {
+            System.out.println(KINDS[k] + ": caught by " + firstResult[k] +
+                (sameCount[k] == ITERATIONS ? "" :
+                    " (only " + sameCount[k] + " times)"));
+        }
+        System.out.println("finally ran " + finallyCount + " times");
+    }
+
+    /*
+     * The inner try has two typed handlers; the outer one has a typed
+     * handler, a RuntimeException handler, and a finally.  Anything else
+     * goes back to the caller.
+     */
+    static String route(int kind) {
+        try {
+            try {
+                throwKind(kind);
+                return "none";
+            } catch (LeafException le) {
+                if (KINDS[kind].equals("leaf-rethrown"))
+                    throw new OtherException();
+                return "leaf handler";
+            } catch (MidException me) {
+                return "mid handler";
+            }
+        } catch (BaseException be) {
+            return "base handler";
+        } catch (RuntimeException re) {
+            return re.getClass().getName() + " handler";
+        } finally {
+            finallyCount++;
+        }
+    }
+
+    static void throwKind(int kind) throws BaseException {
+        String name = KINDS[kind];
+
+        if (name.equals("leaf") || name.equals("leaf-rethrown"))
+            throw new LeafException();
+        if (name.equals("mid"))
+            throw new MidException();
+        if (name.equals("base"))
+            throw new BaseException();
+        if (name.equals("other"))
+            throw new OtherException();
+        if (name.equals("npe")) {
+            Object obj = null;
+            obj.hashCode();
+        }
+        if (name.equals("error"))
+            throw new AssertionError();
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.lang.reflect.Constructor;
+import java.lang.reflect.Method;
+
+/**
+ * Call through Method.invoke and Constructor.newInstance.
+ */
+public class Main {
+    static final int ITERATIONS = 100;
+
+    public static void main(String[] args) throws Exception {
+        checkArguments();
+        checkReturns();
+        checkConstructor();
+        checkAccess();
+    }
+
+    static String describe(Object[] args) {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < args.length; i++) {
+            if (i != 0)
+                sb.append(", ");
+            sb.append(args[i] == null ?
+                "null" : args[i].getClass().getSimpleName());
+        }
+        return sb.toString();
+    }
+
+    /*
+     * Each box type is unboxed and widened to the parameter type, and
+     * anything that can't be is rejected.
+     */
+    static void checkArguments() throws Exception {
+        Method sum = Target.class.getMethod("sum",
+            int.class, long.class, double.class);
+        Object[][] good = {
+            { 1, 2L, 3.0 },
+            { (byte) 1, 2, 3.0f },
+            { (short) 1, (byte) 2, 3L },
+            { 'a', 'b', 'c' },
+        };
+        Object[][] bad = {
+            { 1L, 2L, 3.0 },
+            { true, 2L, 3.0 },
+            { null, 2L, 3.0 },
+            { 1, 2L, "3" },
+        };
+
+        for (Object[] args : good) {
+            System.out.println("sum(" + describe(args) + ") = " +
+                sum.invoke(null, args));
+        }
+        for (Object[] args : bad) {
+            try {
+                sum.invoke(null, args);
+                System.out.println("sum(" + describe(args) + ") accepted");
+            } catch (IllegalArgumentException iae) {
+                System.out.println("sum(" + describe(args) + ") rejected");
+            }
+        }
+    }
+
+    /*
+     * Each primitive result comes back in the right box.
+     */
+    static void checkReturns() throws Exception {
+        String[] names = {
+            "retBoolean", "retChar", "retByte", "retShort", "retInt",
+            "retLong", "retFloat", "retDouble", "retVoid",
+        };
+
+        for (String name : names) {
+            Object result = Target.class.getMethod(name).invoke(null);
+            System.out.println(name + " -> " + (result == null ? "null" :
+                result.getClass().getSimpleName() + " " + result));
+        }
+    }
+
+    static void checkConstructor() throws Exception {
+        Constructor<Target> ctor =
+            Target.class.getConstructor(int.class, long.class);
+
+        System.out.println("new Target(7, (byte) 3).total() = " +
+            ctor.newInstance(7, (byte) 3).total());
+        System.out.println("new Target('A', 1).total() = " +
+            ctor.newInstance('A', 1).total());
+        try {
+            ctor.newInstance(1.0, 2L);
+            System.out.println("new Target(1.0, 2L) accepted");
+        } catch (IllegalArgumentException iae) {
+            System.out.println("new Target(1.0, 2L) rejected");
+        }
+    }
+
+    /*
+     * Target may call its private method; we may not, until we ask.
+     */
+    static void checkAccess() throws Exception {
+        Method secret = Target.class.getDeclaredMethod("secret");
+        int allowed = 0;
+        int denied = 0;
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            if (Target.callSecret().equals("secret"))
+                allowed++;
+            try {
+                secret.invoke(null);
+            } catch (IllegalAccessException iae) {
+                denied++;
+            }
+        }
+        System.out.println("from Target: " + allowed + " allowed");
+        System.out.println("from Main: " + denied + " denied");
+
+        secret.setAccessible(true);
+        System.out.println("after setAccessible: " + secret.invoke(null));
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Methods and a constructor for Main to call through reflection.
+ */
+public class Target {
+    private final long total;
+
+    public Target(int a, long b) {
+        total = a + b;
+    }
+
+    public long total() {
+        return total;
+    }
+
+    public static double sum(int i, long l, double d) {
+        return i + l + d;
+    }
+
+    public static boolean retBoolean() { return true; }
+    public static char retChar() { return 'x'; }
+    public static byte retByte() { return -1; }
+    public static short retShort() { return 1000; }
+    public static int retInt() { return 123456; }
+    public static long retLong() { return 1L << 40; }
+    public static float retFloat() { return 1.5f; }
+    public static double retDouble() { return 0.25; }
+    public static void retVoid() {}
+
+    private static String secret() {
+        return "secret";
+    }
+
+    /*
+     * Call our own private method through reflection, which is allowed.
+     */
+    public static String callSecret() throws Exception {
+        return (String) Target.class.getDeclaredMethod("secret").invoke(null);
+    }
+}
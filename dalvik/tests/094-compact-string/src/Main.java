@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Strings whose chars all fit in Latin-1 are stored a byte per char.  A
+ * String can still end up with a char[] full of Latin-1 chars (say, a
+ * substring of one that isn't all Latin-1), so check that the two forms
+ * agree everywhere they meet.
+ */
+public class Main {
+    /* a byte per char: every char here is Latin-1 */
+    static final String LATIN1 = "caf\u00e9 au lait \u00ff";
+
+    public static void main(String[] args) {
+        /* the same chars, sharing the char[] of a string that needs one */
+        String wide = (LATIN1 + "\u20ac").substring(0, LATIN1.length());
+        String built = new StringBuilder().append("caf\u00e9").append(' ')
+                .append("au lait \u00ff").toString();
+
+        check("equals", LATIN1.equals(wide) && wide.equals(LATIN1)
+                && built.equals(wide));
+        check("compareTo", LATIN1.compareTo(wide) == 0
+                && "caf\u00e9".compareTo("caf\u20ac") < 0
+                && wide.compareTo("caf") > 0);
+        check("hashCode", LATIN1.hashCode() == wide.hashCode()
+                && LATIN1.hashCode() == hash(LATIN1));
+        check("intern", wide.intern() == LATIN1 && built.intern() == LATIN1);
+        check("charAt", wide.charAt(3) == '\u00e9'
+                && LATIN1.charAt(LATIN1.length() - 1) == '\u00ff');
+        check("indexOf", LATIN1.indexOf('\u00e9') == 3
+                && LATIN1.indexOf('\u20ac') == -1
+                && LATIN1.indexOf('\u01e9') == -1
+                && LATIN1.indexOf("lait") == wide.indexOf("lait")
+                && LATIN1.indexOf(wide.substring(4, 8)) == 4
+                && LATIN1.lastIndexOf('a') == 9
+                && LATIN1.lastIndexOf("a", 8) == 5);
+        check("equalsIgnoreCase", LATIN1.equalsIgnoreCase("CAF\u00c9 AU LAIT \u0178")
+                && wide.equalsIgnoreCase(LATIN1.toUpperCase())
+                && !LATIN1.equalsIgnoreCase("CAFE AU LAIT \u00ff"));
+        check("regionMatches", LATIN1.regionMatches(5, wide, 5, 7)
+                && wide.regionMatches(true, 0, "CAF\u00c9", 0, 4));
+        check("concat", (LATIN1 + "\u20ac").equals(wide + "\u20ac")
+                && (LATIN1 + "\u20ac").charAt(LATIN1.length()) == '\u20ac'
+                && (LATIN1 + wide).length() == 2 * LATIN1.length());
+        check("replace", LATIN1.replace('a', '\u0101').indexOf('\u0101') == 1
+                && LATIN1.replace('\u00e9', 'e').equals("cafe au lait \u00ff")
+                && LATIN1.replace('\u20ac', 'e') == LATIN1
+                && wide.replace("lait", "\u20ac").equals("caf\u00e9 au \u20ac \u00ff"));
+        check("case", LATIN1.toUpperCase().equals("CAF\u00c9 AU LAIT \u0178")
+                && "\u00df".toUpperCase().equals("SS")
+                && "CAF\u00c9".toLowerCase().equals("caf\u00e9"));
+        check("trim", ("  " + LATIN1 + " ").trim().equals(wide));
+        check("toCharArray", new String(LATIN1.toCharArray()).equals(wide)
+                && String.valueOf('\u00e9').equals(wide.substring(3, 4))
+                && String.valueOf('\u20ac').charAt(0) == '\u20ac');
+        check("getBytes", sameBytes(LATIN1, "ISO-8859-1")
+                && sameBytes(LATIN1, "UTF-8")
+                && sameBytes(LATIN1 + "\u20ac", "UTF-8"));
+        check("contentEquals", LATIN1.contentEquals(new StringBuffer(wide))
+                && wide.contentEquals(new StringBuffer(LATIN1)));
+    }
+
+    static void check(String what, boolean ok) {
+        System.out.println(what + (ok ? ": ok" : ": FAILED"));
+    }
+
+    /* String.hashCode(), without the cached value */
+    static int hash(String s) {
+        int h = 0;
+        for (int i = 0; i < s.length(); i++)
+            h = 31 * h + s.charAt(i);
+        return h;
+    }
+
+    /* the encoding round-trips, from either form */
+    static boolean sameBytes(String s, String encoding) {
+        try {
+            byte[] bytes = s.getBytes(encoding);
+            String decoded = new String(bytes, encoding);
+            return decoded.equals(s)
+                    && java.util.Arrays.equals(bytes,
+                            new String(s.toCharArray()).getBytes(encoding));
+        } catch (java.io.UnsupportedEncodingException ex) {
+            return false;
+        }
+    }
+}
@@ -11,6 +11,7 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES := TraceDump.c
 LOCAL_CFLAGS += -O0 -g
 LOCAL_C_INCLUDES += dalvik/vm
+LOCAL_LDLIBS += -lpthread
 LOCAL_MODULE := dmtracedump
 include $(BUILD_HOST_EXECUTABLE)
 
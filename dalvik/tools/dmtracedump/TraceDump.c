@@ -32,6 +32,9 @@
 #include <time.h>
 #include <errno.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* Version number in the key file.  Version 1 uses one byte for the thread id.
  * Version 2 uses two bytes for the thread ids.
@@ -242,6 +245,11 @@ typedef struct Options {
     int outputHtml;
     const char* sortableUrl;
     int threshold;
+    const char* foldedFileName;
+    const char* jsonFileName;
+    int summary;
+    int numWorkers;
+    unsigned int jsonMinUsec;
 } Options;
 
 typedef struct TraceData {
@@ -1010,13 +1018,31 @@ void sortMethodList(DataKeys* pKeys)
         compareMethods);
 }
 
+/*
+ * Check for the "*end" line that finishes the key section.
+ */
+static int hasKeyEnd(const char* data, long len)
+{
+    static const char kEndLine[] = "\n*end\n";
+    const int endLen = sizeof(kEndLine) - 1;
+    long i;
+
+    if (len >= endLen-1 && strncmp(data, kEndLine+1, endLen-1) == 0)
+        return 1;
+    for (i = 0; i + endLen <= len; i++) {
+        if (data[i] == '\n' && strncmp(data + i, kEndLine, endLen) == 0)
+            return 1;
+    }
+    return 0;
+}
+
 /*
  * Parse the key section, and return a copy of the parsed contents.
  */
 DataKeys* parseKeys(FILE *fp, int verbose)
 {
     DataKeys* pKeys = NULL;
-    long offset;
+    long offset, alloc;
     int i;
 
     pKeys = (DataKeys*) calloc(1, sizeof(DataKeys));
@@ -1024,31 +1050,42 @@ DataKeys* parseKeys(FILE *fp, int verbose)
         goto fail;
 
     /*
-     * We load the entire file into memory.  We do this, rather than memory-
-     * mapping it, because we want to change some whitespace to NULs.
+     * We read the key section into memory, rather than memory-mapping it,
+     * because we want to change some whitespace to NULs.  We stop once we
+     * have the "*end" line; the data section after it can be huge.
      */
-    if (fseek(fp, 0L, SEEK_END) != 0) {
-        perror("fseek");
-        goto fail;
-    }
-    pKeys->fileLen = ftell(fp);
-    if (pKeys->fileLen == 0) {
-        fprintf(stderr, "Key file is empty.\n");
-        goto fail;
-    }
     rewind(fp);
-
-    pKeys->fileData = (char*) malloc(pKeys->fileLen);
+    alloc = 65536;
+    pKeys->fileData = (char*) malloc(alloc);
     if (pKeys->fileData == NULL) {
-        fprintf(stderr, "ERROR: unable to alloc %ld bytes\n", pKeys->fileLen);
+        fprintf(stderr, "ERROR: unable to alloc %ld bytes\n", alloc);
         goto fail;
     }
-
-    if (fread(pKeys->fileData, 1, pKeys->fileLen, fp) != (size_t) pKeys->fileLen)
-    {
-        fprintf(stderr, "ERROR: unable to read %ld bytes from trace file\n",
-            pKeys->fileLen);
-        goto fail;
+    pKeys->fileLen = 0;
+    while (!hasKeyEnd(pKeys->fileData, pKeys->fileLen)) {
+        size_t got;
+
+        if (pKeys->fileLen == alloc) {
+            char* newData;
+
+            alloc *= 2;
+            newData = (char*) realloc(pKeys->fileData, alloc);
+            if (newData == NULL) {
+                fprintf(stderr, "ERROR: unable to alloc %ld bytes\n", alloc);
+                goto fail;
+            }
+            pKeys->fileData = newData;
+        }
+        got = fread(pKeys->fileData + pKeys->fileLen, 1,
+            alloc - pKeys->fileLen, fp);
+        if (got == 0) {
+            if (pKeys->fileLen == 0)
+                fprintf(stderr, "Key file is empty.\n");
+            else
+                fprintf(stderr, "ERROR: no end of key section in trace file\n");
+            goto fail;
+        }
+        pKeys->fileLen += got;
     }
 
     offset = 0;
@@ -1174,7 +1211,7 @@ MethodEntry* lookupMethod(DataKeys* pKeys, unsigned int methodId)
 
     /* Create cache if it doesn't already exist */
     if (pKeys->methodCache == NULL) {
-        pKeys->methodCache = (int*) malloc(sizeof(int) * METHOD_CACHE_SIZE);
+        pKeys->methodCache = (int*) calloc(METHOD_CACHE_SIZE, sizeof(int));
     }
 
     // ids are multiples of 4, so shift
@@ -3518,9 +3555,790 @@ void createDiff(DataKeys* d1, uint64_t sum1, DataKeys* d2, uint64_t sum2)
     if (gOptions.outputHtml) printf("</body></html\n");
 }
 
+/*
+ * ===========================================================================
+ *      Streaming reports (-F, -J, -S)
+ * ===========================================================================
+ */
+
+/*
+ * These reports make one pass over the data section and keep only a call
+ * tree per thread, so memory grows with the number of distinct call paths
+ * rather than with the size of the trace.  The data section is mapped and
+ * read by several workers at once.  Each thread's records must be handled
+ * in order, but the VM interleaves threads a chunk at a time, so each
+ * worker scans the whole mapping and takes the threads whose id hashes to
+ * it.  Scanning is cheap next to the tree updates, which are what we split.
+ *
+ * Trace times are 32 bits of usec per record, which wraps after about 71
+ * minutes; we extend them to 64 bits per thread.
+ */
+
+#define STREAM_MAX_WORKERS  64
+#define STREAM_MAX_THREADS  65536           /* 2-byte thread ids */
+#define STREAM_NO_NODE      0xffffffffU
+#define STREAM_TOP_METHODS  25
+
+/*
+ * One distinct call path: a method called from the path "parent".
+ */
+typedef struct StreamNode {
+    unsigned int parent;
+    unsigned int method;            /* index into DataKeys.methods */
+    uint64_t    exclusive;
+    uint64_t    inclusive;
+    unsigned int calls;
+} StreamNode;
+
+typedef struct StreamFrame {
+    unsigned int node;
+    uint64_t    entryTime;
+} StreamFrame;
+
+typedef struct StreamThread {
+    int         threadId;
+    unsigned int root;              /* node for the thread itself */
+    unsigned int lastRawTime;
+    uint64_t    lastEventTime;
+    uint64_t    startTime;
+    uint64_t    numEvents;
+    int         top;
+    int         maxDepth;
+    int         stackSize;
+    StreamFrame* stack;
+} StreamThread;
+
+/*
+ * Per-method totals, summed over threads.
+ */
+typedef struct StreamMethod {
+    uint64_t    exclusive;
+    uint64_t    inclusive;          /* not counting recursive calls */
+    uint64_t    calls;
+    int         active;             /* frames on the current stack */
+} StreamMethod;
+
+typedef struct StreamWorker {
+    struct StreamState* state;
+    int         index;
+    pthread_t   handle;
+
+    StreamNode* nodes;
+    unsigned int numNodes;
+    unsigned int nodesAlloc;
+    unsigned int* nodeHash;         /* open-addressed, node index + 1 */
+    unsigned int nodeHashSize;
+
+    StreamThread** threads;         /* indexed by thread id */
+    StreamMethod* methods;
+    uint64_t    badExits;
+
+    FILE*       jsonFp;             /* temp file of "X" events */
+    int         jsonEvents;
+} StreamWorker;
+
+typedef struct StreamState {
+    DataKeys*   keys;
+    const unsigned char* data;
+    size_t      dataLen;
+    int         recSize;
+    int         numWorkers;
+    unsigned int* methodHash;       /* methodId -> method index + 1 */
+    unsigned int methodHashSize;
+    StreamWorker workers[STREAM_MAX_WORKERS];
+} StreamState;
+
+static void* streamAlloc(void* ptr, size_t size)
+{
+    ptr = realloc(ptr, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "ERROR: unable to alloc %zd bytes\n", size);
+        exit(1);
+    }
+    return ptr;
+}
+
+static unsigned int streamHash(unsigned int a, unsigned int b)
+{
+    uint64_t key = ((uint64_t) a << 32) | b;
+    return (unsigned int) ((key * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+/*
+ * Build a read-only methodId lookup the workers can share.  (The cache
+ * in lookupMethod() is written on every miss.)
+ */
+static void streamBuildMethodHash(StreamState* state)
+{
+    DataKeys* pKeys = state->keys;
+    unsigned int mask;
+    int i;
+
+    state->methodHashSize = 16;
+    while (state->methodHashSize < (unsigned int) pKeys->numMethods * 2)
+        state->methodHashSize *= 2;
+    mask = state->methodHashSize - 1;
+    state->methodHash = (unsigned int*) calloc(state->methodHashSize,
+        sizeof(unsigned int));
+    if (state->methodHash == NULL) {
+        fprintf(stderr, "ERROR: unable to alloc method table\n");
+        exit(1);
+    }
+
+    for (i = UNKNOWN_INDEX + 1; i < pKeys->numMethods; i++) {
+        unsigned int idx = streamHash(pKeys->methods[i].methodId, 0) & mask;
+        while (state->methodHash[idx] != 0)
+            idx = (idx + 1) & mask;
+        state->methodHash[idx] = i + 1;
+    }
+}
+
+static unsigned int streamLookupMethod(const StreamState* state,
+    unsigned int methodId)
+{
+    unsigned int mask = state->methodHashSize - 1;
+    unsigned int idx = streamHash(methodId, 0) & mask;
+
+    while (state->methodHash[idx] != 0) {
+        unsigned int method = state->methodHash[idx] - 1;
+        if (state->keys->methods[method].methodId == methodId)
+            return method;
+        idx = (idx + 1) & mask;
+    }
+    return UNKNOWN_INDEX;
+}
+
+/*
+ * Find or add the node for "method" called from "parent".
+ */
+static unsigned int streamNode(StreamWorker* worker, unsigned int parent,
+    unsigned int method)
+{
+    unsigned int mask, idx;
+    StreamNode* pNode;
+
+    if ((worker->numNodes + 1) * 4 > worker->nodeHashSize * 3) {
+        unsigned int i;
+
+        free(worker->nodeHash);
+        worker->nodeHashSize = (worker->nodeHashSize == 0) ?
+            4096 : worker->nodeHashSize * 2;
+        worker->nodeHash = (unsigned int*) calloc(worker->nodeHashSize,
+            sizeof(unsigned int));
+        if (worker->nodeHash == NULL) {
+            fprintf(stderr, "ERROR: unable to alloc call tree\n");
+            exit(1);
+        }
+        mask = worker->nodeHashSize - 1;
+        for (i = 0; i < worker->numNodes; i++) {
+            idx = streamHash(worker->nodes[i].parent,
+                    worker->nodes[i].method) & mask;
+            while (worker->nodeHash[idx] != 0)
+                idx = (idx + 1) & mask;
+            worker->nodeHash[idx] = i + 1;
+        }
+    }
+
+    mask = worker->nodeHashSize - 1;
+    idx = streamHash(parent, method) & mask;
+    while (worker->nodeHash[idx] != 0) {
+        pNode = &worker->nodes[worker->nodeHash[idx] - 1];
+        if (pNode->parent == parent && pNode->method == method)
+            return worker->nodeHash[idx] - 1;
+        idx = (idx + 1) & mask;
+    }
+
+    if (worker->numNodes == worker->nodesAlloc) {
+        worker->nodesAlloc = (worker->nodesAlloc == 0) ?
+            4096 : worker->nodesAlloc * 2;
+        worker->nodes = (StreamNode*) streamAlloc(worker->nodes,
+            worker->nodesAlloc * sizeof(StreamNode));
+    }
+    pNode = &worker->nodes[worker->numNodes];
+    memset(pNode, 0, sizeof(StreamNode));
+    pNode->parent = parent;
+    pNode->method = method;
+    worker->nodeHash[idx] = worker->numNodes + 1;
+    return worker->numNodes++;
+}
+
+static StreamThread* streamThread(StreamWorker* worker, int threadId,
+    unsigned int rawTime)
+{
+    StreamThread* pThread = worker->threads[threadId];
+
+    if (pThread == NULL) {
+        pThread = (StreamThread*) streamAlloc(NULL, sizeof(StreamThread));
+        memset(pThread, 0, sizeof(StreamThread));
+        pThread->threadId = threadId;
+        /* a root's "method" is its thread id, which can't clash */
+        pThread->root = streamNode(worker, STREAM_NO_NODE, threadId);
+        pThread->lastRawTime = rawTime;
+        pThread->lastEventTime = pThread->startTime = rawTime;
+        worker->threads[threadId] = pThread;
+    }
+    return pThread;
+}
+
+static const char* streamThreadName(const DataKeys* pKeys, int threadId)
+{
+    int i;
+
+    for (i = 0; i < pKeys->numThreads; i++) {
+        if (pKeys->threads[i].threadId == threadId)
+            return pKeys->threads[i].threadName;
+    }
+    return NULL;
+}
+
+/*
+ * Write a string as a JSON string literal.
+ */
+static void streamJsonString(FILE* fp, const char* str)
+{
+    fputc('"', fp);
+    for ( ; *str != '\0'; str++) {
+        unsigned char ch = *str;
+        if (ch == '"' || ch == '\\')
+            fprintf(fp, "\\%c", ch);
+        else if (ch < 0x20)
+            fprintf(fp, "\\u%04x", ch);
+        else
+            fputc(ch, fp);
+    }
+    fputc('"', fp);
+}
+
+static void streamJsonMethod(FILE* fp, const MethodEntry* method)
+{
+    char buf[HTML_BUFSIZE];
+
+    if (method->methodName != NULL) {
+        snprintf(buf, sizeof(buf), "%s.%s", method->className,
+            method->methodName);
+        streamJsonString(fp, buf);
+    } else {
+        streamJsonString(fp, method->className);
+    }
+}
+
+/*
+ * Pop the top frame, charging its time to its node.
+ */
+static void streamPop(StreamWorker* worker, StreamThread* pThread,
+    uint64_t currentTime)
+{
+    StreamFrame* pFrame = &pThread->stack[--pThread->top];
+    StreamNode* pNode = &worker->nodes[pFrame->node];
+    StreamMethod* pMethod = &worker->methods[pNode->method];
+    uint64_t elapsed = currentTime - pFrame->entryTime;
+
+    pNode->inclusive += elapsed;
+    if (--pMethod->active == 0)
+        pMethod->inclusive += elapsed;
+
+    if (worker->jsonFp != NULL && elapsed >= gOptions.jsonMinUsec) {
+        FILE* fp = worker->jsonFp;
+
+        fprintf(fp, "{\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%" PRIu64
+            ",\"dur\":%" PRIu64 ",\"name\":", pThread->threadId,
+            pFrame->entryTime, elapsed);
+        streamJsonMethod(fp, &worker->state->keys->methods[pNode->method]);
+        fputs("},\n", fp);
+        worker->jsonEvents++;
+    }
+}
+
+static void streamRecord(StreamWorker* worker, int threadId,
+    unsigned int methodVal, unsigned int rawTime)
+{
+    StreamThread* pThread = streamThread(worker, threadId, rawTime);
+    unsigned int method = streamLookupMethod(worker->state,
+        METHOD_ID(methodVal));
+    uint64_t currentTime;
+    unsigned int current;
+
+    currentTime = pThread->lastEventTime +
+        (unsigned int) (rawTime - pThread->lastRawTime);
+    pThread->lastRawTime = rawTime;
+    pThread->numEvents++;
+
+    /* charge the time since the last event to whatever was running */
+    current = (pThread->top > 0) ?
+        pThread->stack[pThread->top-1].node : pThread->root;
+    worker->nodes[current].exclusive += currentTime - pThread->lastEventTime;
+    if (pThread->top > 0) {
+        worker->methods[worker->nodes[current].method].exclusive +=
+            currentTime - pThread->lastEventTime;
+    }
+    pThread->lastEventTime = currentTime;
+
+    if (METHOD_ACTION(methodVal) == METHOD_TRACE_ENTER) {
+        StreamFrame* pFrame;
+        unsigned int node = streamNode(worker, current, method);
+
+        if (pThread->top == pThread->stackSize) {
+            pThread->stackSize = (pThread->stackSize == 0) ?
+                64 : pThread->stackSize * 2;
+            pThread->stack = (StreamFrame*) streamAlloc(pThread->stack,
+                pThread->stackSize * sizeof(StreamFrame));
+        }
+        pFrame = &pThread->stack[pThread->top++];
+        pFrame->node = node;
+        pFrame->entryTime = currentTime;
+        if (pThread->top > pThread->maxDepth)
+            pThread->maxDepth = pThread->top;
+
+        worker->nodes[node].calls++;
+        worker->methods[method].calls++;
+        worker->methods[method].active++;
+    } else {
+        int i;
+
+        /*
+         * Pop down to the method that exited.  An exit we have no entry
+         * for (the call started before tracing did) is ignored, rather
+         * than treated as fatal.
+         */
+        for (i = pThread->top - 1; i >= 0; i--) {
+            if (worker->nodes[pThread->stack[i].node].method == method)
+                break;
+        }
+        if (i < 0) {
+            worker->badExits++;
+            return;
+        }
+        if (i != pThread->top - 1)
+            worker->badExits++;
+        while (pThread->top > i)
+            streamPop(worker, pThread, currentTime);
+    }
+}
+
+static void* streamWorkerMain(void* arg)
+{
+    StreamWorker* worker = (StreamWorker*) arg;
+    StreamState* state = worker->state;
+    const unsigned char* ptr = state->data;
+    const unsigned char* end = ptr +
+        (state->dataLen / state->recSize) * state->recSize;
+    int numWorkers = state->numWorkers;
+    int index = worker->index;
+    int i;
+
+    /* the thread id is 1 byte in version 1 traces, 2 bytes after */
+    int idLen = state->recSize - 8;
+
+    for ( ; ptr < end; ptr += state->recSize) {
+        const unsigned char* rest = ptr + idLen;
+        int threadId;
+        unsigned int methodVal, rawTime;
+
+        threadId = (idLen == 1) ? ptr[0] : (ptr[0] | (ptr[1] << 8));
+        if (threadId % numWorkers != index)
+            continue;
+        methodVal = rest[0] | (rest[1] << 8) | (rest[2] << 16) |
+            ((unsigned int) rest[3] << 24);
+        rawTime = rest[4] | (rest[5] << 8) | (rest[6] << 16) |
+            ((unsigned int) rest[7] << 24);
+
+        streamRecord(worker, threadId, methodVal, rawTime);
+    }
+
+    /* anything still running ran until the thread's last event */
+    for (i = 0; i < STREAM_MAX_THREADS; i++) {
+        StreamThread* pThread = worker->threads[i];
+        if (pThread == NULL)
+            continue;
+        while (pThread->top > 0)
+            streamPop(worker, pThread, pThread->lastEventTime);
+        worker->nodes[pThread->root].inclusive =
+            pThread->lastEventTime - pThread->startTime;
+    }
+
+    return NULL;
+}
+
+static FILE* streamOpenOutput(const char* fileName)
+{
+    FILE* fp;
+
+    if (strcmp(fileName, "-") == 0)
+        return stdout;
+    fp = fopen(fileName, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: unable to open '%s': %s\n", fileName,
+            strerror(errno));
+    }
+    return fp;
+}
+
+static void streamCloseOutput(FILE* fp)
+{
+    if (fp != stdout)
+        fclose(fp);
+    else
+        fflush(fp);
+}
+
+/*
+ * Write "thread;outer;...;inner usecs" for every call path that used any
+ * time of its own.
+ */
+static void streamWriteFolded(StreamState* state, FILE* fp)
+{
+    DataKeys* pKeys = state->keys;
+    unsigned int* path = NULL;
+    int pathAlloc = 0;
+    int w;
+
+    for (w = 0; w < state->numWorkers; w++) {
+        StreamWorker* worker = &state->workers[w];
+        unsigned int i;
+
+        for (i = 0; i < worker->numNodes; i++) {
+            unsigned int node;
+            const char* threadName;
+            int depth = 0;
+
+            if (worker->nodes[i].exclusive == 0)
+                continue;
+
+            for (node = i; worker->nodes[node].parent != STREAM_NO_NODE;
+                node = worker->nodes[node].parent)
+            {
+                if (depth == pathAlloc) {
+                    pathAlloc = (pathAlloc == 0) ? 256 : pathAlloc * 2;
+                    path = (unsigned int*) streamAlloc(path,
+                        pathAlloc * sizeof(unsigned int));
+                }
+                path[depth++] = worker->nodes[node].method;
+            }
+
+            /* a root's "method" is its thread id */
+            threadName = streamThreadName(pKeys, worker->nodes[node].method);
+            if (threadName != NULL)
+                fputs(threadName, fp);
+            else
+                fprintf(fp, "thread-%u", worker->nodes[node].method);
+            while (depth > 0) {
+                const MethodEntry* method = &pKeys->methods[path[--depth]];
+
+                if (method->methodName != NULL)
+                    fprintf(fp, ";%s.%s", method->className,
+                        method->methodName);
+                else
+                    fprintf(fp, ";%s", method->className);
+            }
+            fprintf(fp, " %" PRIu64 "\n", worker->nodes[i].exclusive);
+        }
+    }
+    free(path);
+}
+
+/*
+ * Write a Chrome trace-event file from the workers' events.  Events are
+ * "X" (complete) events, so they don't need to be in time order.
+ */
+static int streamWriteJson(StreamState* state, FILE* fp)
+{
+    DataKeys* pKeys = state->keys;
+    char buf[8192];
+    int w, i;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", fp);
+    for (w = 0; w < state->numWorkers; w++) {
+        StreamWorker* worker = &state->workers[w];
+        size_t got;
+
+        rewind(worker->jsonFp);
+        while ((got = fread(buf, 1, sizeof(buf), worker->jsonFp)) > 0) {
+            if (fwrite(buf, 1, got, fp) != got) {
+                fprintf(stderr, "ERROR: failed writing trace events\n");
+                return -1;
+            }
+        }
+    }
+    for (i = 0; i < pKeys->numThreads; i++) {
+        fprintf(fp, "{\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+            "\"name\":\"thread_name\",\"args\":{\"name\":",
+            pKeys->threads[i].threadId);
+        streamJsonString(fp, pKeys->threads[i].threadName);
+        fputs("}},\n", fp);
+    }
+    fputs("{\"ph\":\"M\",\"pid\":0,\"name\":\"process_name\","
+        "\"args\":{\"name\":", fp);
+    streamJsonString(fp, gOptions.traceFileName);
+    fputs("}}\n]}\n", fp);
+    return 0;
+}
+
+static StreamMethod* gStreamTotals;
+
+static int compareStreamExclusive(const void* a, const void* b)
+{
+    uint64_t timeA = gStreamTotals[*(const int*) a].exclusive;
+    uint64_t timeB = gStreamTotals[*(const int*) b].exclusive;
+
+    if (timeA != timeB)
+        return (timeA > timeB) ? -1 : 1;
+    return *(const int*) a - *(const int*) b;
+}
+
+static int compareStreamInclusive(const void* a, const void* b)
+{
+    uint64_t timeA = gStreamTotals[*(const int*) a].inclusive;
+    uint64_t timeB = gStreamTotals[*(const int*) b].inclusive;
+
+    if (timeA != timeB)
+        return (timeA > timeB) ? -1 : 1;
+    return *(const int*) a - *(const int*) b;
+}
+
+static void streamPrintMethods(StreamState* state, int* order, int count,
+    uint64_t sumThreadTime, int exclusive)
+{
+    DataKeys* pKeys = state->keys;
+    int i;
+
+    printf("\nTop methods by %s time:\n", exclusive ? "exclusive" : "inclusive");
+    printf("%12s %6s %12s %12s  %s\n",
+        "usecs", "%", "excl usecs", "calls", "method");
+    for (i = 0; i < count && i < STREAM_TOP_METHODS; i++) {
+        const StreamMethod* pTotal = &gStreamTotals[order[i]];
+        const MethodEntry* method = &pKeys->methods[order[i]];
+        uint64_t time = exclusive ? pTotal->exclusive : pTotal->inclusive;
+
+        if (time == 0)
+            break;
+        printf("%12" PRIu64 " %6.2f %12" PRIu64 " %12" PRIu64 "  ",
+            time, (sumThreadTime != 0) ? 100.0 * time / sumThreadTime : 0.0,
+            pTotal->exclusive, pTotal->calls);
+        if (method->methodName != NULL)
+            printf("%s.%s %s\n", method->className, method->methodName,
+                method->signature);
+        else
+            printf("%s\n", method->className);
+    }
+}
+
+static void streamWriteSummary(StreamState* state, uint64_t numRecords)
+{
+    DataKeys* pKeys = state->keys;
+    uint64_t sumThreadTime = 0, badExits = 0;
+    unsigned int numPaths = 0;
+    int* order;
+    int w, i, count;
+
+    gStreamTotals = (StreamMethod*) calloc(pKeys->numMethods,
+        sizeof(StreamMethod));
+    order = (int*) malloc(pKeys->numMethods * sizeof(int));
+    if (gStreamTotals == NULL || order == NULL) {
+        fprintf(stderr, "ERROR: unable to alloc summary\n");
+        exit(1);
+    }
+
+    printf("Threads:\n");
+    printf("%6s %12s %12s %6s  %s\n", "id", "usecs", "events", "depth", "name");
+    for (w = 0; w < state->numWorkers; w++) {
+        StreamWorker* worker = &state->workers[w];
+
+        for (i = 0; i < pKeys->numMethods; i++) {
+            gStreamTotals[i].exclusive += worker->methods[i].exclusive;
+            gStreamTotals[i].inclusive += worker->methods[i].inclusive;
+            gStreamTotals[i].calls += worker->methods[i].calls;
+        }
+        numPaths += worker->numNodes;
+        badExits += worker->badExits;
+    }
+    for (i = 0; i < STREAM_MAX_THREADS; i++) {
+        const StreamThread* pThread =
+            state->workers[i % state->numWorkers].threads[i];
+        const char* threadName;
+        uint64_t elapsed;
+
+        if (pThread == NULL)
+            continue;
+        elapsed = pThread->lastEventTime - pThread->startTime;
+        sumThreadTime += elapsed;
+        threadName = streamThreadName(pKeys, i);
+        printf("%6d %12" PRIu64 " %12" PRIu64 " %6d  %s\n", i, elapsed,
+            pThread->numEvents, pThread->maxDepth,
+            (threadName != NULL) ? threadName : "(unknown)");
+    }
+
+    count = 0;
+    for (i = UNKNOWN_INDEX; i < pKeys->numMethods; i++) {
+        if (gStreamTotals[i].calls != 0)
+            order[count++] = i;
+    }
+    qsort(order, count, sizeof(int), compareStreamExclusive);
+    streamPrintMethods(state, order, count, sumThreadTime, 1);
+    qsort(order, count, sizeof(int), compareStreamInclusive);
+    streamPrintMethods(state, order, count, sumThreadTime, 0);
+
+    printf("\nTotal: %" PRIu64 " usecs in all threads, %" PRIu64
+        " records, %d methods called, %u call paths, %" PRIu64
+        " unmatched exits\n", sumThreadTime, numRecords, count, numPaths,
+        badExits);
+
+    free(order);
+    free(gStreamTotals);
+    gStreamTotals = NULL;
+}
+
+/*
+ * Produce the streaming reports asked for with -F, -J and -S.
+ */
+int streamTrace(void)
+{
+    StreamState* state = NULL;
+    DataHeader dataHeader;
+    FILE* traceFp = NULL;
+    FILE* foldedFp = NULL;
+    FILE* jsonFp = NULL;
+    void* map = MAP_FAILED;
+    struct stat st;
+    long dataStart;
+    int w, result = 1;
+
+    traceFp = fopen(gOptions.traceFileName, "r");
+    if (traceFp == NULL) {
+        fprintf(stderr, "ERROR: unable to open '%s': %s\n",
+            gOptions.traceFileName, strerror(errno));
+        goto bail;
+    }
+
+    state = (StreamState*) calloc(1, sizeof(StreamState));
+    if (state == NULL)
+        goto bail;
+    if ((state->keys = parseKeys(traceFp, 0)) == NULL)
+        goto bail;
+    if (parseDataHeader(traceFp, &dataHeader) < 0 ||
+        dataHeader.magic != 0x574f4c53)
+    {
+        fprintf(stderr, "ERROR: bad data section header\n");
+        goto bail;
+    }
+    dataStart = ftell(traceFp);
+
+    if (fstat(fileno(traceFp), &st) != 0 || st.st_size < dataStart) {
+        fprintf(stderr, "ERROR: unable to stat trace file\n");
+        goto bail;
+    }
+    state->dataLen = st.st_size - dataStart;
+    if (state->dataLen != 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+            fileno(traceFp), 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "ERROR: unable to map trace file: %s\n",
+                strerror(errno));
+            goto bail;
+        }
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        state->data = (const unsigned char*) map + dataStart;
+    }
+    state->recSize = (versionNumber == 1) ? 9 : 10;
+    streamBuildMethodHash(state);
+
+    if (gOptions.foldedFileName != NULL &&
+        (foldedFp = streamOpenOutput(gOptions.foldedFileName)) == NULL)
+        goto bail;
+    if (gOptions.jsonFileName != NULL &&
+        (jsonFp = streamOpenOutput(gOptions.jsonFileName)) == NULL)
+        goto bail;
+
+    state->numWorkers = gOptions.numWorkers;
+    if (state->numWorkers <= 0)
+        state->numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (state->numWorkers <= 0)
+        state->numWorkers = 1;
+    if (state->numWorkers > STREAM_MAX_WORKERS)
+        state->numWorkers = STREAM_MAX_WORKERS;
+
+    for (w = 0; w < state->numWorkers; w++) {
+        StreamWorker* worker = &state->workers[w];
+
+        worker->state = state;
+        worker->index = w;
+        worker->threads = (StreamThread**) calloc(STREAM_MAX_THREADS,
+            sizeof(StreamThread*));
+        worker->methods = (StreamMethod*) calloc(state->keys->numMethods,
+            sizeof(StreamMethod));
+        if (worker->threads == NULL || worker->methods == NULL) {
+            fprintf(stderr, "ERROR: unable to alloc worker state\n");
+            goto bail;
+        }
+        if (jsonFp != NULL && (worker->jsonFp = tmpfile()) == NULL) {
+            fprintf(stderr, "ERROR: unable to create temp file: %s\n",
+                strerror(errno));
+            goto bail;
+        }
+    }
+    for (w = 0; w < state->numWorkers; w++) {
+        if (pthread_create(&state->workers[w].handle, NULL, streamWorkerMain,
+                &state->workers[w]) != 0)
+        {
+            /* do the rest here */
+            fprintf(stderr, "WARNING: unable to start worker thread\n");
+            state->workers[w].handle = pthread_self();
+        }
+    }
+    for (w = 0; w < state->numWorkers; w++) {
+        if (pthread_equal(state->workers[w].handle, pthread_self()))
+            streamWorkerMain(&state->workers[w]);
+        else
+            pthread_join(state->workers[w].handle, NULL);
+    }
+
+    if (foldedFp != NULL)
+        streamWriteFolded(state, foldedFp);
+    if (jsonFp != NULL && streamWriteJson(state, jsonFp) != 0)
+        goto bail;
+    if (gOptions.summary)
+        streamWriteSummary(state, state->dataLen / state->recSize);
+    result = 0;
+
+bail:
+    if (foldedFp != NULL)
+        streamCloseOutput(foldedFp);
+    if (jsonFp != NULL)
+        streamCloseOutput(jsonFp);
+    if (state != NULL) {
+        for (w = 0; w < state->numWorkers; w++) {
+            StreamWorker* worker = &state->workers[w];
+            int i;
+
+            if (worker->threads != NULL) {
+                for (i = 0; i < STREAM_MAX_THREADS; i++) {
+                    if (worker->threads[i] != NULL) {
+                        free(worker->threads[i]->stack);
+                        free(worker->threads[i]);
+                    }
+                }
+            }
+            if (worker->jsonFp != NULL)
+                fclose(worker->jsonFp);
+            free(worker->threads);
+            free(worker->methods);
+            free(worker->nodes);
+            free(worker->nodeHash);
+        }
+        free(state->methodHash);
+        freeDataKeys(state->keys);
+        free(state);
+    }
+    if (map != MAP_FAILED)
+        munmap(map, st.st_size);
+    if (traceFp != NULL)
+        fclose(traceFp);
+    return result;
+}
+
 int usage(const char *program)
 {
     fprintf(stderr, "usage: %s [-ho] [-s sortable] [-d trace-file-name] [-g outfile] [-f filter-file] trace-file-name\n", program);
+    fprintf(stderr, "       %s [-S] [-F folded-file] [-J json-file] [-m usecs] [-j workers] trace-file-name\n", program);
     fprintf(stderr, "  -d trace-file-name  - Diff with this trace\n");
     fprintf(stderr, "  -g outfile          - Write graph to 'outfile'\n");
     fprintf(stderr, "  -f filter-file      - Filter functions as specified in file\n");
@@ -3529,6 +4347,12 @@ int usage(const char *program)
     fprintf(stderr, "  -o                  - Dump the dmtrace file instead of profiling\n");
     fprintf(stderr, "  -s                  - URL base to where the sortable javascript file\n");
     fprintf(stderr, "  -t threshold        - Threshold percentage for including nodes in the graph\n");
+    fprintf(stderr, "Streaming reports, in one pass over the trace:\n");
+    fprintf(stderr, "  -S                  - Print a summary of threads and top methods\n");
+    fprintf(stderr, "  -F folded-file      - Write folded stacks for flame graphs ('-' for stdout)\n");
+    fprintf(stderr, "  -J json-file        - Write Chrome trace-event JSON ('-' for stdout)\n");
+    fprintf(stderr, "  -m usecs            - Leave calls shorter than this out of the JSON\n");
+    fprintf(stderr, "  -j workers          - Number of worker threads (default: one per CPU)\n");
     return 2;
 }
 
@@ -3536,7 +4360,7 @@ int usage(const char *program)
 int parseOptions(int argc, char **argv)
 {
     while (1) {
-        int opt = getopt(argc, argv, "d:hg:kos:t:f:");
+        int opt = getopt(argc, argv, "d:hg:kos:t:f:SF:J:m:j:");
         if (opt == -1)
             break;
         switch (opt) {
@@ -3564,6 +4388,21 @@ int parseOptions(int argc, char **argv)
             case 't':
                 gOptions.threshold = atoi(optarg);
                 break;
+            case 'S':
+                gOptions.summary = 1;
+                break;
+            case 'F':
+                gOptions.foldedFileName = optarg;
+                break;
+            case 'J':
+                gOptions.jsonFileName = optarg;
+                break;
+            case 'm':
+                gOptions.jsonMinUsec = strtoul(optarg, NULL, 0);
+                break;
+            case 'j':
+                gOptions.numWorkers = atoi(optarg);
+                break;
             default:
                 return 1;
         }
@@ -3594,6 +4433,12 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    if (gOptions.summary || gOptions.foldedFileName != NULL ||
+        gOptions.jsonFileName != NULL)
+    {
+        return streamTrace();
+    }
+
     uint64_t sumThreadTime = 0;
 
     Filter** filters = NULL;
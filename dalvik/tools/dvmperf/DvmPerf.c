@@ -0,0 +1,1028 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Put Java frames into Linux "perf" samples of a VM run with -Xperfshadow,
+ * and write the result as folded stacks for flame graph tools.
+ *
+ * "perf script" unwinds and symbolizes the native stacks, but to perf the
+ * interpreter is just dvmInterpret() and friends.  The Java frames each
+ * activation was running are in its PerfShadow (see vm/PerfMap.h), which
+ * is on the native stack, so it's in the stack copy perf keeps for each
+ * sample when recording with "--call-graph dwarf".  We read those copies
+ * straight from perf.data, match them to the "perf script" samples by
+ * thread and time, and splice the Java frames in after the dvmInterpret
+ * frame they belong to.  Method addresses are named from the
+ * /tmp/perf-<pid>.methods file the VM writes.
+ *
+ * Typical use:
+ *
+ *   perf record --call-graph dwarf,16384 -p <pid>
+ *   perf script -F tid,time,ip,sym --ns > perf.txt
+ *   dvmperf -m /tmp/perf-<pid>.methods perf.data perf.txt > out.folded
+ */
+#define NOT_VM
+#include "PerfMap.h"        // from VM header
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef uint8_t  u1;
+typedef uint16_t u2;
+typedef uint32_t u4;
+typedef uint64_t u8;
+
+#ifndef FALSE
+# define FALSE 0
+# define TRUE (!FALSE)
+#endif
+
+/* the native frame the Java frames of an activation go after */
+#define kInterpEntrySymbol  "dvmInterpret"
+
+/* longest "perf script" line we expect */
+#define kMaxLineLen         4096
+
+/* deepest native stack we keep */
+#define kMaxNativeFrames    512
+
+/*
+ * perf.data definitions, from the kernel's perf_event.h and perf's
+ * util/header.h.  We only use the fields we need.
+ */
+#define PERF_MAGIC              0x32454c4946524550ULL   /* "PERFILE2" */
+
+#define PERF_RECORD_SAMPLE      9
+
+enum {
+    PERF_SAMPLE_IP              = 1U << 0,
+    PERF_SAMPLE_TID             = 1U << 1,
+    PERF_SAMPLE_TIME            = 1U << 2,
+    PERF_SAMPLE_ADDR            = 1U << 3,
+    PERF_SAMPLE_READ            = 1U << 4,
+    PERF_SAMPLE_CALLCHAIN       = 1U << 5,
+    PERF_SAMPLE_ID              = 1U << 6,
+    PERF_SAMPLE_CPU             = 1U << 7,
+    PERF_SAMPLE_PERIOD          = 1U << 8,
+    PERF_SAMPLE_STREAM_ID       = 1U << 9,
+    PERF_SAMPLE_RAW             = 1U << 10,
+    PERF_SAMPLE_BRANCH_STACK    = 1U << 11,
+    PERF_SAMPLE_REGS_USER       = 1U << 12,
+    PERF_SAMPLE_STACK_USER      = 1U << 13,
+    PERF_SAMPLE_IDENTIFIER      = 1U << 16,
+};
+
+enum {
+    PERF_FORMAT_TOTAL_TIME_ENABLED  = 1U << 0,
+    PERF_FORMAT_TOTAL_TIME_RUNNING  = 1U << 1,
+    PERF_FORMAT_ID                  = 1U << 2,
+    PERF_FORMAT_GROUP               = 1U << 3,
+    PERF_FORMAT_LOST                = 1U << 4,
+};
+
+#define PERF_SAMPLE_BRANCH_HW_INDEX (1U << 17)
+
+/* offsets into perf_event_attr */
+#define kAttrOffSize            4
+#define kAttrOffSampleType      24
+#define kAttrOffReadFormat      32
+#define kAttrOffBranchType      72
+#define kAttrOffRegsUser        80
+#define kAttrMinSize            64      /* PERF_ATTR_SIZE_VER0 */
+
+typedef struct PerfFileSection {
+    u8      offset;
+    u8      size;
+} PerfFileSection;
+
+typedef struct PerfFileHeader {
+    u8      magic;
+    u8      size;
+    u8      attrSize;
+    PerfFileSection attrs;
+    PerfFileSection data;
+    PerfFileSection eventTypes;
+} PerfFileHeader;
+
+/*
+ * What we need to know about one event to pick its samples apart.
+ */
+typedef struct PerfAttr {
+    u8      sampleType;
+    u8      readFormat;
+    u8      branchSampleType;
+    u8      regsUser;
+    u8*     ids;
+    int     numIds;
+} PerfAttr;
+
+/*
+ * A named Method, from the methods file.
+ */
+typedef struct MethodName {
+    u8      addr;
+    char*   name;
+} MethodName;
+
+/*
+ * The shadows found in one sample's stack copy, innermost activation
+ * first.  The frames are in "gFramePool", each shadow stored as a count,
+ * a "truncated" flag, and that many method addresses, innermost first.
+ */
+typedef struct SampleShadows {
+    u4      tid;
+    u8      time;
+    u4      numShadows;
+    size_t  poolOffset;
+} SampleShadows;
+
+/*
+ * A folded stack and its sample count.
+ */
+typedef struct FoldedStack {
+    struct FoldedStack* next;
+    u4      count;
+    char    stack[1];
+} FoldedStack;
+
+static MethodName* gMethods;
+static int gNumMethods;
+
+static SampleShadows* gSamples;         /* open-addressed hash table */
+static size_t gSamplesSize;             /* power of 2 */
+static size_t gNumSamples;
+
+static u8* gFramePool;
+static size_t gFramePoolLen;
+static size_t gFramePoolAlloc;
+
+static FoldedStack** gFolded;           /* chained hash table */
+static size_t gFoldedSize = 65536;
+static size_t gNumFolded;
+
+/*
+ * ===========================================================================
+ *      Utility
+ * ===========================================================================
+ */
+
+static void* xmalloc(size_t size)
+{
+    void* ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "dvmperf: out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static void* xcalloc(size_t count, size_t size)
+{
+    void* ptr = calloc(count, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "dvmperf: out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static u4 hashString(const char* str)
+{
+    u4 hash = 0;
+
+    while (*str != '\0')
+        hash = hash * 31 + (u1) *str++;
+    return hash;
+}
+
+static int popCount(u8 val)
+{
+    int count = 0;
+
+    while (val != 0) {
+        val &= val - 1;
+        count++;
+    }
+    return count;
+}
+
+/*
+ * ===========================================================================
+ *      Methods file
+ * ===========================================================================
+ */
+
+static int compareMethodName(const void* vone, const void* vtwo)
+{
+    const MethodName* one = (const MethodName*) vone;
+    const MethodName* two = (const MethodName*) vtwo;
+
+    if (one->addr != two->addr)
+        return (one->addr < two->addr) ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Read "<hex addr> <hex size> <name>" lines.
+ */
+static int readMethods(const char* fileName)
+{
+    char line[kMaxLineLen];
+    int alloc = 0;
+    int i, j;
+    FILE* fp;
+
+    fp = fopen(fileName, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "dvmperf: can't open '%s': %s\n",
+            fileName, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        unsigned long long addr;
+        unsigned int size;
+        int nameStart;
+        char* nl;
+
+        if (sscanf(line, "%llx %x %n", &addr, &size, &nameStart) < 2)
+            continue;
+        nl = strchr(line, '\n');
+        if (nl != NULL)
+            *nl = '\0';
+
+        if (gNumMethods == alloc) {
+            alloc = (alloc == 0) ? 4096 : alloc * 2;
+            gMethods = (MethodName*) realloc(gMethods,
+                alloc * sizeof(MethodName));
+            if (gMethods == NULL) {
+                fprintf(stderr, "dvmperf: out of memory\n");
+                exit(1);
+            }
+        }
+        gMethods[gNumMethods].addr = addr;
+        gMethods[gNumMethods].name = strdup(line + nameStart);
+        gNumMethods++;
+    }
+    fclose(fp);
+
+    /* the VM may name a class's methods more than once */
+    qsort(gMethods, gNumMethods, sizeof(MethodName), compareMethodName);
+    for (i = j = 0; i < gNumMethods; i++) {
+        if (j > 0 && gMethods[j-1].addr == gMethods[i].addr) {
+            free(gMethods[i].name);
+            continue;
+        }
+        gMethods[j++] = gMethods[i];
+    }
+    gNumMethods = j;
+
+    return 0;
+}
+
+static const char* lookupMethod(u8 addr)
+{
+    MethodName key;
+    const MethodName* found;
+
+    key.addr = addr;
+    found = (const MethodName*) bsearch(&key, gMethods, gNumMethods,
+        sizeof(MethodName), compareMethodName);
+    return (found != NULL) ? found->name : NULL;
+}
+
+/*
+ * ===========================================================================
+ *      perf.data
+ * ===========================================================================
+ */
+
+static u4 hashSample(u4 tid, u8 time)
+{
+    u8 hash = (time ^ ((u8) tid << 32)) * 0x9e3779b97f4a7c15ULL;
+    return (u4) (hash >> 32);
+}
+
+static SampleShadows* findSample(u4 tid, u8 time, int doAdd)
+{
+    size_t mask = gSamplesSize - 1;
+    size_t idx;
+
+    if (doAdd && (gNumSamples + 1) * 4 > gSamplesSize * 3) {
+        SampleShadows* old = gSamples;
+        size_t oldSize = gSamplesSize;
+        size_t i;
+
+        gSamplesSize = (oldSize == 0) ? 4096 : oldSize * 2;
+        gSamples = (SampleShadows*) xcalloc(gSamplesSize,
+            sizeof(SampleShadows));
+        mask = gSamplesSize - 1;
+        for (i = 0; i < oldSize; i++) {
+            if (old[i].numShadows == 0)
+                continue;
+            idx = hashSample(old[i].tid, old[i].time) & mask;
+            while (gSamples[idx].numShadows != 0)
+                idx = (idx + 1) & mask;
+            gSamples[idx] = old[i];
+        }
+        free(old);
+    }
+    if (gSamplesSize == 0)
+        return NULL;
+
+    idx = hashSample(tid, time) & mask;
+    while (gSamples[idx].numShadows != 0) {
+        if (gSamples[idx].tid == tid && gSamples[idx].time == time)
+            return &gSamples[idx];
+        idx = (idx + 1) & mask;
+    }
+    if (!doAdd)
+        return NULL;
+
+    gSamples[idx].tid = tid;
+    gSamples[idx].time = time;
+    gNumSamples++;
+    return &gSamples[idx];
+}
+
+static void poolAdd(u8 val)
+{
+    if (gFramePoolLen == gFramePoolAlloc) {
+        gFramePoolAlloc = (gFramePoolAlloc == 0) ? 65536 : gFramePoolAlloc * 2;
+        gFramePool = (u8*) realloc(gFramePool, gFramePoolAlloc * sizeof(u8));
+        if (gFramePool == NULL) {
+            fprintf(stderr, "dvmperf: out of memory\n");
+            exit(1);
+        }
+    }
+    gFramePool[gFramePoolLen++] = val;
+}
+
+/*
+ * Find the shadows in a sample's copy of the user stack.  The copy starts
+ * at the stack pointer, so the innermost activation comes first.
+ */
+static void scanStack(u4 tid, u8 time, const u1* stack, size_t len)
+{
+    const u8 magic = kPerfShadowMagic;
+    size_t poolStart = gFramePoolLen;
+    u4 numShadows = 0;
+    size_t off = 0;
+
+    while (off + sizeof(PerfShadow) <= len) {
+        PerfShadow shadow;
+        u4 i;
+
+        if (memcmp(stack + off, &magic, sizeof(magic)) != 0) {
+            off += 4;
+            continue;
+        }
+        memcpy(&shadow, stack + off, sizeof(shadow));
+        if (shadow.depth == 0 || shadow.valid == 0 ||
+            shadow.valid > kPerfShadowFrames || shadow.valid > shadow.depth)
+        {
+            off += 4;
+            continue;
+        }
+
+        poolAdd(shadow.valid);
+        poolAdd(shadow.valid < shadow.depth);
+        for (i = 0; i < shadow.valid; i++) {
+            u4 slot = (shadow.depth - 1 - i) & (kPerfShadowFrames-1);
+            poolAdd(shadow.method[slot]);
+        }
+        numShadows++;
+        off += sizeof(PerfShadow);
+    }
+
+    if (numShadows != 0) {
+        SampleShadows* pSample = findSample(tid, time, TRUE);
+        pSample->numShadows = numShadows;
+        pSample->poolOffset = poolStart;
+    }
+}
+
+/*
+ * Pick apart one PERF_RECORD_SAMPLE.  Returns FALSE if it's malformed.
+ */
+#define NEED(_len)  do { if ((size_t) (end - ptr) < (size_t) (_len)) return FALSE; } while (0)
+#define SKIP(_len)  do { NEED(_len); ptr += (_len); } while (0)
+#define READ8(_dst) do { NEED(8); memcpy(&(_dst), ptr, 8); ptr += 8; } while (0)
+
+static int parseSample(const PerfAttr* attrs, int numAttrs,
+    const u1* ptr, const u1* end)
+{
+    const PerfAttr* pAttr = &attrs[0];
+    u8 type, val;
+    u4 tid = 0;
+    u8 time = 0;
+
+    if (numAttrs > 1 && (attrs[0].sampleType & PERF_SAMPLE_IDENTIFIER)) {
+        int i, j;
+
+        if (end - ptr < 8)
+            return FALSE;
+        memcpy(&val, ptr, 8);
+        for (i = 0; i < numAttrs; i++) {
+            for (j = 0; j < attrs[i].numIds; j++) {
+                if (attrs[i].ids[j] == val)
+                    break;
+            }
+            if (j < attrs[i].numIds) {
+                pAttr = &attrs[i];
+                break;
+            }
+        }
+    }
+    type = pAttr->sampleType;
+
+    if (type & PERF_SAMPLE_IDENTIFIER)
+        SKIP(8);
+    if (type & PERF_SAMPLE_IP)
+        SKIP(8);
+    if (type & PERF_SAMPLE_TID) {
+        NEED(8);
+        memcpy(&tid, ptr + 4, 4);
+        ptr += 8;
+    }
+    if (type & PERF_SAMPLE_TIME)
+        READ8(time);
+    if (type & PERF_SAMPLE_ADDR)
+        SKIP(8);
+    if (type & PERF_SAMPLE_ID)
+        SKIP(8);
+    if (type & PERF_SAMPLE_STREAM_ID)
+        SKIP(8);
+    if (type & PERF_SAMPLE_CPU)
+        SKIP(8);
+    if (type & PERF_SAMPLE_PERIOD)
+        SKIP(8);
+    if (type & PERF_SAMPLE_READ) {
+        u8 fmt = pAttr->readFormat;
+        int valueLen = 8 + ((fmt & PERF_FORMAT_ID) ? 8 : 0) +
+            ((fmt & PERF_FORMAT_LOST) ? 8 : 0);
+        int timesLen = ((fmt & PERF_FORMAT_TOTAL_TIME_ENABLED) ? 8 : 0) +
+            ((fmt & PERF_FORMAT_TOTAL_TIME_RUNNING) ? 8 : 0);
+
+        if (fmt & PERF_FORMAT_GROUP) {
+            READ8(val);
+            SKIP(timesLen);
+            NEED(val * valueLen);
+            SKIP(val * valueLen);
+        } else {
+            SKIP(valueLen + timesLen);
+        }
+    }
+    if (type & PERF_SAMPLE_CALLCHAIN) {
+        READ8(val);
+        NEED(val * 8);
+        SKIP(val * 8);
+    }
+    if (type & PERF_SAMPLE_RAW) {
+        u4 rawLen;
+
+        NEED(4);
+        memcpy(&rawLen, ptr, 4);
+        SKIP(4 + (size_t) rawLen);
+    }
+    if (type & PERF_SAMPLE_BRANCH_STACK) {
+        READ8(val);
+        if (pAttr->branchSampleType & PERF_SAMPLE_BRANCH_HW_INDEX)
+            SKIP(8);
+        NEED(val * 24);
+        SKIP(val * 24);
+    }
+    if (type & PERF_SAMPLE_REGS_USER) {
+        READ8(val);
+        if (val != 0)
+            SKIP(popCount(pAttr->regsUser) * 8);
+    }
+    if (type & PERF_SAMPLE_STACK_USER) {
+        u8 size, dynSize;
+        const u1* stack;
+
+        READ8(size);
+        stack = ptr;
+        SKIP(size);
+        if (size != 0) {
+            READ8(dynSize);
+            if (dynSize < size)
+                size = dynSize;
+            scanStack(tid, time, stack, size);
+        }
+    }
+
+    return TRUE;
+}
+
+#undef NEED
+#undef SKIP
+#undef READ8
+
+/*
+ * Read the user stack copies out of perf.data.
+ */
+static int readPerfData(const char* fileName)
+{
+    PerfFileHeader hdr;
+    PerfAttr* attrs = NULL;
+    const u1* base;
+    struct stat st;
+    int numAttrs = 0, numWithStack = 0;
+    size_t off, end;
+    int fd, i, result = -1;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "dvmperf: can't open '%s': %s\n",
+            fileName, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    if ((size_t) st.st_size < sizeof(hdr)) {
+        fprintf(stderr, "dvmperf: '%s' is too short\n", fileName);
+        close(fd);
+        return -1;
+    }
+    base = (const u1*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "dvmperf: can't map '%s': %s\n",
+            fileName, strerror(errno));
+        return -1;
+    }
+
+    memcpy(&hdr, base, sizeof(hdr));
+    if (hdr.magic != PERF_MAGIC) {
+        fprintf(stderr, "dvmperf: '%s' isn't a perf.data file from a "
+            "little-endian machine\n", fileName);
+        goto bail;
+    }
+    if (hdr.size == 16) {
+        fprintf(stderr, "dvmperf: piped perf.data isn't supported\n");
+        goto bail;
+    }
+    if (hdr.attrSize < kAttrMinSize + sizeof(PerfFileSection) ||
+        hdr.attrs.offset + hdr.attrs.size > (u8) st.st_size ||
+        hdr.data.offset + hdr.data.size > (u8) st.st_size)
+    {
+        fprintf(stderr, "dvmperf: '%s' is damaged\n", fileName);
+        goto bail;
+    }
+
+    numAttrs = hdr.attrs.size / hdr.attrSize;
+    if (numAttrs == 0) {
+        fprintf(stderr, "dvmperf: no events in '%s'\n", fileName);
+        goto bail;
+    }
+    attrs = (PerfAttr*) xcalloc(numAttrs, sizeof(PerfAttr));
+    for (i = 0; i < numAttrs; i++) {
+        const u1* pAttr = base + hdr.attrs.offset + i * hdr.attrSize;
+        size_t attrLen = hdr.attrSize - sizeof(PerfFileSection);
+        PerfFileSection ids;
+        u4 size;
+
+        memcpy(&size, pAttr + kAttrOffSize, 4);
+        if (size > attrLen)
+            size = attrLen;
+        memcpy(&attrs[i].sampleType, pAttr + kAttrOffSampleType, 8);
+        memcpy(&attrs[i].readFormat, pAttr + kAttrOffReadFormat, 8);
+        if (size >= kAttrOffBranchType + 8)
+            memcpy(&attrs[i].branchSampleType, pAttr + kAttrOffBranchType, 8);
+        if (size >= kAttrOffRegsUser + 8)
+            memcpy(&attrs[i].regsUser, pAttr + kAttrOffRegsUser, 8);
+
+        memcpy(&ids, pAttr + attrLen, sizeof(ids));
+        if (ids.offset + ids.size <= (u8) st.st_size) {
+            attrs[i].ids = (u8*) (base + ids.offset);
+            attrs[i].numIds = ids.size / 8;
+        }
+
+        if (attrs[i].sampleType != attrs[0].sampleType &&
+            !(attrs[0].sampleType & PERF_SAMPLE_IDENTIFIER))
+        {
+            fprintf(stderr, "dvmperf: events in '%s' have different "
+                "sample layouts; record one event only\n", fileName);
+            goto bail;
+        }
+        if (attrs[i].sampleType & PERF_SAMPLE_STACK_USER)
+            numWithStack++;
+    }
+    if (numWithStack == 0) {
+        fprintf(stderr, "dvmperf: '%s' has no stack copies; record with "
+            "'--call-graph dwarf'\n", fileName);
+        goto bail;
+    }
+
+    off = hdr.data.offset;
+    end = hdr.data.offset + hdr.data.size;
+    while (off + 8 <= end) {
+        u4 type;
+        u2 size;
+
+        memcpy(&type, base + off, 4);
+        memcpy(&size, base + off + 6, 2);
+        if (size < 8 || off + size > end) {
+            fprintf(stderr, "dvmperf: bad record at offset %zu in '%s'\n",
+                off, fileName);
+            break;
+        }
+        if (type == PERF_RECORD_SAMPLE)
+            parseSample(attrs, numAttrs, base + off + 8, base + off + size);
+        off += size;
+    }
+    result = 0;
+
+bail:
+    free(attrs);
+    munmap((void*) base, st.st_size);
+    return result;
+}
+
+/*
+ * ===========================================================================
+ *      Folded stacks
+ * ===========================================================================
+ */
+
+static void addFolded(const char* stack)
+{
+    u4 idx = hashString(stack) & (gFoldedSize - 1);
+    FoldedStack* pStack;
+
+    if (gFolded == NULL)
+        gFolded = (FoldedStack**) xcalloc(gFoldedSize, sizeof(FoldedStack*));
+
+    for (pStack = gFolded[idx]; pStack != NULL; pStack = pStack->next) {
+        if (strcmp(pStack->stack, stack) == 0) {
+            pStack->count++;
+            return;
+        }
+    }
+    pStack = (FoldedStack*) xmalloc(sizeof(FoldedStack) + strlen(stack));
+    strcpy(pStack->stack, stack);
+    pStack->count = 1;
+    pStack->next = gFolded[idx];
+    gFolded[idx] = pStack;
+    gNumFolded++;
+}
+
+static int compareFolded(const void* vone, const void* vtwo)
+{
+    return strcmp((*(const FoldedStack**) vone)->stack,
+        (*(const FoldedStack**) vtwo)->stack);
+}
+
+static void writeFolded(FILE* out)
+{
+    FoldedStack** sorted;
+    size_t i, n = 0;
+
+    if (gNumFolded == 0)
+        return;
+    sorted = (FoldedStack**) xmalloc(gNumFolded * sizeof(FoldedStack*));
+    for (i = 0; i < gFoldedSize; i++) {
+        FoldedStack* pStack;
+        for (pStack = gFolded[i]; pStack != NULL; pStack = pStack->next)
+            sorted[n++] = pStack;
+    }
+    qsort(sorted, n, sizeof(FoldedStack*), compareFolded);
+    for (i = 0; i < n; i++)
+        fprintf(out, "%s %u\n", sorted[i]->stack, sorted[i]->count);
+    free(sorted);
+}
+
+/*
+ * A growable string, for building one folded stack.
+ */
+typedef struct StrBuf {
+    char*   str;
+    size_t  len;
+    size_t  alloc;
+} StrBuf;
+
+static void strAppend(StrBuf* pBuf, const char* str)
+{
+    size_t len = strlen(str);
+
+    if (pBuf->len + len + 2 > pBuf->alloc) {
+        pBuf->alloc = (pBuf->len + len + 2) * 2;
+        pBuf->str = (char*) realloc(pBuf->str, pBuf->alloc);
+        if (pBuf->str == NULL) {
+            fprintf(stderr, "dvmperf: out of memory\n");
+            exit(1);
+        }
+    }
+    if (pBuf->len != 0)
+        pBuf->str[pBuf->len++] = ';';
+    memcpy(pBuf->str + pBuf->len, str, len + 1);
+    pBuf->len += len;
+}
+
+/*
+ * Add one activation's Java frames, outermost first.
+ */
+static void appendJavaFrames(StrBuf* pBuf, const u8* shadow)
+{
+    u8 count = shadow[0];
+    char unknown[32];
+    int i;
+
+    if (shadow[1])
+        strAppend(pBuf, "[...]");
+    for (i = (int) count - 1; i >= 0; i--) {
+        const char* name = lookupMethod(shadow[2 + i]);
+        if (name == NULL) {
+            snprintf(unknown, sizeof(unknown), "[java %#" PRIx64 "]",
+                shadow[2 + i]);
+            name = unknown;
+        }
+        strAppend(pBuf, name);
+    }
+}
+
+/*
+ * Turn one "perf script" sample (native frames, innermost first) into a
+ * folded stack, with the Java frames spliced in.
+ */
+static void foldSample(u4 tid, u8 time, char** frames, int numFrames,
+    int* pNumMatched)
+{
+    const SampleShadows* pSample = findSample(tid, time, FALSE);
+    const u8* shadows[kMaxNativeFrames];
+    int anchorShadow[kMaxNativeFrames];
+    StrBuf buf;
+    int i, numShadows = 0, numAnchors = 0;
+
+    if (pSample != NULL) {
+        size_t pos = pSample->poolOffset;
+        u4 j;
+
+        for (j = 0; j < pSample->numShadows && j < kMaxNativeFrames; j++) {
+            shadows[numShadows++] = &gFramePool[pos];
+            pos += 2 + gFramePool[pos];
+        }
+        (*pNumMatched)++;
+    }
+
+    /* the innermost dvmInterpret gets the innermost shadow, and so on */
+    for (i = 0; i < numFrames; i++) {
+        anchorShadow[i] = -1;
+        if (strcmp(frames[i], kInterpEntrySymbol) == 0) {
+            if (numAnchors < numShadows)
+                anchorShadow[i] = numAnchors;
+            numAnchors++;
+        }
+    }
+
+    memset(&buf, 0, sizeof(buf));
+    for (i = numFrames - 1; i >= 0; i--) {
+        strAppend(&buf, frames[i]);
+        if (anchorShadow[i] >= 0)
+            appendJavaFrames(&buf, shadows[anchorShadow[i]]);
+    }
+    if (buf.str != NULL) {
+        addFolded(buf.str);
+        free(buf.str);
+    }
+}
+
+/*
+ * Parse a sample header line, e.g. "  1234 5678.123456789: ..." or
+ * "1200/1234 5678.123456789: ...".  On success, returns a pointer to
+ * whatever follows the timestamp.
+ */
+static const char* parseHeader(const char* line, u4* pTid, u8* pTime)
+{
+    const char* cp = line;
+    const char* prevTok = NULL;
+
+    while (*cp != '\0') {
+        const char* tok;
+        unsigned long long sec, nsec;
+        int secLen, nsecLen;
+
+        while (isspace((u1) *cp))
+            cp++;
+        tok = cp;
+        while (*cp != '\0' && !isspace((u1) *cp))
+            cp++;
+        if (tok == cp)
+            break;
+
+        if (sscanf(tok, "%llu%n.%llu%n", &sec, &secLen, &nsec, &nsecLen) == 2
+            && tok[nsecLen] == ':' && tok + nsecLen + 1 == cp &&
+            prevTok != NULL)
+        {
+            const char* slash;
+
+            nsecLen -= secLen + 1;
+            if (nsecLen != 9) {
+                fprintf(stderr, "dvmperf: timestamps need nanoseconds; "
+                    "run 'perf script' with --ns\n");
+                exit(1);
+            }
+            slash = strchr(prevTok, '/');
+            if (slash != NULL && slash < tok)
+                prevTok = slash + 1;
+            *pTid = (u4) strtoul(prevTok, NULL, 10);
+            *pTime = sec * 1000000000ULL + nsec;
+            return cp;
+        }
+        prevTok = tok;
+    }
+    return NULL;
+}
+
+/*
+ * Get the symbol from a "    <hex ip> <symbol>[+0x<off>] [(dso)]" frame.
+ * Returns NULL if it isn't a frame line.
+ */
+static char* parseFrame(char* line)
+{
+    char* cp = line;
+    char* sym;
+    char* plus;
+    size_t len;
+
+    while (isspace((u1) *cp))
+        cp++;
+    if (!isxdigit((u1) *cp))
+        return NULL;
+    while (isxdigit((u1) *cp))
+        cp++;
+    if (!isspace((u1) *cp))
+        return NULL;
+    while (isspace((u1) *cp))
+        cp++;
+    sym = cp;
+
+    len = strlen(sym);
+    while (len > 0 && isspace((u1) sym[len-1]))
+        sym[--len] = '\0';
+    if (len > 0 && sym[len-1] == ')') {
+        char* open = strrchr(sym, '(');
+        if (open != NULL && open > sym && open[-1] == ' ') {
+            open[-1] = '\0';
+            len = strlen(sym);
+        }
+    }
+    plus = strstr(sym, "+0x");
+    if (plus != NULL)
+        *plus = '\0';
+    if (*sym == '\0')
+        return "[unknown]";
+
+    /* ';' separates frames in the output */
+    for (cp = sym; *cp != '\0'; cp++) {
+        if (*cp == ';')
+            *cp = ':';
+    }
+    return sym;
+}
+
+/*
+ * Read "perf script" output.  Each sample is a header line, then its call
+ * chain with one tab-indented frame per line, then a blank line.
+ */
+static void readPerfScript(FILE* in, int* pNumSamples, int* pNumMatched)
+{
+    char line[kMaxLineLen];
+    char* frames[kMaxNativeFrames];
+    int numFrames = 0;
+    int inSample = FALSE;
+    u4 tid = 0, nextTid;
+    u8 time = 0, nextTime;
+
+    while (TRUE) {
+        char* got = fgets(line, sizeof(line), in);
+        const char* rest = NULL;
+        char* sym;
+
+        if (got != NULL && line[0] != '\t')
+            rest = parseHeader(line, &nextTid, &nextTime);
+
+        if (got == NULL || rest != NULL || line[0] == '\n') {
+            /* end of a sample */
+            if (inSample && numFrames > 0) {
+                foldSample(tid, time, frames, numFrames, pNumMatched);
+                (*pNumSamples)++;
+            }
+            while (numFrames > 0)
+                free(frames[--numFrames]);
+            inSample = FALSE;
+            if (got == NULL)
+                break;
+        }
+
+        if (rest != NULL) {
+            inSample = TRUE;
+            tid = nextTid;
+            time = nextTime;
+
+            /* without a call chain, the ip and symbol are on this line */
+            sym = parseFrame((char*) rest);
+            if (sym != NULL)
+                frames[numFrames++] = strdup(sym);
+        } else if (inSample && line[0] == '\t') {
+            sym = parseFrame(line);
+            if (sym != NULL && numFrames < kMaxNativeFrames)
+                frames[numFrames++] = strdup(sym);
+        }
+    }
+}
+
+/*
+ * ===========================================================================
+ *      main
+ * ===========================================================================
+ */
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: dvmperf [-m methods-file] perf.data perf-script-output\n\n"
+        "Record and prepare with:\n"
+        "  dalvikvm -Xperfshadow ...\n"
+        "  perf record --call-graph dwarf,16384 -p <pid>\n"
+        "  perf script -F tid,time,ip,sym --ns > perf.txt\n\n"
+        "Writes folded stacks to stdout.  Specify '-' to read the perf\n"
+        "script output from stdin.  The methods file defaults to\n"
+        "/tmp/perf-<pid>.methods when -p <pid> is given instead of -m.\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* methodsFile = NULL;
+    char defaultMethods[64];
+    int numSamples = 0, numMatched = 0;
+    FILE* in;
+    int ic;
+
+    while ((ic = getopt(argc, argv, "m:p:")) != -1) {
+        switch (ic) {
+        case 'm':
+            methodsFile = optarg;
+            break;
+        case 'p':
+            snprintf(defaultMethods, sizeof(defaultMethods),
+                "/tmp/perf-%s.methods", optarg);
+            methodsFile = defaultMethods;
+            break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    if (argc - optind != 2 || methodsFile == NULL) {
+        usage();
+        return 2;
+    }
+
+    if (readMethods(methodsFile) != 0)
+        return 1;
+    if (readPerfData(argv[optind]) != 0)
+        return 1;
+
+    if (strcmp(argv[optind+1], "-") == 0) {
+        in = stdin;
+    } else {
+        in = fopen(argv[optind+1], "r");
+        if (in == NULL) {
+            fprintf(stderr, "dvmperf: can't open '%s': %s\n",
+                argv[optind+1], strerror(errno));
+            return 1;
+        }
+    }
+    readPerfScript(in, &numSamples, &numMatched);
+    if (in != stdin)
+        fclose(in);
+
+    writeFolded(stdout);
+    fprintf(stderr, "dvmperf: %d samples, %d with Java frames, "
+        "%d methods named\n", numSamples, numMatched, gNumMethods);
+    return 0;
+}
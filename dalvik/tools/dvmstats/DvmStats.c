@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Print the counters from a VM's stats file (-Xstatsfile).  The VM isn't
+ * involved; we just map the file and copy the counters out.
+ *
+ * Output is one "name value" line per counter, after a "#" line giving
+ * the pid and the age of the values, which is easy for scripts to use.
+ */
+#define NOT_VM
+#include "StatsPage.h"      // from VM header
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+/* how many times to try for a consistent copy before giving up */
+#define kMaxReadTries   1000
+
+/*
+ * A consistent copy of the page.
+ */
+typedef struct Snapshot {
+    uint32_t    pid;
+    uint32_t    intervalMsec;
+    uint32_t    flags;
+    uint64_t    updateTimeMsec;
+    uint32_t    numCounters;
+    StatsCounter* counters;
+} Snapshot;
+
+static uint64_t wallTimeMsec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+}
+
+/*
+ * Map the file and check that it's a stats page we understand.  Returns
+ * NULL on failure.
+ */
+static const StatsPage* mapPage(const char* fileName, size_t* pSize)
+{
+    const StatsPage* page;
+    struct stat st;
+    uint64_t end;
+    int fd;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "dvmstats: can't open '%s': %s\n",
+            fileName, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    if ((size_t) st.st_size < offsetof(StatsPage, counters)) {
+        fprintf(stderr, "dvmstats: '%s' is too short\n", fileName);
+        close(fd);
+        return NULL;
+    }
+    page = (const StatsPage*) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED,
+        fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        fprintf(stderr, "dvmstats: can't map '%s': %s\n",
+            fileName, strerror(errno));
+        return NULL;
+    }
+
+    if (page->magic != kStatsPageMagic) {
+        fprintf(stderr, "dvmstats: '%s' isn't a VM stats file, or the VM "
+            "hasn't finished creating it\n", fileName);
+        goto bail;
+    }
+    __sync_synchronize();
+    end = (uint64_t) page->headerSize +
+        (uint64_t) page->numCounters * page->counterSize;
+    if (page->version < 1 || page->counterSize < sizeof(StatsCounter) ||
+        page->headerSize < offsetof(StatsPage, counters) ||
+        end > (uint64_t) st.st_size)
+    {
+        fprintf(stderr, "dvmstats: '%s' has an unknown layout "
+            "(version %u)\n", fileName, page->version);
+        goto bail;
+    }
+
+    *pSize = st.st_size;
+    return page;
+
+bail:
+    munmap((void*) page, st.st_size);
+    return NULL;
+}
+
+/*
+ * Copy the counters, retrying while the VM is in the middle of an update.
+ */
+static int takeSnapshot(const StatsPage* page, Snapshot* pSnap)
+{
+    const char* base = (const char*) page + page->headerSize;
+    int tries;
+    uint32_t i;
+
+    pSnap->numCounters = page->numCounters;
+    for (tries = 0; tries < kMaxReadTries; tries++) {
+        uint32_t seq = page->sequence;
+
+        if ((seq & 1) != 0) {
+            usleep(100);
+            continue;
+        }
+        __sync_synchronize();
+
+        for (i = 0; i < pSnap->numCounters; i++) {
+            memcpy(&pSnap->counters[i], base + i * page->counterSize,
+                sizeof(StatsCounter));
+            pSnap->counters[i].name[kStatsNameLen-1] = '\0';
+        }
+        pSnap->updateTimeMsec = page->updateTimeMsec;
+        pSnap->pid = page->pid;
+        pSnap->intervalMsec = page->intervalMsec;
+        pSnap->flags = page->flags;
+
+        __sync_synchronize();
+        if (page->sequence == seq)
+            return 0;
+    }
+
+    fprintf(stderr, "dvmstats: couldn't get a consistent copy\n");
+    return -1;
+}
+
+static void printSnapshot(const Snapshot* pSnap)
+{
+    uint64_t now = wallTimeMsec();
+    int64_t age = (int64_t) (now - pSnap->updateTimeMsec);
+    const char* state;
+    uint32_t i;
+
+    if (!(pSnap->flags & kStatsPageLive))
+        state = "exited";
+    else if (age > 3 * (int64_t) pSnap->intervalMsec + 1000)
+        state = "stale";
+    else
+        state = "live";
+
+    printf("# pid %u %s, updated %" PRId64 " msec ago\n",
+        pSnap->pid, state, age);
+    for (i = 0; i < pSnap->numCounters; i++) {
+        printf("%s %" PRIu64 "\n", pSnap->counters[i].name,
+            pSnap->counters[i].value);
+    }
+    fflush(stdout);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: dvmstats [-i msec] [-c count] stats-file\n\n"
+        "Prints the counters from a VM started with -Xstatsfile.\n"
+        "  -i msec   repeat every 'msec' milliseconds\n"
+        "  -c count  stop after 'count' repeats (default: forever)\n");
+}
+
+int main(int argc, char** argv)
+{
+    const StatsPage* page;
+    Snapshot snap;
+    size_t size;
+    long intervalMsec = 0, count = -1;
+    int ic, result = 0;
+
+    while ((ic = getopt(argc, argv, "i:c:")) != -1) {
+        switch (ic) {
+        case 'i':
+            intervalMsec = strtol(optarg, NULL, 10);
+            break;
+        case 'c':
+            count = strtol(optarg, NULL, 10);
+            break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    if (argc - optind != 1 || intervalMsec < 0) {
+        usage();
+        return 2;
+    }
+    if (intervalMsec == 0)
+        count = 1;
+
+    page = mapPage(argv[optind], &size);
+    if (page == NULL)
+        return 1;
+
+    snap.counters = (StatsCounter*) malloc(page->numCounters *
+        sizeof(StatsCounter));
+    if (snap.counters == NULL) {
+        fprintf(stderr, "dvmstats: out of memory\n");
+        return 1;
+    }
+
+    while (count != 0) {
+        if (takeSnapshot(page, &snap) != 0) {
+            result = 1;
+            break;
+        }
+        printSnapshot(&snap);
+        if (count > 0)
+            count--;
+        if (count != 0)
+            usleep(intervalMsec * 1000);
+    }
+
+    free(snap.counters);
+    munmap((void*) page, size);
+    return result;
+}
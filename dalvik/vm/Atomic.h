@@ -33,6 +33,13 @@
  */
 #define MEM_BARRIER()   do { asm volatile ("":::"memory"); } while (0)
 
+/*
+ * Hardware memory barrier.  Use this when publishing data to other
+ * threads that read it without taking a lock; MEM_BARRIER() only keeps
+ * the compiler from reordering, not the CPU.
+ */
+#define MEM_BARRIER_SMP()   __sync_synchronize()
+
 /*
  * Atomic compare-and-swap macro.
  *
@@ -34,22 +34,35 @@
 #define ATOMIC_LOCK_FLAG        (1 << 31)
 
 /*
- * Allocate cache.
+ * Set up the list of caches.
  */
-AtomicCache* dvmAllocAtomicCache(int numEntries)
+bool dvmAtomicCacheStartup(void)
 {
-    AtomicCache* newCache;
+    dvmInitMutex(&gDvm.atomicCacheLock);
+    gDvm.atomicCacheEpoch = 1;
+    return true;
+}
 
-    newCache = (AtomicCache*) calloc(1, sizeof(AtomicCache));
-    if (newCache == NULL)
-        return NULL;
+/*
+ * Allocate a table with "numEntries" entries.
+ */
+static AtomicCacheTable* allocTable(int numEntries)
+{
+    AtomicCacheTable* pTable;
+    int i;
 
-    newCache->numEntries = numEntries;
+    pTable = (AtomicCacheTable*) calloc(1, sizeof(AtomicCacheTable));
+    if (pTable == NULL)
+        return NULL;
 
-    newCache->entryAlloc = calloc(1,
+    for (pTable->shift = 32, i = numEntries; i > 1; i >>= 1)
+        pTable->shift--;
+    pTable->entryAlloc = calloc(1,
         sizeof(AtomicCacheEntry) * numEntries + CPU_CACHE_WIDTH);
-    if (newCache->entryAlloc == NULL)
+    if (pTable->entryAlloc == NULL) {
+        free(pTable);
         return NULL;
+    }
 
     /*
      * Adjust storage to align on a 32-byte boundary.  Each entry is 16 bytes
@@ -57,8 +70,48 @@ AtomicCache* dvmAllocAtomicCache(int numEntries)
      * line.
      */
     assert(sizeof(AtomicCacheEntry) == 16);
-    newCache->entries = (AtomicCacheEntry*)
-        (((int) newCache->entryAlloc + CPU_CACHE_WIDTH_1) & ~CPU_CACHE_WIDTH_1);
+    pTable->entries = (AtomicCacheEntry*)
+        (((int) pTable->entryAlloc + CPU_CACHE_WIDTH_1) & ~CPU_CACHE_WIDTH_1);
+
+    return pTable;
+}
+
+/*
+ * Allocate cache.
+ */
+AtomicCache* dvmAllocAtomicCache(int numEntries, const char* name)
+{
+    AtomicCache* newCache;
+
+    assert(numEntries >= 2 && (numEntries & (numEntries - 1)) == 0);
+
+    newCache = (AtomicCache*) calloc(1, sizeof(AtomicCache));
+    if (newCache == NULL)
+        return NULL;
+
+    newCache->numEntries = numEntries;
+    newCache->name = name;
+
+    newCache->maxEntries = numEntries;
+    if (gDvm.atomicCacheGrow) {
+        newCache->maxEntries = numEntries * ATOMIC_CACHE_MAX_GROWTH;
+        if (newCache->maxEntries > ATOMIC_CACHE_MAX_ENTRIES)
+            newCache->maxEntries = ATOMIC_CACHE_MAX_ENTRIES;
+        if (newCache->maxEntries < numEntries)
+            newCache->maxEntries = numEntries;
+    }
+
+    newCache->table = allocTable(numEntries);
+    if (newCache->table == NULL) {
+        free(newCache);
+        return NULL;
+    }
+    newCache->checkUsec = dvmGetRelativeTimeUsec();
+
+    dvmLockMutex(&gDvm.atomicCacheLock);
+    newCache->next = gDvm.atomicCacheList;
+    gDvm.atomicCacheList = newCache;
+    dvmUnlockMutex(&gDvm.atomicCacheLock);
 
     return newCache;
 }
@@ -68,27 +121,109 @@ AtomicCache* dvmAllocAtomicCache(int numEntries)
  */
 void dvmFreeAtomicCache(AtomicCache* cache)
 {
-    if (cache != NULL) {
-        free(cache->entryAlloc);
-        free(cache);
+    AtomicCache** ppCache;
+    AtomicCacheTable* pTable;
+
+    if (cache == NULL)
+        return;
+
+    dvmLockMutex(&gDvm.atomicCacheLock);
+    for (ppCache = &gDvm.atomicCacheList; *ppCache != NULL;
+        ppCache = &(*ppCache)->next)
+    {
+        if (*ppCache == cache) {
+            *ppCache = cache->next;
+            break;
+        }
     }
+    /* invalidate anything the threads' L0 caches hold for this one */
+    gDvm.atomicCacheEpoch++;
+    dvmUnlockMutex(&gDvm.atomicCacheLock);
+
+    pTable = cache->table;
+    while (pTable != NULL) {
+        AtomicCacheTable* prev = pTable->prev;
+        free(pTable->entryAlloc);
+        free(pTable);
+        pTable = prev;
+    }
+    free(cache);
+}
+
+/*
+ * Replace the cache's table with one twice the size.  The new table
+ * starts out empty; refilling it is cheap compared to the misses we're
+ * trying to get rid of.
+ *
+ * If another thread is already doing this, we just return.
+ */
+static void growCache(AtomicCache* pCache)
+{
+    AtomicCacheTable* pOldTable;
+    AtomicCacheTable* pNewTable;
+    int newSize;
+
+    if (!ATOMIC_CMP_SWAP(&pCache->growing, 0, 1))
+        return;
+
+    newSize = pCache->numEntries * 2;
+    if (newSize > pCache->maxEntries)
+        goto bail;
+
+    pNewTable = allocTable(newSize);
+    if (pNewTable == NULL)
+        goto bail;
+
+    pOldTable = pCache->table;
+    pNewTable->prev = pOldTable;
+
+    /* make sure the zeroed entries are visible before the pointer is */
+    MEM_BARRIER_SMP();
+    pCache->table = pNewTable;
+    pCache->numEntries = newSize;
+    pCache->grows++;
+
+    LOGD("Grew %s cache to %d entries\n",
+        pCache->name != NULL ? pCache->name : "atomic", newSize);
+
+bail:
+    pCache->growing = 0;
 }
 
+/*
+ * Once we've seen enough conflict misses since the last check, see how
+ * quickly they came.  We don't count hits (see CALC_CACHE_STATS), so the
+ * rate stands in for the miss ratio.
+ */
+static void checkGrowth(AtomicCache* pCache)
+{
+    int misses;
+    u8 now;
 
+    misses = pCache->misses;
+    if ((misses - pCache->checkMisses) * 2 < pCache->numEntries)
+        return;
+
+    /* the counters aren't updated atomically, and several threads may
+     * get here at once; growCache sorts that out */
+    now = dvmGetRelativeTimeUsec();
+    if (now - pCache->checkUsec < ATOMIC_CACHE_GROW_MSEC * 1000 &&
+        pCache->numEntries < pCache->maxEntries)
+    {
+        growCache(pCache);
+    }
+
+    pCache->checkUsec = now;
+    pCache->checkMisses = misses;
+}
 
 /*
  * Update a cache entry.
  *
  * In the event of a collision with another thread, the update may be skipped.
- *
- * We only need "pCache" for stats.
  */
 void dvmUpdateAtomicCache(u4 key1, u4 key2, u4 value, AtomicCacheEntry* pEntry,
-    u4 firstVersion
-#if CALC_CACHE_STATS > 0
-    , AtomicCache* pCache
-#endif
-    )
+    u4 firstVersion, AtomicCache* pCache)
 {
     /*
      * The fields don't match, so we need to update them.  There is a
@@ -111,22 +246,19 @@ void dvmUpdateAtomicCache(u4 key1, u4 key2, u4 value, AtomicCacheEntry* pEntry,
         /*
          * We couldn't get the write lock.  Return without updating the table.
          */
-#if CALC_CACHE_STATS > 0
-        pCache->fail++;
-#endif
+        if (CALC_CACHE_STATS)
+            pCache->fail++;
         return;
     }
 
     /* must be even-valued on entry */
     assert((firstVersion & 0x01) == 0);
 
-#if CALC_CACHE_STATS > 0
-    /* for stats, assume a key value of zero indicates an empty entry */
+    /* assume a key value of zero indicates an empty entry */
     if (pEntry->key1 == 0)
         pCache->fills++;
     else
         pCache->misses++;
-#endif
 
     /* volatile incr */
     pEntry->version++;
@@ -151,6 +283,29 @@ void dvmUpdateAtomicCache(u4 key1, u4 key2, u4 value, AtomicCacheEntry* pEntry,
         //LOGE("unable to reset the instanceof cache ownership\n");
         dvmAbort();
     }
+
+    if (pCache->numEntries < pCache->maxEntries)
+        checkGrowth(pCache);
+}
+
+/*
+ * Empty a thread's L0 cache and note the epoch it's now good for.
+ */
+void dvmResetAtomicCacheL0(AtomicCacheL0* pL0)
+{
+    pL0->epoch = gDvm.atomicCacheEpoch;
+    memset(pL0->entries, 0, sizeof(pL0->entries));
+}
+
+/*
+ * Keep the counts from threads that have gone away.
+ */
+void dvmRetireAtomicCacheL0(const AtomicCacheL0* pL0)
+{
+    dvmLockMutex(&gDvm.atomicCacheLock);
+    gDvm.atomicCacheL0Hits += pL0->hits;
+    gDvm.atomicCacheL0Misses += pL0->misses;
+    dvmUnlockMutex(&gDvm.atomicCacheLock);
 }
 
 
@@ -171,3 +326,84 @@ void dvmDumpAtomicCacheStats(const AtomicCache* pCache)
         pCache->numEntries);
 }
 
+/*
+ * Percentage, without dividing by zero.
+ */
+static int percent(u8 part, u8 total)
+{
+    return (total == 0) ? 0 : (int) (part * 100 / total);
+}
+
+/*
+ * Log one line per cache name, adding up caches that share a name (e.g.
+ * the per-DEX interface caches), then one line for the L0 caches.
+ */
+void dvmLogAtomicCacheStats(void)
+{
+    const char* names[16];
+    int numNames = 0;
+    AtomicCache* pCache;
+    Thread* thread;
+    u8 l0Hits, l0Misses;
+    int i;
+
+    dvmLockMutex(&gDvm.atomicCacheLock);
+
+    for (pCache = gDvm.atomicCacheList; pCache != NULL; pCache = pCache->next)
+    {
+        for (i = 0; i < numNames; i++) {
+            if (strcmp(names[i], pCache->name) == 0)
+                break;
+        }
+        if (i == numNames && numNames < (int) NELEM(names))
+            names[numNames++] = pCache->name;
+    }
+
+    for (i = 0; i < numNames; i++) {
+        u8 hits = 0, lookups = 0, misses = 0;
+        int count = 0, entries = 0, grows = 0;
+
+        for (pCache = gDvm.atomicCacheList; pCache != NULL;
+            pCache = pCache->next)
+        {
+            if (strcmp(names[i], pCache->name) != 0)
+                continue;
+            count++;
+            entries += pCache->numEntries;
+            grows += pCache->grows;
+            misses += (u4) pCache->misses;
+            hits += (u4) pCache->hits;
+            lookups += (u4) pCache->hits + (u4) pCache->misses +
+                (u4) pCache->fills + (u4) pCache->fail;
+        }
+
+        if (CALC_CACHE_STATS) {
+            LOGI("AtomicCache %s: %d cache(s), %d entries, %d grows, "
+                 "hit %d%% of %llu\n",
+                names[i], count, entries, grows, percent(hits, lookups),
+                lookups);
+        } else {
+            LOGI("AtomicCache %s: %d cache(s), %d entries, %d grows, "
+                 "%llu misses\n",
+                names[i], count, entries, grows, misses);
+        }
+    }
+
+    l0Hits = gDvm.atomicCacheL0Hits;
+    l0Misses = gDvm.atomicCacheL0Misses;
+
+    dvmUnlockMutex(&gDvm.atomicCacheLock);
+
+    if (!gDvm.atomicCacheL0)
+        return;
+
+    dvmLockThreadList(NULL);
+    for (thread = gDvm.threadList; thread != NULL; thread = thread->next) {
+        l0Hits += thread->atomicCacheL0.hits;
+        l0Misses += thread->atomicCacheL0.misses;
+    }
+    dvmUnlockThreadList();
+
+    LOGI("AtomicCache L0: hit %d%% of %llu\n",
+        percent(l0Hits, l0Hits + l0Misses), l0Hits + l0Misses);
+}
@@ -20,10 +20,32 @@
 #define _DALVIK_ATOMICCACHE
 
 /*
- * If set to "1", gather some stats on our caching success rate.
+ * If set to "1", count hits and contention failures, and dump cache stats
+ * at shutdown and when a class path entry goes away.  Those counters are
+ * shared by every thread doing lookups, so they're off by default.  Misses
+ * and fills are always counted; they're only touched when an entry is
+ * replaced, and they drive the resizing below.
  */
 #define CALC_CACHE_STATS 0
 
+/*
+ * A cache that keeps missing because entries evict each other is doubled
+ * in size, up to this many times its initial size and never past
+ * ATOMIC_CACHE_MAX_ENTRIES.  We check once the number of conflict misses
+ * since the last check reaches half the table size, and grow if they
+ * took less than ATOMIC_CACHE_GROW_MSEC to pile up.
+ */
+#define ATOMIC_CACHE_MAX_GROWTH     16
+#define ATOMIC_CACHE_MAX_ENTRIES    16384
+#define ATOMIC_CACHE_GROW_MSEC      10
+
+/*
+ * Entries in each thread's private "L0" cache, which sits in front of all
+ * of the shared caches.  Must be a power of 2.
+ */
+#define ATOMIC_CACHE_L0_SIZE        32
+#define ATOMIC_CACHE_L0_SHIFT       27      /* 32 - log2(L0 size) */
+
 
 /*
  * One entry in the cache.  We store two keys (e.g. the classes that are
@@ -39,17 +61,36 @@ typedef struct AtomicCacheEntry {
 } AtomicCacheEntry;
 
 /*
- * One cache.
+ * The entries, and the shift that turns a hash into an index.
  *
- * Thought: we might be able to save a few cycles by storing the cache
- * struct and "entries" separately, avoiding an indirection.  (We already
- * handle "numEntries" separately in ATOMIC_CACHE_LOOKUP.)
+ * When a cache grows we build a new, empty table and swap the pointer.
+ * A lookup reads the pointer once and uses that table's shift, so it
+ * can never index past the end of whichever table it got.  The old table may
+ * still be in use by a lookup in another thread, so it stays allocated
+ * (chained through "prev") until the cache itself is freed.  Since each
+ * table is twice the size of the one before, the old ones add up to less
+ * than the current one.
  */
-typedef struct AtomicCache {
+typedef struct AtomicCacheTable {
     AtomicCacheEntry*   entries;        /* array of entries */
-    int         numEntries;             /* #of entries, must be power of 2 */
+    u4          shift;                  /* 32 - log2(#of entries) */
 
     void*       entryAlloc;             /* memory allocated for entries */
+    struct AtomicCacheTable* prev;      /* table this one replaced */
+} AtomicCacheTable;
+
+/*
+ * One cache.
+ */
+typedef struct AtomicCache {
+    AtomicCacheTable* volatile table;   /* current table */
+    int         numEntries;             /* #of entries, must be power of 2 */
+    int         maxEntries;             /* don't grow beyond this */
+    volatile int growing;               /* set while a thread is growing it */
+    const char* name;                   /* for stats */
+
+    /* all caches, for stats; guarded by gDvm.atomicCacheLock */
+    struct AtomicCache* next;
 
     /* cache stats; note we don't guarantee atomic increments for these */
     int         trivial;                /* cache access not required */
@@ -57,8 +98,46 @@ typedef struct AtomicCache {
     int         hits;                   /* found entry in cache */
     int         misses;                 /* entry was for other keys */
     int         fills;                  /* entry was empty */
+    int         grows;                  /* #of times the table was doubled */
+
+    /* time and misses when we last considered growing */
+    u8          checkUsec;
+    int         checkMisses;
 } AtomicCache;
 
+/*
+ * Per-thread cache of recent results from any of the shared caches, kept
+ * in the Thread struct.  Only the owning thread touches it, so there's no
+ * versioning and the counters are exact.
+ *
+ * Freeing a shared cache bumps gDvm.atomicCacheEpoch; a thread that sees
+ * a new epoch empties its L0 before using it, so a stale entry can't match
+ * a new cache that was allocated at the same address.
+ */
+typedef struct AtomicCacheL0Entry {
+    const AtomicCache*  cache;
+    u4          key1;
+    u4          key2;
+    u4          value;
+} AtomicCacheL0Entry;
+
+typedef struct AtomicCacheL0 {
+    u4          epoch;                  /* gDvm.atomicCacheEpoch at reset */
+    u4          hits;
+    u4          misses;
+    AtomicCacheL0Entry  entries[ATOMIC_CACHE_L0_SIZE];
+} AtomicCacheL0;
+
+/*
+ * Multiplicative hash; the index is taken from the top bits.  The keys
+ * are often aligned pointers or small integers, which leave the low bits
+ * of a plain XOR mostly constant, so we rotate "key2" up and let the
+ * multiply carry everything into the bits we use.
+ */
+#define ATOMIC_CACHE_HASH(_key1, _key2)                                     \
+    ((((u4)(_key1)) ^ (((u4)(_key2) << 16) | ((u4)(_key2) >> 16)))        \
+        * 0x9e3779b1)
+
 /*
  * Do a cache lookup.  We need to be able to read and write entries
  * atomically.  There are a couple of ways to do this:
@@ -79,8 +158,13 @@ typedef struct AtomicCache {
  * We expect a 95+% hit rate for the things we use this for, so #2 is
  * much better than #1.
  *
+ * If gDvm.atomicCacheL0 is set, we first look in the calling thread's L0
+ * cache, which doesn't need the version dance and keeps hot pairs off the
+ * shared cache lines entirely.  Anything we get from the shared cache, or
+ * compute, is copied into the L0.
+ *
+ * _self is the current Thread*, or NULL to skip the L0
  * _cache is an AtomicCache*
- * _cacheSize is _cache->cacheSize (can save a cycle avoiding the lookup)
  * _key1, _key2 are the keys
  *
  * Define a function ATOMIC_CACHE_CALC that returns a 32-bit value.  This
@@ -88,66 +172,103 @@ typedef struct AtomicCache {
  *
  * Returns the value.
  */
-#if CALC_CACHE_STATS > 0
-# define CACHE_XARG(_value) ,_value
-#else
-# define CACHE_XARG(_value)
-#endif
-#define ATOMIC_CACHE_LOOKUP(_cache, _cacheSize, _key1, _key2) ({            \
-    AtomicCacheEntry* pEntry;                                               \
-    int hash;                                                               \
-    u4 firstVersion;                                                        \
+#define ATOMIC_CACHE_LOOKUP_SELF(_self, _cache, _key1, _key2) ({            \
+    Thread* l0Self = (_self);                                               \
+    AtomicCacheL0* pL0 = NULL;                                              \
+    AtomicCacheL0Entry* pL0Entry = NULL;                                    \
     u4 value;                                                               \
                                                                             \
-    /* simple hash function */                                              \
-    hash = (((u4)(_key1) >> 2) ^ (u4)(_key2)) & ((_cacheSize)-1);           \
-    pEntry = (_cache)->entries + hash;                                      \
+    if (l0Self != NULL && gDvm.atomicCacheL0) {                             \
+        pL0 = &l0Self->atomicCacheL0;                                       \
+        if (pL0->epoch != gDvm.atomicCacheEpoch)                            \
+            dvmResetAtomicCacheL0(pL0);                                     \
+        pL0Entry = &pL0->entries[                                           \
+            ATOMIC_CACHE_HASH((u4)(_key1) ^ (u4)(_cache), _key2)            \
+                >> ATOMIC_CACHE_L0_SHIFT];                                  \
+    }                                                                       \
+                                                                            \
+    if (pL0Entry != NULL && pL0Entry->cache == (_cache) &&                  \
+        pL0Entry->key1 == (u4)(_key1) && pL0Entry->key2 == (u4)(_key2))     \
+    {                                                                       \
+        pL0->hits++;                                                        \
+        value = pL0Entry->value;                                            \
+    } else {                                                                \
+        AtomicCacheTable* pTable = (_cache)->table;                         \
+        AtomicCacheEntry* pEntry;                                           \
+        u4 firstVersion;                                                    \
                                                                             \
-    /* volatile read */                                                     \
-    firstVersion = pEntry->version;                                         \
+        pEntry = pTable->entries +                                          \
+            (ATOMIC_CACHE_HASH(_key1, _key2) >> pTable->shift);             \
                                                                             \
-    if (pEntry->key1 == (u4)(_key1) && pEntry->key2 == (u4)(_key2)) {       \
-        /*                                                                  \
-         * The fields match.  Get the value, then read the version a        \
-         * second time to verify that we didn't catch a partial update.     \
-         * We're also hosed if "firstVersion" was odd, indicating that      \
-         * an update was in progress before we got here.                    \
-         */                                                                 \
-        value = pEntry->value;    /* must grab before next check */         \
+        /* volatile read */                                                 \
+        firstVersion = pEntry->version;                                     \
                                                                             \
-        if ((firstVersion & 0x01) != 0 || firstVersion != pEntry->version)  \
-        {                                                                   \
+        if (pEntry->key1 == (u4)(_key1) && pEntry->key2 == (u4)(_key2)) {   \
             /*                                                              \
-             * We clashed with another thread.  Instead of sitting and      \
-             * spinning, which might not complete if we're a high priority  \
-             * thread, just do the regular computation.                     \
+             * The fields match.  Get the value, then read the version a    \
+             * second time to verify that we didn't catch a partial update. \
+             * We're also hosed if "firstVersion" was odd, indicating that  \
+             * an update was in progress before we got here.                \
              */                                                             \
-            if (CALC_CACHE_STATS)                                           \
-                (_cache)->fail++;                                           \
-            value = (u4) ATOMIC_CACHE_CALC;                                 \
+            value = pEntry->value;    /* must grab before next check */     \
+                                                                            \
+            if ((firstVersion & 0x01) != 0 ||                               \
+                firstVersion != pEntry->version)                            \
+            {                                                               \
+                /*                                                          \
+                 * We clashed with another thread.  Instead of sitting and  \
+                 * spinning, which might not complete if we're a high       \
+                 * priority thread, just do the regular computation.        \
+                 */                                                         \
+                if (CALC_CACHE_STATS)                                       \
+                    (_cache)->fail++;                                       \
+                value = (u4) ATOMIC_CACHE_CALC;                             \
+            } else {                                                        \
+                /* all good */                                              \
+                if (CALC_CACHE_STATS)                                       \
+                    (_cache)->hits++;                                       \
+            }                                                               \
         } else {                                                            \
-            /* all good */                                                  \
-            if (CALC_CACHE_STATS)                                           \
-                (_cache)->hits++;                                           \
+            /*                                                              \
+             * Compute the result and update the cache.  We really want     \
+             * this to happen in a different method -- it makes the ARM     \
+             * frame setup for this method simpler, which gives us a ~10%   \
+             * speed boost.                                                 \
+             */                                                             \
+            value = (u4) ATOMIC_CACHE_CALC;                                 \
+            dvmUpdateAtomicCache((u4) (_key1), (u4) (_key2), value, pEntry, \
+                        firstVersion, (_cache));                            \
+        }                                                                   \
+                                                                            \
+        if (pL0Entry != NULL) {                                             \
+            pL0->misses++;                                                  \
+            pL0Entry->cache = (_cache);                                     \
+            pL0Entry->key1 = (u4)(_key1);                                   \
+            pL0Entry->key2 = (u4)(_key2);                                   \
+            pL0Entry->value = value;                                        \
         }                                                                   \
-    } else {                                                                \
-        /*                                                                  \
-         * Compute the result and update the cache.  We really want this    \
-         * to happen in a different method -- it makes the ARM frame        \
-         * setup for this method simpler, which gives us a ~10% speed       \
-         * boost.                                                           \
-         */                                                                 \
-        value = (u4) ATOMIC_CACHE_CALC;                                     \
-        dvmUpdateAtomicCache((u4) (_key1), (u4) (_key2), value, pEntry,     \
-                    firstVersion CACHE_XARG(_cache) );                      \
     }                                                                       \
     value;                                                                  \
 })
 
 /*
- * Allocate a cache.
+ * As above, for callers that don't have the current thread handy.  We
+ * only look it up if the L0 caches are enabled.
+ */
+#define ATOMIC_CACHE_LOOKUP(_cache, _key1, _key2)                           \
+    ATOMIC_CACHE_LOOKUP_SELF(gDvm.atomicCacheL0 ? dvmThreadSelf() : NULL,   \
+        _cache, _key1, _key2)
+
+/*
+ * Set up the list of caches.
+ */
+bool dvmAtomicCacheStartup(void);
+
+/*
+ * Allocate a cache.  "name" is used to group caches in the stats, and
+ * must stay valid for the life of the cache.
  */
-AtomicCache* dvmAllocAtomicCache(int numEntries);
+AtomicCache* dvmAllocAtomicCache(int numEntries, const char* name);
 
 /*
  * Free a cache.
@@ -155,21 +276,30 @@ AtomicCache* dvmAllocAtomicCache(int numEntries);
 void dvmFreeAtomicCache(AtomicCache* cache);
 
 /*
- * Update a cache entry.
- *
- * Making the last argument optional, instead of merely unused, saves us
- * a few percent in the ATOMIC_CACHE_LOOKUP time.
+ * Update a cache entry, and grow the cache if it's missing too often.
  */
 void dvmUpdateAtomicCache(u4 key1, u4 key2, u4 value, AtomicCacheEntry* pEntry,
-    u4 firstVersion
-#if CALC_CACHE_STATS > 0
-    , AtomicCache* pCache
-#endif
-    );
+    u4 firstVersion, AtomicCache* pCache);
+
+/*
+ * Empty a thread's L0 cache.  Only the owning thread may call this.
+ */
+void dvmResetAtomicCacheL0(AtomicCacheL0* pL0);
+
+/*
+ * Fold an exiting thread's L0 counters into the global totals.
+ */
+void dvmRetireAtomicCacheL0(const AtomicCacheL0* pL0);
 
 /*
  * Debugging.
  */
 void dvmDumpAtomicCacheStats(const AtomicCache* pCache);
 
+/*
+ * Log the miss counts (and hit rates, with CALC_CACHE_STATS) of all
+ * caches, grouped by name, and the hit rate of the per-thread L0 caches.
+ */
+void dvmLogAtomicCacheStats(void);
+
 #endif /*_DALVIK_ATOMICCACHE*/
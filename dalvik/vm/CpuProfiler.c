@@ -0,0 +1,980 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Statistical CPU profiler.
+ *
+ * Every VM thread gets a timer on its own CPU-time clock, which sends it
+ * SIGPROF each time it has used another 1/N second of CPU.  The handler
+ * copies the thread's interpreted call stack (the curFrame chain) into a
+ * ring that belongs to that thread.  Nobody is suspended, and the handler
+ * takes no locks.
+ *
+ * A "CPU Profiler" thread arms timers for new threads, empties the rings
+ * into a table of stack -> sample count, and now and then rewrites the
+ * output file.  Threads that exit hand over their leftover samples on the
+ * way out.
+ *
+ * The output is "folded" stacks (one "root;...;leaf count" line per
+ * distinct stack, as used by flame graph tools), or an uncompressed pprof
+ * profile if the file name ends in ".pb" or ".pprof".
+ *
+ * SIGPROF is installed with SA_RESTART, but a few calls (usleep, for
+ * one) still come back early when it arrives.  The VM already copes with
+ * that for its own signals.
+ */
+#include "Dalvik.h"
+
+#ifdef WITH_PROFILER        // -- include rest of file
+
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+
+#ifndef SIGEV_THREAD_ID
+# define SIGEV_THREAD_ID        4
+#endif
+#ifndef sigev_notify_thread_id
+# define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* Linux's CPU-time clock for thread "_tid" (MAKE_THREAD_CPUCLOCK) */
+#define THREAD_CPU_CLOCK(_tid)  ((clockid_t) ((~(clockid_t) (_tid) << 3) | 6))
+
+#define kMaxSampleDepth     64      /* interpreted frames kept per sample */
+#define kMaxFrames          (kMaxSampleDepth + 2)
+#define kMaxStacks          65536   /* distinct stacks we'll keep */
+#define kCollectMsec        100     /* how often we empty the rings */
+#define kWriteSec           10      /* how often we rewrite the file */
+
+/*
+ * Pseudo-frames, for where a sample wasn't in interpreted code.  Real
+ * Method pointers are never this small.
+ */
+enum {
+    kFrameNative = 1,               /* in a native method */
+    kFrameVm,                       /* in the VM, waiting or working */
+    kFrameTruncated,                /* stack deeper than kMaxSampleDepth */
+    kFrameBad,                      /* not a Method we recognize */
+    kFrameMaxPseudo = kFrameBad
+};
+
+/*
+ * A stack, and how many samples landed on it.  StackKey is the part used
+ * for lookups.
+ */
+typedef struct StackKey {
+    u4          depth;
+    const uintptr_t* frames;        /* innermost first */
+} StackKey;
+
+typedef struct StackCount {
+    StackKey    key;
+    u4          count;
+    uintptr_t   storage[1];         /* "frames" points here */
+} StackCount;
+
+/*
+ * A distinct frame, when writing the profile.
+ */
+typedef struct FrameInfo {
+    uintptr_t   frame;
+    u4          id;                 /* 1-based, in first-seen order */
+    char*       name;
+    const char* sourceFile;
+    int         lineNum;
+} FrameInfo;
+
+/*
+ * ===========================================================================
+ *      Sampling
+ * ===========================================================================
+ */
+
+/*
+ * Walk "self"'s interpreted stack and put the frames in its ring.  This
+ * runs in a signal handler, on "self", so it can see the stack in the
+ * middle of being changed.  We don't follow anything outside the
+ * thread's interpreted stack, and check the methods later.
+ */
+static void recordSample(Thread* self, CpuSampleRing* ring)
+{
+    uintptr_t frames[kMaxFrames];
+    const u1* stackTop = self->interpStackStart;
+    const u1* stackBottom = stackTop - self->interpStackSize;
+    const u1* fp = (const u1*) self->curFrame;
+    u4 head, depth = 0, i;
+
+    switch (self->status) {
+    case THREAD_RUNNING:
+        break;
+    case THREAD_NATIVE:
+        frames[depth++] = kFrameNative;
+        break;
+    default:
+        frames[depth++] = kFrameVm;
+        break;
+    }
+
+    while (fp != NULL && depth < kMaxSampleDepth) {
+        const StackSaveArea* saveArea;
+        const u1* prevFrame;
+
+        if (fp < stackBottom + sizeof(StackSaveArea) || fp >= stackTop)
+            break;
+        saveArea = SAVEAREA_FROM_FP(fp);
+        if (saveArea->method != NULL)
+            frames[depth++] = (uintptr_t) saveArea->method;
+
+        prevFrame = (const u1*) saveArea->prevFrame;
+        if (prevFrame != NULL && prevFrame <= fp)
+            break;                          /* wrong way */
+        fp = prevFrame;
+    }
+    if (fp != NULL && depth == kMaxSampleDepth)
+        frames[depth++] = kFrameTruncated;
+    if (depth == 0)
+        frames[depth++] = kFrameVm;
+
+    head = ring->head;
+    if (kCpuSampleRingSize - (head - ring->tail) < depth + 1) {
+        ring->dropped++;
+        return;
+    }
+    ring->slots[head & (kCpuSampleRingSize-1)] = depth;
+    for (i = 0; i < depth; i++)
+        ring->slots[(head + 1 + i) & (kCpuSampleRingSize-1)] = frames[i];
+
+    /* make the sample visible before the new head */
+    MEM_BARRIER_SMP();
+    ring->head = head + 1 + depth;
+}
+
+/*
+ * SIGPROF handler.
+ */
+static void cpuProfSignalHandler(int signum, siginfo_t* info, void* context)
+{
+    int savedErrno = errno;
+    Thread* self = dvmThreadSelf();
+
+    UNUSED_PARAMETER(signum);
+    UNUSED_PARAMETER(info);
+    UNUSED_PARAMETER(context);
+
+    if (self != NULL && self->cpuSampleRing != NULL)
+        recordSample(self, self->cpuSampleRing);
+
+    errno = savedErrno;
+}
+
+/*
+ * ===========================================================================
+ *      Collecting
+ * ===========================================================================
+ */
+
+static int hashcmpStack(const void* tableItem, const void* looseItem)
+{
+    const StackKey* one = (const StackKey*) tableItem;
+    const StackKey* two = (const StackKey*) looseItem;
+
+    if (one->depth != two->depth)
+        return one->depth - two->depth;
+    return memcmp(one->frames, two->frames, one->depth * sizeof(uintptr_t));
+}
+
+static u4 hashStack(const uintptr_t* frames, u4 depth)
+{
+    u4 hash = depth;
+    u4 i;
+
+    for (i = 0; i < depth; i++)
+        hash = hash * 31 + (u4) (frames[i] >> 2);
+    return hash;
+}
+
+/*
+ * Count one sample.  Caller must hold cpuProfilerLock.
+ */
+static void addSample(const uintptr_t* frames, u4 depth)
+{
+    HashTable* pTable = gDvm.cpuProfileStacks;
+    StackKey key;
+    StackCount* pCount;
+    u4 hash;
+
+    key.depth = depth;
+    key.frames = frames;
+    hash = hashStack(frames, depth);
+
+    pCount = (StackCount*) dvmHashTableLookup(pTable, hash, &key,
+        hashcmpStack, false);
+    if (pCount == NULL) {
+        if (dvmHashTableNumEntries(pTable) >= kMaxStacks) {
+            gDvm.cpuProfileDropped++;
+            return;
+        }
+        pCount = (StackCount*) malloc(sizeof(StackCount) +
+            (depth - 1) * sizeof(uintptr_t));
+        if (pCount == NULL) {
+            gDvm.cpuProfileDropped++;
+            return;
+        }
+        memcpy(pCount->storage, frames, depth * sizeof(uintptr_t));
+        pCount->key.depth = depth;
+        pCount->key.frames = pCount->storage;
+        pCount->count = 0;
+        dvmHashTableLookup(pTable, hash, pCount, hashcmpStack, true);
+    }
+    pCount->count++;
+    gDvm.cpuProfileSamples++;
+}
+
+/*
+ * Move everything from a ring into the table.  Caller must hold
+ * cpuProfilerLock.
+ */
+static void drainRing(CpuSampleRing* ring)
+{
+    uintptr_t frames[kMaxFrames];
+    u4 head = ring->head;
+    u4 tail = ring->tail;
+    u4 dropped, depth, i;
+
+    /* read the samples only after we've seen the head that covers them */
+    MEM_BARRIER_SMP();
+
+    while (tail != head) {
+        depth = ring->slots[tail & (kCpuSampleRingSize-1)];
+        if (depth == 0 || depth > kMaxFrames || depth >= head - tail) {
+            LOGW("CPU profiler: bad sample ring (depth %u)\n", depth);
+            break;
+        }
+        for (i = 0; i < depth; i++)
+            frames[i] = ring->slots[(tail + 1 + i) & (kCpuSampleRingSize-1)];
+        addSample(frames, depth);
+        tail += 1 + depth;
+    }
+
+    /* done reading; let the handler have the slots back */
+    MEM_BARRIER_SMP();
+    ring->tail = head;
+
+    dropped = ring->dropped;
+    gDvm.cpuProfileDropped += dropped - ring->droppedSeen;
+    ring->droppedSeen = dropped;
+}
+
+/*
+ * Give a thread a sample ring and start its timer.  Caller must hold the
+ * thread list lock and cpuProfilerLock.
+ */
+static void armThread(Thread* thread)
+{
+    CpuSampleRing* ring;
+    struct sigevent sev;
+    struct itimerspec spec;
+    long periodNsec;
+
+    if (thread->systemTid == 0)
+        return;                             /* still starting up */
+
+    ring = (CpuSampleRing*) calloc(1, sizeof(CpuSampleRing));
+    if (ring == NULL)
+        return;
+
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = thread->systemTid;
+    if (timer_create(THREAD_CPU_CLOCK(thread->systemTid), &sev,
+            &ring->timer) != 0)
+    {
+        LOGW("CPU profiler: can't create timer for tid %d: %s; giving up\n",
+            (int) thread->systemTid, strerror(errno));
+        gDvm.cpuProfilerTimersFailed = true;
+        free(ring);
+        return;
+    }
+    ring->timerLive = true;
+
+    /* the ring has to be there before the first signal is */
+    thread->cpuSampleRing = ring;
+    MEM_BARRIER_SMP();
+
+    periodNsec = 1000000000L / gDvm.cpuProfileHz;
+    spec.it_interval.tv_sec = periodNsec / 1000000000L;
+    spec.it_interval.tv_nsec = periodNsec % 1000000000L;
+    spec.it_value = spec.it_interval;
+    if (timer_settime(ring->timer, 0, &spec, NULL) != 0) {
+        LOGW("CPU profiler: can't start timer for tid %d: %s\n",
+            (int) thread->systemTid, strerror(errno));
+    }
+}
+
+/*
+ * Arm any new threads, and pick up everybody's samples.
+ */
+static void collectSamples(Thread* self)
+{
+    Thread* thread;
+
+    dvmLockThreadList(self);
+    dvmLockMutex(&gDvm.cpuProfilerLock);
+    for (thread = gDvm.threadList; thread != NULL; thread = thread->next) {
+        if (thread->cpuSampleRing != NULL)
+            drainRing(thread->cpuSampleRing);
+        else if (!gDvm.cpuProfilerTimersFailed)
+            armThread(thread);
+    }
+    dvmUnlockMutex(&gDvm.cpuProfilerLock);
+    dvmUnlockThreadList();
+}
+
+/*
+ * Called when a thread is leaving the thread list.  Stop its timer and
+ * keep whatever it collected.
+ *
+ * A SIGPROF that was already on its way can still arrive after the timer
+ * is gone, but it's delivered to this thread, so once we clear
+ * cpuSampleRing the handler won't touch the ring again.
+ */
+void dvmCpuProfilerThreadExit(Thread* self)
+{
+    CpuSampleRing* ring = self->cpuSampleRing;
+
+    if (ring == NULL)
+        return;
+    assert(self == dvmThreadSelf());
+    if (ring->timerLive)
+        timer_delete(ring->timer);
+    self->cpuSampleRing = NULL;
+    MEM_BARRIER();
+
+    dvmLockMutex(&gDvm.cpuProfilerLock);
+    if (gDvm.cpuProfileStacks != NULL)
+        drainRing(ring);
+    dvmUnlockMutex(&gDvm.cpuProfilerLock);
+    free(ring);
+}
+
+/*
+ * The profiler thread.  We don't touch objects, so we stay in VMWAIT and
+ * never hold up the GC.
+ */
+static void* cpuProfilerThreadStart(void* arg)
+{
+    Thread* self = dvmThreadSelf();
+    u8 lastWrite = dvmGetRelativeTimeUsec();
+    u8 lastSamples = 0;
+
+    UNUSED_PARAMETER(arg);
+
+    dvmChangeStatus(self, THREAD_VMWAIT);
+
+    while (true) {
+        u8 now;
+
+        dvmLockMutex(&gDvm.cpuProfilerLock);
+        if (!gDvm.haltCpuProfiler) {
+            dvmRelativeCondWait(&gDvm.cpuProfilerCond,
+                &gDvm.cpuProfilerLock, kCollectMsec, 0);
+        }
+        if (gDvm.haltCpuProfiler) {
+            dvmUnlockMutex(&gDvm.cpuProfilerLock);
+            break;
+        }
+        dvmUnlockMutex(&gDvm.cpuProfilerLock);
+
+        collectSamples(self);
+
+        now = dvmGetRelativeTimeUsec();
+        if (now - lastWrite >= kWriteSec * 1000000LL &&
+            gDvm.cpuProfileSamples != lastSamples)
+        {
+            lastSamples = gDvm.cpuProfileSamples;
+            lastWrite = now;
+            dvmCpuProfilerWrite();
+        }
+    }
+
+    dvmChangeStatus(self, THREAD_RUNNING);
+    return NULL;
+}
+
+/*
+ * ===========================================================================
+ *      Output
+ * ===========================================================================
+ */
+
+/*
+ * Decide whether "method" really points to a Method.  A sample can catch
+ * a frame half-built, so we can't take it on trust.
+ */
+static bool isValidMethod(const Method* method)
+{
+    ClassObject* clazz;
+
+    if (!dvmLinearAllocContains(method, sizeof(Method)))
+        return false;
+    clazz = method->clazz;
+    if (!dvmIsValidObject((Object*) clazz) ||
+        clazz->obj.clazz != gDvm.classJavaLangClass)
+    {
+        return false;
+    }
+    return (method >= clazz->directMethods &&
+            method < clazz->directMethods + clazz->directMethodCount) ||
+           (method >= clazz->virtualMethods &&
+            method < clazz->virtualMethods + clazz->virtualMethodCount);
+}
+
+/*
+ * Fill in the name and source position of a frame.
+ */
+static void describeFrame(FrameInfo* pInfo)
+{
+    static const char* kPseudoNames[] = {
+        NULL, "(native)", "(vm)", "(truncated)", "(unknown)"
+    };
+    const Method* method = (const Method*) pInfo->frame;
+    char* className;
+    size_t len;
+
+    pInfo->sourceFile = NULL;
+    pInfo->lineNum = 0;
+
+    if (pInfo->frame > kFrameMaxPseudo && !isValidMethod(method))
+        pInfo->frame = kFrameBad;
+    if (pInfo->frame <= kFrameMaxPseudo) {
+        pInfo->name = strdup(kPseudoNames[pInfo->frame]);
+        return;
+    }
+
+    className = dvmDescriptorToName(method->clazz->descriptor);
+    len = strlen(className) + 1 + strlen(method->name) + 1;
+    pInfo->name = (char*) malloc(len);
+    if (pInfo->name != NULL)
+        snprintf(pInfo->name, len, "%s.%s", className, method->name);
+    free(className);
+
+    pInfo->sourceFile = dvmGetMethodSourceFile(method);
+    if (!dvmIsNativeMethod(method) && !dvmIsAbstractMethod(method))
+        pInfo->lineNum = dvmLineNumFromPC(method, 0);
+}
+
+static int hashcmpFrame(const void* tableItem, const void* looseItem)
+{
+    uintptr_t one = ((const FrameInfo*) tableItem)->frame;
+    uintptr_t two = ((const FrameInfo*) looseItem)->frame;
+
+    return (one == two) ? 0 : ((one < two) ? -1 : 1);
+}
+
+/*
+ * Gather the distinct frames, so each one is only described once.
+ */
+typedef struct FrameTable {
+    HashTable*  byFrame;
+    FrameInfo** list;               /* in id order */
+    u4          count;
+    u4          alloc;
+} FrameTable;
+
+static FrameInfo* lookupFrame(FrameTable* pFrames, uintptr_t frame)
+{
+    FrameInfo key;
+    FrameInfo* pInfo;
+    u4 hash = (u4) (frame >> 2);
+
+    key.frame = frame;
+    pInfo = (FrameInfo*) dvmHashTableLookup(pFrames->byFrame, hash, &key,
+        hashcmpFrame, false);
+    if (pInfo != NULL)
+        return pInfo;
+
+    if (pFrames->count == pFrames->alloc) {
+        u4 newAlloc = (pFrames->alloc == 0) ? 256 : pFrames->alloc * 2;
+        FrameInfo** newList = (FrameInfo**) realloc(pFrames->list,
+            newAlloc * sizeof(FrameInfo*));
+        if (newList == NULL)
+            return NULL;
+        pFrames->list = newList;
+        pFrames->alloc = newAlloc;
+    }
+
+    pInfo = (FrameInfo*) malloc(sizeof(FrameInfo));
+    if (pInfo == NULL)
+        return NULL;
+    pInfo->frame = frame;
+    describeFrame(pInfo);
+    pInfo->frame = frame;           /* keep the key, even if it was bad */
+    if (pInfo->name == NULL) {
+        free(pInfo);
+        return NULL;
+    }
+    pInfo->id = ++pFrames->count;
+    pFrames->list[pInfo->id - 1] = pInfo;
+    dvmHashTableLookup(pFrames->byFrame, hash, pInfo, hashcmpFrame, true);
+    return pInfo;
+}
+
+static void freeFrameInfo(void* vinfo)
+{
+    FrameInfo* pInfo = (FrameInfo*) vinfo;
+
+    free(pInfo->name);
+    free(pInfo);
+}
+
+/*
+ * Write one stack as a folded line, root first.
+ */
+typedef struct FoldedContext {
+    FILE*       fp;
+    FrameTable* pFrames;
+    bool        failed;
+} FoldedContext;
+
+static int writeFoldedStack(void* vcount, void* vctx)
+{
+    const StackCount* pCount = (const StackCount*) vcount;
+    FoldedContext* pCtx = (FoldedContext*) vctx;
+    int i;
+
+    for (i = pCount->key.depth - 1; i >= 0; i--) {
+        FrameInfo* pInfo = lookupFrame(pCtx->pFrames, pCount->key.frames[i]);
+        if (pInfo == NULL) {
+            pCtx->failed = true;
+            return 1;
+        }
+        fputs(pInfo->name, pCtx->fp);
+        if (i != 0)
+            fputc(';', pCtx->fp);
+    }
+    fprintf(pCtx->fp, " %u\n", pCount->count);
+    return 0;
+}
+
+/*
+ * A growable buffer for protobuf encoding.
+ */
+typedef struct ProtoBuf {
+    u1*         data;
+    size_t      len;
+    size_t      alloc;
+    bool        failed;
+} ProtoBuf;
+
+static void pbAppend(ProtoBuf* pBuf, const void* data, size_t len)
+{
+    if (pBuf->len + len > pBuf->alloc) {
+        size_t newAlloc = (pBuf->alloc == 0) ? 4096 : pBuf->alloc * 2;
+        u1* newData;
+
+        while (newAlloc < pBuf->len + len)
+            newAlloc *= 2;
+        newData = (u1*) realloc(pBuf->data, newAlloc);
+        if (newData == NULL) {
+            pBuf->failed = true;
+            return;
+        }
+        pBuf->data = newData;
+        pBuf->alloc = newAlloc;
+    }
+    memcpy(pBuf->data + pBuf->len, data, len);
+    pBuf->len += len;
+}
+
+static void pbVarint(ProtoBuf* pBuf, u8 val)
+{
+    u1 bytes[10];
+    size_t len = 0;
+
+    do {
+        bytes[len] = val & 0x7f;
+        val >>= 7;
+        if (val != 0)
+            bytes[len] |= 0x80;
+        len++;
+    } while (val != 0);
+    pbAppend(pBuf, bytes, len);
+}
+
+static void pbTagVarint(ProtoBuf* pBuf, int field, u8 val)
+{
+    pbVarint(pBuf, field << 3);
+    pbVarint(pBuf, val);
+}
+
+static void pbTagBytes(ProtoBuf* pBuf, int field, const void* data,
+    size_t len)
+{
+    pbVarint(pBuf, (field << 3) | 2);
+    pbVarint(pBuf, len);
+    pbAppend(pBuf, data, len);
+}
+
+/*
+ * Add a finished sub-message to "pBuf" as field "field", and empty "pMsg"
+ * for the next one.
+ */
+static void pbTagMessage(ProtoBuf* pBuf, int field, ProtoBuf* pMsg)
+{
+    pbTagBytes(pBuf, field, pMsg->data, pMsg->len);
+    pBuf->failed |= pMsg->failed;
+    pMsg->len = 0;
+}
+
+/*
+ * Field numbers from perftools.profiles.Profile (profile.proto).
+ */
+enum {
+    kProfileSampleType = 1, kProfileSample = 2, kProfileLocation = 4,
+    kProfileFunction = 5, kProfileStringTable = 6, kProfileTimeNanos = 9,
+    kProfileDurationNanos = 10, kProfilePeriodType = 11, kProfilePeriod = 12,
+
+    kValueTypeType = 1, kValueTypeUnit = 2,
+    kSampleLocationId = 1, kSampleValue = 2,
+    kLocationId = 1, kLocationLine = 4,
+    kLineFunctionId = 1, kLineLine = 2,
+    kFunctionId = 1, kFunctionName = 2, kFunctionSystemName = 3,
+    kFunctionFilename = 4, kFunctionStartLine = 5,
+};
+
+/* fixed part of the string table; the frames' strings follow */
+static const char* kPprofStrings[] = {
+    "", "samples", "count", "cpu", "nanoseconds"
+};
+#define kPprofFirstFrameString  NELEM(kPprofStrings)
+
+typedef struct PprofContext {
+    ProtoBuf*   pOut;
+    ProtoBuf*   pMsg;
+    FrameTable* pFrames;
+    u8          periodNsec;
+} PprofContext;
+
+static int writePprofSample(void* vcount, void* vctx)
+{
+    const StackCount* pCount = (const StackCount*) vcount;
+    PprofContext* pCtx = (PprofContext*) vctx;
+    u4 i;
+
+    /* locations are innermost first, which is how we keep them */
+    for (i = 0; i < pCount->key.depth; i++) {
+        FrameInfo* pInfo = lookupFrame(pCtx->pFrames, pCount->key.frames[i]);
+        if (pInfo == NULL) {
+            pCtx->pMsg->failed = true;
+            break;
+        }
+        pbTagVarint(pCtx->pMsg, kSampleLocationId, pInfo->id);
+    }
+    pbTagVarint(pCtx->pMsg, kSampleValue, pCount->count);
+    pbTagVarint(pCtx->pMsg, kSampleValue, pCount->count * pCtx->periodNsec);
+    pbTagMessage(pCtx->pOut, kProfileSample, pCtx->pMsg);
+
+    return pCtx->pOut->failed ? 1 : 0;
+}
+
+/*
+ * Write the profile in pprof's format.
+ */
+static bool writePprof(FILE* fp, FrameTable* pFrames)
+{
+    ProtoBuf out, msg, line;
+    PprofContext ctx;
+    struct timeval tv;
+    u4 i;
+    bool result;
+
+    memset(&out, 0, sizeof(out));
+    memset(&msg, 0, sizeof(msg));
+    memset(&line, 0, sizeof(line));
+
+    /* sample_type { samples count } { cpu nanoseconds } */
+    pbTagVarint(&msg, kValueTypeType, 1);
+    pbTagVarint(&msg, kValueTypeUnit, 2);
+    pbTagMessage(&out, kProfileSampleType, &msg);
+    pbTagVarint(&msg, kValueTypeType, 3);
+    pbTagVarint(&msg, kValueTypeUnit, 4);
+    pbTagMessage(&out, kProfileSampleType, &msg);
+
+    ctx.pOut = &out;
+    ctx.pMsg = &msg;
+    ctx.pFrames = pFrames;
+    ctx.periodNsec = 1000000000LL / gDvm.cpuProfileHz;
+    dvmHashForeach(gDvm.cpuProfileStacks, writePprofSample, &ctx);
+
+    /* one location and one function per frame, sharing the id */
+    for (i = 0; i < pFrames->count; i++) {
+        const FrameInfo* pInfo = pFrames->list[i];
+        u4 nameIdx = kPprofFirstFrameString + i * 2;
+
+        pbTagVarint(&line, kLineFunctionId, pInfo->id);
+        pbTagVarint(&line, kLineLine, pInfo->lineNum);
+        pbTagVarint(&msg, kLocationId, pInfo->id);
+        pbTagMessage(&msg, kLocationLine, &line);
+        pbTagMessage(&out, kProfileLocation, &msg);
+
+        pbTagVarint(&msg, kFunctionId, pInfo->id);
+        pbTagVarint(&msg, kFunctionName, nameIdx);
+        pbTagVarint(&msg, kFunctionSystemName, nameIdx);
+        pbTagVarint(&msg, kFunctionFilename, nameIdx + 1);
+        pbTagVarint(&msg, kFunctionStartLine, pInfo->lineNum);
+        pbTagMessage(&out, kProfileFunction, &msg);
+    }
+
+    for (i = 0; i < kPprofFirstFrameString; i++) {
+        pbTagBytes(&out, kProfileStringTable, kPprofStrings[i],
+            strlen(kPprofStrings[i]));
+    }
+    for (i = 0; i < pFrames->count; i++) {
+        const FrameInfo* pInfo = pFrames->list[i];
+        const char* sourceFile =
+            (pInfo->sourceFile != NULL) ? pInfo->sourceFile : "";
+
+        pbTagBytes(&out, kProfileStringTable, pInfo->name,
+            strlen(pInfo->name));
+        pbTagBytes(&out, kProfileStringTable, sourceFile, strlen(sourceFile));
+    }
+
+    gettimeofday(&tv, NULL);
+    pbTagVarint(&out, kProfileTimeNanos, gDvm.cpuProfileStartWallNsec);
+    pbTagVarint(&out, kProfileDurationNanos,
+        (tv.tv_sec * 1000000LL + tv.tv_usec) * 1000 -
+        gDvm.cpuProfileStartWallNsec);
+    pbTagVarint(&msg, kValueTypeType, 3);
+    pbTagVarint(&msg, kValueTypeUnit, 4);
+    pbTagMessage(&out, kProfilePeriodType, &msg);
+    pbTagVarint(&out, kProfilePeriod, ctx.periodNsec);
+
+    result = !out.failed && !msg.failed && !line.failed &&
+        fwrite(out.data, out.len, 1, fp) == 1;
+
+    free(out.data);
+    free(msg.data);
+    free(line.data);
+    return result;
+}
+
+/*
+ * Check for a file name ending in "suffix".
+ */
+static bool hasSuffix(const char* str, const char* suffix)
+{
+    size_t strLen = strlen(str);
+    size_t suffixLen = strlen(suffix);
+
+    return strLen >= suffixLen &&
+        strcmp(str + strLen - suffixLen, suffix) == 0;
+}
+
+/*
+ * Write the profile so far.  We write a temporary file and rename it, so
+ * anybody reading the profile never sees half of one.
+ */
+void dvmCpuProfilerWrite(void)
+{
+    const char* fileName = gDvm.cpuProfileFile;
+    FrameTable frames;
+    char* tmpName;
+    FILE* fp;
+    bool ok;
+
+    if (gDvm.cpuProfileStacks == NULL)
+        return;
+
+    tmpName = (char*) malloc(strlen(fileName) + sizeof(".tmp"));
+    if (tmpName == NULL)
+        return;
+    sprintf(tmpName, "%s.tmp", fileName);
+
+    fp = fopen(tmpName, "w");
+    if (fp == NULL) {
+        LOGW("CPU profiler: unable to open '%s': %s\n",
+            tmpName, strerror(errno));
+        free(tmpName);
+        return;
+    }
+
+    memset(&frames, 0, sizeof(frames));
+    frames.byFrame = dvmHashTableCreate(1024, freeFrameInfo);
+
+    dvmLockMutex(&gDvm.cpuProfilerLock);
+    if (frames.byFrame == NULL) {
+        ok = false;
+    } else if (hasSuffix(fileName, ".pb") || hasSuffix(fileName, ".pprof")) {
+        ok = writePprof(fp, &frames);
+    } else {
+        FoldedContext ctx;
+
+        ctx.fp = fp;
+        ctx.pFrames = &frames;
+        ctx.failed = false;
+        dvmHashForeach(gDvm.cpuProfileStacks, writeFoldedStack, &ctx);
+        ok = !ctx.failed;
+    }
+    LOGD("CPU profiler: %llu samples in %d stacks, %llu dropped\n",
+        gDvm.cpuProfileSamples, dvmHashTableNumEntries(gDvm.cpuProfileStacks),
+        gDvm.cpuProfileDropped);
+    dvmUnlockMutex(&gDvm.cpuProfilerLock);
+
+    dvmHashTableFree(frames.byFrame);
+    free(frames.list);
+
+    if (ferror(fp))
+        ok = false;
+    if (fclose(fp) != 0)
+        ok = false;
+    if (ok && rename(tmpName, fileName) != 0) {
+        LOGW("CPU profiler: unable to rename '%s': %s\n",
+            tmpName, strerror(errno));
+        ok = false;
+    }
+    if (!ok) {
+        LOGW("CPU profiler: failed writing '%s'\n", fileName);
+        unlink(tmpName);
+    }
+    free(tmpName);
+}
+
+/*
+ * ===========================================================================
+ *      Startup and shutdown
+ * ===========================================================================
+ */
+
+/*
+ * Replace a "%p" in the file name with our pid, so each process started
+ * from the zygote gets its own profile.
+ */
+static char* expandFileName(const char* fileName)
+{
+    const char* pct = strstr(fileName, "%p");
+    char pidStr[16];
+    char* result;
+
+    if (pct == NULL)
+        return strdup(fileName);
+
+    snprintf(pidStr, sizeof(pidStr), "%d", (int) getpid());
+    result = (char*) malloc(strlen(fileName) - 2 + strlen(pidStr) + 1);
+    if (result == NULL)
+        return NULL;
+    sprintf(result, "%.*s%s%s", (int) (pct - fileName), fileName, pidStr,
+        pct + 2);
+    return result;
+}
+
+/*
+ * Start the profiler, if -Xcpuprofile asked for it.  This happens after
+ * the zygote fork.
+ *
+ * Not being able to profile isn't worth failing VM startup for, so we
+ * complain and carry on.
+ */
+bool dvmCpuProfilerStartup(void)
+{
+    struct sigaction sa;
+    struct timeval tv;
+    char* fileName;
+
+    if (gDvm.cpuProfileFile == NULL)
+        return true;
+
+    fileName = expandFileName(gDvm.cpuProfileFile);
+    if (fileName == NULL)
+        return false;
+    free(gDvm.cpuProfileFile);
+    gDvm.cpuProfileFile = fileName;
+
+    dvmInitMutex(&gDvm.cpuProfilerLock);
+    pthread_cond_init(&gDvm.cpuProfilerCond, NULL);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = cpuProfSignalHandler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, NULL) != 0) {
+        LOGW("CPU profiler: unable to handle SIGPROF: %s\n", strerror(errno));
+        return true;
+    }
+
+    gDvm.cpuProfileStacks = dvmHashTableCreate(1024, free);
+    if (gDvm.cpuProfileStacks == NULL)
+        return false;
+    gettimeofday(&tv, NULL);
+    gDvm.cpuProfileStartWallNsec = (tv.tv_sec * 1000000LL + tv.tv_usec) * 1000;
+
+    if (!dvmCreateInternalThread(&gDvm.cpuProfilerHandle, "CPU Profiler",
+            cpuProfilerThreadStart, NULL))
+    {
+        dvmHashTableFree(gDvm.cpuProfileStacks);
+        gDvm.cpuProfileStacks = NULL;
+        return false;
+    }
+
+    LOGI("CPU profiler: sampling at %d Hz of thread CPU time into '%s'\n",
+        gDvm.cpuProfileHz, gDvm.cpuProfileFile);
+    return true;
+}
+
+/*
+ * Stop the timers, collect what's left, and write the profile one last
+ * time.  Threads keep their rings; they free them when they exit.
+ */
+void dvmCpuProfilerShutdown(void)
+{
+    Thread* thread;
+
+    if (gDvm.cpuProfileStacks == NULL)
+        return;
+
+    dvmLockMutex(&gDvm.cpuProfilerLock);
+    gDvm.haltCpuProfiler = true;
+    pthread_cond_signal(&gDvm.cpuProfilerCond);
+    dvmUnlockMutex(&gDvm.cpuProfilerLock);
+    pthread_join(gDvm.cpuProfilerHandle, NULL);
+
+    dvmLockThreadList(NULL);
+    dvmLockMutex(&gDvm.cpuProfilerLock);
+    for (thread = gDvm.threadList; thread != NULL; thread = thread->next) {
+        CpuSampleRing* ring = thread->cpuSampleRing;
+
+        if (ring == NULL)
+            continue;
+        if (ring->timerLive) {
+            timer_delete(ring->timer);
+            ring->timerLive = false;
+        }
+        drainRing(ring);
+    }
+    dvmUnlockMutex(&gDvm.cpuProfilerLock);
+    dvmUnlockThreadList();
+
+    dvmCpuProfilerWrite();
+
+    dvmLockMutex(&gDvm.cpuProfilerLock);
+    dvmHashTableFree(gDvm.cpuProfileStacks);
+    gDvm.cpuProfileStacks = NULL;
+    dvmUnlockMutex(&gDvm.cpuProfilerLock);
+}
+
+#endif /*WITH_PROFILER*/
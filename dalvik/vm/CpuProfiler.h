@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Statistical CPU profiler, driven by per-thread CPU timers (-Xcpuprofile).
+ */
+#ifndef _DALVIK_CPUPROFILER
+#define _DALVIK_CPUPROFILER
+
+#include <time.h>
+
+struct Thread;
+
+/*
+ * Samples from one thread, written by that thread's SIGPROF handler and
+ * read by the profiler thread.  Each sample is a frame count followed by
+ * that many frames, innermost first.
+ */
+#define kCpuSampleRingSize  2048            /* slots; must be power of 2 */
+
+typedef struct CpuSampleRing {
+    volatile u4 head;                       /* next slot the handler fills */
+    volatile u4 tail;                       /* next slot the reader reads */
+    volatile u4 dropped;                    /* samples that didn't fit */
+    u4          droppedSeen;                /* "dropped" at the last read */
+
+    timer_t     timer;                      /* fires SIGPROF at the thread */
+    bool        timerLive;
+
+    uintptr_t   slots[kCpuSampleRingSize];
+} CpuSampleRing;
+
+/*
+ * Start and stop the profiler.  Startup does nothing unless -Xcpuprofile
+ * was given.
+ */
+bool dvmCpuProfilerStartup(void);
+void dvmCpuProfilerShutdown(void);
+
+/*
+ * Write the profile collected so far.
+ */
+void dvmCpuProfilerWrite(void);
+
+/*
+ * Called when a thread is removed from the thread list.  Must be called
+ * by the thread itself, with the thread list lock held.
+ */
+void dvmCpuProfilerThreadExit(struct Thread* self);
+
+#endif /*_DALVIK_CPUPROFILER*/
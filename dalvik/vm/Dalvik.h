@@ -41,6 +41,8 @@
 #include "DalvikVersion.h"
 #include "Debugger.h"
 #include "Profile.h"
+#include "CpuProfiler.h"
+#include "PerfMap.h"
 #include "UtfString.h"
 #include "Intern.h"
 #include "ReferenceTable.h"
@@ -53,6 +55,7 @@
 #include "oo/Class.h"
 #include "oo/Resolve.h"
 #include "oo/Array.h"
+#include "oo/FieldLayout.h"
 #include "Exception.h"
 #include "alloc/Alloc.h"
 #include "alloc/HeapDebug.h"
@@ -64,6 +67,7 @@
 #include "jdwp/Jdwp.h"
 #include "SignalCatcher.h"
 #include "StdioConverter.h"
+#include "StatsPage.h"
 #include "JniInternal.h"
 #include "LinearAlloc.h"
 #include "analysis/DexVerify.h"
@@ -292,24 +292,24 @@ void dvmDdmSendThreadNotification(Thread* thread, bool started)
     u1 buf[256];
 
     if (started) {
-        const u2* chars;
+        u2 chars[(sizeof(buf) - sizeof(u4)*2) / 2];
+        const u2* inChars = chars;
         u2* outChars;
         size_t stringLen;
 
         type = CHUNK_TYPE("THCR");
 
-        if (nameObj != NULL) {
+        if (nameObj != NULL)
             stringLen = dvmStringLen(nameObj);
-            chars = dvmStringChars(nameObj);
-        } else {
+        else
             stringLen = 0;
-            chars = NULL;
-        }
 
         /* leave room for the two integer fields */
-        if (stringLen > (sizeof(buf) - sizeof(u4)*2) / 2)
-            stringLen = (sizeof(buf) - sizeof(u4)*2) / 2;
+        if (stringLen > NELEM(chars))
+            stringLen = NELEM(chars);
         len = stringLen*2 + sizeof(u4)*2;
+        if (stringLen > 0)
+            dvmStringCopyChars(nameObj, 0, stringLen, chars);
 
         set4BE(&buf[0x00], thread->threadId);
         set4BE(&buf[0x04], stringLen);
@@ -317,7 +317,7 @@ void dvmDdmSendThreadNotification(Thread* thread, bool started)
         /* copy the UTF-16 string, transforming to big-endian */
         outChars = (u2*) &buf[0x08];
         while (stringLen--)
-            set2BE((u1*) (outChars++), *chars++);
+            set2BE((u1*) (outChars++), *inChars++);
     } else {
         type = CHUNK_TYPE("THDE");
 
@@ -338,7 +338,10 @@ void dvmDdmSendThreadNameChange(int threadId, StringObject* newName)
         return;
 
     size_t stringLen = dvmStringLen(newName);
-    const u2* chars = dvmStringChars(newName);
+    u2 chars[stringLen];
+    const u2* inChars = chars;
+
+    dvmStringCopyChars(newName, 0, stringLen, chars);
 
     /*
      * Output format:
@@ -353,7 +356,7 @@ void dvmDdmSendThreadNameChange(int threadId, StringObject* newName)
     set4BE(&buf[0x04], stringLen);
     u2* outChars = (u2*) &buf[0x08];
     while (stringLen--)
-        set2BE((u1*) (outChars++), *chars++);
+        set2BE((u1*) (outChars++), *inChars++);
 
     dvmDbgDdmSendChunk(CHUNK_TYPE("THNM"), bufLen, buf);
 }
@@ -100,6 +100,7 @@ LOCAL_SRC_FILES := \
 	AllocTracker.c \
 	AtomicCache.c \
 	CheckJni.c \
+	CpuProfiler.c \
 	Ddm.c \
 	Debugger.c \
 	DvmDex.c \
@@ -115,12 +116,14 @@ LOCAL_SRC_FILES := \
 	LinearAlloc.c \
 	Misc.c.arm \
 	Native.c \
+	PerfMap.c \
 	PointerSet.c \
 	Profile.c \
 	Properties.c \
 	RawDexFile.c \
 	ReferenceTable.c \
 	SignalCatcher.c \
+	StatsPage.c \
 	StdioConverter.c \
 	Sync.c \
 	TestCompability.c \
@@ -186,6 +189,7 @@ LOCAL_SRC_FILES := \
 	oo/AccessCheck.c \
 	oo/Array.c \
 	oo/Class.c \
+	oo/FieldLayout.c \
 	oo/Object.c \
 	oo/Resolve.c \
 	oo/TypeCheck.c \
@@ -193,8 +197,12 @@ LOCAL_SRC_FILES := \
 	reflect/Proxy.c \
 	reflect/Reflect.c \
 	test/AtomicSpeed.c \
+	test/TestFieldLayout.c \
 	test/TestHash.c \
-	test/TestIndirectRefTable.c
+	test/TestIndirectRefTable.c \
+	test/TestJniPin.c \
+	test/TestNativeLookup.c \
+	test/TestUtfString.c
 
 WITH_JIT := $(strip $(WITH_JIT))
 
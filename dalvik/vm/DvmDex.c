@@ -87,7 +87,8 @@ static DvmDex* allocateAuxStructures(DexFile* pDexFile)
         pDvmDex, stringCount, classCount, methodCount, fieldCount,
         (stringCount + classCount + methodCount + fieldCount) * 4);
 
-    pDvmDex->pInterfaceCache = dvmAllocAtomicCache(DEX_INTERFACE_CACHE_SIZE);
+    pDvmDex->pInterfaceCache = dvmAllocAtomicCache(DEX_INTERFACE_CACHE_SIZE,
+        "interface");
 
     if (pDvmDex->pResStrings == NULL ||
         pDvmDex->pResClasses == NULL ||
@@ -95,6 +95,39 @@ Current plan is option (b), because it's simple, fast, and doesn't change
 the way the stack works.
 */
 
+/*
+ * Number of entries in the catch handler cache.  MUST be a power of 2.
+ */
+#define CATCH_HANDLER_CACHE_SIZE    256
+
+/*
+ * Decoded form of a method's try/catch tables.  The DEX form has to be
+ * binary-searched and LEB128-decoded on every throw; this is built once
+ * per method, the first time an exception passes through it.
+ *
+ * "clazz" is filled in as catch classes are resolved.  Classes are never
+ * unloaded, so once set it stays valid.
+ */
+typedef struct CatchTable CatchTable;
+
+typedef struct CatchHandlerEntry {
+    u4              typeIdx;        /* kDexNoIndex for a catch-all */
+    u4              address;        /* handler address */
+    ClassObject*    clazz;          /* resolved catch class, or NULL */
+} CatchHandlerEntry;
+
+typedef struct CatchRange {
+    u4              startAddr;
+    u4              endAddr;        /* exclusive */
+    int             handlerCount;
+    CatchHandlerEntry* handlers;
+} CatchRange;
+
+struct CatchTable {
+    int             rangeCount;
+    CatchRange*     ranges;         /* sorted by address, no overlaps */
+};
+
 /* fwd */
 static bool initException(Object* exception, const char* msg, Object* cause,
     Thread* self);
@@ -170,6 +203,11 @@ bool dvmExceptionStartup(void)
         return false;
     }
 
+    gDvm.catchHandlerCache = dvmAllocAtomicCache(CATCH_HANDLER_CACHE_SIZE,
+        "catch handler");
+    if (gDvm.catchHandlerCache == NULL)
+        return false;
+
     return true;
 }
 
@@ -178,7 +216,18 @@ bool dvmExceptionStartup(void)
  */
 void dvmExceptionShutdown(void)
 {
-    // nothing to do
+    int i;
+
+    for (i = 0; i < gDvm.noStackTraceClassCount; i++)
+        free(gDvm.noStackTraceClasses[i]);
+    free(gDvm.noStackTraceClasses);
+    gDvm.noStackTraceClasses = NULL;
+    gDvm.noStackTraceClassCount = 0;
+
+    if (CALC_CACHE_STATS && gDvm.catchHandlerCache != NULL)
+        dvmDumpAtomicCacheStats(gDvm.catchHandlerCache);
+    dvmFreeAtomicCache(gDvm.catchHandlerCache);
+    gDvm.catchHandlerCache = NULL;
 }
 
 
@@ -752,111 +801,294 @@ void dvmPrintExceptionStackTrace(void)
 }
 
 /*
- * Search the method's list of exceptions for a match.
+ * Decode the try/catch tables for "method" into a CatchTable.  Everything
+ * lives in a single allocation, so it can be discarded with free().
  *
- * Returns the offset of the catch block on success, or -1 on failure.
+ * Returns NULL if the method has no try blocks.
  */
-static int findCatchInMethod(Thread* self, const Method* method, int relPc,
-    ClassObject* excepClass)
+static CatchTable* buildCatchTable(const Method* method)
 {
+    const DexCode* pCode = dvmGetMethodCode(method);
+    const DexTry* pTries = dexGetTries(pCode);
+    CatchTable* pTable;
+    CatchHandlerEntry* pEntry;
+    DexCatchIterator iterator;
+    int triesSize = pCode->triesSize;
+    int handlerCount, i;
+
+    if (triesSize == 0)
+        return NULL;
+
     /*
-     * Need to clear the exception before entry.  Otherwise, dvmResolveClass
-     * might think somebody threw an exception while it was loading a class.
+     * Handler lists are frequently shared between try blocks.  We just
+     * copy them out for each range; they're short.
      */
-    assert(!dvmCheckException(self));
-    assert(!dvmIsNativeMethod(method));
+    handlerCount = 0;
+    for (i = 0; i < triesSize; i++) {
+        dexCatchIteratorInit(&iterator, pCode, pTries[i].handlerOff);
+        while (dexCatchIteratorNext(&iterator) != NULL)
+            handlerCount++;
+    }
 
-    LOGVV("findCatchInMethod %s.%s excep=%s depth=%d\n",
-        method->clazz->descriptor, method->name, excepClass->descriptor,
-        dvmComputeExactFrameDepth(self->curFrame));
+    pTable = (CatchTable*) malloc(sizeof(CatchTable) +
+                sizeof(CatchRange) * triesSize +
+                sizeof(CatchHandlerEntry) * handlerCount);
+    if (pTable == NULL) {
+        LOGE("Unable to allocate catch table for %s.%s\n",
+            method->clazz->descriptor, method->name);
+        dvmAbort();
+    }
+    pTable->rangeCount = triesSize;
+    pTable->ranges = (CatchRange*) (pTable + 1);
+    pEntry = (CatchHandlerEntry*) (pTable->ranges + triesSize);
+
+    for (i = 0; i < triesSize; i++) {
+        CatchRange* pRange = &pTable->ranges[i];
+        DexCatchHandler* handler;
+
+        pRange->startAddr = pTries[i].startAddr;
+        pRange->endAddr = pTries[i].startAddr + pTries[i].insnCount;
+        pRange->handlers = pEntry;
+        pRange->handlerCount = 0;
+
+        dexCatchIteratorInit(&iterator, pCode, pTries[i].handlerOff);
+        while ((handler = dexCatchIteratorNext(&iterator)) != NULL) {
+            pEntry->typeIdx = handler->typeIdx;
+            pEntry->address = handler->address;
+            pEntry->clazz = NULL;
+            pEntry++;
+            pRange->handlerCount++;
+        }
+    }
+
+    return pTable;
+}
+
+/*
+ * Free a catch table.
+ */
+void dvmFreeCatchTable(CatchTable* pTable)
+{
+    free(pTable);
+}
+
+/*
+ * Get the catch table for "method", building it if necessary.
+ *
+ * Two threads may race to build the same table; the loser throws its
+ * copy away.
+ */
+static CatchTable* getCatchTable(Method* method)
+{
+    ClassObject* clazz = method->clazz;
+    CatchTable* pTable;
 
+    pTable = method->catchTable;
+    if (pTable != NULL)
+        return pTable;
+
+    pTable = buildCatchTable(method);
+    if (pTable == NULL)
+        return NULL;
+
+    /* might be virtual or direct */
+    dvmLinearReadWrite(clazz->classLoader, clazz->virtualMethods);
+    dvmLinearReadWrite(clazz->classLoader, clazz->directMethods);
+
+    if (!ATOMIC_CMP_SWAP((int32_t*)(void*)&method->catchTable,
+            (int32_t) NULL, (int32_t) pTable))
+    {
+        dvmFreeCatchTable(pTable);
+        pTable = method->catchTable;
+    }
+
+    dvmLinearReadOnly(clazz->classLoader, clazz->virtualMethods);
+    dvmLinearReadOnly(clazz->classLoader, clazz->directMethods);
+
+    return pTable;
+}
+
+/*
+ * Find the try range that covers "relPc", or NULL if there isn't one.
+ */
+static const CatchRange* findCatchRange(const CatchTable* pTable, u4 relPc)
+{
+    int lo = 0;
+    int hi = pTable->rangeCount - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) >> 1;
+        const CatchRange* pRange = &pTable->ranges[mid];
+
+        if (relPc < pRange->startAddr)
+            hi = mid - 1;
+        else if (relPc >= pRange->endAddr)
+            lo = mid + 1;
+        else
+            return pRange;
+    }
+
+    return NULL;
+}
+
+/*
+ * Resolve the catch classes for a try range.
+ *
+ * Returns "false" if one or more classes could not be resolved.  Those
+ * entries can never match, but because the failure might be transient
+ * (e.g. we ran off the end of the stack) we don't cache anything for the
+ * range until everything resolves.
+ */
+static bool resolveCatchRange(Thread* self, const Method* method,
+    const CatchRange* pRange)
+{
     DvmDex* pDvmDex = method->clazz->pDvmDex;
-    const DexCode* pCode = dvmGetMethodCode(method);
-    DexCatchIterator iterator;
+    bool result = true;
+    int i;
 
-    if (dexFindCatchHandler(&iterator, pCode, relPc)) {
-        for (;;) {
-            DexCatchHandler* handler = dexCatchIteratorNext(&iterator);
+    for (i = 0; i < pRange->handlerCount; i++) {
+        CatchHandlerEntry* pEntry = &pRange->handlers[i];
+        ClassObject* throwable;
 
-            if (handler == NULL) {
-                break;
-            }
-                
-            if (handler->typeIdx == kDexNoIndex) {
-                /* catch-all */
-                LOGV("Match on catch-all block at 0x%02x in %s.%s for %s\n",
-                        relPc, method->clazz->descriptor,
-                        method->name, excepClass->descriptor);
-                return handler->address;
-            }
+        if (pEntry->typeIdx == kDexNoIndex || pEntry->clazz != NULL)
+            continue;
 
-            ClassObject* throwable =
-                dvmDexGetResolvedClass(pDvmDex, handler->typeIdx);
+        throwable = dvmDexGetResolvedClass(pDvmDex, pEntry->typeIdx);
+        if (throwable == NULL) {
+            /*
+             * TODO: this behaves badly if we run off the stack
+             * while trying to throw an exception.  The problem is
+             * that, if we're in a class loaded by a class loader,
+             * the call to dvmResolveClass has to ask the class
+             * loader for help resolving any previously-unresolved
+             * classes.  If this particular class loader hasn't
+             * resolved StackOverflowError, it will call into
+             * interpreted code, and blow up.
+             *
+             * We currently replace the previous exception with
+             * the StackOverflowError, which means they won't be
+             * catching it *unless* they explicitly catch
+             * StackOverflowError, in which case we'll be unable
+             * to resolve the class referred to by the "catch"
+             * block.
+             *
+             * We end up getting a huge pile of warnings if we do
+             * a simple synthetic test, because this method gets
+             * called on every stack frame up the tree, and it
+             * fails every time.
+             *
+             * This eventually bails out, effectively becoming an
+             * uncatchable exception, so other than the flurry of
+             * warnings it's not really a problem.  Still, we could
+             * probably handle this better.
+             */
+            throwable = dvmResolveClass(method->clazz, pEntry->typeIdx, true);
             if (throwable == NULL) {
                 /*
-                 * TODO: this behaves badly if we run off the stack
-                 * while trying to throw an exception.  The problem is
-                 * that, if we're in a class loaded by a class loader,
-                 * the call to dvmResolveClass has to ask the class
-                 * loader for help resolving any previously-unresolved
-                 * classes.  If this particular class loader hasn't
-                 * resolved StackOverflowError, it will call into
-                 * interpreted code, and blow up.
-                 *
-                 * We currently replace the previous exception with
-                 * the StackOverflowError, which means they won't be
-                 * catching it *unless* they explicitly catch
-                 * StackOverflowError, in which case we'll be unable
-                 * to resolve the class referred to by the "catch"
-                 * block.
-                 *
-                 * We end up getting a huge pile of warnings if we do
-                 * a simple synthetic test, because this method gets
-                 * called on every stack frame up the tree, and it
-                 * fails every time.
-                 *
-                 * This eventually bails out, effectively becoming an
-                 * uncatchable exception, so other than the flurry of
-                 * warnings it's not really a problem.  Still, we could
-                 * probably handle this better.
+                 * We couldn't find the exception they wanted in
+                 * our class files (or, perhaps, the stack blew up
+                 * while we were querying a class loader). Cough
+                 * up a warning, then move on to the next entry.
+                 * Keep the exception status clear.
                  */
-                throwable = dvmResolveClass(method->clazz, handler->typeIdx,
-                    true);
-                if (throwable == NULL) {
-                    /*
-                     * We couldn't find the exception they wanted in
-                     * our class files (or, perhaps, the stack blew up
-                     * while we were querying a class loader). Cough
-                     * up a warning, then move on to the next entry.
-                     * Keep the exception status clear.
-                     */
-                    LOGW("Could not resolve class ref'ed in exception "
-                            "catch list (class index %d, exception %s)\n",
-                            handler->typeIdx,
-                            (self->exception != NULL) ?
-                            self->exception->clazz->descriptor : "(none)");
-                    dvmClearException(self);
-                    continue;
-                }
+                LOGW("Could not resolve class ref'ed in exception "
+                        "catch list (class index %d, exception %s)\n",
+                        pEntry->typeIdx,
+                        (self->exception != NULL) ?
+                        self->exception->clazz->descriptor : "(none)");
+                dvmClearException(self);
+                result = false;
+                continue;
             }
+        }
 
-            //LOGD("ADDR MATCH, check %s instanceof %s\n",
-            //    excepClass->descriptor, pEntry->excepClass->descriptor);
+        pEntry->clazz = throwable;
+    }
 
-            if (dvmInstanceof(excepClass, throwable)) {
-                LOGV("Match on catch block at 0x%02x in %s.%s for %s\n",
-                        relPc, method->clazz->descriptor,
-                        method->name, excepClass->descriptor);
-                return handler->address;
-            }
+    return result;
+}
+
+/*
+ * Walk the handlers for a try range, returning the address of the first
+ * one that catches "excepClass", or -1 if none do.
+ */
+static int matchCatchRange(const CatchRange* pRange,
+    const ClassObject* excepClass)
+{
+    int i;
+
+    for (i = 0; i < pRange->handlerCount; i++) {
+        const CatchHandlerEntry* pEntry = &pRange->handlers[i];
+
+        if (pEntry->typeIdx == kDexNoIndex) {
+            /* catch-all */
+            return pEntry->address;
         }
+
+        //LOGD("ADDR MATCH, check %s instanceof %s\n",
+        //    excepClass->descriptor, pEntry->clazz->descriptor);
+
+        if (pEntry->clazz != NULL && dvmInstanceof(excepClass, pEntry->clazz))
+            return pEntry->address;
     }
 
-    LOGV("No matching catch block at 0x%02x in %s for %s\n",
-        relPc, method->name, excepClass->descriptor);
     return -1;
 }
 
+/*
+ * Search the method's list of exceptions for a match.
+ *
+ * Returns the offset of the catch block on success, or -1 on failure.
+ */
+static int findCatchInMethod(Thread* self, const Method* method, int relPc,
+    ClassObject* excepClass)
+{
+    const CatchTable* pTable;
+    const CatchRange* pRange;
+    int catchAddr;
+
+    /*
+     * Need to clear the exception before entry.  Otherwise, dvmResolveClass
+     * might think somebody threw an exception while it was loading a class.
+     */
+    assert(!dvmCheckException(self));
+    assert(!dvmIsNativeMethod(method));
+
+    LOGVV("findCatchInMethod %s.%s excep=%s depth=%d\n",
+        method->clazz->descriptor, method->name, excepClass->descriptor,
+        dvmComputeExactFrameDepth(self->curFrame));
+
+    /* most frames have no try blocks at all */
+    if (dvmGetMethodCode(method)->triesSize == 0)
+        return -1;
+
+    pTable = getCatchTable((Method*) method);
+    pRange = findCatchRange(pTable, relPc);
+    if (pRange == NULL) {
+        catchAddr = -1;
+    } else if (!resolveCatchRange(self, method, pRange) ||
+        gDvm.catchHandlerCache == NULL)
+    {
+        catchAddr = matchCatchRange(pRange, excepClass);
+    } else {
+        /* cache stores address+1, so that an empty entry reads as "none" */
+#define ATOMIC_CACHE_CALC (matchCatchRange(pRange, excepClass) + 1)
+        catchAddr = (int) ATOMIC_CACHE_LOOKUP_SELF(self,
+                        gDvm.catchHandlerCache, pRange, excepClass) - 1;
+#undef ATOMIC_CACHE_CALC
+    }
+
+    if (catchAddr >= 0) {
+        LOGV("Match on catch block at 0x%02x in %s.%s for %s\n",
+                relPc, method->clazz->descriptor,
+                method->name, excepClass->descriptor);
+    } else {
+        LOGV("No matching catch block at 0x%02x in %s for %s\n",
+            relPc, method->name, excepClass->descriptor);
+    }
+    return catchAddr;
+}
+
 /*
  * Find a matching "catch" block.  "pc" is the relative PC within the
  * current method, indicating the offset from the start in 16-bit units.
@@ -960,6 +1192,27 @@ int dvmFindCatchBlock(Thread* self, int relPc, Object* exception,
     return catchAddr;
 }
 
+/*
+ * Returns "true" if stack traces for instances of "clazz" have been
+ * suppressed with -Xnostacktrace.  Subclasses of a listed class are
+ * suppressed as well.
+ */
+static bool isNoStackTraceClass(const ClassObject* clazz)
+{
+    int i;
+
+    if (gDvm.noStackTraceClassCount == 0)
+        return false;
+
+    for ( ; clazz != NULL; clazz = clazz->super) {
+        for (i = 0; i < gDvm.noStackTraceClassCount; i++) {
+            if (strcmp(clazz->descriptor, gDvm.noStackTraceClasses[i]) == 0)
+                return true;
+        }
+    }
+    return false;
+}
+
 /*
  * We have to carry the exception's stack trace around, but in many cases
  * it will never be examined.  It makes sense to keep it in a compact,
@@ -976,6 +1229,10 @@ int dvmFindCatchBlock(Thread* self, int relPc, Object* exception,
  * presently an array of integers, but could become something else in the
  * future.  If "wantObject" is false, return plain malloc data.
  *
+ * Only the object form is used for Throwable, so only the object form
+ * honors -Xstacktracedepth and -Xnostacktrace.  Thread dumps and DDMS
+ * always get the full stack.
+ *
  * NOTE: if we support class unloading, we will need to scan the class
  * object references out of these arrays.
  */
@@ -983,9 +1240,10 @@ void* dvmFillInStackTraceInternal(Thread* thread, bool wantObject, int* pCount)
 {
     ArrayObject* stackData = NULL;
     int* simpleData = NULL;
+    const ClassObject* excepClass = NULL;
     void* fp;
     void* startFp;
-    int stackDepth;
+    int stackDepth, maxDepth;
     int* intPtr;
 
     if (pCount != NULL)
@@ -1014,19 +1272,39 @@ void* dvmFillInStackTraceInternal(Thread* thread, bool wantObject, int* pCount)
             break;
         //LOGD("EXCEP: ignoring %s.%s\n",
         //         method->clazz->descriptor, method->name);
+        excepClass = method->clazz;
         fp = saveArea->prevFrame;
     }
     startFp = fp;
 
     /*
-     * Compute the stack depth.
+     * The last Throwable method we scraped off is normally the <init> of
+     * the most-derived class, so it tells us what's being constructed
+     * without having to dig "this" out of the frame.
+     */
+    maxDepth = 0;
+    if (wantObject) {
+        if (excepClass != NULL && isNoStackTraceClass(excepClass)) {
+            /* empty trace; getStackTrace() returns a zero-length array */
+            stackData = dvmAllocPrimitiveArray('I', 0, ALLOC_DEFAULT);
+            goto bail;
+        }
+        maxDepth = gDvm.stackTraceDepthLimit;
+    }
+
+    /*
+     * Compute the stack depth.  With a depth limit we stop walking as
+     * soon as we have enough frames.
      */
     stackDepth = 0;
     while (fp != NULL) {
         const StackSaveArea* saveArea = SAVEAREA_FROM_FP(fp);
 
-        if (!dvmIsBreakFrame(fp))
+        if (!dvmIsBreakFrame(fp)) {
             stackDepth++;
+            if (stackDepth == maxDepth)
+                break;
+        }
 
         assert(fp != saveArea->prevFrame);
         fp = saveArea->prevFrame;
@@ -1062,10 +1340,11 @@ void* dvmFillInStackTraceInternal(Thread* thread, bool wantObject, int* pCount)
         *pCount = stackDepth;
 
     fp = startFp;
-    while (fp != NULL) {
+    while (stackDepth > 0) {
         const StackSaveArea* saveArea = SAVEAREA_FROM_FP(fp);
         const Method* method = saveArea->method;
 
+        assert(fp != NULL);
         if (!dvmIsBreakFrame(fp)) {
             //LOGD("EXCEP keeping %s.%s\n", method->clazz->descriptor,
             //         method->name);
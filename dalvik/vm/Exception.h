@@ -177,6 +177,11 @@ void dvmLogExceptionStackTrace(void);
 int dvmFindCatchBlock(Thread* self, int relPc, Object* exception,
     bool doUnroll, void** newFrame);
 
+/*
+ * Free the decoded catch table hanging off a Method.
+ */
+void dvmFreeCatchTable(struct CatchTable* pTable);
+
 /*
  * Support for saving exception stack traces and converting them to
  * usable form.  Use the "FillIn" function to generate a compact array
@@ -108,11 +108,28 @@ struct DvmGlobals {
     bool        verifyDexChecksum;
     char*       stackTraceFile;     // for SIGQUIT-inspired output
 
+    /*
+     * Throwable stack trace capture.  "stackTraceDepthLimit" caps the
+     * number of frames recorded for a new exception (0 means no limit).
+     * Exceptions whose class is, or is a subclass of, one of the
+     * "noStackTraceClasses" descriptors get an empty trace.
+     */
+    int         stackTraceDepthLimit;
+    int         noStackTraceClassCount;
+    char**      noStackTraceClasses;
+
     bool        logStdio;
 
     DexOptimizerMode    dexOptMode;
     DexClassVerifyMode  classVerifyMode;
     bool        preciseGc;
+    bool        stringDedupGc;
+    bool        atomicCacheL0;
+    bool        atomicCacheGrow;
+
+    /* instance field access profile from -Xfieldlayout, or NULL */
+    char*       fieldLayoutFile;
+    struct HashTable* fieldLayoutProfile;
     bool        generateRegisterMaps;
 
     int         assertionCtrlCount;
@@ -165,9 +182,9 @@ struct DvmGlobals {
     InitiatingLoaderList* initiatingLoaderList;
 
     /*
-     * Interned strings.
+     * Interned strings (see Intern.c).
      */
-    HashTable*  internedStrings;
+    struct InternStripe* internStripes;
 
     /*
      * Quick lookups for popular classes used internally.
@@ -218,6 +235,9 @@ struct DvmGlobals {
     ClassObject* classArrayInt;
     ClassObject* classArrayLong;
 
+    /* box classes (e.g. java/lang/Integer), indexed by PrimitiveType */
+    ClassObject* boxClasses[PRIM_MAX];
+
     /* method offsets - Object */
     int         voffJavaLangObject_equals;
     int         voffJavaLangObject_hashCode;
@@ -233,6 +253,7 @@ struct DvmGlobals {
     int         offJavaLangString_count;
     int         offJavaLangString_offset;
     int         offJavaLangString_hashCode;
+    int         offJavaLangString_coder;
 
     /* field offsets - Thread */
     int         offJavaLangThread_vmThread;
@@ -406,6 +427,10 @@ struct DvmGlobals {
      * on a condition variable.
      */
     int         nonDaemonThreadCount;   /* must hold threadListLock to access */
+
+    /* threads on the list, and ever added to it; guarded by threadListLock */
+    int         threadCount;
+    u4          threadsStarted;
     //pthread_mutex_t vmExitLock;
     pthread_cond_t  vmExitCond;
 
@@ -415,22 +440,32 @@ struct DvmGlobals {
     HashTable*  userDexFiles;
 
     /*
-     * JNI global reference table.
+     * JNI global reference table.  Without indirect references the table
+     * is striped by object address; jniGlobalRefLock then only guards the
+     * usage tracking marks.
      */
 #ifdef USE_INDIRECT_REF
     IndirectRefTable jniGlobalRefTable;
 #else
-    ReferenceTable  jniGlobalRefTable;
+    JniRefStripe    jniGlobalRefStripes[kJniRefStripes];
 #endif
     pthread_mutex_t jniGlobalRefLock;
     int         jniGlobalRefHiMark;
     int         jniGlobalRefLoMark;
 
     /*
-     * JNI pinned object table (used for primitive arrays).
+     * JNI pinned object table (used for primitive arrays), striped by
+     * object address.
      */
-    ReferenceTable  jniPinRefTable;
-    pthread_mutex_t jniPinRefLock;
+    JniRefStripe    jniPinRefStripes[kJniRefStripes];
+
+    /*
+     * Critical pins are tracked per thread (Thread.jniCriticalPinTable);
+     * these hold the counts from threads that have exited.  Updated
+     * while holding threadListLock.
+     */
+    u4          jniCriticalPinRetired;
+    u4          jniCriticalUnpinRetired;
 
     /* special ReferenceQueue for JNI weak globals */
     Object*     jniWeakGlobalRefQueue;
@@ -440,6 +475,10 @@ struct DvmGlobals {
      */
     HashTable*  nativeLibs;
 
+    /* shared-lib JNI method resolution stats (updated under no lock) */
+    u4          nativeResolveCount;
+    u8          nativeResolveTimeNsec;
+
     /*
      * GC heap lock.  Functions like gcMalloc() acquire this before making
      * any changes to the heap.  It is held throughout garbage collection.
@@ -449,6 +488,13 @@ struct DvmGlobals {
     /* Opaque pointer representing the heap. */
     GcHeap*     gcHeap;
 
+    /* GC totals, for the stats page; updated while holding gcHeapLock */
+    u4          gcCount;
+    u8          gcTotalMsec;
+    u4          gcLastMsec;
+    u8          gcFreedObjects;
+    u8          gcFreedBytes;
+
     /*
      * Pre-allocated throwables.
      */
@@ -459,6 +505,10 @@ struct DvmGlobals {
     /* Monitor list, so we can free them */
     /*volatile*/ Monitor* monitorList;
 
+    /* monitors created (thin locks inflated), and freed by the GC */
+    volatile int32_t monitorsCreated;
+    u4          monitorsFreed;
+
     /* Monitor for Thread.sleep() implementation */
     Monitor*    threadSleepMon;
 
@@ -481,6 +531,29 @@ struct DvmGlobals {
      */
     AtomicCache* instanceofCache;
 
+    /*
+     * Cache results of "which handler in this try range catches an
+     * exception of class X".
+     */
+    AtomicCache* catchHandlerCache;
+
+    /*
+     * Cache results of reflective method access checks, keyed on the
+     * calling class and the target Method.
+     */
+    AtomicCache* reflectAccessCache;
+
+    /*
+     * All AtomicCaches, for stats, and counts from the L0 caches of
+     * threads that have exited.  "atomicCacheEpoch" changes whenever a
+     * cache is freed; see AtomicCacheL0.
+     */
+    pthread_mutex_t atomicCacheLock;
+    AtomicCache* atomicCacheList;
+    volatile u4 atomicCacheEpoch;
+    u8          atomicCacheL0Hits;
+    u8          atomicCacheL0Misses;
+
     /* instruction width table, used for optimization and verification */
     InstructionWidth*   instrWidth;
     /* instruction flags table, used for verification */
@@ -578,6 +651,17 @@ struct DvmGlobals {
     enum { kDPOff=0, kDPWarn, kDPErr, kDPAbort } deadlockPredictMode;
 #endif
 
+    /*
+     * Shared-memory stats page (-Xstatsfile).
+     */
+    char*       statsFile;
+    int         statsIntervalMsec;
+    struct StatsPage* statsPage;
+    pthread_t   statsPageHandle;
+    pthread_mutex_t statsPageLock;
+    pthread_cond_t statsPageCond;
+    bool        haltStatsPage;
+
 #ifdef WITH_PROFILER
     /*
      * When a profiler is enabled, this is incremented.  Distinct profilers
@@ -593,6 +677,32 @@ struct DvmGlobals {
      * State for method-trace profiling.
      */
     MethodTraceState methodTrace;
+    ProfilerClockSource profilerClockSource;
+
+    /*
+     * State for the sampling CPU profiler (-Xcpuprofile).  The stack table
+     * and the totals are guarded by cpuProfilerLock.
+     */
+    char*       cpuProfileFile;
+    int         cpuProfileHz;
+    pthread_t   cpuProfilerHandle;
+    pthread_mutex_t cpuProfilerLock;
+    pthread_cond_t cpuProfilerCond;
+    bool        haltCpuProfiler;
+    bool        cpuProfilerTimersFailed;
+    struct HashTable* cpuProfileStacks;
+    u8          cpuProfileSamples;
+    u8          cpuProfileDropped;
+    u8          cpuProfileStartWallNsec;
+
+    /*
+     * Symbols for native profilers (-Xperfmap, -Xperfshadow).
+     */
+    bool        perfMap;
+    bool        perfShadow;
+    pthread_mutex_t perfMapLock;
+    FILE*       perfCodeFile;           // /tmp/perf-<pid>.map
+    FILE*       perfMethodFile;         // /tmp/perf-<pid>.methods
 
     /*
      * State for emulator tracing.
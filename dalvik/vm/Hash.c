@@ -15,8 +15,19 @@
  */
 /*
  * Hash table.  The dominant calls are add and lookup, with removals
- * happening very infrequently.  We use probing, and don't worry much
- * about tombstone removal.
+ * happening very infrequently.
+ *
+ * We use open addressing with Robin Hood insertion: an entry being added
+ * displaces any entry that is closer to its home slot than the new one
+ * would be.  That keeps probe sequences short and evenly spread, and it
+ * lets a failed lookup stop as soon as it reaches an entry that is closer
+ * to home than the key would be, instead of walking to the next empty
+ * slot.  Removal shifts the rest of the run back one slot ("backward-shift
+ * deletion"), so there are no tombstones and no slow decay as entries come
+ * and go.
+ *
+ * Each entry keeps its full hash value next to the data pointer, so the
+ * compare function is only called when the hash matches.
  */
 #include "Dalvik.h"
 
@@ -54,7 +65,7 @@ HashTable* dvmHashTableCreate(size_t initialSize, HashFreeFunc freeFunc)
     dvmInitMutex(&pHashTable->lock);
 
     pHashTable->tableSize = dexRoundUpPower2(initialSize);
-    pHashTable->numEntries = pHashTable->numDeadEntries = 0;
+    pHashTable->numEntries = 0;
     pHashTable->freeFunc = freeFunc;
     pHashTable->pEntries =
         (HashEntry*) malloc(pHashTable->tableSize * sizeof(HashEntry));
@@ -77,10 +88,7 @@ void dvmHashTableClear(HashTable* pHashTable)
 
     pEnt = pHashTable->pEntries;
     for (i = 0; i < pHashTable->tableSize; i++, pEnt++) {
-        if (pEnt->data == HASH_TOMBSTONE) {
-            // nuke entry
-            pEnt->data = NULL;
-        } else if (pEnt->data != NULL) {
+        if (pEnt->data != NULL) {
             // call free func then nuke entry
             if (pHashTable->freeFunc != NULL)
                 (*pHashTable->freeFunc)(pEnt->data);
@@ -89,7 +97,6 @@ void dvmHashTableClear(HashTable* pHashTable)
     }
 
     pHashTable->numEntries = 0;
-    pHashTable->numDeadEntries = 0;
 }
 
 /*
@@ -104,21 +111,70 @@ void dvmHashTableFree(HashTable* pHashTable)
     free(pHashTable);
 }
 
-#ifndef NDEBUG
 /*
- * Count up the number of tombstone entries in the hash table.
+ * How far the entry in slot "idx" sits from its home slot.
  */
-static int countTombStones(HashTable* pHashTable)
+static inline int probeDistance(u4 hashValue, int idx, int mask)
 {
-    int i, count;
+    return (idx - (int) (hashValue & mask)) & mask;
+}
 
-    for (count = i = 0; i < pHashTable->tableSize; i++) {
-        if (pHashTable->pEntries[i].data == HASH_TOMBSTONE)
-            count++;
+/*
+ * Place an entry, starting the search at slot "idx", which is "dist"
+ * slots from the entry's home.  Whenever we pass an entry that is closer
+ * to its own home than we are to ours, we take its slot and carry the
+ * displaced entry forward instead.
+ *
+ * The table must have at least one empty slot.
+ */
+static void robinHoodInsert(HashEntry* pEntries, int mask, int idx, int dist,
+    u4 hashValue, void* data)
+{
+    while (pEntries[idx].data != NULL) {
+        HashEntry* pEntry = &pEntries[idx];
+        int entryDist = probeDistance(pEntry->hashValue, idx, mask);
+
+        if (entryDist < dist) {
+            u4 tmpHash = pEntry->hashValue;
+            void* tmpData = pEntry->data;
+
+            pEntry->hashValue = hashValue;
+            pEntry->data = data;
+            hashValue = tmpHash;
+            data = tmpData;
+            dist = entryDist;
+        }
+
+        idx = (idx + 1) & mask;
+        dist++;
     }
-    return count;
+
+    pEntries[idx].hashValue = hashValue;
+    pEntries[idx].data = data;
+}
+
+/*
+ * Remove the entry in slot "idx" by sliding the rest of its run back one
+ * slot.  The run ends at an empty slot or at an entry already in its home
+ * slot.
+ */
+static void backwardShiftRemove(HashTable* pHashTable, int idx)
+{
+    HashEntry* pEntries = pHashTable->pEntries;
+    int mask = pHashTable->tableSize - 1;
+    int next = (idx + 1) & mask;
+
+    while (pEntries[next].data != NULL &&
+        probeDistance(pEntries[next].hashValue, next, mask) != 0)
+    {
+        pEntries[idx] = pEntries[next];
+        idx = next;
+        next = (next + 1) & mask;
+    }
+
+    pEntries[idx].data = NULL;
+    pHashTable->numEntries--;
 }
-#endif
 
 /*
  * Resize a hash table.  We do this when adding an entry increased the
@@ -133,10 +189,7 @@ static int countTombStones(HashTable* pHashTable)
 static bool resizeHash(HashTable* pHashTable, int newSize)
 {
     HashEntry* pNewEntries;
-    int i;
-
-    assert(countTombStones(pHashTable) == pHashTable->numDeadEntries);
-    //LOGI("before: dead=%d\n", pHashTable->numDeadEntries);
+    int i, newMask = newSize - 1;
 
     pNewEntries = (HashEntry*) calloc(newSize, sizeof(HashEntry));
     if (pNewEntries == NULL)
@@ -144,29 +197,59 @@ static bool resizeHash(HashTable* pHashTable, int newSize)
 
     for (i = 0; i < pHashTable->tableSize; i++) {
         void* data = pHashTable->pEntries[i].data;
-        if (data != NULL && data != HASH_TOMBSTONE) {
-            int hashValue = pHashTable->pEntries[i].hashValue;
-            int newIdx;
-
-            /* probe for new spot, wrapping around */
-            newIdx = hashValue & (newSize-1);
-            while (pNewEntries[newIdx].data != NULL)
-                newIdx = (newIdx + 1) & (newSize-1);
+        if (data != NULL) {
+            u4 hashValue = pHashTable->pEntries[i].hashValue;
 
-            pNewEntries[newIdx].hashValue = hashValue;
-            pNewEntries[newIdx].data = data;
+            robinHoodInsert(pNewEntries, newMask, hashValue & newMask, 0,
+                hashValue, data);
         }
     }
 
     free(pHashTable->pEntries);
     pHashTable->pEntries = pNewEntries;
     pHashTable->tableSize = newSize;
-    pHashTable->numDeadEntries = 0;
-
-    assert(countTombStones(pHashTable) == 0);
     return true;
 }
 
+/*
+ * Find the slot holding "item", or return -1.  "*pDist" is set to the
+ * probe distance at which the search stopped, which for a miss is where
+ * the item would be inserted.
+ */
+static inline int findSlot(const HashTable* pHashTable, u4 itemHash,
+    const void* item, HashCompareFunc cmpFunc, int* pIdx, int* pDist)
+{
+    const HashEntry* pEntries = pHashTable->pEntries;
+    int mask = pHashTable->tableSize - 1;
+    int idx = itemHash & mask;
+    int dist = 0;
+
+    while (true) {
+        const HashEntry* pEntry = &pEntries[idx];
+
+        if (pEntry->data == NULL ||
+            probeDistance(pEntry->hashValue, idx, mask) < dist)
+        {
+            /* empty slot, or an entry that would have been displaced */
+            break;
+        }
+        if (pEntry->hashValue == itemHash &&
+            (*cmpFunc)(pEntry->data, item) == 0)
+        {
+            *pIdx = idx;
+            *pDist = dist;
+            return idx;
+        }
+
+        idx = (idx + 1) & mask;
+        dist++;
+    }
+
+    *pIdx = idx;
+    *pDist = dist;
+    return -1;
+}
+
 /*
  * Look up an entry.
  *
@@ -175,72 +258,37 @@ static bool resizeHash(HashTable* pHashTable, int newSize)
 void* dvmHashTableLookup(HashTable* pHashTable, u4 itemHash, void* item,
     HashCompareFunc cmpFunc, bool doAdd)
 {
-    HashEntry* pEntry;
-    HashEntry* pEnd;
-    void* result = NULL;
+    int idx, dist;
 
     assert(pHashTable->tableSize > 0);
-    assert(item != HASH_TOMBSTONE);
     assert(item != NULL);
 
-    /* jump to the first entry and probe for a match */
-    pEntry = &pHashTable->pEntries[itemHash & (pHashTable->tableSize-1)];
-    pEnd = &pHashTable->pEntries[pHashTable->tableSize];
-    while (pEntry->data != NULL) {
-        if (pEntry->data != HASH_TOMBSTONE &&
-            pEntry->hashValue == itemHash &&
-            (*cmpFunc)(pEntry->data, item) == 0)
-        {
-            /* match */
-            //LOGD("+++ match on entry %d\n", pEntry - pHashTable->pEntries);
-            break;
-        }
-
-        pEntry++;
-        if (pEntry == pEnd) {     /* wrap around to start */
-            if (pHashTable->tableSize == 1)
-                break;      /* edge case - single-entry table */
-            pEntry = pHashTable->pEntries;
-        }
+    if (findSlot(pHashTable, itemHash, item, cmpFunc, &idx, &dist) >= 0)
+        return pHashTable->pEntries[idx].data;
 
-        //LOGI("+++ look probing %d...\n", pEntry - pHashTable->pEntries);
-    }
+    if (!doAdd)
+        return NULL;
 
-    if (pEntry->data == NULL) {
-        if (doAdd) {
-            pEntry->hashValue = itemHash;
-            pEntry->data = item;
-            pHashTable->numEntries++;
-
-            /*
-             * We've added an entry.  See if this brings us too close to full.
-             */
-            if ((pHashTable->numEntries+pHashTable->numDeadEntries) * LOAD_DENOM
-                > pHashTable->tableSize * LOAD_NUMER)
-            {
-                if (!resizeHash(pHashTable, pHashTable->tableSize * 2)) {
-                    /* don't really have a way to indicate failure */
-                    LOGE("Dalvik hash resize failure\n");
-                    dvmAbort();
-                }
-                /* note "pEntry" is now invalid */
-            } else {
-                //LOGW("okay %d/%d/%d\n",
-                //    pHashTable->numEntries, pHashTable->tableSize,
-                //    (pHashTable->tableSize * LOAD_NUMER) / LOAD_DENOM);
-            }
+    robinHoodInsert(pHashTable->pEntries, pHashTable->tableSize - 1, idx, dist,
+        itemHash, item);
+    pHashTable->numEntries++;
 
-            /* full table is bad -- search for nonexistent never halts */
-            assert(pHashTable->numEntries < pHashTable->tableSize);
-            result = item;
-        } else {
-            assert(result == NULL);
+    /*
+     * We've added an entry.  See if this brings us too close to full.
+     */
+    if (pHashTable->numEntries * LOAD_DENOM
+        > pHashTable->tableSize * LOAD_NUMER)
+    {
+        if (!resizeHash(pHashTable, pHashTable->tableSize * 2)) {
+            /* don't really have a way to indicate failure */
+            LOGE("Dalvik hash resize failure\n");
+            dvmAbort();
         }
-    } else {
-        result = pEntry->data;
     }
 
-    return result;
+    /* full table is bad -- search for nonexistent never halts */
+    assert(pHashTable->numEntries < pHashTable->tableSize);
+    return item;
 }
 
 /*
@@ -250,31 +298,24 @@ void* dvmHashTableLookup(HashTable* pHashTable, u4 itemHash, void* item,
  */
 bool dvmHashTableRemove(HashTable* pHashTable, u4 itemHash, void* item)
 {
-    HashEntry* pEntry;
-    HashEntry* pEnd;
+    HashEntry* pEntries = pHashTable->pEntries;
+    int mask = pHashTable->tableSize - 1;
+    int idx = itemHash & mask;
+    int dist = 0;
 
     assert(pHashTable->tableSize > 0);
 
     /* jump to the first entry and probe for a match */
-    pEntry = &pHashTable->pEntries[itemHash & (pHashTable->tableSize-1)];
-    pEnd = &pHashTable->pEntries[pHashTable->tableSize];
-    while (pEntry->data != NULL) {
-        if (pEntry->data == item) {
-            //LOGI("+++ stepping on entry %d\n", pEntry - pHashTable->pEntries);
-            pEntry->data = HASH_TOMBSTONE;
-            pHashTable->numEntries--;
-            pHashTable->numDeadEntries++;
+    while (pEntries[idx].data != NULL &&
+        probeDistance(pEntries[idx].hashValue, idx, mask) >= dist)
+    {
+        if (pEntries[idx].data == item) {
+            backwardShiftRemove(pHashTable, idx);
             return true;
         }
 
-        pEntry++;
-        if (pEntry == pEnd) {     /* wrap around to start */
-            if (pHashTable->tableSize == 1)
-                break;      /* edge case - single-entry table */
-            pEntry = pHashTable->pEntries;
-        }
-
-        //LOGI("+++ del probing %d...\n", pEntry - pHashTable->pEntries);
+        idx = (idx + 1) & mask;
+        dist++;
     }
 
     return false;
@@ -288,25 +329,40 @@ bool dvmHashTableRemove(HashTable* pHashTable, u4 itemHash, void* item)
  * Does NOT invoke the "free" function on the item.
  *
  * Returning values other than 0 or 1 will abort the routine.
+ *
+ * Removing an entry pulls the following entries in its run back a slot,
+ * so after a removal we look at the same slot again.  We start the scan
+ * just past an empty slot, so nothing can be shifted back across our
+ * starting point and get visited twice.
  */
 int dvmHashForeachRemove(HashTable* pHashTable, HashForeachRemoveFunc func)
 {
-    int i, val;
+    int mask = pHashTable->tableSize - 1;
+    int start, i, count, val;
 
-    for (i = 0; i < pHashTable->tableSize; i++) {
+    if (pHashTable->numEntries == 0)
+        return 0;
+
+    for (start = 0; pHashTable->pEntries[start].data != NULL; start++)
+        ;
+    start = (start + 1) & mask;
+
+    i = start;
+    for (count = 0; count < pHashTable->tableSize; count++) {
         HashEntry* pEnt = &pHashTable->pEntries[i];
 
-        if (pEnt->data != NULL && pEnt->data != HASH_TOMBSTONE) {
+        while (pEnt->data != NULL) {
             val = (*func)(pEnt->data);
             if (val == 1) {
-                pEnt->data = HASH_TOMBSTONE;
-                pHashTable->numEntries--;
-                pHashTable->numDeadEntries++;
-            }
-            else if (val != 0) {
+                backwardShiftRemove(pHashTable, i);
+            } else if (val != 0) {
                 return val;
+            } else {
+                break;
             }
         }
+
+        i = (i + 1) & mask;
     }
     return 0;
 }
@@ -324,7 +380,7 @@ int dvmHashForeach(HashTable* pHashTable, HashForeachFunc func, void* arg)
     for (i = 0; i < pHashTable->tableSize; i++) {
         HashEntry* pEnt = &pHashTable->pEntries[i];
 
-        if (pEnt->data != NULL && pEnt->data != HASH_TOMBSTONE) {
+        if (pEnt->data != NULL) {
             val = (*func)(pEnt->data, arg);
             if (val != 0)
                 return val;
@@ -343,39 +399,15 @@ int dvmHashForeach(HashTable* pHashTable, HashForeachFunc func, void* arg)
 static int countProbes(HashTable* pHashTable, u4 itemHash, const void* item,
     HashCompareFunc cmpFunc)
 {
-    HashEntry* pEntry;
-    HashEntry* pEnd;
-    int count = 0;
+    int idx, dist;
 
     assert(pHashTable->tableSize > 0);
-    assert(item != HASH_TOMBSTONE);
     assert(item != NULL);
 
-    /* jump to the first entry and probe for a match */
-    pEntry = &pHashTable->pEntries[itemHash & (pHashTable->tableSize-1)];
-    pEnd = &pHashTable->pEntries[pHashTable->tableSize];
-    while (pEntry->data != NULL) {
-        if (pEntry->data != HASH_TOMBSTONE &&
-            pEntry->hashValue == itemHash &&
-            (*cmpFunc)(pEntry->data, item) == 0)
-        {
-            /* match */
-            break;
-        }
-
-        pEntry++;
-        if (pEntry == pEnd) {     /* wrap around to start */
-            if (pHashTable->tableSize == 1)
-                break;      /* edge case - single-entry table */
-            pEntry = pHashTable->pEntries;
-        }
-
-        count++;
-    }
-    if (pEntry->data == NULL)
+    if (findSlot(pHashTable, itemHash, item, cmpFunc, &idx, &dist) < 0)
         return -1;
 
-    return count;
+    return dist;
 }
 
 /*
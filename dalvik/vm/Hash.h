@@ -51,10 +51,9 @@ typedef int (*HashForeachRemoveFunc)(void* data);
 /*
  * One entry in the hash table.  "data" values are expected to be (or have
  * the same characteristics as) valid pointers.  In particular, a NULL
- * value for "data" indicates an empty slot, and HASH_TOMBSTONE indicates
- * a no-longer-used slot that must be stepped over during probing.
+ * value for "data" indicates an empty slot.
  *
- * Attempting to add a NULL or tombstone value is an error.
+ * Attempting to add a NULL value is an error.
  *
  * When an entry is released, we will call (HashFreeFunc)(entry->data).
  */
@@ -63,8 +62,6 @@ typedef struct HashEntry {
     void* data;
 } HashEntry;
 
-#define HASH_TOMBSTONE ((void*) 0xcbcacccd)     // invalid ptr value
-
 /*
  * Expandable hash table.
  *
@@ -73,7 +70,6 @@ typedef struct HashEntry {
 typedef struct HashTable {
     int         tableSize;          /* must be power of 2 */
     int         numEntries;         /* current #of "live" entries */
-    int         numDeadEntries;     /* current #of tombstone entries */
     HashEntry*  pEntries;           /* array on heap */
     HashFreeFunc freeFunc;
     pthread_mutex_t lock;
@@ -148,6 +144,10 @@ void* dvmHashTableLookup(HashTable* pHashTable, u4 itemHash, void* item,
 /*
  * Remove an item from the hash table, given its "data" pointer.  Does not
  * invoke the "free" function; just detaches it from the table.
+ *
+ * Removal moves other entries around, so don't call this while walking
+ * the table with dvmHashForeach() or a HashIter; use
+ * dvmHashForeachRemove() instead.
  */
 bool dvmHashTableRemove(HashTable* pHashTable, u4 hash, void* item);
 
@@ -189,7 +189,7 @@ INLINE void dvmHashIterNext(HashIter* pIter) {
     int lim = pIter->pHashTable->tableSize;
     for ( ; i < lim; i++) {
         void* data = pIter->pHashTable->pEntries[i].data;
-        if (data != NULL && data != HASH_TOMBSTONE)
+        if (data != NULL)
             break;
     }
     pIter->idx = i;
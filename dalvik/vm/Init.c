@@ -106,7 +106,22 @@ static void dvmUsage(const char* progName)
     dvmFprintf(stderr, "  -Xjniopts:{warnonly,forcecopy}\n");
     dvmFprintf(stderr, "  -Xdeadlockpredict:{off,warn,err,abort}\n");
     dvmFprintf(stderr, "  -Xstacktracefile:<filename>\n");
+    dvmFprintf(stderr, "  -Xstacktracedepth:N  (0 means no limit)\n");
+    dvmFprintf(stderr, "  -Xnostacktrace:<class name>[,<class name>]*\n");
     dvmFprintf(stderr, "  -Xgc:[no]precise\n");
+    dvmFprintf(stderr, "  -Xgc:[no]dedup\n");
+    dvmFprintf(stderr, "  -Xatomiccache:{[no]l0,[no]grow}\n");
+    dvmFprintf(stderr,
+                "  -Xfieldlayout:<profile file>  (needs -Xdexopt:none)\n");
+    dvmFprintf(stderr, "  -Xstatsfile:<filename>  (%%p is replaced by the pid)\n");
+    dvmFprintf(stderr, "  -Xstatsinterval:N  (msec, default 1000)\n");
+#ifdef WITH_PROFILER
+    dvmFprintf(stderr, "  -Xprofile:{wallclock,threadcpuclock}\n");
+    dvmFprintf(stderr, "  -Xcpuprofile:<filename>  (%%p is replaced by the pid)\n");
+    dvmFprintf(stderr, "  -Xcpuprofilehz:N  (1-1000, default 100)\n");
+    dvmFprintf(stderr, "  -Xperfmap  (name generated code in /tmp/perf-<pid>.map)\n");
+    dvmFprintf(stderr, "  -Xperfshadow  (show Java frames to native profilers)\n");
+#endif
     dvmFprintf(stderr, "  -Xgenregmap\n");
     dvmFprintf(stderr, "  -Xcheckdexsum\n");
 #if defined(WITH_JIT)
@@ -550,6 +565,45 @@ void dvmLateEnableAssertions(void)
 }
 
 
+/*
+ * Parse -Xnostacktrace:<class>[,<class>]*, converting each dotted class
+ * name into a descriptor.  The list may be given more than once.
+ */
+static bool processXnostacktrace(const char* opt)
+{
+    char* buf = strdup(opt);
+    char* start = buf;
+    char* end;
+    bool result = true;
+
+    do {
+        end = strchr(start, ',');
+        if (end != NULL)
+            *end = '\0';
+
+        if (*start == '\0') {
+            result = false;
+            break;
+        }
+
+        char** newList = (char**) realloc(gDvm.noStackTraceClasses,
+            sizeof(char*) * (gDvm.noStackTraceClassCount + 1));
+        if (newList == NULL) {
+            result = false;
+            break;
+        }
+        gDvm.noStackTraceClasses = newList;
+        gDvm.noStackTraceClasses[gDvm.noStackTraceClassCount++] =
+            dvmDotToDescriptor(start);
+
+        if (end != NULL)
+            start = end + 1;
+    } while (end != NULL);
+
+    free(buf);
+    return result;
+}
+
 /*
  * Release memory associated with the AssertionCtrl array.
  */
@@ -955,6 +1009,22 @@ static int dvmProcessOptions(int argc, const char* const argv[],
         } else if (strncmp(argv[i], "-Xstacktracefile:", 17) == 0) {
             gDvm.stackTraceFile = strdup(argv[i]+17);
 
+        } else if (strncmp(argv[i], "-Xstacktracedepth:", 18) == 0) {
+            int depth = atoi(argv[i] + 18);
+            if (depth < 0) {
+                dvmFprintf(stderr, "Bad value for -Xstacktracedepth: '%s'\n",
+                    argv[i]+18);
+                return -1;
+            }
+            gDvm.stackTraceDepthLimit = depth;
+
+        } else if (strncmp(argv[i], "-Xnostacktrace:", 15) == 0) {
+            if (!processXnostacktrace(argv[i] + 15)) {
+                dvmFprintf(stderr, "Bad value for -Xnostacktrace: '%s'\n",
+                    argv[i]+15);
+                return -1;
+            }
+
         } else if (strcmp(argv[i], "-Xgenregmap") == 0) {
             gDvm.generateRegisterMaps = true;
             LOGV("Register maps will be generated during verification\n");
@@ -964,11 +1034,80 @@ static int dvmProcessOptions(int argc, const char* const argv[],
                 gDvm.preciseGc = true;
             else if (strcmp(argv[i] + 5, "noprecise") == 0)
                 gDvm.preciseGc = false;
+            else if (strcmp(argv[i] + 5, "dedup") == 0)
+                gDvm.stringDedupGc = true;
+            else if (strcmp(argv[i] + 5, "nodedup") == 0)
+                gDvm.stringDedupGc = false;
             else {
                 dvmFprintf(stderr, "Bad value for -Xgc");
                 return -1;
             }
             LOGV("Precise GC configured %s\n", gDvm.preciseGc ? "ON" : "OFF");
+            LOGV("String dedup configured %s\n",
+                gDvm.stringDedupGc ? "ON" : "OFF");
+
+        } else if (strncmp(argv[i], "-Xatomiccache:", 14) == 0) {
+            if (strcmp(argv[i] + 14, "l0") == 0)
+                gDvm.atomicCacheL0 = true;
+            else if (strcmp(argv[i] + 14, "nol0") == 0)
+                gDvm.atomicCacheL0 = false;
+            else if (strcmp(argv[i] + 14, "grow") == 0)
+                gDvm.atomicCacheGrow = true;
+            else if (strcmp(argv[i] + 14, "nogrow") == 0)
+                gDvm.atomicCacheGrow = false;
+            else {
+                dvmFprintf(stderr, "Bad value for -Xatomiccache: '%s'\n",
+                    argv[i]+14);
+                return -1;
+            }
+
+        } else if (strncmp(argv[i], "-Xfieldlayout:", 14) == 0) {
+            free(gDvm.fieldLayoutFile);
+            gDvm.fieldLayoutFile = strdup(argv[i] + 14);
+
+#ifdef WITH_PROFILER
+        } else if (strncmp(argv[i], "-Xprofile:", 10) == 0) {
+            if (strcmp(argv[i] + 10, "wallclock") == 0)
+                gDvm.profilerClockSource = kProfilerClockSourceWall;
+            else if (strcmp(argv[i] + 10, "threadcpuclock") == 0)
+                gDvm.profilerClockSource = kProfilerClockSourceThreadCpu;
+            else {
+                dvmFprintf(stderr, "Bad value for -Xprofile: '%s'\n",
+                    argv[i]+10);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "-Xcpuprofile:", 13) == 0) {
+            free(gDvm.cpuProfileFile);
+            gDvm.cpuProfileFile = strdup(argv[i] + 13);
+        } else if (strncmp(argv[i], "-Xcpuprofilehz:", 15) == 0) {
+            char* end;
+            long hz = strtol(argv[i] + 15, &end, 10);
+            if (end == argv[i] + 15 || *end != '\0' || hz < 1 || hz > 1000) {
+                dvmFprintf(stderr, "Bad value for -Xcpuprofilehz: '%s'\n",
+                    argv[i]+15);
+                return -1;
+            }
+            gDvm.cpuProfileHz = (int) hz;
+        } else if (strcmp(argv[i], "-Xperfmap") == 0) {
+            gDvm.perfMap = true;
+        } else if (strcmp(argv[i], "-Xperfshadow") == 0) {
+            gDvm.perfShadow = true;
+#endif
+
+        } else if (strncmp(argv[i], "-Xstatsfile:", 12) == 0) {
+            free(gDvm.statsFile);
+            gDvm.statsFile = strdup(argv[i] + 12);
+        } else if (strncmp(argv[i], "-Xstatsinterval:", 16) == 0) {
+            char* end;
+            long msec = strtol(argv[i] + 16, &end, 10);
+            if (end == argv[i] + 16 || *end != '\0' || msec < 10 ||
+                msec > 3600 * 1000)
+            {
+                dvmFprintf(stderr, "Bad value for -Xstatsinterval: '%s'\n",
+                    argv[i]+16);
+                return -1;
+            }
+            gDvm.statsIntervalMsec = (int) msec;
 
         } else if (strcmp(argv[i], "-Xcheckdexsum") == 0) {
             gDvm.verifyDexChecksum = true;
@@ -1025,6 +1164,18 @@ static void setCommandLineDefaults()
     gDvm.classVerifyMode = VERIFY_MODE_ALL;
     gDvm.dexOptMode = OPTIMIZE_MODE_VERIFIED;
 
+    /* shared caches grow when thrashed; per-thread front caches are opt-in */
+    gDvm.atomicCacheL0 = false;
+    gDvm.atomicCacheGrow = true;
+
+    /* update period for -Xstatsfile */
+    gDvm.statsIntervalMsec = 1000;
+
+#ifdef WITH_PROFILER
+    /* sampling rate for -Xcpuprofile */
+    gDvm.cpuProfileHz = 100;
+#endif
+
     /*
      * Default execution mode.
      *
@@ -1126,6 +1277,16 @@ int dvmStartup(int argc, const char* const argv[], bool ignoreUnrecognized,
         goto fail;
     }
 
+#ifdef WITH_PROFILER
+    /* only "portable" interp keeps the frame shadow up to date */
+    if (gDvm.perfShadow &&
+        gDvm.executionMode != kExecutionModeInterpPortable)
+    {
+        LOGI("Switching to 'portable' interpreter for -Xperfshadow\n");
+        gDvm.executionMode = kExecutionModeInterpPortable;
+    }
+#endif
+
 #if WITH_EXTRA_GC_CHECKS > 1
     /* only "portable" interp has the extra goodies */
     if (gDvm.executionMode != kExecutionModeInterpPortable) {
@@ -1174,8 +1335,12 @@ int dvmStartup(int argc, const char* const argv[], bool ignoreUnrecognized,
         goto fail;
     if (!dvmRegisterMapStartup())
         goto fail;
+    if (!dvmAtomicCacheStartup())
+        goto fail;
     if (!dvmInstanceofStartup())
         goto fail;
+    if (!dvmFieldLayoutStartup())
+        goto fail;
     if (!dvmClassStartup())
         goto fail;
     if (!dvmThreadObjStartup())
@@ -1287,8 +1452,20 @@ int dvmStartup(int argc, const char* const argv[], bool ignoreUnrecognized,
 #ifndef NDEBUG
     if (!dvmTestHash())
         LOGE("dmvTestHash FAILED\n");
+    if (false /*noisy!*/ && !dvmTestHashSpeed())
+        LOGE("dvmTestHashSpeed FAILED\n");
     if (false /*noisy!*/ && !dvmTestIndirectRefTable())
         LOGE("dvmTestIndirectRefTable FAILED\n");
+    if (!dvmTestFieldLayout())
+        LOGE("dvmTestFieldLayout FAILED\n");
+    if (false /*noisy!*/ && !dvmTestJniPin())
+        LOGE("dvmTestJniPin FAILED\n");
+    if (false /*noisy!*/ && !dvmTestNativeLookup())
+        LOGE("dvmTestNativeLookup FAILED\n");
+    if (!dvmTestUtfString())
+        LOGE("dvmTestUtfString FAILED\n");
+    if (false /*noisy!*/ && !dvmTestUtfStringSpeed())
+        LOGE("dvmTestUtfStringSpeed FAILED\n");
 #endif
 
     assert(!dvmCheckException(dvmThreadSelf()));
@@ -1379,6 +1556,20 @@ bool dvmInitAfterZygote(void)
             return false;
     }
 
+#ifdef WITH_PROFILER
+    /* start the sampling CPU profiler, if requested */
+    if (!dvmCpuProfilerStartup())
+        return false;
+
+    /* write symbols for native profilers, if requested */
+    if (!dvmPerfMapStartup())
+        return false;
+#endif
+
+    /* start updating the stats page, if requested */
+    if (!dvmStatsPageStartup())
+        return false;
+
     endQuit = dvmGetRelativeTimeUsec();
     startJdwp = dvmGetRelativeTimeUsec();
 
@@ -1529,6 +1720,8 @@ int dvmPrepForDexOpt(const char* bootClassPath, DexOptimizerMode dexOptMode,
         goto fail;
     if (!dvmRegisterMapStartup())
         goto fail;
+    if (!dvmAtomicCacheStartup())
+        goto fail;
     if (!dvmInstanceofStartup())
         goto fail;
     if (!dvmClassStartup())
@@ -1582,10 +1775,26 @@ void dvmShutdown(void)
     gDvm.jdwpHost = NULL;
     free(gDvm.stackTraceFile);
     gDvm.stackTraceFile = NULL;
+    free(gDvm.fieldLayoutFile);
+    gDvm.fieldLayoutFile = NULL;
 
     /* tell signal catcher to shut down if it was started */
     dvmSignalCatcherShutdown();
 
+#ifdef WITH_PROFILER
+    /* write the CPU profile and stop sampling */
+    dvmCpuProfilerShutdown();
+    free(gDvm.cpuProfileFile);
+    gDvm.cpuProfileFile = NULL;
+
+    dvmPerfMapShutdown();
+#endif
+
+    /* stop updating the stats page */
+    dvmStatsPageShutdown();
+    free(gDvm.statsFile);
+    gDvm.statsFile = NULL;
+
     /* shut down stdout/stderr conversion */
     dvmStdioConverterShutdown();
 
@@ -1616,6 +1825,7 @@ void dvmShutdown(void)
     dvmExceptionShutdown();
     dvmThreadShutdown();
     dvmClassShutdown();
+    dvmFieldLayoutShutdown();
     dvmVerificationShutdown();
     dvmRegisterMapShutdown();
     dvmInstanceofShutdown();
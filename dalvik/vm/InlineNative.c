@@ -22,6 +22,19 @@
 
 #include <math.h>
 
+/*
+ * The SSE2 string kernels are built for any x86 target.  x86-64 always
+ * has SSE2, so they're called directly; a 32-bit build may not be allowed
+ * to assume it, so there we pick a version once at startup.
+ */
+#if defined(__i386__) || defined(__x86_64__)
+# define WITH_SSE2_KERNELS
+# include <emmintrin.h>
+# ifndef __SSE2__
+#  define WITH_SSE2_DISPATCH
+# endif
+#endif
+
 #ifdef HAVE__MEMCMP16
 /* hand-coded assembly implementation, available on some platforms */
 //#warning "trying memcmp16"
@@ -109,6 +122,345 @@ static bool org_apache_harmony_dalvik_NativeTestTarget_emptyInlineMethod(
 }
 
 
+/*
+ * ===========================================================================
+ *      String array kernels
+ * ===========================================================================
+ */
+
+/*
+ * These do the heavy lifting for the String inlines.  On x86 we look at
+ * eight chars per step with SSE2; elsewhere we use simple loops, which
+ * are what the compiler handles best on ARM.  (On ARM the compare/equals
+ * inlines use __memcmp16 instead, where it's available.)
+ *
+ * Unaligned loads are fine; String data can start at any char offset.
+ *
+ * The "16" kernels work on the char[] of a UTF-16 String, the "8" ones on
+ * the byte[] of a Latin-1 String.
+ */
+
+/*
+ * Returns the index of the first char that differs between "s0" and
+ * "s1", or "count" if the first "count" chars are identical.
+ */
+static inline int firstMismatch16Generic(const u2* s0, const u2* s1,
+    int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (s0[i] != s1[i])
+            break;
+    }
+    return i;
+}
+
+/*
+ * Returns the index of the first occurrence of "ch" in chars[start,count),
+ * or -1.  "start" must be in [0..count].
+ */
+static inline int indexOfChar16Generic(const u2* chars, int start,
+    int count, u2 ch)
+{
+    int i;
+
+    for (i = start; i < count; i++) {
+        if (chars[i] == ch)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Returns the index of the last occurrence of "ch" in chars[0,start], or
+ * -1.  "start" must be in [-1..count-1].
+ */
+static inline int lastIndexOfChar16Generic(const u2* chars, int start, u2 ch)
+{
+    int i;
+
+    for (i = start; i >= 0; i--) {
+        if (chars[i] == ch)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Returns the index of the first char that differs between "s0" and
+ * "s1", or "count" if the first "count" chars are identical.
+ */
+static inline int firstMismatch8Generic(const u1* s0, const u1* s1,
+    int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (s0[i] != s1[i])
+            break;
+    }
+    return i;
+}
+
+/*
+ * Same, for a Latin-1 "s0" and a UTF-16 "s1".
+ */
+static inline int firstMismatchMixed(const u1* s0, const u2* s1, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (s0[i] != s1[i])
+            break;
+    }
+    return i;
+}
+
+/*
+ * Returns the index of the first occurrence of "ch" in chars[start,count),
+ * or -1.  "start" must be in [0..count].  libc's memchr() is already
+ * vectorized everywhere we run.
+ */
+static inline int indexOfChar8(const u1* chars, int start, int count, u1 ch)
+{
+    const u1* match = (const u1*) memchr(chars + start, ch, count - start);
+
+    return (match != NULL) ? match - chars : -1;
+}
+
+/*
+ * Returns the index of the last occurrence of "ch" in chars[0,start], or
+ * -1.  "start" must be in [-1..count-1].
+ */
+static inline int lastIndexOfChar8(const u1* chars, int start, u1 ch)
+{
+    int i;
+
+    for (i = start; i >= 0; i--) {
+        if (chars[i] == ch)
+            return i;
+    }
+    return -1;
+}
+
+#ifdef WITH_SSE2_KERNELS
+/* index of the lowest set bit; "mask" must be nonzero */
+# define LOWEST_BIT(mask)   __builtin_ctz(mask)
+/* index of the highest set bit; "mask" must be nonzero */
+# define HIGHEST_BIT(mask)  (31 - __builtin_clz(mask))
+
+/*
+ * SSE2 versions of the above.  They finish off with the generic ones.
+ */
+__attribute__((target("sse2")))
+static int firstMismatch16Sse2(const u2* s0, const u2* s1, int count)
+{
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*) (s0 + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*) (s1 + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v0, v1)) ^ 0xffff;
+        if (mask != 0)
+            return i + LOWEST_BIT(mask) / 2;
+    }
+    return i + firstMismatch16Generic(s0 + i, s1 + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static int indexOfChar16Sse2(const u2* chars, int start, int count, u2 ch)
+{
+    __m128i key = _mm_set1_epi16((short) ch);
+    int i;
+
+    for (i = start; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (chars + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, key));
+        if (mask != 0)
+            return i + LOWEST_BIT(mask) / 2;
+    }
+    return indexOfChar16Generic(chars, i, count, ch);
+}
+
+__attribute__((target("sse2")))
+static int lastIndexOfChar16Sse2(const u2* chars, int start, u2 ch)
+{
+    __m128i key = _mm_set1_epi16((short) ch);
+    int i;
+
+    for (i = start; i >= 7; i -= 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (chars + i - 7));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, key));
+        if (mask != 0)
+            return i - 7 + HIGHEST_BIT(mask) / 2;
+    }
+    return lastIndexOfChar16Generic(chars, i, ch);
+}
+
+__attribute__((target("sse2")))
+static int firstMismatch8Sse2(const u1* s0, const u1* s1, int count)
+{
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*) (s0 + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*) (s1 + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v0, v1)) ^ 0xffff;
+        if (mask != 0)
+            return i + LOWEST_BIT(mask);
+    }
+    return i + firstMismatch8Generic(s0 + i, s1 + i, count - i);
+}
+#endif /*WITH_SSE2_KERNELS*/
+
+/*
+ * The versions the inlines call.
+ */
+#if defined(WITH_SSE2_DISPATCH)
+/* set up by dvmInlineNativeStartup() */
+static int (*firstMismatch16)(const u2* s0, const u2* s1, int count) =
+    firstMismatch16Generic;
+static int (*indexOfChar16)(const u2* chars, int start, int count, u2 ch) =
+    indexOfChar16Generic;
+static int (*lastIndexOfChar16)(const u2* chars, int start, u2 ch) =
+    lastIndexOfChar16Generic;
+static int (*firstMismatch8)(const u1* s0, const u1* s1, int count) =
+    firstMismatch8Generic;
+#elif defined(WITH_SSE2_KERNELS)
+# define firstMismatch16    firstMismatch16Sse2
+# define indexOfChar16      indexOfChar16Sse2
+# define lastIndexOfChar16  lastIndexOfChar16Sse2
+# define firstMismatch8     firstMismatch8Sse2
+#else
+# define firstMismatch16    firstMismatch16Generic
+# define indexOfChar16      indexOfChar16Generic
+# define lastIndexOfChar16  lastIndexOfChar16Generic
+# define firstMismatch8     firstMismatch8Generic
+#endif
+
+/*
+ * The chars of a String, in whichever form it keeps them.
+ *
+ * This would be simpler and faster if we promoted StringObject to a full
+ * representation, lining up the C structure fields with the actual
+ * object fields.
+ */
+typedef struct StringChars {
+    union {
+        const u1*   latin1;
+        const u2*   utf16;
+    } u;
+    int         count;
+    bool        isLatin1;
+} StringChars;
+
+static inline void getStringChars(Object* strObj, StringChars* pChars)
+{
+    ArrayObject* value =
+        (ArrayObject*) dvmGetFieldObject(strObj, STRING_FIELDOFF_VALUE);
+    int offset = dvmGetFieldInt(strObj, STRING_FIELDOFF_OFFSET);
+
+    pChars->count = dvmGetFieldInt(strObj, STRING_FIELDOFF_COUNT);
+    pChars->isLatin1 = (dvmGetFieldInt(strObj, STRING_FIELDOFF_CODER)
+                            == STRING_CODER_LATIN1);
+    if (pChars->isLatin1)
+        pChars->u.latin1 = (const u1*) value->contents + offset;
+    else
+        pChars->u.utf16 = (const u2*) value->contents + offset;
+}
+
+static inline u2 stringCharAt(const StringChars* pChars, int index)
+{
+    if (pChars->isLatin1)
+        return pChars->u.latin1[index];
+    return pChars->u.utf16[index];
+}
+
+/*
+ * Returns the index of the first mismatch between the "count" chars of
+ * "s0" starting at "start0" and those of "s1" starting at "start1", or
+ * "count".  A UTF-16 String may still hold only Latin-1 chars, so the
+ * two can be equal even when their coders differ.
+ */
+static int stringFirstMismatch(const StringChars* s0, int start0,
+    const StringChars* s1, int start1, int count)
+{
+    if (s0->isLatin1 && s1->isLatin1) {
+        return firstMismatch8(s0->u.latin1 + start0, s1->u.latin1 + start1,
+                count);
+    } else if (!s0->isLatin1 && !s1->isLatin1) {
+        return firstMismatch16(s0->u.utf16 + start0, s1->u.utf16 + start1,
+                count);
+    } else if (s0->isLatin1) {
+        return firstMismatchMixed(s0->u.latin1 + start0,
+                s1->u.utf16 + start1, count);
+    } else {
+        return firstMismatchMixed(s1->u.latin1 + start1,
+                s0->u.utf16 + start0, count);
+    }
+}
+
+/*
+ * Index of the first "ch" in [start,count), or -1.
+ */
+static inline int stringIndexOfChar(const StringChars* pChars, int start,
+    int count, u2 ch)
+{
+    if (!pChars->isLatin1)
+        return indexOfChar16(pChars->u.utf16, start, count, ch);
+    if (ch > 0xff)
+        return -1;
+    return indexOfChar8(pChars->u.latin1, start, count, (u1) ch);
+}
+
+/*
+ * Index of the last "ch" in [0,start], or -1.
+ */
+static inline int stringLastIndexOfChar(const StringChars* pChars,
+    int start, u2 ch)
+{
+    if (!pChars->isLatin1)
+        return lastIndexOfChar16(pChars->u.utf16, start, ch);
+    if (ch > 0xff)
+        return -1;
+    return lastIndexOfChar8(pChars->u.latin1, start, (u1) ch);
+}
+
+/*
+ * Returns "true" if the chars of "s0" and "s1" from "start" on are equal
+ * ignoring ASCII case.  The two must be the same length.  Stops at the
+ * first char that isn't ASCII and isn't an exact match, and returns its
+ * index in "*pStop" ("count" if we made it to the end).
+ */
+static inline bool asciiEqualsIgnoreCase(const StringChars* s0,
+    const StringChars* s1, int start, int* pStop)
+{
+    int count = s0->count;
+    int i;
+
+    for (i = start; i < count; i++) {
+        u2 c0 = stringCharAt(s0, i);
+        u2 c1 = stringCharAt(s1, i);
+        if (c0 == c1)
+            continue;
+        if ((c0 | c1) >= 0x80)
+            break;
+        /* fold A-Z to a-z; anything else that differs is a mismatch */
+        if (c0 - 'A' < 26u)
+            c0 += 'a' - 'A';
+        if (c1 - 'A' < 26u)
+            c1 += 'a' - 'A';
+        if (c0 != c1) {
+            *pStop = i;
+            return false;
+        }
+    }
+    *pStop = i;
+    return true;
+}
+
+
 /*
  * ===========================================================================
  *      java.lang.String
@@ -121,24 +473,19 @@ static bool org_apache_harmony_dalvik_NativeTestTarget_emptyInlineMethod(
 static bool javaLangString_charAt(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
     JValue* pResult)
 {
-    int count, offset;
-    ArrayObject* chars;
+    StringChars chars;
 
     /* null reference check on "this" */
     if (!dvmValidateObject((Object*) arg0))
         return false;
 
     //LOGI("String.charAt this=0x%08x index=%d\n", arg0, arg1);
-    count = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_COUNT);
-    if ((s4) arg1 < 0 || (s4) arg1 >= count) {
+    getStringChars((Object*) arg0, &chars);
+    if ((s4) arg1 < 0 || (s4) arg1 >= chars.count) {
         dvmThrowException("Ljava/lang/StringIndexOutOfBoundsException;", NULL);
         return false;
     } else {
-        offset = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_OFFSET);
-        chars = (ArrayObject*)
-            dvmGetFieldObject((Object*) arg0, STRING_FIELDOFF_VALUE);
-
-        pResult->i = ((const u2*) chars->contents)[arg1 + offset];
+        pResult->i = stringCharAt(&chars, arg1);
         return true;
     }
 }
@@ -146,6 +493,7 @@ static bool javaLangString_charAt(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
 #ifdef CHECK_MEMCMP16
 /*
  * Utility function when we're evaluating alternative implementations.
+ * Only called for a pair of UTF-16 Strings.
  */
 static void badMatch(StringObject* thisStrObj, StringObject* compStrObj,
     int expectResult, int newResult, const char* compareType)
@@ -209,71 +557,55 @@ static bool javaLangString_compareTo(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
         return true;
     }
 
-    /*
-     * This would be simpler and faster if we promoted StringObject to
-     * a full representation, lining up the C structure fields with the
-     * actual object fields.
-     */
-    int thisCount, thisOffset, compCount, compOffset;
-    ArrayObject* thisArray;
-    ArrayObject* compArray;
-    const u2* thisChars;
-    const u2* compChars;
+    StringChars thisChars, compChars;
     int i, minCount, countDiff;
 
-    thisCount = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_COUNT);
-    compCount = dvmGetFieldInt((Object*) arg1, STRING_FIELDOFF_COUNT);
-    countDiff = thisCount - compCount;
-    minCount = (countDiff < 0) ? thisCount : compCount;
-    thisOffset = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_OFFSET);
-    compOffset = dvmGetFieldInt((Object*) arg1, STRING_FIELDOFF_OFFSET);
-    thisArray = (ArrayObject*)
-        dvmGetFieldObject((Object*) arg0, STRING_FIELDOFF_VALUE);
-    compArray = (ArrayObject*)
-        dvmGetFieldObject((Object*) arg1, STRING_FIELDOFF_VALUE);
-    thisChars = ((const u2*) thisArray->contents) + thisOffset;
-    compChars = ((const u2*) compArray->contents) + compOffset;
+    getStringChars((Object*) arg0, &thisChars);
+    getStringChars((Object*) arg1, &compChars);
+    countDiff = thisChars.count - compChars.count;
+    minCount = (countDiff < 0) ? thisChars.count : compChars.count;
 
 #ifdef HAVE__MEMCMP16
-    /*
-     * Use assembly version, which returns the difference between the
-     * characters.  The annoying part here is that 0x00e9 - 0xffff != 0x00ea,
-     * because the interpreter converts the characters to 32-bit integers
-     * *without* sign extension before it subtracts them (which makes some
-     * sense since "char" is unsigned).  So what we get is the result of
-     * 0x000000e9 - 0x0000ffff, which is 0xffff00ea.
-     */
-    int otherRes = __memcmp16(thisChars, compChars, minCount);
+    if (!thisChars.isLatin1 && !compChars.isLatin1) {
+        /*
+         * Use assembly version, which returns the difference between the
+         * characters.  The annoying part here is that 0x00e9 - 0xffff !=
+         * 0x00ea, because the interpreter converts the characters to
+         * 32-bit integers *without* sign extension before it subtracts
+         * them (which makes some sense since "char" is unsigned).  So what
+         * we get is the result of 0x000000e9 - 0x0000ffff, which is
+         * 0xffff00ea.
+         */
+        const u2* thisData = thisChars.u.utf16;
+        const u2* compData = compChars.u.utf16;
+        int otherRes = __memcmp16(thisData, compData, minCount);
 # ifdef CHECK_MEMCMP16
-    for (i = 0; i < minCount; i++) {
-        if (thisChars[i] != compChars[i]) {
-            pResult->i = (s4) thisChars[i] - (s4) compChars[i];
-            if (pResult->i != otherRes) {
-                badMatch((StringObject*) arg0, (StringObject*) arg1,
-                    pResult->i, otherRes, "compareTo");
+        for (i = 0; i < minCount; i++) {
+            if (thisData[i] != compData[i]) {
+                pResult->i = (s4) thisData[i] - (s4) compData[i];
+                if (pResult->i != otherRes) {
+                    badMatch((StringObject*) arg0, (StringObject*) arg1,
+                        pResult->i, otherRes, "compareTo");
+                }
+                return true;
             }
-            return true;
         }
-    }
 # endif
-    if (otherRes != 0) {
-        pResult->i = otherRes;
+        pResult->i = (otherRes != 0) ? otherRes : countDiff;
         return true;
     }
+#endif
 
-#else
     /*
-     * Straightforward implementation, examining 16 bits at a time.  Compare
-     * the characters that overlap, and if they're all the same then return
-     * the difference in lengths.
+     * Compare the characters that overlap, and if they're all the same
+     * then return the difference in lengths.
      */
-    for (i = 0; i < minCount; i++) {
-        if (thisChars[i] != compChars[i]) {
-            pResult->i = (s4) thisChars[i] - (s4) compChars[i];
-            return true;
-        }
+    i = stringFirstMismatch(&thisChars, 0, &compChars, 0, minCount);
+    if (i < minCount) {
+        pResult->i = (s4) stringCharAt(&thisChars, i) -
+                     (s4) stringCharAt(&compChars, i);
+        return true;
     }
-#endif
 
     pResult->i = countDiff;
     return true;
@@ -308,66 +640,38 @@ static bool javaLangString_equals(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
         return true;
     }
 
-    /*
-     * This would be simpler and faster if we promoted StringObject to
-     * a full representation, lining up the C structure fields with the
-     * actual object fields.
-     */
-    int thisCount, thisOffset, compCount, compOffset;
-    ArrayObject* thisArray;
-    ArrayObject* compArray;
-    const u2* thisChars;
-    const u2* compChars;
-    int i;
+    StringChars thisChars, compChars;
+    int count;
 
     /* quick length check */
-    thisCount = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_COUNT);
-    compCount = dvmGetFieldInt((Object*) arg1, STRING_FIELDOFF_COUNT);
-    if (thisCount != compCount) {
+    count = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_COUNT);
+    if (count != dvmGetFieldInt((Object*) arg1, STRING_FIELDOFF_COUNT)) {
         pResult->i = false;
         return true;
     }
 
-    thisOffset = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_OFFSET);
-    compOffset = dvmGetFieldInt((Object*) arg1, STRING_FIELDOFF_OFFSET);
-    thisArray = (ArrayObject*)
-        dvmGetFieldObject((Object*) arg0, STRING_FIELDOFF_VALUE);
-    compArray = (ArrayObject*)
-        dvmGetFieldObject((Object*) arg1, STRING_FIELDOFF_VALUE);
-    thisChars = ((const u2*) thisArray->contents) + thisOffset;
-    compChars = ((const u2*) compArray->contents) + compOffset;
+    getStringChars((Object*) arg0, &thisChars);
+    getStringChars((Object*) arg1, &compChars);
 
 #ifdef HAVE__MEMCMP16
-    pResult->i = (__memcmp16(thisChars, compChars, thisCount) == 0);
+    if (!thisChars.isLatin1 && !compChars.isLatin1) {
+        pResult->i =
+            (__memcmp16(thisChars.u.utf16, compChars.u.utf16, count) == 0);
 # ifdef CHECK_MEMCMP16
-    int otherRes = (memcmp(thisChars, compChars, thisCount * 2) == 0);
-    if (pResult->i != otherRes) {
-        badMatch((StringObject*) arg0, (StringObject*) arg1,
-            otherRes, pResult->i, "equals-1");
-    }
-# endif
-#else
-    /*
-     * Straightforward implementation, examining 16 bits at a time.  The
-     * direction of the loop doesn't matter, and starting at the end may
-     * give us an advantage when comparing certain types of strings (e.g.
-     * class names).
-     *
-     * We want to go forward for benchmarks against __memcmp16 so we get a
-     * meaningful comparison when the strings don't match (could also test
-     * with palindromes).
-     */
-    //for (i = 0; i < thisCount; i++)
-    for (i = thisCount-1; i >= 0; --i)
-    {
-        if (thisChars[i] != compChars[i]) {
-            pResult->i = false;
-            return true;
+        int otherRes =
+            (memcmp(thisChars.u.utf16, compChars.u.utf16, count * 2) == 0);
+        if (pResult->i != otherRes) {
+            badMatch((StringObject*) arg0, (StringObject*) arg1,
+                otherRes, pResult->i, "equals-1");
         }
+# endif
+        return true;
     }
-    pResult->i = true;
 #endif
 
+    /* (memcmp() would do, but this is quicker for short strings) */
+    pResult->i = (stringFirstMismatch(&thisChars, 0, &compChars, 0, count)
+                    == count);
     return true;
 }
 
@@ -404,38 +708,22 @@ static inline int indexOfCommon(Object* strObj, int ch, int start)
     //    return -1;
 
     /* pull out the basic elements */
-    ArrayObject* charArray =
-        (ArrayObject*) dvmGetFieldObject(strObj, STRING_FIELDOFF_VALUE);
-    const u2* chars = (const u2*) charArray->contents;
-    int offset = dvmGetFieldInt(strObj, STRING_FIELDOFF_OFFSET);
-    int count = dvmGetFieldInt(strObj, STRING_FIELDOFF_COUNT);
-    //LOGI("String.indexOf(0x%08x, 0x%04x, %d) off=%d count=%d\n",
-    //    (u4) strObj, ch, start, offset, count);
-
-    /* factor out the offset */
-    chars += offset;
+    StringChars chars;
+    getStringChars(strObj, &chars);
+    int count = chars.count;
+    //LOGI("String.indexOf(0x%08x, 0x%04x, %d) count=%d\n",
+    //    (u4) strObj, ch, start, count);
 
     if (start < 0)
         start = 0;
+    else if (start > count)
+        start = count;
 
-#if 0
-    /* 16-bit loop, simple */
-    while (start < count) {
-        if (chars[start] == ch)
-            return start;
-        start++;
-    }
-#else
-    /* 16-bit loop, slightly better on ARM */
-    const u2* ptr = chars + start;
-    const u2* endPtr = chars + count;
-    while (ptr < endPtr) {
-        if (*ptr++ == ch)
-            return (ptr-1) - chars;
-    }
-#endif
+    /* a char can't match a negative value or a supplementary code point */
+    if ((u4) ch > 0xffff)
+        return -1;
 
-    return -1;
+    return stringIndexOfChar(&chars, start, count, (u2) ch);
 }
 
 /*
@@ -470,6 +758,250 @@ static bool javaLangString_indexOf_II(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
     return true;
 }
 
+/*
+ * Search for "subStr" in "strObj", starting at "start".  Same semantics
+ * as String.indexOf(String, int).
+ */
+static int indexOfStringCommon(Object* strObj, Object* subStrObj, int start)
+{
+    StringChars chars, subChars;
+    getStringChars(strObj, &chars);
+    getStringChars(subStrObj, &subChars);
+    int count = chars.count;
+    int subCount = subChars.count;
+
+    if (start < 0)
+        start = 0;
+    if (subCount == 0)
+        return (start < count) ? start : count;
+    if (subCount > count - start)
+        return -1;
+
+    /*
+     * Find the first char, then compare the rest.  "last" is the final
+     * position where a match could begin.
+     */
+    u2 firstChar = stringCharAt(&subChars, 0);
+    int last = count - subCount;
+    while (start <= last) {
+        int i = stringIndexOfChar(&chars, start, last + 1, firstChar);
+        if (i < 0)
+            break;
+        if (stringFirstMismatch(&chars, i + 1, &subChars, 1, subCount - 1)
+                == subCount - 1)
+        {
+            return i;
+        }
+        start = i + 1;
+    }
+    return -1;
+}
+
+/*
+ * public int indexOf(String string)
+ */
+static bool javaLangString_indexOf_String(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    /* null reference check on "this" and the argument */
+    if (!dvmValidateObject((Object*) arg0) ||
+        !dvmValidateObject((Object*) arg1))
+    {
+        return false;
+    }
+
+    pResult->i = indexOfStringCommon((Object*) arg0, (Object*) arg1, 0);
+    return true;
+}
+
+/*
+ * public int indexOf(String subString, int start)
+ */
+static bool javaLangString_indexOf_StringI(u4 arg0, u4 arg1, u4 arg2,
+    u4 arg3, JValue* pResult)
+{
+    /* null reference check on "this" and the argument */
+    if (!dvmValidateObject((Object*) arg0) ||
+        !dvmValidateObject((Object*) arg1))
+    {
+        return false;
+    }
+
+    pResult->i = indexOfStringCommon((Object*) arg0, (Object*) arg1, arg2);
+    return true;
+}
+
+/*
+ * Scan backward from "start" for "ch".  Same semantics as
+ * String.lastIndexOf(int, int).
+ */
+static inline int lastIndexOfCommon(Object* strObj, int ch, int start)
+{
+    StringChars chars;
+    getStringChars(strObj, &chars);
+
+    if (start < 0 || (u4) ch > 0xffff)
+        return -1;
+    if (start >= chars.count)
+        start = chars.count - 1;
+
+    return stringLastIndexOfChar(&chars, start, (u2) ch);
+}
+
+/*
+ * public int lastIndexOf(int c)
+ */
+static bool javaLangString_lastIndexOf_I(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    /* null reference check on "this" */
+    if (!dvmValidateObject((Object*) arg0))
+        return false;
+
+    pResult->i = lastIndexOfCommon((Object*) arg0, arg1, 0x7fffffff);
+    return true;
+}
+
+/*
+ * public int lastIndexOf(int c, int start)
+ */
+static bool javaLangString_lastIndexOf_II(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    /* null reference check on "this" */
+    if (!dvmValidateObject((Object*) arg0))
+        return false;
+
+    pResult->i = lastIndexOfCommon((Object*) arg0, arg1, arg2);
+    return true;
+}
+
+/*
+ * public int hashCode()
+ *
+ * Like the Java-language version, we cache the result in the "hashCode"
+ * field.  A string whose hash really is zero gets recomputed every time.
+ */
+static bool javaLangString_hashCode(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    /* null reference check on "this" */
+    if (!dvmValidateObject((Object*) arg0))
+        return false;
+
+    int hash = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_HASHCODE);
+    if (hash == 0) {
+        hash = dvmComputeStringHash((StringObject*) arg0);
+        dvmSetFieldInt((Object*) arg0, STRING_FIELDOFF_HASHCODE, hash);
+    }
+    pResult->i = hash;
+    return true;
+}
+
+/*
+ * Compare two non-ASCII chars the way String.equalsIgnoreCase does, by
+ * calling Character.toUpperCase and toLowerCase.  This is the slow path;
+ * we only get here for chars outside the ASCII range.
+ *
+ * Returns "false" if an exception was thrown.
+ */
+static bool unicodeCharsEqualIgnoreCase(u2 c0, u2 c1, bool* pEqual)
+{
+    static Method* toUpperCase = NULL;
+    static Method* toLowerCase = NULL;
+    Thread* self = dvmThreadSelf();
+    JValue upper0, upper1, lower0, lower1;
+
+    if (toLowerCase == NULL) {
+        /* races are harmless; everybody finds the same methods */
+        ClassObject* clazz = dvmFindSystemClass("Ljava/lang/Character;");
+        if (clazz == NULL)
+            return false;
+        if (!dvmIsClassInitialized(clazz) && !dvmInitClass(clazz))
+            return false;
+        toUpperCase = dvmFindDirectMethodByDescriptor(clazz,
+            "toUpperCase", "(C)C");
+        toLowerCase = dvmFindDirectMethodByDescriptor(clazz,
+            "toLowerCase", "(C)C");
+        assert(toUpperCase != NULL && toLowerCase != NULL);
+    }
+
+    dvmCallMethod(self, toUpperCase, NULL, &upper0, (u4) c0);
+    dvmCallMethod(self, toUpperCase, NULL, &upper1, (u4) c1);
+    if (dvmCheckException(self))
+        return false;
+    if (upper0.c == upper1.c) {
+        *pEqual = true;
+        return true;
+    }
+
+    /* required for unicode that we test both cases */
+    dvmCallMethod(self, toLowerCase, NULL, &lower0, (u4) c0);
+    dvmCallMethod(self, toLowerCase, NULL, &lower1, (u4) c1);
+    if (dvmCheckException(self))
+        return false;
+    *pEqual = (lower0.c == lower1.c);
+    return true;
+}
+
+/*
+ * public boolean equalsIgnoreCase(String string)
+ *
+ * ASCII case folding is done here; any other mismatched pair goes to
+ * Character, which knows the Unicode rules.
+ */
+static bool javaLangString_equalsIgnoreCase(u4 arg0, u4 arg1, u4 arg2,
+    u4 arg3, JValue* pResult)
+{
+    /* null reference check on "this" */
+    if (!dvmValidateObject((Object*) arg0))
+        return false;
+
+    if (arg0 == arg1) {
+        pResult->i = true;
+        return true;
+    }
+    if (arg1 == 0) {
+        pResult->i = false;
+        return true;
+    }
+
+    int count = dvmGetFieldInt((Object*) arg0, STRING_FIELDOFF_COUNT);
+    if (count != dvmGetFieldInt((Object*) arg1, STRING_FIELDOFF_COUNT)) {
+        pResult->i = false;
+        return true;
+    }
+
+    StringChars thisChars, compChars;
+    getStringChars((Object*) arg0, &thisChars);
+    getStringChars((Object*) arg1, &compChars);
+
+    int i = 0;
+    while (true) {
+        if (!asciiEqualsIgnoreCase(&thisChars, &compChars, i, &i)) {
+            pResult->i = false;
+            return true;
+        }
+        if (i == count)
+            break;
+
+        bool equal;
+        if (!unicodeCharsEqualIgnoreCase(stringCharAt(&thisChars, i),
+                stringCharAt(&compChars, i), &equal))
+        {
+            return false;
+        }
+        if (!equal) {
+            pResult->i = false;
+            return true;
+        }
+        i++;
+    }
+
+    pResult->i = true;
+    return true;
+}
+
 
 /*
  * ===========================================================================
@@ -619,6 +1151,220 @@ static bool javaLangMath_sin(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
 }
 
 
+/*
+ * ===========================================================================
+ *      dalvik.system.VMStack
+ * ===========================================================================
+ */
+
+/*
+ * These replace calls to the VMStack natives used by Class.forName(),
+ * ResourceBundle and friends.  An inline op doesn't get a stack frame of
+ * its own, so self->curFrame is the frame of the method that called
+ * VMStack (e.g. Class.forName), which is one frame up from where the
+ * native versions start their walk.
+ *
+ * Walk up "depth" frames from the caller of VMStack, skipping break
+ * frames and reflection, and return that frame's class.
+ */
+static ClassObject* getVMStackCallerClass(int depth)
+{
+    void* fp = dvmThreadSelf()->curFrame;
+
+    while (depth-- > 0) {
+        fp = dvmGetCallerFP(fp);
+        if (fp == NULL)
+            return NULL;
+    }
+    return SAVEAREA_FROM_FP(fp)->method->clazz;
+}
+
+/*
+ * public static ClassLoader getCallingClassLoader()
+ */
+static bool dalvikSystemVMStack_getCallingClassLoader(u4 arg0, u4 arg1,
+    u4 arg2, u4 arg3, JValue* pResult)
+{
+    ClassObject* clazz = getVMStackCallerClass(1);
+
+    pResult->l = (clazz != NULL) ? clazz->classLoader : NULL;
+    return true;
+}
+
+/*
+ * public static ClassLoader getCallingClassLoader2()
+ */
+static bool dalvikSystemVMStack_getCallingClassLoader2(u4 arg0, u4 arg1,
+    u4 arg2, u4 arg3, JValue* pResult)
+{
+    ClassObject* clazz = getVMStackCallerClass(2);
+
+    pResult->l = (clazz != NULL) ? clazz->classLoader : NULL;
+    return true;
+}
+
+/*
+ * public static Class<?> getStackClass2()
+ */
+static bool dalvikSystemVMStack_getStackClass2(u4 arg0, u4 arg1,
+    u4 arg2, u4 arg3, JValue* pResult)
+{
+    pResult->l = getVMStackCallerClass(2);
+    return true;
+}
+
+
+/*
+ * ===========================================================================
+ *      java.lang.Object, java.lang.Thread, java.lang.System
+ * ===========================================================================
+ */
+
+/*
+ * public final Class getClass()
+ */
+static bool javaLangObject_getClass(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    /* null reference check on "this" */
+    if (!dvmValidateObject((Object*) arg0))
+        return false;
+
+    pResult->l = ((Object*) arg0)->clazz;
+    return true;
+}
+
+/*
+ * public static Thread currentThread()
+ */
+static bool javaLangThread_currentThread(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    pResult->l = dvmThreadSelf()->threadObj;
+    return true;
+}
+
+/*
+ * public static int identityHashCode(Object x)
+ */
+static bool javaLangSystem_identityHashCode(u4 arg0, u4 arg1, u4 arg2,
+    u4 arg3, JValue* pResult)
+{
+    pResult->i = dvmIdentityHashCode((Object*) arg0);
+    return true;
+}
+
+/*
+ * public static long nanoTime()
+ */
+static bool javaLangSystem_nanoTime(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    pResult->j = dvmGetRelativeTimeNsec();
+    return true;
+}
+
+
+/*
+ * ===========================================================================
+ *      java.lang.Float, java.lang.Double
+ * ===========================================================================
+ */
+
+/*
+ * The arguments arrive as raw bits, so the "raw" conversions just pass
+ * them through.  The non-raw versions collapse every NaN to the canonical
+ * one, like the libcore natives do.
+ */
+
+/*
+ * public static int floatToIntBits(float value)
+ */
+static bool javaLangFloat_floatToIntBits(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    if ((arg0 & 0x7fffffff) > 0x7f800000)
+        pResult->i = 0x7fc00000;
+    else
+        pResult->i = arg0;
+    return true;
+}
+
+/*
+ * public static int floatToRawIntBits(float value)
+ */
+static bool javaLangFloat_floatToRawIntBits(u4 arg0, u4 arg1, u4 arg2,
+    u4 arg3, JValue* pResult)
+{
+    pResult->i = arg0;
+    return true;
+}
+
+/*
+ * public static float intBitsToFloat(int bits)
+ */
+static bool javaLangFloat_intBitsToFloat(u4 arg0, u4 arg1, u4 arg2, u4 arg3,
+    JValue* pResult)
+{
+    pResult->i = arg0;
+    return true;
+}
+
+/*
+ * public static long doubleToLongBits(double value)
+ */
+static bool javaLangDouble_doubleToLongBits(u4 arg0, u4 arg1, u4 arg2,
+    u4 arg3, JValue* pResult)
+{
+    union {
+        u4 arg[2];
+        u8 ll;
+    } convert;
+
+    convert.arg[0] = arg0;
+    convert.arg[1] = arg1;
+    if ((convert.ll & 0x7fffffffffffffffULL) > 0x7ff0000000000000ULL)
+        pResult->j = 0x7ff8000000000000LL;
+    else
+        pResult->j = convert.ll;
+    return true;
+}
+
+/*
+ * public static long doubleToRawLongBits(double value)
+ */
+static bool javaLangDouble_doubleToRawLongBits(u4 arg0, u4 arg1, u4 arg2,
+    u4 arg3, JValue* pResult)
+{
+    union {
+        u4 arg[2];
+        s8 ll;
+    } convert;
+
+    convert.arg[0] = arg0;
+    convert.arg[1] = arg1;
+    pResult->j = convert.ll;
+    return true;
+}
+
+/*
+ * public static double longBitsToDouble(long bits)
+ */
+static bool javaLangDouble_longBitsToDouble(u4 arg0, u4 arg1, u4 arg2,
+    u4 arg3, JValue* pResult)
+{
+    union {
+        u4 arg[2];
+        s8 ll;
+    } convert;
+
+    convert.arg[0] = arg0;
+    convert.arg[1] = arg1;
+    pResult->j = convert.ll;
+    return true;
+}
+
+
 /*
  * ===========================================================================
  *      Infrastructure
@@ -675,13 +1421,67 @@ const InlineOperation gDvmInlineOpsTable[] = {
         "Ljava/lang/Math;", "cos", "(D)D" },
     { javaLangMath_sin,
         "Ljava/lang/Math;", "sin", "(D)D" },
+
+    { dalvikSystemVMStack_getCallingClassLoader,
+        "Ldalvik/system/VMStack;", "getCallingClassLoader",
+        "()Ljava/lang/ClassLoader;" },
+    { dalvikSystemVMStack_getCallingClassLoader2,
+        "Ldalvik/system/VMStack;", "getCallingClassLoader2",
+        "()Ljava/lang/ClassLoader;" },
+    { dalvikSystemVMStack_getStackClass2,
+        "Ldalvik/system/VMStack;", "getStackClass2", "()Ljava/lang/Class;" },
+
+    { javaLangString_indexOf_String,
+        "Ljava/lang/String;", "indexOf", "(Ljava/lang/String;)I" },
+    { javaLangString_indexOf_StringI,
+        "Ljava/lang/String;", "indexOf", "(Ljava/lang/String;I)I" },
+    { javaLangString_lastIndexOf_I,
+        "Ljava/lang/String;", "lastIndexOf", "(I)I" },
+    { javaLangString_lastIndexOf_II,
+        "Ljava/lang/String;", "lastIndexOf", "(II)I" },
+    { javaLangString_hashCode,
+        "Ljava/lang/String;", "hashCode", "()I" },
+    { javaLangString_equalsIgnoreCase,
+        "Ljava/lang/String;", "equalsIgnoreCase", "(Ljava/lang/String;)Z" },
+
+    { javaLangObject_getClass,
+        "Ljava/lang/Object;", "getClass", "()Ljava/lang/Class;" },
+    { javaLangThread_currentThread,
+        "Ljava/lang/Thread;", "currentThread", "()Ljava/lang/Thread;" },
+    { javaLangSystem_identityHashCode,
+        "Ljava/lang/System;", "identityHashCode", "(Ljava/lang/Object;)I" },
+    { javaLangSystem_nanoTime,
+        "Ljava/lang/System;", "nanoTime", "()J" },
+
+    { javaLangFloat_floatToIntBits,
+        "Ljava/lang/Float;", "floatToIntBits", "(F)I" },
+    { javaLangFloat_floatToRawIntBits,
+        "Ljava/lang/Float;", "floatToRawIntBits", "(F)I" },
+    { javaLangFloat_intBitsToFloat,
+        "Ljava/lang/Float;", "intBitsToFloat", "(I)F" },
+    { javaLangDouble_doubleToLongBits,
+        "Ljava/lang/Double;", "doubleToLongBits", "(D)J" },
+    { javaLangDouble_doubleToRawLongBits,
+        "Ljava/lang/Double;", "doubleToRawLongBits", "(D)J" },
+    { javaLangDouble_longBitsToDouble,
+        "Ljava/lang/Double;", "longBitsToDouble", "(J)D" },
 };
 
 /*
- * Allocate some tables.
+ * Pick the string kernels and allocate some tables.
  */
 bool dvmInlineNativeStartup(void)
 {
+#ifdef WITH_SSE2_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        firstMismatch16 = firstMismatch16Sse2;
+        indexOfChar16 = indexOfChar16Sse2;
+        lastIndexOfChar16 = lastIndexOfChar16Sse2;
+        firstMismatch8 = firstMismatch8Sse2;
+    }
+#endif
+
 #ifdef WITH_PROFILER
     gDvm.inlinedMethods =
         (Method**) calloc(NELEM(gDvmInlineOpsTable), sizeof(Method*));
@@ -66,6 +66,25 @@ typedef enum NativeInlineOps {
     INLINE_MATH_SQRT = 13,
     INLINE_MATH_COS = 14,
     INLINE_MATH_SIN = 15,
+    INLINE_VMSTACK_GETCALLINGCLASSLOADER = 16,
+    INLINE_VMSTACK_GETCALLINGCLASSLOADER2 = 17,
+    INLINE_VMSTACK_GETSTACKCLASS2 = 18,
+    INLINE_STRING_INDEXOF_STRING = 19,
+    INLINE_STRING_INDEXOF_STRING_I = 20,
+    INLINE_STRING_LASTINDEXOF_I = 21,
+    INLINE_STRING_LASTINDEXOF_II = 22,
+    INLINE_STRING_HASHCODE = 23,
+    INLINE_STRING_EQUALSIGNORECASE = 24,
+    INLINE_OBJECT_GETCLASS = 25,
+    INLINE_THREAD_CURRENTTHREAD = 26,
+    INLINE_SYSTEM_IDENTITYHASHCODE = 27,
+    INLINE_SYSTEM_NANOTIME = 28,
+    INLINE_FLOAT_FLOATTOINTBITS = 29,
+    INLINE_FLOAT_FLOATTORAWINTBITS = 30,
+    INLINE_FLOAT_INTBITSTOFLOAT = 31,
+    INLINE_DOUBLE_DOUBLETOLONGBITS = 32,
+    INLINE_DOUBLE_DOUBLETORAWLONGBITS = 33,
+    INLINE_DOUBLE_LONGBITSTODOUBLE = 34,
 } NativeInlineOps;
 
 /*
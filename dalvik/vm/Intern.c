@@ -15,6 +15,23 @@
  */
 /*
  * String interning.
+ *
+ * The intern table is split into kInternStripes open-addressed tables,
+ * picked by the top bits of the string's scrambled hash code, each with
+ * its own lock.  Lookups of strings that are already interned don't take any
+ * lock.  That is safe because:
+ *
+ *  - outside of GC, a slot is only ever filled in (hash first, then the
+ *    string pointer, with a barrier between), or has its immortal bit
+ *    set, which is a single word store;
+ *  - a table that fills up is replaced, not resized in place, and the old
+ *    one is kept around until the next GC;
+ *  - the intern functions are only called by threads in THREAD_RUNNING
+ *    and never suspend partway through, so the GC (which removes dead
+ *    entries and frees old tables) can't overlap a lookup.
+ *
+ * A lookup that races with an insert may miss.  It then tries again under
+ * the lock, which is also how new strings are added.
  */
 #include "Dalvik.h"
 
@@ -28,19 +45,94 @@
 #define IS_IMMORTAL(strObj) \
             ((uintptr_t)(strObj) & INTERN_STRING_IMMORTAL_BIT)
 
+#define kInternStripes      16      /* must be a power of 2 */
+#define kInternStripeShift  28      /* 32 - log2(kInternStripes) */
+#define kInternInitialSize  64      /* slots per stripe; power of 2 */
+
+/*
+ * The top bits of String.hashCode() are zero for every short ASCII string,
+ * so multiply them in from the rest before picking a stripe.
+ */
+#define INTERN_STRIPE(_hash) \
+            (((u4)(_hash) * 0x9e3779b1u) >> kInternStripeShift)
+
+/* marks a slot whose string was collected; keeps probe chains intact */
+#define kInternTombstone    ((void*) 0xcbcacccd)
+
+typedef struct InternSlot {
+    u4              hash;
+    void* volatile  strObj;     /* with immortal bit; NULL if never used */
+} InternSlot;
+
+typedef struct InternTable {
+    struct InternTable* retiredNext;    /* outgrown tables, freed by GC */
+    u4              mask;               /* number of slots - 1 */
+    InternSlot      slots[1];
+} InternTable;
+
+typedef struct InternStripe {
+    pthread_mutex_t lock;
+    InternTable* volatile table;
+    int             numEntries;         /* live strings */
+    int             numUsed;            /* live strings + tombstones */
+    InternTable*    retired;
+} InternStripe;
+
+/*
+ * What we're looking for: either the chars of a StringObject, or a
+ * modified UTF-8 string constant straight out of a DEX file.
+ */
+typedef struct InternKey {
+    StringObject*   strObj;
+    const char*     utf8;
+    int             len;        /* in UTF-16 chars */
+} InternKey;
+
+
+static InternTable* allocInternTable(u4 numSlots)
+{
+    InternTable* pTable;
+
+    assert((numSlots & (numSlots - 1)) == 0);
+    pTable = (InternTable*) calloc(1,
+                offsetof(InternTable, slots) + numSlots * sizeof(InternSlot));
+    if (pTable != NULL)
+        pTable->mask = numSlots - 1;
+    return pTable;
+}
 
 /*
  * Prep string interning.
  */
 bool dvmStringInternStartup(void)
 {
-    gDvm.internedStrings = dvmHashTableCreate(256, NULL);
-    if (gDvm.internedStrings == NULL)
+    InternStripe* stripes;
+    int i;
+
+    stripes = (InternStripe*) calloc(kInternStripes, sizeof(InternStripe));
+    if (stripes == NULL)
         return false;
 
+    for (i = 0; i < kInternStripes; i++) {
+        dvmInitMutex(&stripes[i].lock);
+        stripes[i].table = allocInternTable(kInternInitialSize);
+        if (stripes[i].table == NULL)
+            return false;
+    }
+
+    gDvm.internStripes = stripes;
     return true;
 }
 
+static void freeRetiredTables(InternStripe* pStripe)
+{
+    while (pStripe->retired != NULL) {
+        InternTable* next = pStripe->retired->retiredNext;
+        free(pStripe->retired);
+        pStripe->retired = next;
+    }
+}
+
 /*
  * Chuck the intern list.
  *
@@ -48,28 +140,218 @@ bool dvmStringInternStartup(void)
  */
 void dvmStringInternShutdown(void)
 {
-    dvmHashTableFree(gDvm.internedStrings);
-    gDvm.internedStrings = NULL;
+    InternStripe* stripes = gDvm.internStripes;
+    int i;
+
+    if (stripes == NULL)
+        return;
+
+    for (i = 0; i < kInternStripes; i++) {
+        freeRetiredTables(&stripes[i]);
+        free(stripes[i].table);
+        dvmDestroyMutex(&stripes[i].lock);
+    }
+    free(stripes);
+    gDvm.internStripes = NULL;
+}
+
+
+/*
+ * Returns "true" if "strObj" holds exactly the chars described by "pKey".
+ */
+static bool keyMatches(const InternKey* pKey, StringObject* strObj)
+{
+    const char* utf8;
+    int i;
+
+    if (dvmStringLen(strObj) != pKey->len)
+        return false;
+
+    if (pKey->strObj != NULL)
+        return dvmStringEquals(strObj, pKey->strObj);
+
+    utf8 = pKey->utf8;
+    if (dvmStringIsLatin1(strObj)) {
+        const u1* bytes = dvmStringLatin1Chars(strObj);
+
+        for (i = 0; i < pKey->len; i++) {
+            if (bytes[i] != dexGetUtf16FromUtf8(&utf8))
+                return false;
+        }
+    } else {
+        const u2* chars = dvmStringChars(strObj);
+
+        for (i = 0; i < pKey->len; i++) {
+            if (chars[i] != dexGetUtf16FromUtf8(&utf8))
+                return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Find the slot holding the string described by "pKey", or NULL.
+ *
+ * This can be called without the stripe lock.  In that case a string
+ * that is being added right now may not be found.
+ */
+static InternSlot* findSlot(const InternTable* pTable, u4 hash,
+    const InternKey* pKey)
+{
+    u4 idx = hash & pTable->mask;
+
+    for (;;) {
+        InternSlot* pSlot = (InternSlot*) &pTable->slots[idx];
+        void* strObj = pSlot->strObj;
+
+        if (strObj == NULL)
+            return NULL;
+        if (strObj != kInternTombstone && pSlot->hash == hash &&
+            keyMatches(pKey, (StringObject*) STRIP_IMMORTAL_BIT(strObj)))
+        {
+            return pSlot;
+        }
+        idx = (idx + 1) & pTable->mask;
+    }
+}
+
+/*
+ * Add "strObj" (which may have the immortal bit set) to "pTable" without
+ * checking for duplicates.  Returns "true" if this used an empty slot
+ * rather than a tombstone.
+ */
+static bool insertSlot(InternTable* pTable, u4 hash, void* strObj)
+{
+    u4 idx = hash & pTable->mask;
+
+    for (;;) {
+        InternSlot* pSlot = &pTable->slots[idx];
+        void* oldObj = pSlot->strObj;
+
+        if (oldObj == NULL || oldObj == kInternTombstone) {
+            pSlot->hash = hash;
+            MEM_BARRIER_SMP();          /* hash before pointer */
+            pSlot->strObj = strObj;
+            return (oldObj == NULL);
+        }
+        idx = (idx + 1) & pTable->mask;
+    }
 }
 
+/*
+ * Copy the live entries of the stripe's table into a new one with room
+ * for at least "minEntries" at half load.  The old table is freed right
+ * away if "retire" is false (nobody can be reading it); otherwise it is
+ * kept until the next GC.
+ *
+ * Call with the stripe lock held.
+ */
+static bool rebuildStripe(InternStripe* pStripe, int minEntries, bool retire)
+{
+    InternTable* pOld = pStripe->table;
+    InternTable* pNew;
+    u4 numSlots = kInternInitialSize;
+    u4 i;
+
+    while (numSlots < (u4) minEntries * 2)
+        numSlots *= 2;
+
+    pNew = allocInternTable(numSlots);
+    if (pNew == NULL)
+        return false;
+
+    for (i = 0; i <= pOld->mask; i++) {
+        void* strObj = pOld->slots[i].strObj;
+        if (strObj != NULL && strObj != kInternTombstone)
+            insertSlot(pNew, pOld->slots[i].hash, strObj);
+    }
+    pStripe->numUsed = pStripe->numEntries;
+
+    MEM_BARRIER_SMP();                  /* contents before table pointer */
+    pStripe->table = pNew;
+
+    if (retire) {
+        pOld->retiredNext = pStripe->retired;
+        pStripe->retired = pOld;
+    } else {
+        free(pOld);
+    }
+    return true;
+}
 
 /*
- * Compare two string objects that may have INTERN_STRING_IMMORTAL_BIT
- * set in their pointer values.
+ * Look "pKey" up in the table.  If it's there, return the interned
+ * string, making it immortal first if "immortal" is set.  If not, add
+ * "strObj" if it's non-NULL and return it; otherwise return NULL.
  */
-static int hashcmpImmortalStrings(const void* vstrObj1, const void* vstrObj2)
+static StringObject* lookupOrAdd(u4 hash, const InternKey* pKey,
+    StringObject* strObj, bool immortal)
 {
-    return dvmHashcmpStrings((const void*) STRIP_IMMORTAL_BIT(vstrObj1),
-                             (const void*) STRIP_IMMORTAL_BIT(vstrObj2));
+    InternStripe* pStripe =
+        &gDvm.internStripes[INTERN_STRIPE(hash)];
+    InternSlot* pSlot;
+    void* found;
+
+    /* common case: already there, no lock needed */
+    pSlot = findSlot(pStripe->table, hash, pKey);
+    if (pSlot != NULL) {
+        found = pSlot->strObj;
+        if (!immortal || IS_IMMORTAL(found))
+            return (StringObject*) STRIP_IMMORTAL_BIT(found);
+    }
+
+    dvmLockMutex(&pStripe->lock);
+
+    pSlot = findSlot(pStripe->table, hash, pKey);
+    if (pSlot != NULL) {
+        found = pSlot->strObj;
+        if (immortal && !IS_IMMORTAL(found)) {
+            /* Make this entry immortal.  We have to use the existing
+             * object because, as an interned string, it's not allowed
+             * to change.
+             */
+            found = (void*) SET_IMMORTAL_BIT(found);
+            pSlot->strObj = found;
+        }
+    } else if (strObj != NULL) {
+        InternTable* pTable = pStripe->table;
+
+        if ((u4) (pStripe->numUsed + 1) * 2 > pTable->mask + 1) {
+            if (!rebuildStripe(pStripe, pStripe->numEntries + 1, true)) {
+                dvmUnlockMutex(&pStripe->lock);
+                dvmThrowException("Ljava/lang/OutOfMemoryError;",
+                    "intern table");
+                return NULL;
+            }
+            pTable = pStripe->table;
+        }
+
+        found = immortal ? (void*) SET_IMMORTAL_BIT(strObj) : (void*) strObj;
+        if (insertSlot(pTable, hash, found))
+            pStripe->numUsed++;
+        pStripe->numEntries++;
+    } else {
+        found = NULL;
+    }
+
+    dvmUnlockMutex(&pStripe->lock);
+
+    return (StringObject*) STRIP_IMMORTAL_BIT(found);
 }
 
 static StringObject* lookupInternedString(StringObject* strObj, bool immortal)
 {
-    StringObject* found;
+    InternKey key;
     u4 hash;
 
     assert(strObj != NULL);
-    hash = dvmComputeStringHash(strObj);
+
+    /* use the hash code String has already computed, if it has one */
+    hash = dvmGetFieldInt((Object*) strObj, STRING_FIELDOFF_HASHCODE);
+    if (hash == 0) {
+        hash = dvmComputeStringHash(strObj);
+        dvmSetFieldInt((Object*) strObj, STRING_FIELDOFF_HASHCODE, hash);
+    }
 
     if (false) {
         char* debugStr = dvmCreateCstrFromString(strObj);
@@ -77,34 +359,11 @@ static StringObject* lookupInternedString(StringObject* strObj, bool immortal)
         free(debugStr);
     }
 
-    if (immortal) {
-        strObj = (StringObject*) SET_IMMORTAL_BIT(strObj);
-    }
+    key.strObj = strObj;
+    key.utf8 = NULL;
+    key.len = dvmStringLen(strObj);
 
-    dvmHashTableLock(gDvm.internedStrings);
-
-    found = (StringObject*) dvmHashTableLookup(gDvm.internedStrings,
-                                hash, strObj, hashcmpImmortalStrings, true);
-    if (immortal && !IS_IMMORTAL(found)) {
-        /* Make this entry immortal.  We have to use the existing object
-         * because, as an interned string, it's not allowed to change.
-         *
-         * There's no way to get a pointer to the actual hash table entry,
-         * so the only way to modify the existing entry is to remove,
-         * modify, and re-add it.
-         */
-        dvmHashTableRemove(gDvm.internedStrings, hash, found);
-        found = (StringObject*) SET_IMMORTAL_BIT(found);
-        found = (StringObject*) dvmHashTableLookup(gDvm.internedStrings,
-                                    hash, found, hashcmpImmortalStrings, true);
-        assert(IS_IMMORTAL(found));
-    }
-
-    dvmHashTableUnlock(gDvm.internedStrings);
-
-    //if (found == strObj)
-    //    LOGVV("+++  added string\n");
-    return (StringObject*) STRIP_IMMORTAL_BIT(found);
+    return lookupOrAdd(hash, &key, strObj, immortal);
 }
 
 /*
@@ -128,46 +387,104 @@ StringObject* dvmLookupImmortalInternedString(StringObject* strObj)
 }
 
 /*
- * Mark all immortal interned string objects so that they don't
- * get collected by the GC.  Non-immortal strings may or may not
- * get marked by other references.
+ * Find an interned string equal to the modified UTF-8 string "utf8",
+ * whose length is "utf16Size" chars and whose String hash code is "hash",
+ * without creating a StringObject.  The result is made immortal.
+ *
+ * Returns NULL if no such string has been interned.
  */
-static int markStringObject(void* strObj, void* arg)
+StringObject* dvmLookupImmortalInternedUtf8(const char* utf8, u4 utf16Size,
+    u4 hash)
 {
-    UNUSED_PARAMETER(arg);
+    InternKey key;
 
-    if (IS_IMMORTAL(strObj)) {
-        dvmMarkObjectNonNull((Object*) STRIP_IMMORTAL_BIT(strObj));
-    }
-    return 0;
+    key.strObj = NULL;
+    key.utf8 = utf8;
+    key.len = utf16Size;
+
+    return lookupOrAdd(hash, &key, NULL, true);
 }
 
+/*
+ * Mark all immortal interned string objects so that they don't
+ * get collected by the GC.  Non-immortal strings may or may not
+ * get marked by other references.
+ */
 void dvmGcScanInternedStrings()
 {
+    int i;
+
     /* It's possible for a GC to happen before dvmStringInternStartup()
      * is called.
      */
-    if (gDvm.internedStrings != NULL) {
-        dvmHashTableLock(gDvm.internedStrings);
-        dvmHashForeach(gDvm.internedStrings, markStringObject, NULL);
-        dvmHashTableUnlock(gDvm.internedStrings);
+    if (gDvm.internStripes == NULL)
+        return;
+
+    for (i = 0; i < kInternStripes; i++) {
+        InternStripe* pStripe = &gDvm.internStripes[i];
+        InternTable* pTable;
+        u4 j;
+
+        dvmLockMutex(&pStripe->lock);
+        pTable = pStripe->table;
+        for (j = 0; j <= pTable->mask; j++) {
+            void* strObj = pTable->slots[j].strObj;
+            if (strObj != NULL && strObj != kInternTombstone &&
+                IS_IMMORTAL(strObj))
+            {
+                dvmMarkObjectNonNull((Object*) STRIP_IMMORTAL_BIT(strObj));
+            }
+        }
+        dvmUnlockMutex(&pStripe->lock);
     }
 }
 
 /*
  * Called by the GC after all reachable objects have been
- * marked.  isUnmarkedObject is a function suitable for passing
- * to dvmHashForeachRemove();  it must strip the low bits from
- * its pointer argument to deal with the immortal bit, though.
+ * marked.  isUnmarkedObject is called on each interned string (with
+ * the immortal bit stripped); the ones it returns nonzero for are
+ * removed.
+ *
+ * Every other thread is suspended outside the intern code, so this is
+ * also when we can throw away tables that lookups may have been reading,
+ * and squeeze out tombstones.
  */
 void dvmGcDetachDeadInternedStrings(int (*isUnmarkedObject)(void *))
 {
+    int i;
+
     /* It's possible for a GC to happen before dvmStringInternStartup()
      * is called.
      */
-    if (gDvm.internedStrings != NULL) {
-        dvmHashTableLock(gDvm.internedStrings);
-        dvmHashForeachRemove(gDvm.internedStrings, isUnmarkedObject);
-        dvmHashTableUnlock(gDvm.internedStrings);
+    if (gDvm.internStripes == NULL)
+        return;
+
+    for (i = 0; i < kInternStripes; i++) {
+        InternStripe* pStripe = &gDvm.internStripes[i];
+        InternTable* pTable;
+        u4 j;
+
+        dvmLockMutex(&pStripe->lock);
+        freeRetiredTables(pStripe);
+
+        pTable = pStripe->table;
+        for (j = 0; j <= pTable->mask; j++) {
+            void* strObj = pTable->slots[j].strObj;
+            if (strObj != NULL && strObj != kInternTombstone &&
+                isUnmarkedObject((void*) STRIP_IMMORTAL_BIT(strObj)))
+            {
+                pTable->slots[j].strObj = kInternTombstone;
+                pStripe->numEntries--;
+            }
+        }
+
+        /* too many tombstones make misses slow; rebuild (and maybe
+         * shrink) if they're more than a quarter of the table */
+        if ((u4) (pStripe->numUsed - pStripe->numEntries) * 4 >
+                pTable->mask + 1)
+        {
+            rebuildStripe(pStripe, pStripe->numEntries, false);
+        }
+        dvmUnlockMutex(&pStripe->lock);
     }
 }
@@ -24,5 +24,7 @@ void dvmStringInternShutdown(void);
 
 StringObject* dvmLookupInternedString(StringObject* strObj);
 StringObject* dvmLookupImmortalInternedString(StringObject* strObj);
+StringObject* dvmLookupImmortalInternedUtf8(const char* utf8, u4 utf16Size,
+    u4 hash);
 
 #endif /*_DALVIK_INTERN*/
@@ -291,6 +291,151 @@ static jobject addGlobalReference(Object* obj);
 #define kPinTableMaxSize            1024
 #define kPinComplainThreshold       10
 
+/*
+ * The limits are split evenly across the stripes, so the total can't pass
+ * them and no stripe needs to know about the others.  Objects are spread
+ * by address, which is close enough to uniform for these sizes.
+ */
+#define kStripeInitialSize(_size)   ((_size) / kJniRefStripes)
+#define kStripeMaxSize(_size)       ((_size) / kJniRefStripes)
+
+/*
+ * Pick the stripe that holds references to "obj".  Objects are at least
+ * 8-byte aligned, so skip the low bits.
+ */
+static inline JniRefStripe* getRefStripe(JniRefStripe* stripes,
+    const void* obj)
+{
+    return &stripes[((uintptr_t) obj >> 3) & (kJniRefStripes - 1)];
+}
+
+/*
+ * Lock a stripe, counting the cases where somebody else had it.
+ */
+static void lockRefStripe(JniRefStripe* pStripe)
+{
+    if (dvmTryLockMutex(&pStripe->lock) != 0) {
+        dvmLockMutex(&pStripe->lock);
+        pStripe->contendedCount++;
+    }
+    pStripe->lockCount++;
+}
+
+static inline void unlockRefStripe(JniRefStripe* pStripe)
+{
+    dvmUnlockMutex(&pStripe->lock);
+}
+
+/*
+ * Set up a set of stripes.
+ */
+static bool initRefStripes(JniRefStripe* stripes, int initialCount,
+    int maxCount)
+{
+    int i;
+
+    for (i = 0; i < kJniRefStripes; i++) {
+        if (!dvmInitReferenceTable(&stripes[i].table, initialCount, maxCount))
+            return false;
+        dvmInitMutex(&stripes[i].lock);
+        stripes[i].lockCount = stripes[i].contendedCount = 0;
+    }
+    return true;
+}
+
+/*
+ * Free the storage held by a set of stripes.
+ */
+static void clearRefStripes(JniRefStripe* stripes)
+{
+    int i;
+
+    for (i = 0; i < kJniRefStripes; i++)
+        dvmClearReferenceTable(&stripes[i].table);
+}
+
+/*
+ * Count the entries in a set of stripes.  The stripes aren't locked, so
+ * the result is only approximate if other threads are active.
+ */
+static int countRefStripes(const JniRefStripe* stripes)
+{
+    int i, count = 0;
+
+    for (i = 0; i < kJniRefStripes; i++)
+        count += dvmReferenceTableEntries(&stripes[i].table);
+    return count;
+}
+
+/*
+ * Mark every object in a set of stripes.
+ */
+static void markRefStripes(JniRefStripe* stripes)
+{
+    int i;
+
+    for (i = 0; i < kJniRefStripes; i++) {
+        JniRefStripe* pStripe = &stripes[i];
+        Object** op;
+
+        dvmLockMutex(&pStripe->lock);
+        op = pStripe->table.table;
+        while ((uintptr_t)op < (uintptr_t)pStripe->table.nextEntry) {
+            dvmMarkObjectNonNull(*(op++));
+        }
+        dvmUnlockMutex(&pStripe->lock);
+    }
+}
+
+/*
+ * Dump a set of stripes as a single table, so the summary looks the same
+ * as it did before the table was split up.
+ */
+static void dumpRefStripes(JniRefStripe* stripes, const char* descr)
+{
+    ReferenceTable merged;
+    int i, count;
+
+    count = countRefStripes(stripes);
+    if (count == 0)
+        count = 1;
+    if (!dvmInitReferenceTable(&merged, count, INT_MAX)) {
+        LOGW("Unable to allocate %s dump table\n", descr);
+        return;
+    }
+
+    for (i = 0; i < kJniRefStripes; i++) {
+        JniRefStripe* pStripe = &stripes[i];
+        Object** op;
+
+        dvmLockMutex(&pStripe->lock);
+        op = pStripe->table.table;
+        while ((uintptr_t)op < (uintptr_t)pStripe->table.nextEntry)
+            dvmAddToReferenceTable(&merged, *(op++));
+        dvmUnlockMutex(&pStripe->lock);
+    }
+
+    dvmDumpReferenceTable(&merged, descr);
+    dvmClearReferenceTable(&merged);
+}
+
+/*
+ * Log the entry count and lock contention for a set of stripes.
+ */
+static void logRefStripeStats(const JniRefStripe* stripes, const char* descr)
+{
+    u4 lockCount = 0, contendedCount = 0;
+    int i;
+
+    for (i = 0; i < kJniRefStripes; i++) {
+        lockCount += stripes[i].lockCount;
+        contendedCount += stripes[i].contendedCount;
+    }
+
+    LOGI("%s: %d entries, %u lock acquisitions, %u contended\n",
+        descr, countRefStripes(stripes), lockCount, contendedCount);
+}
+
 /*
  * Allocate the global references table, and look up some classes for
  * the benefit of direct buffer access.
@@ -303,8 +448,9 @@ bool dvmJniStartup(void)
             kIndirectKindGlobal))
         return false;
 #else
-    if (!dvmInitReferenceTable(&gDvm.jniGlobalRefTable,
-            kGlobalRefsTableInitialSize, kGlobalRefsTableMaxSize))
+    if (!initRefStripes(gDvm.jniGlobalRefStripes,
+            kStripeInitialSize(kGlobalRefsTableInitialSize),
+            kStripeMaxSize(kGlobalRefsTableMaxSize)))
         return false;
 #endif
 
@@ -312,12 +458,11 @@ bool dvmJniStartup(void)
     gDvm.jniGlobalRefLoMark = 0;
     gDvm.jniGlobalRefHiMark = kGrefWaterInterval * 2;
 
-    if (!dvmInitReferenceTable(&gDvm.jniPinRefTable,
-            kPinTableInitialSize, kPinTableMaxSize))
+    if (!initRefStripes(gDvm.jniPinRefStripes,
+            kStripeInitialSize(kPinTableInitialSize),
+            kStripeMaxSize(kPinTableMaxSize)))
         return false;
 
-    dvmInitMutex(&gDvm.jniPinRefLock);
-
     Method* meth;
 
     /*
@@ -439,9 +584,9 @@ void dvmJniShutdown(void)
 #ifdef USE_INDIRECT_REF
     dvmClearIndirectRefTable(&gDvm.jniGlobalRefTable);
 #else
-    dvmClearReferenceTable(&gDvm.jniGlobalRefTable);
+    clearRefStripes(gDvm.jniGlobalRefStripes);
 #endif
-    dvmClearReferenceTable(&gDvm.jniPinRefTable);
+    clearRefStripes(gDvm.jniPinRefStripes);
 }
 
 
@@ -775,8 +920,6 @@ static jobject addGlobalReference(Object* obj)
 
     jobject jobj;
 
-    dvmLockMutex(&gDvm.jniGlobalRefLock);
-
     /*
      * Throwing an exception on failure is problematic, because JNI code
      * may not be expecting an exception, and things sort of cascade.  We
@@ -787,6 +930,8 @@ static jobject addGlobalReference(Object* obj)
      * run out of space in the GC heap.
      */
 #ifdef USE_INDIRECT_REF
+    dvmLockMutex(&gDvm.jniGlobalRefLock);
+
     jobj = dvmAddToIndirectRefTable(&gDvm.jniGlobalRefTable, IRT_FIRST_SEGMENT,
             obj);
     if (jobj == NULL) {
@@ -823,13 +968,20 @@ static jobject addGlobalReference(Object* obj)
             }
         }
     }
+
+    dvmUnlockMutex(&gDvm.jniGlobalRefLock);
 #else
-    if (!dvmAddToReferenceTable(&gDvm.jniGlobalRefTable, obj)) {
-        dvmDumpReferenceTable(&gDvm.jniGlobalRefTable, "JNI global");
+    JniRefStripe* pStripe = getRefStripe(gDvm.jniGlobalRefStripes, obj);
+
+    lockRefStripe(pStripe);
+    if (!dvmAddToReferenceTable(&pStripe->table, obj)) {
+        unlockRefStripe(pStripe);
+        dumpRefStripes(gDvm.jniGlobalRefStripes, "JNI global");
         LOGE("Failed adding to JNI global ref table (%d entries)\n",
-            (int) dvmReferenceTableEntries(&gDvm.jniGlobalRefTable));
+            countRefStripes(gDvm.jniGlobalRefStripes));
         dvmAbort();
     }
+    unlockRefStripe(pStripe);
     jobj = (jobject) obj;
 
     LOGVV("GREF add %p  (%s.%s)\n", obj,
@@ -838,7 +990,8 @@ static jobject addGlobalReference(Object* obj)
 
     /* GREF usage tracking; should probably be disabled for production env */
     if (kTrackGrefUsage && gDvm.jniGrefLimit != 0) {
-        int count = dvmReferenceTableEntries(&gDvm.jniGlobalRefTable);
+        dvmLockMutex(&gDvm.jniGlobalRefLock);
+        int count = countRefStripes(gDvm.jniGlobalRefStripes);
         if (count > gDvm.jniGlobalRefHiMark) {
             LOGD("GREF has increased to %d\n", count);
             gDvm.jniGlobalRefHiMark += kGrefWaterInterval;
@@ -848,7 +1001,7 @@ static jobject addGlobalReference(Object* obj)
             if (count >= gDvm.jniGrefLimit) {
                 JavaVMExt* vm = (JavaVMExt*) gDvm.vmList;
                 if (vm->warnError) {
-                    dvmDumpReferenceTable(&gDvm.jniGlobalRefTable,"JNI global");
+                    dumpRefStripes(gDvm.jniGlobalRefStripes, "JNI global");
                     LOGE("Excessive JNI global references (%d)\n", count);
                     dvmAbort();
                 } else {
@@ -856,11 +1009,10 @@ static jobject addGlobalReference(Object* obj)
                 }
             }
         }
+        dvmUnlockMutex(&gDvm.jniGlobalRefLock);
     }
 #endif
 
-bail:
-    dvmUnlockMutex(&gDvm.jniGlobalRefLock);
     return jobj;
 }
 
@@ -876,9 +1028,9 @@ static void deleteGlobalReference(jobject jobj)
     if (jobj == NULL)
         return;
 
+#ifdef USE_INDIRECT_REF
     dvmLockMutex(&gDvm.jniGlobalRefLock);
 
-#ifdef USE_INDIRECT_REF
     if (!dvmRemoveFromIndirectRefTable(&gDvm.jniGlobalRefTable,
             IRT_FIRST_SEGMENT, jobj))
     {
@@ -895,27 +1047,35 @@ static void deleteGlobalReference(jobject jobj)
             gDvm.jniGlobalRefLoMark -= kGrefWaterInterval;
         }
     }
+
+bail:
+    dvmUnlockMutex(&gDvm.jniGlobalRefLock);
 #else
-    if (!dvmRemoveFromReferenceTable(&gDvm.jniGlobalRefTable,
-            gDvm.jniGlobalRefTable.table, jobj))
-    {
+    JniRefStripe* pStripe = getRefStripe(gDvm.jniGlobalRefStripes, jobj);
+    bool found;
+
+    lockRefStripe(pStripe);
+    found = dvmRemoveFromReferenceTable(&pStripe->table,
+                pStripe->table.table, jobj);
+    unlockRefStripe(pStripe);
+
+    if (!found) {
         LOGW("JNI: DeleteGlobalRef(%p) failed to find entry (valid=%d)\n",
             jobj, dvmIsValidObject((Object*) jobj));
-        goto bail;
+        return;
     }
 
     if (kTrackGrefUsage && gDvm.jniGrefLimit != 0) {
-        int count = dvmReferenceTableEntries(&gDvm.jniGlobalRefTable);
+        dvmLockMutex(&gDvm.jniGlobalRefLock);
+        int count = countRefStripes(gDvm.jniGlobalRefStripes);
         if (count < gDvm.jniGlobalRefLoMark) {
             LOGD("GREF has decreased to %d\n", count);
             gDvm.jniGlobalRefHiMark -= kGrefWaterInterval;
             gDvm.jniGlobalRefLoMark -= kGrefWaterInterval;
         }
+        dvmUnlockMutex(&gDvm.jniGlobalRefLock);
     }
 #endif
-
-bail:
-    dvmUnlockMutex(&gDvm.jniGlobalRefLock);
 }
 
 
@@ -1059,18 +1219,22 @@ static Object* getPhantomReferent(JNIEnv* env, jweak jwobj)
  * Objects don't currently move, so we just need to create a reference
  * that will ensure the array object isn't collected.
  *
- * We use a separate reference table, which is part of the GC root set.
+ * We use a separate (striped) reference table, which is part of the GC
+ * root set.  All pins for a given array land in the same stripe.
  */
 static void pinPrimitiveArray(ArrayObject* arrayObj)
 {
     if (arrayObj == NULL)
         return;
 
-    dvmLockMutex(&gDvm.jniPinRefLock);
-    if (!dvmAddToReferenceTable(&gDvm.jniPinRefTable, (Object*)arrayObj)) {
-        dvmDumpReferenceTable(&gDvm.jniPinRefTable, "JNI pinned array");
+    JniRefStripe* pStripe = getRefStripe(gDvm.jniPinRefStripes, arrayObj);
+
+    lockRefStripe(pStripe);
+    if (!dvmAddToReferenceTable(&pStripe->table, (Object*)arrayObj)) {
+        unlockRefStripe(pStripe);
+        dumpRefStripes(gDvm.jniPinRefStripes, "JNI pinned array");
         LOGE("Failed adding to JNI pinned array ref table (%d entries)\n",
-            (int) dvmReferenceTableEntries(&gDvm.jniPinRefTable));
+            countRefStripes(gDvm.jniPinRefStripes));
         dvmDumpThread(dvmThreadSelf(), false);
         dvmAbort();
     }
@@ -1085,8 +1249,8 @@ static void pinPrimitiveArray(ArrayObject* arrayObj)
      */
     if (kTrackGrefUsage && gDvm.jniGrefLimit != 0) {
         int count = 0;
-        Object** ppObj = gDvm.jniPinRefTable.table;
-        while (ppObj < gDvm.jniPinRefTable.nextEntry) {
+        Object** ppObj = pStripe->table.table;
+        while (ppObj < pStripe->table.nextEntry) {
             if (*ppObj++ == (Object*) arrayObj)
                 count++;
         }
@@ -1098,7 +1262,7 @@ static void pinPrimitiveArray(ArrayObject* arrayObj)
         }
     }
 
-    dvmUnlockMutex(&gDvm.jniPinRefLock);
+    unlockRefStripe(pStripe);
 }
 
 /*
@@ -1110,9 +1274,11 @@ static void unpinPrimitiveArray(ArrayObject* arrayObj)
     if (arrayObj == NULL)
         return;
 
-    dvmLockMutex(&gDvm.jniPinRefLock);
-    if (!dvmRemoveFromReferenceTable(&gDvm.jniPinRefTable,
-            gDvm.jniPinRefTable.table, (Object*) arrayObj))
+    JniRefStripe* pStripe = getRefStripe(gDvm.jniPinRefStripes, arrayObj);
+
+    lockRefStripe(pStripe);
+    if (!dvmRemoveFromReferenceTable(&pStripe->table,
+            pStripe->table.table, (Object*) arrayObj))
     {
         LOGW("JNI: unpinPrimitiveArray(%p) failed to find entry (valid=%d)\n",
             arrayObj, dvmIsValidObject((Object*) arrayObj));
@@ -1120,7 +1286,68 @@ static void unpinPrimitiveArray(ArrayObject* arrayObj)
     }
 
 bail:
-    dvmUnlockMutex(&gDvm.jniPinRefLock);
+    unlockRefStripe(pStripe);
+}
+
+/*
+ * Pin an array for a "critical" call.
+ *
+ * The critical functions must be called in matched pairs on the same
+ * thread with no intervening JNI calls, so we record the pin in a
+ * per-thread table and skip the global one and its lock.  The table is
+ * scanned as part of the thread's roots.
+ */
+static void pinCriticalArray(Thread* self, ArrayObject* arrayObj)
+{
+    static const int kInitialSize = 4;
+    ReferenceTable* pRefTable = &self->jniCriticalPinTable;
+
+    if (arrayObj == NULL)
+        return;
+
+    /* init table on first use */
+    if (pRefTable->table == NULL) {
+        assert(pRefTable->maxEntries == 0);
+
+        if (!dvmInitReferenceTable(pRefTable, kInitialSize, kPinTableMaxSize))
+        {
+            LOGE("Unable to initialize critical pin table\n");
+            dvmAbort();
+        }
+    }
+
+    if (!dvmAddToReferenceTable(pRefTable, (Object*) arrayObj)) {
+        dvmDumpReferenceTable(pRefTable, "JNI critical pin");
+        LOGE("Failed adding to JNI critical pin table (%d entries)\n",
+            (int) dvmReferenceTableEntries(pRefTable));
+        dvmDumpThread(self, false);
+        dvmAbort();
+    }
+    self->jniCriticalPinCount++;
+}
+
+/*
+ * Un-pin an array pinned by pinCriticalArray().  The JNI spec only allows
+ * the release on the thread that took the pin, and we can't safely change
+ * another thread's table, so a release from anywhere else is rejected.
+ * The pin stays with its owner until that thread releases it or exits.
+ */
+static void unpinCriticalArray(Thread* self, ArrayObject* arrayObj)
+{
+    ReferenceTable* pRefTable = &self->jniCriticalPinTable;
+
+    if (arrayObj == NULL)
+        return;
+
+    if (pRefTable->table == NULL ||
+        !dvmRemoveFromReferenceTable(pRefTable, pRefTable->table,
+            (Object*) arrayObj))
+    {
+        LOGW("JNI WARNING: critical array %p released by threadid=%d, "
+             "which didn't pin it\n", arrayObj, self->threadId);
+        return;
+    }
+    self->jniCriticalUnpinCount++;
 }
 
 /*
@@ -1139,9 +1366,65 @@ void dvmDumpJniReferenceTables(void)
     dvmDumpIndirectRefTable(&gDvm.jniGlobalRefTable, "JNI global");
 #else
     dvmDumpReferenceTable(pLocalRefs, "JNI local");
-    dvmDumpReferenceTable(&gDvm.jniGlobalRefTable, "JNI global");
+    dumpRefStripes(gDvm.jniGlobalRefStripes, "JNI global");
+#endif
+    dumpRefStripes(gDvm.jniPinRefStripes, "JNI pinned array");
+    if (self->jniCriticalPinTable.table != NULL)
+        dvmDumpReferenceTable(&self->jniCriticalPinTable, "JNI critical pin");
+    dvmLogJniRefTableStats();
+}
+
+/*
+ * Dump the JNI global reference table to the log file.
+ */
+void dvmDumpJniGlobalRefTable(void)
+{
+#ifdef USE_INDIRECT_REF
+    dvmLockMutex(&gDvm.jniGlobalRefLock);
+    dvmDumpIndirectRefTable(&gDvm.jniGlobalRefTable, "JNI global");
+    dvmUnlockMutex(&gDvm.jniGlobalRefLock);
+#else
+    dumpRefStripes(gDvm.jniGlobalRefStripes, "JNI global");
+#endif
+}
+
+/*
+ * Log the size of, and lock contention on, the striped JNI tables.  The
+ * counters are read without locking, so they may be slightly stale.
+ */
+void dvmLogJniRefTableStats(void)
+{
+    Thread* thread;
+    u4 pinCount, unpinCount;
+
+#ifndef USE_INDIRECT_REF
+    logRefStripeStats(gDvm.jniGlobalRefStripes, "JNI global refs");
 #endif
-    dvmDumpReferenceTable(&gDvm.jniPinRefTable, "JNI pinned array");
+    logRefStripeStats(gDvm.jniPinRefStripes, "JNI pinned arrays");
+
+    dvmLockThreadList(dvmThreadSelf());
+    pinCount = gDvm.jniCriticalPinRetired;
+    unpinCount = gDvm.jniCriticalUnpinRetired;
+    for (thread = gDvm.threadList; thread != NULL; thread = thread->next) {
+        pinCount += thread->jniCriticalPinCount;
+        unpinCount += thread->jniCriticalUnpinCount;
+    }
+    dvmUnlockThreadList();
+
+    LOGI("JNI critical pins: %u pinned, %u unpinned\n", pinCount, unpinCount);
+}
+
+/*
+ * Get the number of JNI global references and pinned arrays.
+ */
+void dvmGetJniRefCounts(int* pGlobalRefs, int* pPinnedArrays)
+{
+#ifdef USE_INDIRECT_REF
+    *pGlobalRefs = dvmIndirectRefTableEntries(&gDvm.jniGlobalRefTable);
+#else
+    *pGlobalRefs = countRefStripes(gDvm.jniGlobalRefStripes);
+#endif
+    *pPinnedArrays = countRefStripes(gDvm.jniPinRefStripes);
 }
 
 /*
@@ -1151,11 +1434,11 @@ void dvmDumpJniReferenceTables(void)
  */
 void dvmGcMarkJniGlobalRefs()
 {
+#ifdef USE_INDIRECT_REF
     Object** op;
 
     dvmLockMutex(&gDvm.jniGlobalRefLock);
 
-#ifdef USE_INDIRECT_REF
     IndirectRefTable* pRefTable = &gDvm.jniGlobalRefTable;
     op = pRefTable->table;
     int numEntries = dvmIndirectRefTableEntries(pRefTable);
@@ -1167,24 +1450,75 @@ void dvmGcMarkJniGlobalRefs()
             dvmMarkObjectNonNull(obj);
         op++;
     }
+
+    dvmUnlockMutex(&gDvm.jniGlobalRefLock);
 #else
-    op = gDvm.jniGlobalRefTable.table;
-    while ((uintptr_t)op < (uintptr_t)gDvm.jniGlobalRefTable.nextEntry) {
-        dvmMarkObjectNonNull(*(op++));
-    }
+    markRefStripes(gDvm.jniGlobalRefStripes);
 #endif
 
-    dvmUnlockMutex(&gDvm.jniGlobalRefLock);
+    markRefStripes(gDvm.jniPinRefStripes);
+}
 
+/*
+ * Pointer equality, for the pinned-array set below.
+ */
+static int hashcmpPinnedArray(const void* ptr1, const void* ptr2)
+{
+    return (ptr1 != ptr2);
+}
 
-    dvmLockMutex(&gDvm.jniPinRefLock);
+/*
+ * GC helper function to collect every pinned primitive array (the global
+ * pin stripes plus each thread's critical pins) into "pSet", hashed by
+ * address.  Code that wants to change which array an object refers to
+ * (e.g. String deduplication) must leave these alone: the native code
+ * holding the pin has a pointer into the array and will release it by
+ * looking it up again.
+ *
+ * All other threads must be suspended.
+ */
+void dvmGcCollectPinnedArrays(HashTable* pSet)
+{
+    Thread* thread;
+    int i;
+
+    for (i = 0; i < kJniRefStripes; i++) {
+        JniRefStripe* pStripe = &gDvm.jniPinRefStripes[i];
+        Object** op;
 
-    op = gDvm.jniPinRefTable.table;
-    while ((uintptr_t)op < (uintptr_t)gDvm.jniPinRefTable.nextEntry) {
-        dvmMarkObjectNonNull(*(op++));
+        dvmLockMutex(&pStripe->lock);
+        op = pStripe->table.table;
+        while ((uintptr_t)op < (uintptr_t)pStripe->table.nextEntry) {
+            dvmHashTableLookup(pSet, (u4)(uintptr_t)*op >> 3, *op,
+                hashcmpPinnedArray, true);
+            op++;
+        }
+        dvmUnlockMutex(&pStripe->lock);
     }
 
-    dvmUnlockMutex(&gDvm.jniPinRefLock);
+    dvmLockThreadList(dvmThreadSelf());
+    for (thread = gDvm.threadList; thread != NULL; thread = thread->next) {
+        ReferenceTable* pRefTable = &thread->jniCriticalPinTable;
+        Object** op;
+
+        if (pRefTable->table == NULL)
+            continue;
+        for (op = pRefTable->table; op < pRefTable->nextEntry; op++) {
+            dvmHashTableLookup(pSet, (u4)(uintptr_t)*op >> 3, *op,
+                hashcmpPinnedArray, true);
+        }
+    }
+    dvmUnlockThreadList();
+}
+
+/*
+ * Returns "true" if "arrayObj" is in a set built by
+ * dvmGcCollectPinnedArrays().
+ */
+bool dvmGcIsPinnedArray(HashTable* pSet, const ArrayObject* arrayObj)
+{
+    return dvmHashTableLookup(pSet, (u4)(uintptr_t)arrayObj >> 3,
+                (void*) arrayObj, hashcmpPinnedArray, false) != NULL;
 }
 
 
@@ -1316,33 +1650,71 @@ jobjectRefType dvmGetJNIRefType(JNIEnv* env, jobject jobj)
     }
 
     /* check globals */
-    dvmLockMutex(&gDvm.jniGlobalRefLock);
-    if (dvmFindInReferenceTable(&gDvm.jniGlobalRefTable,
-            gDvm.jniGlobalRefTable.table, jobj))
+    JniRefStripe* pStripe = getRefStripe(gDvm.jniGlobalRefStripes, jobj);
+    lockRefStripe(pStripe);
+    if (dvmFindInReferenceTable(&pStripe->table, pStripe->table.table, jobj))
     {
         //LOGI("--- REF found %p in globals\n", jobj);
-        dvmUnlockMutex(&gDvm.jniGlobalRefLock);
+        unlockRefStripe(pStripe);
         return JNIGlobalRefType;
     }
-    dvmUnlockMutex(&gDvm.jniGlobalRefLock);
+    unlockRefStripe(pStripe);
 
     /* not found! */
     return JNIInvalidRefType;
 #endif
 }
 
+/*
+ * Returns "true" if "method" can be called through the "critical" bridge.
+ * It must not be synchronized, every argument must be a primitive or an
+ * array of primitives, and it must not return a reference.
+ */
+static bool isCriticalNativeEligible(const Method* method)
+{
+    DexParameterIterator iterator;
+    const char* descriptor;
+
+    if (dvmIsSynchronizedMethod(method) || method->shorty[0] == 'L')
+        return false;
+
+    dexParameterIteratorInit(&iterator, &method->prototype);
+    while ((descriptor = dexParameterIteratorNextDescriptor(&iterator))
+            != NULL)
+    {
+        if (descriptor[0] == 'L')
+            return false;
+        if (descriptor[0] == '[' &&
+            (descriptor[1] == 'L' || descriptor[1] == '['))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 /*
  * Register a method that uses JNI calling conventions.
+ *
+ * A signature that starts with '!' marks a "critical" native: a leaf
+ * function that is called without a JNIEnv and without leaving the
+ * RUNNING state.  See dvmCallJNIMethod_critical() for the contract.
  */
 static bool dvmRegisterJNIMethod(ClassObject* clazz, const char* methodName,
     const char* signature, void* fnPtr)
 {
     Method* method;
+    bool critical = false;
     bool result = false;
 
     if (fnPtr == NULL)
         goto bail;
 
+    if (*signature == '!') {
+        critical = true;
+        signature++;
+    }
+
     method = dvmFindDirectMethodByDescriptor(clazz, methodName, signature);
     if (method == NULL)
         method = dvmFindVirtualMethodByDescriptor(clazz, methodName, signature);
@@ -1364,10 +1736,19 @@ static bool dvmRegisterJNIMethod(ClassObject* clazz, const char* methodName,
         /* keep going, I guess */
     }
 
-    dvmUseJNIBridge(method, fnPtr);
+    if (critical) {
+        if (!isCriticalNativeEligible(method)) {
+            LOGW("ERROR: %s.%s %s can't be registered as a critical native\n",
+                clazz->descriptor, methodName, signature);
+            goto bail;
+        }
+        dvmSetNativeFunc(method, dvmCallJNIMethod_critical, fnPtr);
+    } else {
+        dvmUseJNIBridge(method, fnPtr);
+    }
 
-    LOGV("JNI-registered %s.%s %s\n", clazz->descriptor, methodName,
-        signature);
+    LOGV("JNI-registered %s%s.%s %s\n", critical ? "critical " : "",
+        clazz->descriptor, methodName, signature);
     result = true;
 
 bail:
@@ -1826,6 +2207,63 @@ void dvmCallJNIMethod_staticNoRef(const u4* args, JValue* pResult,
     convertReferenceResult(self->jniEnv, pResult, method, self);
 }
 
+/*
+ * "Critical" native call, for small leaf functions like checksums and
+ * byte-swapping helpers where the cost of the transition would dominate.
+ *
+ * We don't change the thread status, create local references, or touch
+ * the JNI local frame.  The function is called with the usual JNI
+ * argument layout, but:
+ *  - the JNIEnv* is NULL, so it can't call back into the VM;
+ *  - the jclass/jobject receiver is a raw pointer and must not be used;
+ *  - each primitive array argument is replaced by a pointer to the array
+ *    contents (or NULL for a null array).  Pass the offset and length
+ *    explicitly if the function needs them.
+ *
+ * Because the thread stays in RUNNING, the GC can't start until the
+ * function returns, so the contents pointers stay valid without pinning.
+ * The function must not block or run for long.
+ */
+void dvmCallJNIMethod_critical(const u4* args, JValue* pResult,
+    const Method* method, Thread* self)
+{
+    u4* modArgs = (u4*) args;
+    ClassObject* staticMethodClass;
+    int idx = 0;
+
+    if (dvmIsStaticMethod(method)) {
+        staticMethodClass = method->clazz;
+    } else {
+        staticMethodClass = NULL;
+        idx = 1;
+    }
+
+    const char* shorty = &method->shorty[1];        /* skip return type */
+    while (*shorty != '\0') {
+        switch (*shorty++) {
+        case 'L':
+            if (modArgs[idx] != 0) {
+                ArrayObject* arrayObj = (ArrayObject*) modArgs[idx];
+                modArgs[idx] = (u4) arrayObj->contents;
+            }
+            break;
+        case 'D':
+        case 'J':
+            idx++;
+            break;
+        default:
+            break;
+        }
+        idx++;
+    }
+
+    COMPUTE_STACK_SUM(self);
+    dvmPlatformInvoke(NULL, staticMethodClass,
+        method->jniArgInfo, method->insSize, modArgs, method->shorty,
+        (void*)method->insns, pResult);
+    CHECK_STACK_SUM(self);
+}
+
 /*
  * Extract the return type enum from the "jniArgInfo" field.
  */
@@ -2910,6 +3348,29 @@ static jsize GetStringLength(JNIEnv* env, jstring jstr)
 }
 
 
+/*
+ * A Latin-1 string has no UTF-16 data to hand out, so the jchar calls
+ * get a malloc()ed copy instead.  The coder of a string never changes, so
+ * the release calls can tell which it was.
+ *
+ * Returns NULL and throws on failure.
+ */
+static u2* copyLatin1String(StringObject* strObj)
+{
+    int len = dvmStringLen(strObj);
+    u2* chars;
+
+    /* one extra so that an empty string still gets a pointer */
+    chars = (u2*) malloc((len + 1) * sizeof(u2));
+    if (chars == NULL) {
+        dvmThrowException("Ljava/lang/OutOfMemoryError;",
+            "native heap string alloc failed");
+        return NULL;
+    }
+    dvmStringCopyChars(strObj, 0, len, chars);
+    return chars;
+}
+
 /*
  * Get a string's character data.
  *
@@ -2921,13 +3382,18 @@ static const jchar* GetStringChars(JNIEnv* env, jstring jstr, jboolean* isCopy)
     JNI_ENTER();
 
     StringObject* strObj = (StringObject*) dvmDecodeIndirectRef(env, jstr);
-    ArrayObject* strChars = dvmStringCharArray(strObj);
-
-    pinPrimitiveArray(strChars);
+    const u2* data;
 
-    const u2* data = dvmStringChars(strObj);
-    if (isCopy != NULL)
-        *isCopy = JNI_FALSE;
+    if (dvmStringIsLatin1(strObj)) {
+        data = copyLatin1String(strObj);
+        if (isCopy != NULL)
+            *isCopy = JNI_TRUE;
+    } else {
+        pinPrimitiveArray(dvmStringCharArray(strObj));
+        data = dvmStringChars(strObj);
+        if (isCopy != NULL)
+            *isCopy = JNI_FALSE;
+    }
 
     JNI_EXIT();
     return (jchar*)data;
@@ -2940,8 +3406,10 @@ static void ReleaseStringChars(JNIEnv* env, jstring jstr, const jchar* chars)
 {
     JNI_ENTER();
     StringObject* strObj = (StringObject*) dvmDecodeIndirectRef(env, jstr);
-    ArrayObject* strChars = dvmStringCharArray(strObj);
-    unpinPrimitiveArray(strChars);
+    if (dvmStringIsLatin1(strObj))
+        free((jchar*) chars);
+    else
+        unpinPrimitiveArray(dvmStringCharArray(strObj));
     JNI_EXIT();
 }
 
@@ -3392,7 +3860,7 @@ static void GetStringRegion(JNIEnv* env, jstring jstr, jsize start, jsize len,
     if (start + len > dvmStringLen(strObj))
         dvmThrowException("Ljava/lang/StringIndexOutOfBoundsException;", NULL);
     else
-        memcpy(buf, dvmStringChars(strObj) + start, len * sizeof(u2));
+        dvmStringCopyChars(strObj, start, len, buf);
     JNI_EXIT();
 }
 
@@ -3426,7 +3894,7 @@ static void* GetPrimitiveArrayCritical(JNIEnv* env, jarray jarr,
     JNI_ENTER();
     void* data;
     ArrayObject* arrayObj = (ArrayObject*) dvmDecodeIndirectRef(env, jarr);
-    pinPrimitiveArray(arrayObj);
+    pinCriticalArray(_self, arrayObj);
     data = arrayObj->contents;
     if (isCopy != NULL)
         *isCopy = JNI_FALSE;
@@ -3443,7 +3911,7 @@ static void ReleasePrimitiveArrayCritical(JNIEnv* env, jarray jarr,
     JNI_ENTER();
     if (mode != JNI_COMMIT) {
         ArrayObject* arrayObj = (ArrayObject*) dvmDecodeIndirectRef(env, jarr);
-        unpinPrimitiveArray(arrayObj);
+        unpinCriticalArray(_self, arrayObj);
     }
     JNI_EXIT();
 }
@@ -3456,13 +3924,18 @@ static const jchar* GetStringCritical(JNIEnv* env, jstring jstr,
 {
     JNI_ENTER();
     StringObject* strObj = (StringObject*) dvmDecodeIndirectRef(env, jstr);
-    ArrayObject* strChars = dvmStringCharArray(strObj);
-
-    pinPrimitiveArray(strChars);
+    const u2* data;
 
-    const u2* data = dvmStringChars(strObj);
-    if (isCopy != NULL)
-        *isCopy = JNI_FALSE;
+    if (dvmStringIsLatin1(strObj)) {
+        data = copyLatin1String(strObj);
+        if (isCopy != NULL)
+            *isCopy = JNI_TRUE;
+    } else {
+        pinCriticalArray(_self, dvmStringCharArray(strObj));
+        data = dvmStringChars(strObj);
+        if (isCopy != NULL)
+            *isCopy = JNI_FALSE;
+    }
 
     JNI_EXIT();
     return (jchar*)data;
@@ -3476,8 +3949,10 @@ static void ReleaseStringCritical(JNIEnv* env, jstring jstr,
 {
     JNI_ENTER();
     StringObject* strObj = (StringObject*) dvmDecodeIndirectRef(env, jstr);
-    ArrayObject* strChars = dvmStringCharArray(strObj);
-    unpinPrimitiveArray(strChars);
+    if (dvmStringIsLatin1(strObj))
+        free((jchar*) carray);
+    else
+        unpinCriticalArray(_self, dvmStringCharArray(strObj));
     JNI_EXIT();
 }
 
@@ -70,6 +70,20 @@ typedef struct JavaVMExt {
     pthread_mutex_t envListLock;
 } JavaVMExt;
 
+/*
+ * One segment of a striped JNI reference table.  Global references and
+ * pinned arrays are spread across kJniRefStripes of these by object
+ * address, so threads working on unrelated objects don't all contend on
+ * one lock.  The counters are only updated while "lock" is held.
+ */
+#define kJniRefStripes  16              /* must be a power of 2 */
+typedef struct JniRefStripe {
+    ReferenceTable  table;
+    pthread_mutex_t lock;
+    u4              lockCount;          /* times "lock" was acquired */
+    u4              contendedCount;     /* ...and we had to wait for it */
+} JniRefStripe;
+
 /*
  * Native function return type; used by dvmPlatformInvoke().
  *
@@ -133,6 +147,8 @@ void dvmCallJNIMethod_virtualNoRef(const u4* args, JValue* pResult,
     const Method* method, Thread* self);
 void dvmCallJNIMethod_staticNoRef(const u4* args, JValue* pResult,
     const Method* method, Thread* self);
+void dvmCallJNIMethod_critical(const u4* args, JValue* pResult,
+    const Method* method, Thread* self);
 void dvmCheckCallJNIMethod_general(const u4* args, JValue* pResult,
     const Method* method, Thread* self);
 void dvmCheckCallJNIMethod_synchronized(const u4* args, JValue* pResult,
@@ -208,6 +224,23 @@ void dvmReleaseJniMonitors(Thread* self);
  */
 void dvmDumpJniReferenceTables(void);
 
+/*
+ * Dump the JNI global reference table to the log file.
+ */
+void dvmDumpJniGlobalRefTable(void);
+
+/*
+ * Log the number of entries in, and lock contention on, the JNI global
+ * reference and pinned array tables.
+ */
+void dvmLogJniRefTableStats(void);
+
+/*
+ * Get the number of JNI global references and pinned arrays.  Nothing is
+ * locked, so the counts are approximate while other threads are active.
+ */
+void dvmGetJniRefCounts(int* pGlobalRefs, int* pPinnedArrays);
+
 /*
  * This mask is applied to weak global reference values returned to
  * native code.  The goal is to create an invalid pointer that will cause
@@ -25,6 +25,11 @@
 
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 static void freeSharedLibEntry(void* ptr);
 static void* lookupSharedLibMethod(const Method* method);
@@ -110,7 +115,18 @@ void dvmResolveNativeMethod(const u4* args, JValue* pResult,
     }
 
     /* now scan any DLLs we have loaded for JNI signatures */
+    u8 startWhen = dvmGetRelativeTimeNsec();
     func = lookupSharedLibMethod(method);
+    u8 elapsed = dvmGetRelativeTimeNsec() - startWhen;
+    gDvm.nativeResolveCount++;
+    gDvm.nativeResolveTimeNsec += elapsed;
+    if (gDvm.verboseJni) {
+        LOGI("JNI: %s %s.%s in %lluns (%d lookups, avg %lluns)\n",
+            (func != NULL) ? "resolved" : "failed to resolve",
+            clazz->descriptor, method->name, elapsed,
+            gDvm.nativeResolveCount,
+            gDvm.nativeResolveTimeNsec / gDvm.nativeResolveCount);
+    }
     if (func != NULL) {
         /* found it, point it at the JNI bridge and then call it */
         dvmUseJNIBridge((Method*) method, func);
@@ -158,6 +174,8 @@ typedef struct SharedLib {
     pthread_cond_t  onLoadCond;     /* wait for JNI_OnLoad in other thread */
     u4              onLoadThreadId; /* recursive invocation guard */
     OnLoadState     onLoadResult;   /* result of earlier JNI_OnLoad */
+
+    HashTable*  jniSymbols;         /* exported "Java_" names, or NULL */
 } SharedLib;
 
 /*
@@ -237,6 +255,7 @@ static void freeSharedLibEntry(void* ptr)
      */
     if (false)
         dlclose(pLib->handle);
+    dvmHashTableFree(pLib->jniSymbols);
     free(pLib->pathName);
     free(pLib);
 }
@@ -384,6 +403,178 @@ bail:
 #endif
 
 
+/*
+ * ===========================================================================
+ *      Exported JNI symbol index
+ * ===========================================================================
+ */
+
+#ifdef __LP64__
+typedef Elf64_Ehdr NativeElfEhdr;
+typedef Elf64_Shdr NativeElfShdr;
+typedef Elf64_Sym NativeElfSym;
+# define NATIVE_ELF_CLASS   ELFCLASS64
+# define NATIVE_ELF_ST_TYPE ELF64_ST_TYPE
+# define NATIVE_ELF_ST_BIND ELF64_ST_BIND
+#else
+typedef Elf32_Ehdr NativeElfEhdr;
+typedef Elf32_Shdr NativeElfShdr;
+typedef Elf32_Sym NativeElfSym;
+# define NATIVE_ELF_CLASS   ELFCLASS32
+# define NATIVE_ELF_ST_TYPE ELF32_ST_TYPE
+# define NATIVE_ELF_ST_BIND ELF32_ST_BIND
+#endif
+
+/*
+ * (This is a dvmHashTableLookup callback.)
+ */
+static int hashcmpSymbolName(const void* ventry, const void* vname)
+{
+    return strcmp((const char*) ventry, (const char*) vname);
+}
+
+/*
+ * Return the symbol name if "pSym" is a defined function whose name
+ * starts with "Java_", or NULL if it isn't.  The string table has already
+ * been bounds-checked; we just make sure the name starts inside it.
+ */
+static const char* jniSymbolName(const NativeElfSym* pSym,
+    const char* strtab, size_t strtabSize)
+{
+    int bind = NATIVE_ELF_ST_BIND(pSym->st_info);
+
+    if (pSym->st_shndx == SHN_UNDEF ||
+        NATIVE_ELF_ST_TYPE(pSym->st_info) != STT_FUNC ||
+        (bind != STB_GLOBAL && bind != STB_WEAK) ||
+        pSym->st_name + 6 > strtabSize)
+    {
+        return NULL;
+    }
+    const char* name = strtab + pSym->st_name;
+    if (strncmp(name, "Java_", 5) != 0 ||
+        memchr(name, '\0', strtabSize - pSym->st_name) == NULL)
+    {
+        return NULL;
+    }
+    return name;
+}
+
+/*
+ * Build an index of the "Java_" functions exported by the library at
+ * "pathName", by walking the .dynsym section of the file on disk.
+ *
+ * Without this, resolving a JNI method means mangling its name and
+ * calling dlsym() on every library loaded by the method's class loader,
+ * once for the short form and again for the long form.  Most of those
+ * calls fail, and each one is a full walk through the linker's hash
+ * chains.  With the index, a function the library defines itself is
+ * found with a single dlsym() call before we start probing.
+ *
+ * The index only covers the library's own symbols, but dlsym() also
+ * searches the libraries it depends on, so a name missing from the index
+ * may still resolve.  A miss is never taken as final.
+ *
+ * Returns NULL if the file can't be parsed (e.g. the section headers have
+ * been stripped), in which case the caller falls back to dlsym().
+ */
+static HashTable* buildJniSymbolIndex(const char* pathName)
+{
+    HashTable* pTable = NULL;
+    void* map = MAP_FAILED;
+    size_t mapLen = 0;
+    struct stat st;
+    int fd;
+
+    fd = open(pathName, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(NativeElfEhdr))
+        goto bail;
+    mapLen = st.st_size;
+    map = mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        goto bail;
+
+    const u1* base = (const u1*) map;
+    const NativeElfEhdr* pEhdr = (const NativeElfEhdr*) base;
+    if (memcmp(pEhdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        pEhdr->e_ident[EI_CLASS] != NATIVE_ELF_CLASS ||
+        pEhdr->e_shentsize != sizeof(NativeElfShdr) ||
+        pEhdr->e_shoff == 0 ||
+        pEhdr->e_shoff + (size_t) pEhdr->e_shnum * sizeof(NativeElfShdr)
+            > mapLen)
+    {
+        goto bail;
+    }
+
+    const NativeElfShdr* pShdrs = (const NativeElfShdr*) (base + pEhdr->e_shoff);
+    const NativeElfShdr* pSymShdr = NULL;
+    int i;
+    for (i = 0; i < pEhdr->e_shnum; i++) {
+        if (pShdrs[i].sh_type == SHT_DYNSYM) {
+            pSymShdr = &pShdrs[i];
+            break;
+        }
+    }
+    if (pSymShdr == NULL || pSymShdr->sh_link >= pEhdr->e_shnum ||
+        pSymShdr->sh_entsize != sizeof(NativeElfSym))
+    {
+        goto bail;
+    }
+    const NativeElfShdr* pStrShdr = &pShdrs[pSymShdr->sh_link];
+    if (pSymShdr->sh_offset + pSymShdr->sh_size > mapLen ||
+        pStrShdr->sh_offset + pStrShdr->sh_size > mapLen)
+    {
+        goto bail;
+    }
+
+    const NativeElfSym* pSyms =
+        (const NativeElfSym*) (base + pSymShdr->sh_offset);
+    size_t symCount = pSymShdr->sh_size / sizeof(NativeElfSym);
+    const char* strtab = (const char*) (base + pStrShdr->sh_offset);
+    size_t strtabSize = pStrShdr->sh_size;
+    size_t jniCount = 0;
+    size_t j;
+
+    for (j = 0; j < symCount; j++) {
+        if (jniSymbolName(&pSyms[j], strtab, strtabSize) != NULL)
+            jniCount++;
+    }
+
+    pTable = dvmHashTableCreate(dvmHashSize(jniCount), free);
+    if (pTable == NULL)
+        goto bail;
+    for (j = 0; j < symCount; j++) {
+        const char* name = jniSymbolName(&pSyms[j], strtab, strtabSize);
+        if (name == NULL)
+            continue;
+
+        char* copy = strdup(name);
+        if (dvmHashTableLookup(pTable, dvmComputeUtf8Hash(copy), copy,
+                hashcmpSymbolName, true) != copy)
+        {
+            free(copy);     /* duplicate, e.g. versioned symbol */
+        }
+    }
+
+bail:
+    if (map != MAP_FAILED)
+        munmap(map, mapLen);
+    close(fd);
+    return pTable;
+}
+
+/*
+ * Returns "true" if the library whose index is "jniSymbols" defines
+ * "name" itself.
+ */
+static bool definesJniSymbol(HashTable* jniSymbols, const char* name)
+{
+    return dvmHashTableLookup(jniSymbols, dvmComputeUtf8Hash(name),
+                (void*) name, hashcmpSymbolName, false) != NULL;
+}
+
+
 /*
  * Check the result of an earlier call to JNI_OnLoad on this library.  If
  * the call has not yet finished in another thread, wait for it.
@@ -519,6 +710,18 @@ bool dvmLoadNativeCode(const char* pathName, Object* classLoader)
     pthread_cond_init(&pNewEntry->onLoadCond, NULL);
     pNewEntry->onLoadThreadId = self->threadId;
 
+    u8 indexStart = dvmGetRelativeTimeNsec();
+    pNewEntry->jniSymbols = buildJniSymbolIndex(pathName);
+    if (verbose || gDvm.verboseJni) {
+        if (pNewEntry->jniSymbols == NULL) {
+            LOGD("No JNI symbol index for %s, using dlsym\n", pathName);
+        } else {
+            LOGD("Indexed %d JNI symbols in %s (%lluus)\n",
+                dvmHashTableNumEntries(pNewEntry->jniSymbols), pathName,
+                (dvmGetRelativeTimeNsec() - indexStart) / 1000);
+        }
+    }
+
     /* try to add it to the list */
     SharedLib* pActualEntry = addSharedLibEntry(pNewEntry);
 
@@ -735,85 +938,201 @@ static char* createMangledSignature(const DexProto* proto)
 }
 
 /*
- * (This is a dvmHashForeach callback.)
- *
- * Search for a matching method in this shared library.
- *
- * TODO: we may want to skip libraries for which JNI_OnLoad failed.
+ * Mangled JNI names for the method being resolved.  We build these once
+ * per lookup rather than once per library.
  */
-static int findMethodInLib(void* vlib, void* vmethod)
+typedef struct JniMethodNames {
+    const Method*   meth;
+    char*           shortName;      /* Java_<class>_<method> */
+    char*           longName;       /* shortName + "__" + args; lazy */
+    bool            longFailed;     /* couldn't create longName */
+    bool            indexedOnly;    /* only try names found in an index */
+} JniMethodNames;
+
+/*
+ * Return the long ("overloaded") form of the name, creating it on first
+ * use.  Returns NULL on allocation failure.
+ */
+static const char* getLongJniName(JniMethodNames* pNames)
 {
-    const SharedLib* pLib = (const SharedLib*) vlib;
-    const Method* meth = (const Method*) vmethod;
-    char* preMangleCM = NULL;
-    char* mangleCM = NULL;
-    char* mangleSig = NULL;
-    char* mangleCMSig = NULL;
-    void* func = NULL;
+    char* mangleSig;
+
+    if (pNames->longName != NULL || pNames->longFailed)
+        return pNames->longName;
+
+    mangleSig = createMangledSignature(&pNames->meth->prototype);
+    if (mangleSig != NULL) {
+        pNames->longName = (char*)
+            malloc(strlen(pNames->shortName) + strlen(mangleSig) +3);
+        if (pNames->longName != NULL)
+            sprintf(pNames->longName, "%s__%s", pNames->shortName, mangleSig);
+        free(mangleSig);
+    }
+    pNames->longFailed = (pNames->longName == NULL);
+    return pNames->longName;
+}
+
+/*
+ * Build the short form of the JNI name for "meth".  The long form is
+ * created later, if it's needed.  Returns "false" on allocation failure.
+ */
+static bool initJniMethodNames(JniMethodNames* pNames, const Method* meth)
+{
+    char* preMangleCM;
     int len;
 
-    if (meth->clazz->classLoader != pLib->classLoader) {
-        LOGV("+++ not scanning '%s' for '%s' (wrong CL)\n",
-            pLib->pathName, meth->name);
-        return 0;
-    } else
-        LOGV("+++ scanning '%s' for '%s'\n", pLib->pathName, meth->name);
+    memset(pNames, 0, sizeof(*pNames));
+    pNames->meth = meth;
 
-    /*
-     * First, we try it without the signature.
-     */
     preMangleCM =
         createJniNameString(meth->clazz->descriptor, meth->name, &len);
     if (preMangleCM == NULL)
-        goto bail;
+        return false;
+    pNames->shortName = mangleString(preMangleCM, len);
+    free(preMangleCM);
 
-    mangleCM = mangleString(preMangleCM, len);
-    if (mangleCM == NULL)
-        goto bail;
+    return pNames->shortName != NULL;
+}
 
-    LOGV("+++ calling dlsym(%s)\n", mangleCM);
-    func = dlsym(pLib->handle, mangleCM);
-    if (func == NULL) {
-        mangleSig =
-            createMangledSignature(&meth->prototype);
-        if (mangleSig == NULL)
-            goto bail;
+static void freeJniMethodNames(JniMethodNames* pNames)
+{
+    free(pNames->shortName);
+    free(pNames->longName);
+}
 
-        mangleCMSig = (char*) malloc(strlen(mangleCM) + strlen(mangleSig) +3);
-        if (mangleCMSig == NULL)
-            goto bail;
+/*
+ * Search for the method's function in one library, first without the
+ * signature and then with it.
+ *
+ * If "indexedOnly" is set we only try names that the library's symbol
+ * index ("jniSymbols") says it defines, so each dlsym() call succeeds.
+ * Otherwise we ask dlsym() for both names, which also searches the
+ * libraries this one depends on.
+ */
+static void* findJniFunction(void* handle, HashTable* jniSymbols,
+    JniMethodNames* pNames)
+{
+    const char* longName;
+    void* func;
 
-        sprintf(mangleCMSig, "%s__%s", mangleCM, mangleSig);
+    if (!pNames->indexedOnly ||
+        definesJniSymbol(jniSymbols, pNames->shortName))
+    {
+        LOGV("+++ calling dlsym(%s)\n", pNames->shortName);
+        func = dlsym(handle, pNames->shortName);
+        if (func != NULL) {
+            LOGV("Found '%s' with dlsym\n", pNames->shortName);
+            return func;
+        }
+    }
 
-        LOGV("+++ calling dlsym(%s)\n", mangleCMSig);
-        func = dlsym(pLib->handle, mangleCMSig);
+    longName = getLongJniName(pNames);
+    if (longName != NULL &&
+        (!pNames->indexedOnly || definesJniSymbol(jniSymbols, longName)))
+    {
+        LOGV("+++ calling dlsym(%s)\n", longName);
+        func = dlsym(handle, longName);
         if (func != NULL) {
-            LOGV("Found '%s' with dlsym\n", mangleCMSig);
+            LOGV("Found '%s' with dlsym\n", longName);
+            return func;
         }
-    } else {
-        LOGV("Found '%s' with dlsym\n", mangleCM);
     }
 
-bail:
-    free(preMangleCM);
-    free(mangleCM);
-    free(mangleSig);
-    free(mangleCMSig);
-    return (int) func;
+    return NULL;
+}
+
+/*
+ * (This is a dvmHashForeach callback.)
+ *
+ * Search for a matching method in this shared library.  On the indexed
+ * pass, libraries without an index are left for the second pass.
+ *
+ * TODO: we may want to skip libraries for which JNI_OnLoad failed.
+ */
+static int findMethodInLib(void* vlib, void* vnames)
+{
+    const SharedLib* pLib = (const SharedLib*) vlib;
+    JniMethodNames* pNames = (JniMethodNames*) vnames;
+    const Method* meth = pNames->meth;
+
+    if (meth->clazz->classLoader != pLib->classLoader) {
+        LOGV("+++ not scanning '%s' for '%s' (wrong CL)\n",
+            pLib->pathName, meth->name);
+        return 0;
+    } else
+        LOGV("+++ scanning '%s' for '%s'\n", pLib->pathName, meth->name);
+
+    if (pNames->indexedOnly && pLib->jniSymbols == NULL)
+        return 0;
+
+    return (int) findJniFunction(pLib->handle, pLib->jniSymbols, pNames);
 }
 
 /*
  * See if the requested method lives in any of the currently-loaded
  * shared libraries.  We do this by checking each of them for the expected
  * method signature.
+ *
+ * The first pass only looks at names the libraries' symbol indexes say
+ * they define, which finds the usual case with one dlsym() call.  If
+ * that fails we ask dlsym() about every library, as we always used to;
+ * the function may be exported by one of their dependencies.
  */
 static void* lookupSharedLibMethod(const Method* method)
 {
+    JniMethodNames names;
+    void* func;
+
     if (gDvm.nativeLibs == NULL) {
         LOGE("Unexpected init state: nativeLibs not ready\n");
         dvmAbort();
     }
-    return (void*) dvmHashForeach(gDvm.nativeLibs, findMethodInLib,
-        (void*) method);
+
+    if (!initJniMethodNames(&names, method)) {
+        freeJniMethodNames(&names);
+        return NULL;
+    }
+
+    names.indexedOnly = true;
+    func = (void*) dvmHashForeach(gDvm.nativeLibs, findMethodInLib, &names);
+    if (func == NULL) {
+        names.indexedOnly = false;
+        func = (void*) dvmHashForeach(gDvm.nativeLibs, findMethodInLib,
+                    &names);
+    }
+
+    freeJniMethodNames(&names);
+    return func;
 }
 
+#ifndef NDEBUG
+/*
+ * Look up the function for "meth" in the library opened as "handle",
+ * the way lookupSharedLibMethod() does.  "jniSymbols" may be NULL.  This
+ * is for test/TestNativeLookup.c.
+ */
+void* dvmTestFindJniFunction(void* handle, HashTable* jniSymbols,
+    const Method* meth)
+{
+    JniMethodNames names;
+    void* func = NULL;
+
+    if (!initJniMethodNames(&names, meth)) {
+        freeJniMethodNames(&names);
+        return NULL;
+    }
+
+    if (jniSymbols != NULL) {
+        names.indexedOnly = true;
+        func = findJniFunction(handle, jniSymbols, &names);
+    }
+    if (func == NULL) {
+        names.indexedOnly = false;
+        func = findJniFunction(handle, jniSymbols, &names);
+    }
+
+    freeJniMethodNames(&names);
+    return func;
+}
+#endif
+
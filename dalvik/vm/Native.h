@@ -65,6 +65,15 @@ char* dvmCreateSystemLibraryName(char* libName);
 //void dvmLoadNativeLibrary(StringObject* libNameObj, Object* classLoader);
 bool dvmLoadNativeCode(const char* fileName, Object* classLoader);
 
+#ifndef NDEBUG
+/*
+ * Find the function for "meth" in an already-opened library, using
+ * "jniSymbols" (may be NULL) as its symbol index.  For internal tests.
+ */
+void* dvmTestFindJniFunction(void* handle, struct HashTable* jniSymbols,
+    const Method* meth);
+#endif
+
 
 /*
  * Resolve a native method.  This uses the same prototype as a
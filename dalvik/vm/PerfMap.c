@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Map files for native profilers (-Xperfmap, -Xperfshadow).
+ *
+ * Both files have perf's map format, one "<hex start> <hex size> <name>"
+ * line per symbol.  Lines are only ever appended, and each batch is
+ * flushed, so a profile taken while we run (or after we crash) can use
+ * whatever is there.  If the JIT code cache is flushed and reused, later
+ * lines for the same addresses take over.
+ */
+#include "Dalvik.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#ifdef WITH_PROFILER        // -- include rest of file
+
+/*
+ * Open "/tmp/perf-<pid>.<suffix>".
+ */
+static FILE* openMapFile(const char* suffix)
+{
+    char fileName[64];
+    FILE* fp;
+
+    snprintf(fileName, sizeof(fileName), "/tmp/perf-%d.%s",
+        (int) getpid(), suffix);
+    fp = fopen(fileName, "w");
+    if (fp == NULL) {
+        LOGW("Unable to open '%s': %s\n", fileName, strerror(errno));
+        return NULL;
+    }
+    LOGI("Writing native profiler symbols to '%s'\n", fileName);
+    return fp;
+}
+
+/*
+ * Write one method.  The name is "pkg.Class.method", which is what the
+ * flame graph tools expect.  Caller must hold perfMapLock.
+ */
+static void writeMethod(FILE* fp, const Method* method)
+{
+    const char* cp = method->clazz->descriptor;
+
+    fprintf(fp, "%llx %x ", (unsigned long long) (uintptr_t) method,
+        (int) sizeof(Method));
+    if (*cp == 'L')
+        cp++;
+    for ( ; *cp != '\0' && *cp != ';'; cp++)
+        fputc((*cp == '/') ? '.' : *cp, fp);
+    fprintf(fp, ".%s\n", method->name);
+}
+
+/*
+ * Name every method the class declares.
+ */
+void dvmPerfMapAddClass(const ClassObject* clazz)
+{
+    int i;
+
+    if (gDvm.perfMethodFile == NULL)
+        return;
+
+    dvmLockMutex(&gDvm.perfMapLock);
+    for (i = 0; i < clazz->directMethodCount; i++)
+        writeMethod(gDvm.perfMethodFile, &clazz->directMethods[i]);
+    for (i = 0; i < clazz->virtualMethodCount; i++)
+        writeMethod(gDvm.perfMethodFile, &clazz->virtualMethods[i]);
+    fflush(gDvm.perfMethodFile);
+    dvmUnlockMutex(&gDvm.perfMapLock);
+}
+
+/*
+ * Name a piece of generated code.
+ */
+void dvmPerfMapAddCode(const void* start, size_t size, const char* fmt, ...)
+{
+    va_list args;
+
+    if (gDvm.perfCodeFile == NULL)
+        return;
+
+    dvmLockMutex(&gDvm.perfMapLock);
+    fprintf(gDvm.perfCodeFile, "%llx %zx ",
+        (unsigned long long) (uintptr_t) start, size);
+    va_start(args, fmt);
+    vfprintf(gDvm.perfCodeFile, fmt, args);
+    va_end(args);
+    fputc('\n', gDvm.perfCodeFile);
+    fflush(gDvm.perfCodeFile);
+    dvmUnlockMutex(&gDvm.perfMapLock);
+}
+
+/*
+ * Hash table iterator for the classes that were linked before we started
+ * (e.g. preloaded in the zygote).  Ones still being linked will be written
+ * by dvmLinkClass().
+ */
+static int addLoadedClass(void* vclazz, void* arg)
+{
+    const ClassObject* clazz = (const ClassObject*) vclazz;
+
+    UNUSED_PARAMETER(arg);
+
+    if (clazz->status >= CLASS_RESOLVED)
+        dvmPerfMapAddClass(clazz);
+    return 0;
+}
+
+bool dvmPerfMapStartup(void)
+{
+    if (!gDvm.perfMap && !gDvm.perfShadow)
+        return true;
+
+    dvmInitMutex(&gDvm.perfMapLock);
+
+    if (gDvm.perfMap)
+        gDvm.perfCodeFile = openMapFile("map");
+
+    if (gDvm.perfShadow) {
+        gDvm.perfMethodFile = openMapFile("methods");
+        if (gDvm.perfMethodFile != NULL) {
+            dvmHashTableLock(gDvm.loadedClasses);
+            dvmHashForeach(gDvm.loadedClasses, addLoadedClass, NULL);
+            dvmHashTableUnlock(gDvm.loadedClasses);
+        }
+    }
+
+    return true;
+}
+
+void dvmPerfMapShutdown(void)
+{
+    if (gDvm.perfCodeFile == NULL && gDvm.perfMethodFile == NULL)
+        return;
+
+    dvmLockMutex(&gDvm.perfMapLock);
+    if (gDvm.perfCodeFile != NULL) {
+        fclose(gDvm.perfCodeFile);
+        gDvm.perfCodeFile = NULL;
+    }
+    if (gDvm.perfMethodFile != NULL) {
+        fclose(gDvm.perfMethodFile);
+        gDvm.perfMethodFile = NULL;
+    }
+    dvmUnlockMutex(&gDvm.perfMapLock);
+}
+
+/*
+ * Rebuild a shadow after an exception unwound an unknown number of frames,
+ * or after returns used up the frames it had.
+ */
+void dvmPerfShadowRefill(PerfShadow* shadow, const u4* fp, bool recount)
+{
+    const Method* methods[kPerfShadowFrames];
+    u4 relPcs[kPerfShadowFrames];
+    const StackSaveArea* calleeSave = NULL;
+    u4 count = 0, total = 0;
+    u4 i;
+
+    for ( ; fp != NULL && !dvmIsBreakFrame(fp);
+        fp = SAVEAREA_FROM_FP(fp)->prevFrame)
+    {
+        const StackSaveArea* saveArea = SAVEAREA_FROM_FP(fp);
+
+        if (count < kPerfShadowFrames &&
+            (recount || count < shadow->depth))
+        {
+            methods[count] = saveArea->method;
+            relPcs[count] = (calleeSave == NULL) ? 0 :
+                calleeSave->savedPc - saveArea->method->insns;
+            count++;
+        } else if (!recount) {
+            break;
+        }
+        calleeSave = saveArea;
+        total++;
+    }
+
+    if (recount)
+        shadow->depth = total;
+    for (i = 0; i < count; i++) {
+        u4 slot = (shadow->depth - 1 - i) & (kPerfShadowFrames-1);
+
+        shadow->method[slot] = (uintptr_t) methods[i];
+        shadow->relPc[slot] = relPcs[i];
+    }
+    shadow->valid = count;
+}
+
+#endif /*WITH_PROFILER*/
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Help for native profilers, such as Linux "perf".
+ *
+ * -Xperfmap writes /tmp/perf-<pid>.map, naming the code we generate at
+ * run time (JIT traces), in the format perf reads for anonymous memory.
+ *
+ * -Xperfshadow makes each interpreter activation keep a "shadow" copy of
+ * its innermost Java frames, and writes /tmp/perf-<pid>.methods, naming
+ * every Method struct.  See tools/dvmperf.
+ */
+#ifndef _DALVIK_PERFMAP
+#define _DALVIK_PERFMAP
+
+#include <stdint.h>
+
+/*
+ * The shadow lives in InterpState, which is a local in dvmInterpret(), so
+ * it sits on the native stack just above the interpreter loop.  A profiler
+ * that copies the user stack with each sample ("perf record --call-graph
+ * dwarf") gets it for free, and can find it by the magic number.
+ *
+ * The layout uses fixed-size fields so that 32-bit and 64-bit VMs look
+ * the same to the tools.
+ *
+ * "method" is a ring indexed by frame depth within the activation.  The
+ * innermost frame is in method[(depth-1) % kPerfShadowFrames], its caller
+ * just before that, and so on for "valid" frames.  relPc[n] is where the
+ * frame in method[n] called the next one in, in 16-bit code units; the
+ * innermost frame's isn't kept.
+ */
+#define kPerfShadowMagic    0x574f444148534d56ULL   /* "VMSHADOW" */
+#define kPerfShadowFrames   16                      /* must be power of 2 */
+
+typedef struct PerfShadow {
+    uint64_t    magic;
+    uint32_t    depth;              /* Java frames in this activation */
+    uint32_t    valid;              /* of those, how many are in "method" */
+    uint64_t    method[kPerfShadowFrames];
+    uint32_t    relPc[kPerfShadowFrames];
+} PerfShadow;
+
+#ifndef NOT_VM      /* for tools that include this file */
+
+struct ClassObject;
+
+/*
+ * Open the map files, if asked for.  Happens after the zygote fork.
+ */
+bool dvmPerfMapStartup(void);
+void dvmPerfMapShutdown(void);
+
+/*
+ * Name a newly-linked class's methods in the methods file.
+ */
+void dvmPerfMapAddClass(const struct ClassObject* clazz);
+
+/*
+ * Name a piece of generated code in the perf map.
+ */
+void dvmPerfMapAddCode(const void* start, size_t size, const char* fmt, ...)
+#if defined(__GNUC__)
+    __attribute__ ((format(printf, 3, 4)))
+#endif
+    ;
+
+/*
+ * Rebuild a shadow from the interpreted stack, starting at "fp" and
+ * stopping at the activation's break frame.  With "recount", "depth" is
+ * recomputed too; otherwise it's assumed to be right.
+ */
+void dvmPerfShadowRefill(PerfShadow* shadow, const u4* fp, bool recount);
+
+#endif /*NOT_VM*/
+
+#endif /*_DALVIK_PERFMAP*/
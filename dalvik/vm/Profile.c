@@ -55,6 +55,9 @@
  *  u4  method ID | method action
  *  u4  time delta since start, in usec
  *
+ * Records from one thread are in order.  Records from different threads
+ * are interleaved a chunk at a time, not strictly by time.
+ *
  * 32 bits of microseconds is 70 minutes.
  *
  * All values are stored in little-endian order.
@@ -63,7 +66,15 @@
 #define TRACE_MAGIC         0x574f4c53
 #define TRACE_HEADER_LEN    32
 
-#define FILL_PATTERN        0xeeeeeeee
+/* start size of the in-memory buffer, when we're not using a spool file */
+#define kInitialBufLen      (64 * 1024)
+
+/* fewest chunks we'll run with, however small the requested buffer */
+#define kMinTraceChunks     4
+
+#if defined(__i386__) || defined(__x86_64__)
+# define HAVE_TSC           1
+#endif
 
 
 /*
@@ -78,14 +89,10 @@ static inline u8 getTimeInUsec()
 }
 
 /*
- * Get the current time, in microseconds.
- *
- * This can mean one of two things.  In "global clock" mode, we get the
- * same time across all threads.  If we use CLOCK_THREAD_CPUTIME_ID, we
- * get a per-thread CPU usage timer.  The latter is better, but a bit
- * more complicated to implement.
+ * Get the current thread's CPU time, in microseconds.  Without POSIX
+ * clocks we can't, and use the wall clock instead.
  */
-static inline u8 getClock()
+static inline u8 getThreadCpuClock()
 {
 #if defined(HAVE_POSIX_CLOCKS)
     struct timespec tm;
@@ -106,6 +113,76 @@ static inline u8 getClock()
 #endif
 }
 
+#ifdef HAVE_TSC
+static inline u8 readTsc(void)
+{
+    u4 lo, hi;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((u8) hi << 32) | lo;
+}
+#endif
+
+/*
+ * Work out how fast the TSC runs by watching it across a short sleep.
+ * We assume it runs at a constant rate and is in step across CPUs, which
+ * holds for anything recent.  "tscMult" is left at zero (use the system
+ * clock) if there's no TSC or the numbers look wrong.
+ */
+static void calibrateTsc(MethodTraceState* state)
+{
+    state->tscMult = 0;
+#ifdef HAVE_TSC
+    u8 nsec0, nsec1, tsc0, tsc1, mult;
+
+    nsec0 = dvmGetRelativeTimeNsec();
+    tsc0 = readTsc();
+    usleep(10 * 1000);
+    nsec1 = dvmGetRelativeTimeNsec();
+    tsc1 = readTsc();
+    if (tsc1 <= tsc0 || nsec1 <= nsec0)
+        return;
+
+    /* usec = (cycles * mult) >> 32 */
+    mult = ((nsec1 - nsec0) << 32) / (1000 * (tsc1 - tsc0));
+    if (mult == 0 || mult > 0xffffffffULL)
+        return;
+
+    state->tscBase = tsc1;
+    state->tscMult = (u4) mult;
+    LOGV("TSC runs at %llu MHz\n", (tsc1 - tsc0) * 1000 / (nsec1 - nsec0));
+#endif
+}
+
+/*
+ * Get the wall clock, in microseconds from an arbitrary start point.
+ *
+ * This is called on every traced method entry and exit, so where we can
+ * we read the TSC rather than make a system call.  The cycle count is
+ * shifted down before scaling so the product doesn't overflow for the
+ * first few days of a trace.
+ */
+static inline u8 getWallClock(const MethodTraceState* state)
+{
+#ifdef HAVE_TSC
+    if (state->tscMult != 0)
+        return (((readTsc() - state->tscBase) >> 8) * state->tscMult) >> 24;
+#endif
+    return dvmGetRelativeTimeUsec();
+}
+
+/*
+ * Get the current time, in microseconds, from whichever clock the trace
+ * is using.  In "global clock" mode we get the same time across all
+ * threads; otherwise it's a per-thread CPU usage timer.
+ */
+static inline u8 getClock(const MethodTraceState* state)
+{
+    if (state->wallClock)
+        return getWallClock(state);
+    return getThreadCpuClock();
+}
+
 /*
  * Write little-endian data.
  */
@@ -144,6 +221,9 @@ bool dvmProfilingStartup(void)
     memset(&gDvm.methodTrace, 0, sizeof(gDvm.methodTrace));
     dvmInitMutex(&gDvm.methodTrace.startStopLock);
     pthread_cond_init(&gDvm.methodTrace.threadExitCond, NULL);
+    dvmInitMutex(&gDvm.methodTrace.bufLock);
+    pthread_cond_init(&gDvm.methodTrace.writerCond, NULL);
+    pthread_cond_init(&gDvm.methodTrace.freeCond, NULL);
 
     ClassObject* clazz =
         dvmFindClassNoInit("Ldalvik/system/VMDebug;", NULL);
@@ -323,12 +403,219 @@ static void dumpMethodList(FILE* fp)
     dvmHashTableUnlock(gDvm.loadedClasses);
 }
 
+/*
+ * Create the file the writer thread streams records into until we stop.
+ * It goes next to the trace file and is unlinked right away, so nothing
+ * is left behind if we crash.
+ *
+ * Returns NULL if the file can't be created.
+ */
+static FILE* openSpoolFile(const char* traceFileName)
+{
+    char* path;
+    FILE* fp;
+    int fd;
+
+    path = (char*) malloc(strlen(traceFileName) + sizeof(".XXXXXX"));
+    if (path == NULL)
+        return NULL;
+    sprintf(path, "%s.XXXXXX", traceFileName);
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        LOGW("Unable to create trace spool file '%s': %s\n",
+            path, strerror(errno));
+        free(path);
+        return NULL;
+    }
+    unlink(path);
+    free(path);
+
+    fp = fdopen(fd, "w+");
+    if (fp == NULL)
+        close(fd);
+    return fp;
+}
+
+/*
+ * Append data to wherever we're keeping it until the trace stops.
+ *
+ * Returns "false" if it couldn't be written, or wouldn't fit in memory.
+ */
+static bool spoolData(MethodTraceState* state, const u1* data, int len)
+{
+    if (state->spoolFile != NULL)
+        return fwrite(data, len, 1, state->spoolFile) == 1;
+
+    if (state->curOffset + len > state->bufferSize)
+        return false;
+    if (state->curOffset + len > state->bufLen) {
+        int newLen = state->bufLen * 2;
+        u1* newBuf;
+
+        while (newLen < state->curOffset + len)
+            newLen *= 2;
+        if (newLen > state->bufferSize)
+            newLen = state->bufferSize;
+        newBuf = (u1*) realloc(state->buf, newLen);
+        if (newBuf == NULL)
+            return false;
+        state->buf = newBuf;
+        state->bufLen = newLen;
+    }
+    memcpy(state->buf + state->curOffset, data, len);
+    state->curOffset += len;
+    return true;
+}
+
+/*
+ * Copy the spooled records to the end of the trace file.
+ */
+static bool copySpoolFile(FILE* spoolFile, FILE* traceFile)
+{
+    char buf[8192];
+    size_t count;
+
+    if (fflush(spoolFile) != 0 || fseek(spoolFile, 0, SEEK_SET) != 0)
+        return false;
+    while ((count = fread(buf, 1, sizeof(buf), spoolFile)) != 0) {
+        if (fwrite(buf, count, 1, traceFile) != 1)
+            return false;
+    }
+    return !ferror(spoolFile);
+}
+
+/*
+ * Run through some records and pull out the methods that were visited.
+ * Set a mark so that we know which ones to output.
+ */
+static void markTouchedMethods(const u1* ptr, const u1* end)
+{
+    unsigned int methodVal;
+    Method* method;
+
+    while (ptr < end) {
+        methodVal = *(ptr+1) | (*(ptr+2) << 8) | (*(ptr+3) << 16)
+                    | (*(ptr+4) << 24);
+        method = (Method*) METHOD_ID(methodVal);
+
+        method->inProfile = true;
+        ptr += TRACE_REC_SIZE;
+    }
+}
+
+/*
+ * Add a full chunk to the end of the writer's queue.  Caller must hold
+ * bufLock.
+ */
+static void queueFullChunk(MethodTraceState* state, MethodTraceChunk* chunk)
+{
+    chunk->next = NULL;
+    if (state->fullTail == NULL)
+        state->fullHead = chunk;
+    else
+        state->fullTail->next = chunk;
+    state->fullTail = chunk;
+    pthread_cond_signal(&state->writerCond);
+}
+
+/*
+ * Free all of the chunks.  Only call this once the writer is done.
+ */
+static void freeTraceChunks(MethodTraceState* state)
+{
+    MethodTraceChunk* chunk;
+
+    /* anything still queued was handed over after the writer finished */
+    while (state->fullHead != NULL) {
+        chunk = state->fullHead;
+        state->fullHead = chunk->next;
+        free(chunk);
+    }
+    state->fullTail = NULL;
+
+    while (state->freeChunks != NULL) {
+        chunk = state->freeChunks;
+        state->freeChunks = chunk->next;
+        free(chunk);
+    }
+    state->numChunks = 0;
+}
+
+/*
+ * The method trace writer thread.  This takes full chunks off the queue
+ * as they arrive and writes them out, then puts them on the free list.
+ * It exits once the trace has stopped and the queue is empty.
+ */
+static void* methodTraceWriterThreadStart(void* arg)
+{
+    MethodTraceState* state = &gDvm.methodTrace;
+    MethodTraceChunk* batch;
+    MethodTraceChunk* chunk;
+    MethodTraceChunk* last = NULL;
+    bool warned = false;
+
+    UNUSED_PARAMETER(arg);
+
+    /* we never touch objects, so don't make the GC wait for us */
+    dvmChangeStatus(NULL, THREAD_VMWAIT);
+
+    dvmLockMutex(&state->bufLock);
+    while (true) {
+        u4 written = 0, dropped = 0;
+
+        while (state->fullHead == NULL && !state->writerStop)
+            pthread_cond_wait(&state->writerCond, &state->bufLock);
+        if (state->fullHead == NULL)
+            break;
+
+        batch = state->fullHead;
+        state->fullHead = state->fullTail = NULL;
+        state->writing = true;
+        dvmUnlockMutex(&state->bufLock);
+
+        for (chunk = batch; chunk != NULL; chunk = chunk->next) {
+            int numRecords = chunk->used / TRACE_REC_SIZE;
+
+            markTouchedMethods(chunk->data, chunk->data + chunk->used);
+            if (spoolData(state, chunk->data, chunk->used))
+                written += numRecords;
+            else
+                dropped += numRecords;
+            chunk->used = 0;
+            last = chunk;
+        }
+        if (dropped != 0 && !warned) {
+            LOGW("TRACE unable to save records (%s); some will be lost\n",
+                state->spoolFile != NULL ? strerror(errno) : "buffer full");
+            warned = true;
+        }
+
+        dvmLockMutex(&state->bufLock);
+        last->next = state->freeChunks;
+        state->freeChunks = batch;
+        state->numRecords += written;
+        state->droppedRecords += dropped;
+        state->writing = false;
+        pthread_cond_broadcast(&state->freeCond);
+    }
+
+    state->writerDone = true;
+    pthread_cond_broadcast(&state->freeCond);
+    dvmUnlockMutex(&state->bufLock);
+
+    dvmChangeStatus(NULL, THREAD_RUNNING);
+    return NULL;
+}
+
 /*
  * Start method tracing.  Method tracing is global to the VM (i.e. we
  * trace all threads).
  *
  * This opens the output file (if an already open fd has not been supplied,
- * and we're not going direct to DDMS) and allocates the data buffer.
+ * and we're not going direct to DDMS), sets up somewhere to keep the
+ * records until we stop, and starts the writer thread.  "bufferSize" caps
+ * the memory used for records in flight, and for DDMS, the whole trace.
  *
  * On failure, we throw an exception and return.
  */
@@ -336,6 +623,7 @@ void dvmMethodTraceStart(const char* traceFileName, int traceFd, int bufferSize,
     int flags, bool directToDdms)
 {
     MethodTraceState* state = &gDvm.methodTrace;
+    u1 header[TRACE_HEADER_LEN];
 
     assert(bufferSize > 0);
 
@@ -350,16 +638,8 @@ void dvmMethodTraceStart(const char* traceFileName, int traceFd, int bufferSize,
     LOGI("TRACE STARTED: '%s' %dKB\n", traceFileName, bufferSize / 1024);
 
     /*
-     * Allocate storage and open files.
-     *
-     * We don't need to initialize the buffer, but doing so might remove
-     * some fault overhead if the pages aren't mapped until touched.
+     * Open files.
      */
-    state->buf = (u1*) malloc(bufferSize);
-    if (state->buf == NULL) {
-        dvmThrowException("Ljava/lang/InternalError;", "buffer alloc failed");
-        goto fail;
-    }
     if (!directToDdms) {
         if (traceFd < 0) {
             state->traceFile = fopen(traceFileName, "w");
@@ -375,19 +655,57 @@ void dvmMethodTraceStart(const char* traceFileName, int traceFd, int bufferSize,
                 traceFileName, strerror(err));
             goto fail;
         }
+
+        /*
+         * The records are streamed to a spool file while we run, so the
+         * trace can be as long as there's disk for.  We write the key at
+         * the front of the trace file when we stop, then copy them in.
+         */
+        state->spoolFile = openSpoolFile(traceFileName);
+    }
+
+    /*
+     * For DDMS, or if we couldn't make a spool file, keep the records in
+     * memory instead, up to "bufferSize" bytes.
+     */
+    if (state->spoolFile == NULL) {
+        state->bufLen = (bufferSize < kInitialBufLen) ?
+            bufferSize : kInitialBufLen;
+        state->buf = (u1*) malloc(state->bufLen);
+        if (state->buf == NULL) {
+            dvmThrowException("Ljava/lang/InternalError;",
+                "buffer alloc failed");
+            goto fail;
+        }
     }
-    memset(state->buf, (char)FILL_PATTERN, bufferSize);
+    state->curOffset = 0;
 
     state->directToDdms = directToDdms;
     state->bufferSize = bufferSize;
     state->overflow = false;
 
+    state->freeChunks = state->fullHead = state->fullTail = NULL;
+    state->numChunks = 0;
+    state->maxChunks = bufferSize / sizeof(MethodTraceChunk);
+    if (state->maxChunks < kMinTraceChunks)
+        state->maxChunks = kMinTraceChunks;
+    state->writing = state->writerStop = state->writerDone = false;
+    state->numRecords = 0;
+    state->droppedRecords = 0;
+
     /*
-     * Enable alloc counts if we've been requested to do so.
+     * Pick a clock.  Without POSIX clocks we can't get thread CPU time.
      */
-    state->flags = flags;
-    if ((flags & TRACE_ALLOC_COUNTS) != 0)
-        dvmStartAllocCounting();
+#if defined(HAVE_POSIX_CLOCKS)
+    state->wallClock =
+        (gDvm.profilerClockSource == kProfilerClockSourceWall);
+#else
+    state->wallClock = true;
+#endif
+    if (state->wallClock) {
+        calibrateTsc(state);
+        state->clockBase = getWallClock(state);
+    }
 
     /* reset our notion of the start time for all CPU threads */
     resetCpuClockBase();
@@ -397,12 +715,33 @@ void dvmMethodTraceStart(const char* traceFileName, int traceFd, int bufferSize,
     /*
      * Output the header.
      */
-    memset(state->buf, 0, TRACE_HEADER_LEN);
-    storeIntLE(state->buf + 0, TRACE_MAGIC);
-    storeShortLE(state->buf + 4, TRACE_VERSION);
-    storeShortLE(state->buf + 6, TRACE_HEADER_LEN);
-    storeLongLE(state->buf + 8, state->startWhen);
-    state->curOffset = TRACE_HEADER_LEN;
+    memset(header, 0, TRACE_HEADER_LEN);
+    storeIntLE(header + 0, TRACE_MAGIC);
+    storeShortLE(header + 4, TRACE_VERSION);
+    storeShortLE(header + 6, TRACE_HEADER_LEN);
+    storeLongLE(header + 8, state->startWhen);
+    if (!spoolData(state, header, TRACE_HEADER_LEN)) {
+        dvmThrowException("Ljava/lang/RuntimeException;",
+            "Trace data write failed");
+        goto fail;
+    }
+
+    if (!dvmCreateInternalThread(&state->writerHandle, "Method Trace Writer",
+            methodTraceWriterThreadStart, NULL))
+    {
+        dvmThrowException("Ljava/lang/InternalError;",
+            "unable to start trace writer thread");
+        goto fail;
+    }
+    /* it tells us when it's done, so nobody joins it */
+    pthread_detach(state->writerHandle);
+
+    /*
+     * Enable alloc counts if we've been requested to do so.
+     */
+    state->flags = flags;
+    if ((flags & TRACE_ALLOC_COUNTS) != 0)
+        dvmStartAllocCounting();
 
     MEM_BARRIER();
 
@@ -420,6 +759,10 @@ fail:
         fclose(state->traceFile);
         state->traceFile = NULL;
     }
+    if (state->spoolFile != NULL) {
+        fclose(state->spoolFile);
+        state->spoolFile = NULL;
+    }
     if (state->buf != NULL) {
         free(state->buf);
         state->buf = NULL;
@@ -427,51 +770,30 @@ fail:
     dvmUnlockMutex(&state->startStopLock);
 }
 
-/*
- * Run through the data buffer and pull out the methods that were visited.
- * Set a mark so that we know which ones to output.
- */
-static void markTouchedMethods(int endOffset)
-{
-    u1* ptr = gDvm.methodTrace.buf + TRACE_HEADER_LEN;
-    u1* end = gDvm.methodTrace.buf + endOffset;
-    unsigned int methodVal;
-    Method* method;
-
-    while (ptr < end) {
-        methodVal = *(ptr+1) | (*(ptr+2) << 8) | (*(ptr+3) << 16)
-                    | (*(ptr+4) << 24);
-        method = (Method*) METHOD_ID(methodVal);
-
-        method->inProfile = true;
-        ptr += TRACE_REC_SIZE;
-    }
-}
-
 /*
  * Compute the amount of overhead in a clock call, in nsec.
  *
  * This value is going to vary depending on what else is going on in the
  * system.  When examined across several runs a pattern should emerge.
  */
-static u4 getClockOverhead(void)
+static u4 getClockOverhead(const MethodTraceState* state)
 {
     u8 calStart, calElapsed;
     int i;
 
-    calStart = getClock();
+    calStart = getClock(state);
     for (i = 1000 * 4; i > 0; i--) {
-        getClock();
-        getClock();
-        getClock();
-        getClock();
-        getClock();
-        getClock();
-        getClock();
-        getClock();
+        getClock(state);
+        getClock(state);
+        getClock(state);
+        getClock(state);
+        getClock(state);
+        getClock(state);
+        getClock(state);
+        getClock(state);
     }
 
-    calElapsed = getClock() - calStart;
+    calElapsed = getClock(state) - calStart;
     return (int) (calElapsed / (8*4));
 }
 
@@ -485,13 +807,48 @@ bool dvmIsMethodTraceActive(void)
 }
 
 /*
- * Stop method tracing.  We write the buffer to disk and generate a key
- * file so we can interpret it.
+ * Hand every thread's partly-filled chunk to the writer, and tell it to
+ * finish up.
+ *
+ * The GC can emit records while holding the thread list lock, so we
+ * take that before bufLock.
+ */
+static void flushThreadChunks(MethodTraceState* state)
+{
+    Thread* thread;
+
+    dvmLockThreadList(NULL);
+    dvmLockMutex(&state->bufLock);
+    for (thread = gDvm.threadList; thread != NULL; thread = thread->next) {
+        MethodTraceChunk* chunk = thread->traceChunk;
+
+        if (chunk == NULL)
+            continue;
+        thread->traceChunk = NULL;
+        if (chunk->used != 0) {
+            queueFullChunk(state, chunk);
+        } else {
+            chunk->next = state->freeChunks;
+            state->freeChunks = chunk;
+        }
+    }
+    state->writerStop = true;
+    pthread_cond_signal(&state->writerCond);
+    pthread_cond_broadcast(&state->freeCond);
+    dvmUnlockMutex(&state->bufLock);
+    dvmUnlockThreadList();
+}
+
+/*
+ * Stop method tracing.  We wait for the writer to save the last of the
+ * records, then write a key file and the records to the trace file.
  */
 void dvmMethodTraceStop(void)
 {
     MethodTraceState* state = &gDvm.methodTrace;
+    Thread* self = dvmThreadSelf();
     u8 elapsed;
+    int oldStatus;
 
     /*
      * We need this to prevent somebody from starting a new trace while
@@ -514,9 +871,7 @@ void dvmMethodTraceStop(void)
     /*
      * Globally disable it, and allow other threads to notice.  We want
      * to stall here for at least as long as dvmMethodTraceAdd needs
-     * to finish.  There's no real risk though -- it will take a while to
-     * write the data to disk, and we don't clear the buffer pointer until
-     * after that completes.
+     * to finish writing into its chunk, since we're about to take it.
      */
     state->traceEnabled = false;
     MEM_BARRIER();
@@ -527,50 +882,25 @@ void dvmMethodTraceStop(void)
         dvmStopAllocCounting();
 
     /*
-     * It's possible under some circumstances for a thread to have advanced
-     * the data pointer but not written the method value.  It's possible
-     * (though less likely) for the data pointer to be advanced, or partial
-     * data written, while we're doing work here.
-     *
-     * To avoid seeing partially-written data, we grab state->curOffset here,
-     * and use our local copy from here on.  We then scan through what's
-     * already written.  If we see the fill pattern in what should be the
-     * method pointer, we cut things off early.  (If we don't, we'll fail
-     * when we dereference the pointer.)
-     *
-     * There's a theoretical possibility of interrupting another thread
-     * after it has partially written the method pointer, in which case
-     * we'll likely crash when we dereference it.  The possibility of
-     * this actually happening should be at or near zero.  Fixing it
-     * completely could be done by writing the thread number last and
-     * using a sentinel value to indicate a partially-written record,
-     * but that requires memory barriers.
+     * Flush the threads' chunks and wait for the writer to drain the
+     * queue.  It doesn't need anything from us, but a GC might, so
+     * don't hold one up while we wait.
      */
-    int finalCurOffset = state->curOffset;
-
-    if (finalCurOffset > TRACE_HEADER_LEN) {
-        u4 fillVal = METHOD_ID(FILL_PATTERN);
-        u1* scanPtr = state->buf + TRACE_HEADER_LEN;
-
-        while (scanPtr < state->buf + finalCurOffset) {
-            u4 methodVal = scanPtr[1] | (scanPtr[2] << 8) | (scanPtr[3] << 16)
-                        | (scanPtr[4] << 24);
-            if (METHOD_ID(methodVal) == fillVal) {
-                u1* scanBase = state->buf + TRACE_HEADER_LEN;
-                LOGW("Found unfilled record at %d (of %d)\n",
-                    (scanPtr - scanBase) / TRACE_REC_SIZE,
-                    (finalCurOffset - TRACE_HEADER_LEN) / TRACE_REC_SIZE);
-                finalCurOffset = scanPtr - state->buf;
-                break;
-            }
-
-            scanPtr += TRACE_REC_SIZE;
-        }
-    }
-
-    LOGI("TRACE STOPPED%s: writing %d records\n",
+    flushThreadChunks(state);
+
+    oldStatus = dvmChangeStatus(self, THREAD_VMWAIT);
+    dvmLockMutex(&state->bufLock);
+    while (!state->writerDone)
+        pthread_cond_wait(&state->freeCond, &state->bufLock);
+    dvmUnlockMutex(&state->bufLock);
+    dvmChangeStatus(self, oldStatus);
+
+    state->overflow = (state->droppedRecords != 0);
+    if (state->overflow)
+        LOGW("TRACE dropped %u records\n", state->droppedRecords);
+    LOGI("TRACE STOPPED%s: writing %llu records\n",
         state->overflow ? " (NOTE: overflowed buffer)" : "",
-        (finalCurOffset - TRACE_HEADER_LEN) / TRACE_REC_SIZE);
+        state->numRecords);
     if (gDvm.debuggerActive) {
         LOGW("WARNING: a debugger is active; method-tracing results "
              "will be skewed\n");
@@ -579,9 +909,7 @@ void dvmMethodTraceStop(void)
     /*
      * Do a quick calibration test to see how expensive our clock call is.
      */
-    u4 clockNsec = getClockOverhead();
-
-    markTouchedMethods(finalCurOffset);
+    u4 clockNsec = getClockOverhead(state);
 
     char* memStreamPtr;
     size_t memStreamSize;
@@ -600,14 +928,10 @@ void dvmMethodTraceStop(void)
     fprintf(state->traceFile, "%d\n", TRACE_VERSION);
     fprintf(state->traceFile, "data-file-overflow=%s\n",
         state->overflow ? "true" : "false");
-#if defined(HAVE_POSIX_CLOCKS)
-    fprintf(state->traceFile, "clock=thread-cpu\n");
-#else
-    fprintf(state->traceFile, "clock=global\n");
-#endif
+    fprintf(state->traceFile, "clock=%s\n",
+        state->wallClock ? "global" : "thread-cpu");
     fprintf(state->traceFile, "elapsed-time-usec=%llu\n", elapsed);
-    fprintf(state->traceFile, "num-method-calls=%d\n",
-        (finalCurOffset - TRACE_HEADER_LEN) / TRACE_REC_SIZE);
+    fprintf(state->traceFile, "num-method-calls=%llu\n", state->numRecords);
     fprintf(state->traceFile, "clock-call-overhead-nsec=%d\n", clockNsec);
     fprintf(state->traceFile, "vm=dalvik\n");
     if ((state->flags & TRACE_ALLOC_COUNTS) != 0) {
@@ -635,19 +959,32 @@ void dvmMethodTraceStop(void)
         iov[0].iov_base = memStreamPtr;
         iov[0].iov_len = memStreamSize;
         iov[1].iov_base = state->buf;
-        iov[1].iov_len = finalCurOffset;
+        iov[1].iov_len = state->curOffset;
         dvmDbgDdmSendChunkV(CHUNK_TYPE("MPSE"), iov, 2);
     } else {
         /* append the profiling data */
-        if (fwrite(state->buf, finalCurOffset, 1, state->traceFile) != 1) {
+        bool ok;
+
+        if (state->spoolFile != NULL) {
+            ok = copySpoolFile(state->spoolFile, state->traceFile);
+        } else {
+            ok = fwrite(state->buf, state->curOffset, 1,
+                    state->traceFile) == 1;
+        }
+        if (!ok) {
             int err = errno;
-            LOGE("trace fwrite(%d) failed, errno=%d\n", finalCurOffset, err);
+            LOGE("trace data write failed, errno=%d\n", err);
             dvmThrowExceptionFmt("Ljava/lang/RuntimeException;",
                 "Trace data write failed: %s", strerror(err));
         }
     }
 
     /* done! */
+    freeTraceChunks(state);
+    if (state->spoolFile != NULL) {
+        fclose(state->spoolFile);
+        state->spoolFile = NULL;
+    }
     free(state->buf);
     state->buf = NULL;
     fclose(state->traceFile);
@@ -659,56 +996,102 @@ void dvmMethodTraceStop(void)
     dvmUnlockMutex(&state->startStopLock);
 }
 
+/*
+ * Hand "self"'s full chunk, if it has one, to the writer and get an empty
+ * one.
+ *
+ * If every chunk is in use we wait for the writer to free some, so that a
+ * briefly slow disk doesn't cost us records.  If they're all sitting in
+ * threads there's nothing to wait for, and the record is dropped.
+ */
+static MethodTraceChunk* swapTraceChunk(MethodTraceState* state, Thread* self)
+{
+    MethodTraceChunk* chunk = self->traceChunk;
+
+    dvmLockMutex(&state->bufLock);
+    if (chunk != NULL) {
+        self->traceChunk = NULL;
+        queueFullChunk(state, chunk);
+        chunk = NULL;
+    }
+
+    while (state->traceEnabled) {
+        if (state->freeChunks != NULL) {
+            chunk = state->freeChunks;
+            state->freeChunks = chunk->next;
+            break;
+        }
+        if (state->numChunks < state->maxChunks) {
+            chunk = (MethodTraceChunk*) malloc(sizeof(MethodTraceChunk));
+            if (chunk != NULL) {
+                state->numChunks++;
+                break;
+            }
+        }
+        if (state->fullHead == NULL && !state->writing)
+            break;
+        pthread_cond_wait(&state->freeCond, &state->bufLock);
+    }
+
+    if (chunk != NULL) {
+        chunk->next = NULL;
+        chunk->used = 0;
+        self->traceChunk = chunk;
+    } else {
+        state->droppedRecords++;
+    }
+    dvmUnlockMutex(&state->bufLock);
+
+    return chunk;
+}
 
 /*
  * We just did something with a method.  Emit a record.
  *
- * Multiple threads may be banging on this all at once.  We use atomic ops
- * rather than mutexes for speed.
+ * Multiple threads may be banging on this all at once.  Each has its own
+ * chunk to write into, so we only need a lock when one fills up.
  */
 void dvmMethodTraceAdd(Thread* self, const Method* method, int action)
 {
     MethodTraceState* state = &gDvm.methodTrace;
+    MethodTraceChunk* chunk;
     u4 clockDiff, methodVal;
-    int oldOffset, newOffset;
     u1* ptr;
 
-    /*
-     * We can only access the per-thread CPU clock from within the
-     * thread, so we have to initialize the base time on the first use.
-     * (Looks like pthread_getcpuclockid(thread, &id) will do what we
-     * want, but it doesn't appear to be defined on the device.)
-     */
-    if (!self->cpuClockBaseSet) {
-        self->cpuClockBase = getClock();
-        self->cpuClockBaseSet = true;
-        //LOGI("thread base id=%d 0x%llx\n",
-        //    self->threadId, self->cpuClockBase);
+    chunk = self->traceChunk;
+    if (chunk == NULL || chunk->used + TRACE_REC_SIZE > kMethodTraceChunkSize) {
+        chunk = swapTraceChunk(state, self);
+        if (chunk == NULL)
+            return;
     }
 
-    /*
-     * Advance "curOffset" atomically.
-     */
-    do {
-        oldOffset = state->curOffset;
-        newOffset = oldOffset + TRACE_REC_SIZE;
-        if (newOffset > state->bufferSize) {
-            state->overflow = true;
-            return;
+    if (state->wallClock) {
+        clockDiff = (u4) (getWallClock(state) - state->clockBase);
+    } else {
+        /*
+         * We can only access the per-thread CPU clock from within the
+         * thread, so we have to initialize the base time on the first use.
+         * (Looks like pthread_getcpuclockid(thread, &id) will do what we
+         * want, but it doesn't appear to be defined on the device.)
+         */
+        if (!self->cpuClockBaseSet) {
+            self->cpuClockBase = getThreadCpuClock();
+            self->cpuClockBaseSet = true;
+            //LOGI("thread base id=%d 0x%llx\n",
+            //    self->threadId, self->cpuClockBase);
         }
-    } while (!ATOMIC_CMP_SWAP(&state->curOffset, oldOffset, newOffset));
+        clockDiff = (u4) (getThreadCpuClock() - self->cpuClockBase);
+    }
 
     //assert(METHOD_ACTION((u4) method) == 0);
 
-    u8 now = getClock();
-    clockDiff = (u4) (now - self->cpuClockBase);
-
     methodVal = METHOD_COMBINE((u4) method, action);
 
     /*
-     * Write data into "oldOffset".
+     * Write the record, then count it.  dvmMethodTraceStop only looks at
+     * "used" after giving us time to finish.
      */
-    ptr = state->buf + oldOffset;
+    ptr = chunk->data + chunk->used;
     *ptr++ = self->threadId;
     *ptr++ = (u1) methodVal;
     *ptr++ = (u1) (methodVal >> 8);
@@ -718,6 +1101,7 @@ void dvmMethodTraceAdd(Thread* self, const Method* method, int action)
     *ptr++ = (u1) (clockDiff >> 8);
     *ptr++ = (u1) (clockDiff >> 16);
     *ptr++ = (u1) (clockDiff >> 24);
+    chunk->used += TRACE_REC_SIZE;
 }
 
 /*
@@ -37,8 +37,28 @@ bool dvmProfilingStartup(void);
 void dvmProfilingShutdown(void);
 
 /*
- * Method trace state.  This is currently global.  In theory we could make
- * most of this per-thread.
+ * Clock used for method trace timestamps (-Xprofile).
+ */
+typedef enum ProfilerClockSource {
+    kProfilerClockSourceWall,       // wall clock, from the TSC if we have one
+    kProfilerClockSourceThreadCpu,  // per-thread CPU time
+} ProfilerClockSource;
+
+/*
+ * A chunk of method trace records.  Each thread fills one of these on its
+ * own, then hands it to the writer thread and takes an empty one.
+ */
+#define kMethodTraceChunkSize   8192
+
+typedef struct MethodTraceChunk {
+    struct MethodTraceChunk* next;
+    int     used;                   // bytes of "data" filled in
+    u1      data[kMethodTraceChunkSize];
+} MethodTraceChunk;
+
+/*
+ * Method trace state.  Records are written to per-thread chunks, which a
+ * writer thread streams out while the trace runs.
  */
 typedef struct MethodTraceState {
     /* these are set during VM init */
@@ -54,10 +74,43 @@ typedef struct MethodTraceState {
     int     flags;
 
     bool    traceEnabled;
-    u1*     buf;
-    volatile int curOffset;
     u8      startWhen;
     int     overflow;
+
+    /* clock */
+    bool    wallClock;
+    u8      clockBase;              // wall clock value at trace start
+    u8      tscBase;                // TSC value at calibration
+    u4      tscMult;                // TSC to usec factor, or 0 if no TSC
+
+    /*
+     * Chunks.  These are guarded by bufLock.  Full chunks are queued in
+     * the order they were filled, so each thread's records stay in order.
+     */
+    pthread_mutex_t bufLock;
+    pthread_cond_t  writerCond;     // full chunks queued, or stopping
+    pthread_cond_t  freeCond;       // chunks freed, or writer finished
+    MethodTraceChunk* freeChunks;
+    MethodTraceChunk* fullHead;
+    MethodTraceChunk* fullTail;
+    int     numChunks;
+    int     maxChunks;
+    bool    writing;                // writer is holding a batch
+    bool    writerStop;
+    bool    writerDone;
+    pthread_t writerHandle;
+    u4      droppedRecords;
+
+    /*
+     * Where the writer puts the records until we stop and can write the
+     * key.  This is a spool file if we could make one, otherwise "buf",
+     * which is never allowed to grow past bufferSize.
+     */
+    FILE*   spoolFile;
+    u1*     buf;
+    int     bufLen;
+    int     curOffset;
+    u8      numRecords;
 } MethodTraceState;
 
 /*
@@ -169,11 +169,9 @@ static void handleSigQuit(void)
     dvmCompilerDumpStats();
 #endif
 
-    if (false) {
-        dvmLockMutex(&gDvm.jniGlobalRefLock);
-        dvmDumpReferenceTable(&gDvm.jniGlobalRefTable, "JNI global");
-        dvmUnlockMutex(&gDvm.jniGlobalRefLock);
-    }
+    dvmLogJniRefTableStats();
+    dvmLogAtomicCacheStats();
+    if (false) dvmDumpJniGlobalRefTable();
     if (false) dvmDumpTrackedAllocations(true);
 
     dvmResumeAllThreads(SUSPEND_FOR_STACK_DUMP);
@@ -208,6 +206,15 @@ static void handleSigQuit(void)
         free(traceBuf);
         dvmChangeStatus(dvmThreadSelf(), oldStatus);
     }
+
+#ifdef WITH_PROFILER
+    /* bring the CPU profile up to date too */
+    if (gDvm.cpuProfileFile != NULL) {
+        int oldStatus = dvmChangeStatus(dvmThreadSelf(), THREAD_VMWAIT);
+        dvmCpuProfilerWrite();
+        dvmChangeStatus(dvmThreadSelf(), oldStatus);
+    }
+#endif
 }
 
 /*
@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Shared-memory stats page (-Xstatsfile).
+ *
+ * A "Stats Page Writer" thread copies counters from gDvm into the mapped
+ * file every -Xstatsinterval msec.  The counters themselves are kept where
+ * they always were, by the code that owns them; this thread only reads
+ * them.  It never waits for a lock: values that need one (the heap's,
+ * the AtomicCache totals) are skipped for a round if the lock is busy,
+ * and keep their previous values.
+ */
+#include "Dalvik.h"
+#include "alloc/HeapInternal.h"
+#include "alloc/HeapSource.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+/*
+ * The counters, in page order.  Add new ones at the end.
+ */
+enum {
+    kStatGcCount = 0,
+    kStatGcTimeMsec,
+    kStatGcLastMsec,
+    kStatGcFreedObjects,
+    kStatGcFreedBytes,
+    kStatHeapFootprint,
+    kStatHeapAllowedFootprint,
+    kStatHeapBytesAllocated,
+    kStatHeapObjectsAllocated,
+    kStatHeapExternalBytes,
+    kStatThreadsLive,
+    kStatThreadsNonDaemon,
+    kStatThreadsStarted,
+    kStatMonitorsCreated,
+    kStatMonitorsFreed,
+    kStatClassesLoaded,
+    kStatMethodsDeclared,
+    kStatJniGlobalRefs,
+    kStatJniPinnedArrays,
+    kStatJniNativeResolves,
+    kStatJniNativeResolveUsec,
+    kStatAtomicCacheMisses,
+    kStatAtomicCacheFills,
+    kStatAtomicCacheGrows,
+    kStatAtomicCacheL0Hits,
+    kStatAtomicCacheL0Misses,
+    kStatJitCompilations,
+    kStatJitCodeCacheBytes,
+    kStatJitCodeCacheResets,
+
+    kStatNumCounters
+};
+
+static const char* kStatNames[kStatNumCounters] = {
+    "gc.count",
+    "gc.time_msec",
+    "gc.last_msec",
+    "gc.freed_objects",
+    "gc.freed_bytes",
+    "heap.footprint",
+    "heap.allowed_footprint",
+    "heap.bytes_allocated",
+    "heap.objects_allocated",
+    "heap.external_bytes",
+    "threads.live",
+    "threads.nondaemon",
+    "threads.started",
+    "monitors.created",
+    "monitors.freed",
+    "classes.loaded",
+    "classes.declared_methods",
+    "jni.global_refs",
+    "jni.pinned_arrays",
+    "jni.native_resolves",
+    "jni.native_resolve_usec",
+    "atomiccache.misses",
+    "atomiccache.fills",
+    "atomiccache.grows",
+    "atomiccache.l0_hits",
+    "atomiccache.l0_misses",
+    "jit.compilations",
+    "jit.code_cache_bytes",
+    "jit.code_cache_resets",
+};
+
+static u8 wallTimeMsec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+/*
+ * Gather the current values.  "values" holds the previous ones on entry,
+ * which we keep for anything we can't get without waiting.
+ */
+static void gatherStats(u8* values)
+{
+    AtomicCache* pCache;
+    int globalRefs, pinnedArrays;
+
+    values[kStatGcCount] = gDvm.gcCount;
+    values[kStatGcTimeMsec] = gDvm.gcTotalMsec;
+    values[kStatGcLastMsec] = gDvm.gcLastMsec;
+    values[kStatGcFreedObjects] = gDvm.gcFreedObjects;
+    values[kStatGcFreedBytes] = gDvm.gcFreedBytes;
+
+    if (dvmTryLockMutex(&gDvm.gcHeapLock) == 0) {
+        values[kStatHeapFootprint] =
+            dvmHeapSourceGetValue(HS_FOOTPRINT, NULL, 0);
+        values[kStatHeapAllowedFootprint] =
+            dvmHeapSourceGetValue(HS_ALLOWED_FOOTPRINT, NULL, 0);
+        values[kStatHeapBytesAllocated] =
+            dvmHeapSourceGetValue(HS_BYTES_ALLOCATED, NULL, 0);
+        values[kStatHeapObjectsAllocated] =
+            dvmHeapSourceGetValue(HS_OBJECTS_ALLOCATED, NULL, 0);
+        values[kStatHeapExternalBytes] =
+            dvmHeapSourceGetValue(HS_EXTERNAL_BYTES_ALLOCATED, NULL, 0);
+        dvmUnlockMutex(&gDvm.gcHeapLock);
+    }
+
+    /* these are guarded by the thread list lock, but we only read them */
+    values[kStatThreadsLive] = gDvm.threadCount;
+    values[kStatThreadsNonDaemon] = gDvm.nonDaemonThreadCount;
+    values[kStatThreadsStarted] = gDvm.threadsStarted;
+
+    values[kStatMonitorsCreated] = (u4) gDvm.monitorsCreated;
+    values[kStatMonitorsFreed] = gDvm.monitorsFreed;
+
+    values[kStatClassesLoaded] = gDvm.numLoadedClasses;
+    values[kStatMethodsDeclared] = gDvm.numDeclaredMethods;
+
+    dvmGetJniRefCounts(&globalRefs, &pinnedArrays);
+    values[kStatJniGlobalRefs] = globalRefs;
+    values[kStatJniPinnedArrays] = pinnedArrays;
+    values[kStatJniNativeResolves] = gDvm.nativeResolveCount;
+    values[kStatJniNativeResolveUsec] = gDvm.nativeResolveTimeNsec / 1000;
+
+    if (dvmTryLockMutex(&gDvm.atomicCacheLock) == 0) {
+        u8 misses = 0, fills = 0, grows = 0;
+
+        /* hits aren't counted unless CALC_CACHE_STATS is set */
+        for (pCache = gDvm.atomicCacheList; pCache != NULL;
+            pCache = pCache->next)
+        {
+            misses += (u4) pCache->misses;
+            fills += (u4) pCache->fills;
+            grows += pCache->grows;
+        }
+        values[kStatAtomicCacheMisses] = misses;
+        values[kStatAtomicCacheFills] = fills;
+        values[kStatAtomicCacheGrows] = grows;
+
+        /* live threads' L0 counts are added when the threads exit */
+        values[kStatAtomicCacheL0Hits] = gDvm.atomicCacheL0Hits;
+        values[kStatAtomicCacheL0Misses] = gDvm.atomicCacheL0Misses;
+        dvmUnlockMutex(&gDvm.atomicCacheLock);
+    }
+
+#ifdef WITH_JIT
+    values[kStatJitCompilations] = gDvmJit.numCompilations;
+    values[kStatJitCodeCacheBytes] = gDvmJit.codeCacheByteUsed;
+    values[kStatJitCodeCacheResets] = gDvmJit.numCodeCacheReset;
+#endif
+}
+
+/*
+ * Copy the values into the page.
+ */
+static void publishStats(StatsPage* page, const u8* values)
+{
+    int i;
+
+    page->sequence++;
+    MEM_BARRIER_SMP();
+    for (i = 0; i < kStatNumCounters; i++)
+        page->counters[i].value = values[i];
+    page->updateTimeMsec = wallTimeMsec();
+    MEM_BARRIER_SMP();
+    page->sequence++;
+}
+
+static void* statsPageThreadStart(void* arg)
+{
+    Thread* self = dvmThreadSelf();
+    StatsPage* page = gDvm.statsPage;
+    u8 values[kStatNumCounters];
+
+    UNUSED_PARAMETER(arg);
+
+    memset(values, 0, sizeof(values));
+
+    dvmChangeStatus(self, THREAD_VMWAIT);
+
+    while (true) {
+        gatherStats(values);
+        publishStats(page, values);
+
+        dvmLockMutex(&gDvm.statsPageLock);
+        if (!gDvm.haltStatsPage) {
+            dvmRelativeCondWait(&gDvm.statsPageCond, &gDvm.statsPageLock,
+                gDvm.statsIntervalMsec, 0);
+        }
+        if (gDvm.haltStatsPage) {
+            dvmUnlockMutex(&gDvm.statsPageLock);
+            break;
+        }
+        dvmUnlockMutex(&gDvm.statsPageLock);
+    }
+
+    /* leave final values for whoever reads the file after we're gone */
+    gatherStats(values);
+    publishStats(page, values);
+
+    dvmChangeStatus(self, THREAD_RUNNING);
+    return NULL;
+}
+
+/*
+ * Replace "%p" in the file name with our pid, so that processes forked
+ * from the zygote each get their own file.
+ */
+static char* expandStatsFileName(const char* fileName)
+{
+    const char* pct = strstr(fileName, "%p");
+    char pidStr[16];
+    char* result;
+
+    if (pct == NULL)
+        return strdup(fileName);
+
+    snprintf(pidStr, sizeof(pidStr), "%d", (int) getpid());
+    result = (char*) malloc(strlen(fileName) - 2 + strlen(pidStr) + 1);
+    if (result == NULL)
+        return NULL;
+    sprintf(result, "%.*s%s%s", (int) (pct - fileName), fileName, pidStr,
+        pct + 2);
+    return result;
+}
+
+/*
+ * Create the file, map it, and start the writer thread.
+ *
+ * Not having stats isn't worth failing VM startup for, so we complain and
+ * carry on if the file can't be created.
+ */
+bool dvmStatsPageStartup(void)
+{
+    StatsPage* page;
+    size_t size;
+    char* fileName;
+    int fd, i;
+
+    if (gDvm.statsFile == NULL)
+        return true;
+
+    fileName = expandStatsFileName(gDvm.statsFile);
+    if (fileName == NULL)
+        return false;
+    free(gDvm.statsFile);
+    gDvm.statsFile = fileName;
+
+    size = offsetof(StatsPage, counters) + kStatNumCounters * sizeof(StatsCounter);
+    fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOGW("Unable to create stats file '%s': %s\n",
+            fileName, strerror(errno));
+        return true;
+    }
+    if (ftruncate(fd, size) != 0) {
+        LOGW("Unable to size stats file '%s': %s\n",
+            fileName, strerror(errno));
+        close(fd);
+        unlink(fileName);
+        return true;
+    }
+    page = (StatsPage*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        LOGW("Unable to map stats file '%s': %s\n",
+            fileName, strerror(errno));
+        unlink(fileName);
+        return true;
+    }
+
+    /* fill in everything but the magic, which says the page is ready */
+    page->version = kStatsPageVersion;
+    page->headerSize = offsetof(StatsPage, counters);
+    page->counterSize = sizeof(StatsCounter);
+    page->numCounters = kStatNumCounters;
+    page->pid = getpid();
+    page->intervalMsec = gDvm.statsIntervalMsec;
+    page->sequence = 0;
+    page->flags = kStatsPageLive;
+    page->startTimeMsec = wallTimeMsec();
+    for (i = 0; i < kStatNumCounters; i++) {
+        strncpy(page->counters[i].name, kStatNames[i], kStatsNameLen - 1);
+        page->counters[i].value = 0;
+    }
+    MEM_BARRIER_SMP();
+    page->magic = kStatsPageMagic;
+
+    gDvm.statsPage = page;
+    dvmInitMutex(&gDvm.statsPageLock);
+    pthread_cond_init(&gDvm.statsPageCond, NULL);
+
+    if (!dvmCreateInternalThread(&gDvm.statsPageHandle, "Stats Page Writer",
+            statsPageThreadStart, NULL))
+    {
+        munmap(page, size);
+        unlink(fileName);
+        gDvm.statsPage = NULL;
+        return false;
+    }
+
+    LOGI("Writing VM stats to '%s' every %d msec\n",
+        fileName, gDvm.statsIntervalMsec);
+    return true;
+}
+
+/*
+ * Stop the writer.  The file stays, marked as no longer live, so the last
+ * values can still be read.
+ */
+void dvmStatsPageShutdown(void)
+{
+    StatsPage* page = gDvm.statsPage;
+
+    if (page == NULL)
+        return;
+
+    dvmLockMutex(&gDvm.statsPageLock);
+    gDvm.haltStatsPage = true;
+    pthread_cond_signal(&gDvm.statsPageCond);
+    dvmUnlockMutex(&gDvm.statsPageLock);
+
+    pthread_join(gDvm.statsPageHandle, NULL);
+
+    page->flags &= ~kStatsPageLive;
+    MEM_BARRIER_SMP();
+    munmap(page, offsetof(StatsPage, counters) +
+        page->numCounters * sizeof(StatsCounter));
+    gDvm.statsPage = NULL;
+}
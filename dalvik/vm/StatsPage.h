@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Runtime counters in a memory-mapped file (-Xstatsfile), so that a
+ * monitor can read them without talking to, or stopping, the VM.  See
+ * tools/dvmstats.
+ */
+#ifndef _DALVIK_STATSPAGE
+#define _DALVIK_STATSPAGE
+
+#include <stdint.h>
+
+/*
+ * The file is a header followed by an array of named 64-bit counters.
+ * Readers must find the counters with "headerSize" and step through them
+ * with "counterSize", and look them up by name, so that later versions
+ * can add header fields and counters without breaking them.  A counter's
+ * name and meaning never change once it has shipped.
+ *
+ * One thread in the VM writes the page.  It makes "sequence" odd while it
+ * updates the counters and even again when it's done, so a reader copies
+ * the counters and tries again if "sequence" was odd or changed.  64-bit
+ * stores aren't atomic on every CPU we run on, so this is what keeps a
+ * reader from seeing half of a value.
+ */
+#define kStatsPageMagic     0x53544154534d5644ULL   /* "DVMSTATS" */
+#define kStatsPageVersion   1
+#define kStatsNameLen       40
+
+enum {
+    kStatsPageLive      = 0x01,     /* cleared when the VM shuts down */
+};
+
+typedef struct StatsCounter {
+    char        name[kStatsNameLen];    /* null-terminated */
+    uint64_t    value;
+} StatsCounter;
+
+typedef struct StatsPage {
+    uint64_t    magic;
+    uint32_t    version;
+    uint32_t    headerSize;             /* offset of the first counter */
+    uint32_t    counterSize;            /* sizeof(StatsCounter) */
+    uint32_t    numCounters;
+    uint32_t    pid;
+    uint32_t    intervalMsec;           /* how often the VM updates it */
+    volatile uint32_t sequence;         /* odd while an update is going on */
+    volatile uint32_t flags;
+    uint64_t    startTimeMsec;          /* wall clock, when the VM started */
+    volatile uint64_t updateTimeMsec;   /* wall clock, at the last update */
+    StatsCounter counters[1];
+} StatsPage;
+
+#ifndef NOT_VM      /* for tools that include this file */
+
+/*
+ * Create the stats file and start updating it, if -Xstatsfile asked for
+ * it.  Happens after the zygote fork.
+ */
+bool dvmStatsPageStartup(void);
+void dvmStatsPageShutdown(void);
+
+#endif /*NOT_VM*/
+
+#endif /*_DALVIK_STATSPAGE*/
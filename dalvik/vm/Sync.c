@@ -154,6 +154,7 @@ struct Monitor {
 Monitor* dvmCreateMonitor(Object* obj)
 {
     Monitor* mon;
+    int32_t count;
 
     mon = (Monitor*) calloc(1, sizeof(Monitor));
     if (mon == NULL) {
@@ -173,6 +174,10 @@ Monitor* dvmCreateMonitor(Object* obj)
     } while (!ATOMIC_CMP_SWAP((int32_t*)(void*)&gDvm.monitorList,
                               (int32_t)mon->next, (int32_t)mon));
 
+    do {
+        count = gDvm.monitorsCreated;
+    } while (!ATOMIC_CMP_SWAP(&gDvm.monitorsCreated, count, count + 1));
+
     return mon;
 }
 
@@ -319,6 +324,7 @@ static void freeObjectMonitor(Object* obj)
     free(mon->historyRawStackTrace);
 #endif
     free(mon);
+    gDvm.monitorsFreed++;
 }
 
 /*
@@ -313,6 +313,8 @@ bool dvmThreadStartup(void)
      */
     prepareThread(thread);
     gDvm.threadList = thread;
+    gDvm.threadCount = 1;
+    gDvm.threadsStarted = 1;
 
 #ifdef COUNT_PRECISE_METHODS
     gDvm.preciseMethods = dvmPointerSetAlloc(200);
@@ -1044,6 +1046,8 @@ static bool prepareThread(Thread* thread)
         return false;
 
     memset(&thread->jniMonitorRefTable, 0, sizeof(thread->jniMonitorRefTable));
+    memset(&thread->jniCriticalPinTable, 0,
+        sizeof(thread->jniCriticalPinTable));
 
     pthread_cond_init(&thread->waitCond, NULL);
     dvmInitMutex(&thread->waitMutex);
@@ -1069,6 +1073,16 @@ static void unlinkThread(Thread* thread)
     if (thread->next != NULL)
         thread->next->prev = thread->prev;
     thread->prev = thread->next = NULL;
+    gDvm.threadCount--;
+
+#ifdef WITH_PROFILER
+    /* stop the CPU profiler's timer and keep this thread's samples */
+    dvmCpuProfilerThreadExit(thread);
+#endif
+
+    /* keep the JNI pin stats for threads that have gone away */
+    gDvm.jniCriticalPinRetired += thread->jniCriticalPinCount;
+    gDvm.jniCriticalUnpinRetired += thread->jniCriticalUnpinCount;
 }
 
 /*
@@ -1103,6 +1117,16 @@ static void freeThread(Thread* thread)
     dvmClearReferenceTable(&thread->internalLocalRefTable);
     if (&thread->jniMonitorRefTable.table != NULL)
         dvmClearReferenceTable(&thread->jniMonitorRefTable);
+    if (thread->jniCriticalPinTable.table != NULL) {
+        int count = dvmReferenceTableEntries(&thread->jniCriticalPinTable);
+        if (count != 0) {
+            LOGW("threadid=%d: exiting with %d critical JNI pin(s)\n",
+                thread->threadId, count);
+        }
+        dvmClearReferenceTable(&thread->jniCriticalPinTable);
+    }
+
+    dvmRetireAtomicCacheL0(&thread->atomicCacheL0);
 
 #if defined(WITH_SELF_VERIFICATION)
     dvmSelfVerificationShadowSpaceFree(thread);
@@ -1553,6 +1577,8 @@ bool dvmCreateInterpThread(Object* threadObj, int reqStackSize)
         newThread->next->prev = newThread;
     newThread->prev = gDvm.threadList;
     gDvm.threadList->next = newThread;
+    gDvm.threadCount++;
+    gDvm.threadsStarted++;
 
     if (!dvmGetFieldBoolean(threadObj, gDvm.offJavaLangThread_daemon))
         gDvm.nonDaemonThreadCount++;        // guarded by thread list lock
@@ -2009,6 +2035,8 @@ bool dvmAttachCurrentThread(const JavaVMAttachArgs* pArgs, bool isDaemon)
         self->next->prev = self;
     self->prev = gDvm.threadList;
     gDvm.threadList->next = self;
+    gDvm.threadCount++;
+    gDvm.threadsStarted++;
     if (!isDaemon)
         gDvm.nonDaemonThreadCount++;
 
@@ -4069,6 +4097,12 @@ static void gcScanThread(Thread *thread)
         gcScanReferenceTable(&thread->jniMonitorRefTable);
     }
 
+    if (thread->jniCriticalPinTable.table != NULL) {
+        HPROF_SET_GC_SCAN_STATE(HPROF_ROOT_JNI_GLOBAL, thread->threadId);
+
+        gcScanReferenceTable(&thread->jniCriticalPinTable);
+    }
+
     HPROF_SET_GC_SCAN_STATE(HPROF_ROOT_JAVA_FRAME, thread->threadId);
 
     gcScanInterpStackReferences(thread);
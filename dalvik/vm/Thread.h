@@ -180,6 +180,20 @@ typedef struct Thread {
     /* JNI native monitor reference tracking (initialized on first use) */
     ReferenceTable  jniMonitorRefTable;
 
+    /*
+     * Arrays pinned by GetPrimitiveArrayCritical and GetStringCritical
+     * (initialized on first use).  Only this thread adds or removes
+     * entries, and only while running, so no lock is needed.  The GC
+     * treats the entries as roots; a moving collector must also leave
+     * them where they are.
+     */
+    ReferenceTable  jniCriticalPinTable;
+    u4          jniCriticalPinCount;
+    u4          jniCriticalUnpinCount;
+
+    /* recent results from the shared AtomicCaches; see AtomicCache.h */
+    AtomicCacheL0   atomicCacheL0;
+
     /* hack to make JNI_OnLoad work right */
     Object*     classLoaderOverride;
 
@@ -232,6 +246,12 @@ typedef struct Thread {
     bool        cpuClockBaseSet;
     u8          cpuClockBase;
 
+    /* method trace records not yet handed to the writer thread */
+    MethodTraceChunk* traceChunk;
+
+    /* CPU profiler samples not yet collected */
+    struct CpuSampleRing* cpuSampleRing;
+
     /* memory allocation profiling state */
     AllocProfState allocProf;
 #endif
@@ -24,6 +24,10 @@
 #include "Dalvik.h"
 #include <stdlib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*
  * Initialize string globals.
  *
@@ -53,18 +57,22 @@ static bool stringStartup()
             dvmFindSystemClassNoInit("Ljava/lang/String;");
 
     gDvm.offJavaLangString_value =
-        dvmFindFieldOffset(gDvm.classJavaLangString, "value", "[C");
+        dvmFindFieldOffset(gDvm.classJavaLangString, "value",
+            "Ljava/lang/Object;");
     gDvm.offJavaLangString_count =
         dvmFindFieldOffset(gDvm.classJavaLangString, "count", "I");
     gDvm.offJavaLangString_offset =
         dvmFindFieldOffset(gDvm.classJavaLangString, "offset", "I");
     gDvm.offJavaLangString_hashCode =
         dvmFindFieldOffset(gDvm.classJavaLangString, "hashCode", "I");
+    gDvm.offJavaLangString_coder =
+        dvmFindFieldOffset(gDvm.classJavaLangString, "coder", "B");
 
     if (gDvm.offJavaLangString_value < 0 ||
         gDvm.offJavaLangString_count < 0 ||
         gDvm.offJavaLangString_offset < 0 ||
-        gDvm.offJavaLangString_hashCode < 0)
+        gDvm.offJavaLangString_hashCode < 0 ||
+        gDvm.offJavaLangString_coder < 0)
     {
         LOGE("VM-required field missing from java/lang/String\n");
         return false;
@@ -91,6 +99,11 @@ static bool stringStartup()
             gDvm.offJavaLangString_hashCode, STRING_FIELDOFF_HASHCODE);
         badValue = true;
     }
+    if (gDvm.offJavaLangString_coder != STRING_FIELDOFF_CODER) {
+        LOGE("InlineNative: String.coder offset = %d, expected %d\n",
+            gDvm.offJavaLangString_coder, STRING_FIELDOFF_CODER);
+        badValue = true;
+    }
     if (badValue)
         return false;
 
@@ -107,6 +120,165 @@ void dvmStringShutdown()
     // currently unused
 }
 
+/*
+ * ===========================================================================
+ *      ASCII fast paths
+ * ===========================================================================
+ */
+
+/*
+ * Nearly everything that crosses the UTF-8/UTF-16 boundary -- class and
+ * member names, string literals, most JNI traffic -- is plain ASCII.  The
+ * conversion and length functions below handle ASCII runs several chars
+ * at a time (16 bytes with SSE2, one machine word elsewhere) and drop to
+ * the per-char code for everything else.
+ *
+ * NUL-terminated input is only read ahead with aligned loads.  Those can
+ * look past the terminator, but never onto the next page.
+ */
+#define kAsciiWordOnes  ((unsigned long) -1 / 0xff)         /* 0x0101... */
+#define kAsciiWordHighs (kAsciiWordOnes * 0x80)             /* 0x8080... */
+
+typedef unsigned long __attribute__((__may_alias__)) AsciiWord;
+
+/*
+ * Returns the number of leading bytes in "utf8Str" that are in
+ * [0x01,0x7f], i.e. the length of the ASCII run that starts there.
+ */
+static inline int utf8AsciiRunLen(const char* utf8Str)
+{
+    const u1* start = (const u1*) utf8Str;
+    const u1* ptr = start;
+
+#ifdef __SSE2__
+    while (((uintptr_t) ptr & 15) != 0) {
+        if (*ptr == 0 || *ptr >= 0x80)
+            return ptr - start;
+        ptr++;
+    }
+    for (;;) {
+        __m128i v = _mm_load_si128((const __m128i*) ptr);
+        int mask = _mm_movemask_epi8(v) |
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        if (mask != 0)
+            return ptr - start + __builtin_ctz(mask);
+        ptr += 16;
+    }
+#else
+    while (((uintptr_t) ptr & (sizeof(AsciiWord) - 1)) != 0) {
+        if (*ptr == 0 || *ptr >= 0x80)
+            return ptr - start;
+        ptr++;
+    }
+    for (;;) {
+        /* a byte that is 0 or has its high bit set shows up in the high
+         * bits of (w | (w - 1)); borrows only start at a zero byte */
+        AsciiWord w = *(const AsciiWord*) ptr;
+        if (((w | (w - kAsciiWordOnes)) & kAsciiWordHighs) != 0)
+            break;
+        ptr += sizeof(AsciiWord);
+    }
+    while (*ptr != 0 && *ptr < 0x80)
+        ptr++;
+    return ptr - start;
+#endif
+}
+
+/*
+ * Copy the ASCII run at the start of "utf8Str" to "utf16Str", widening
+ * each byte.  Returns the number of chars copied.
+ */
+static inline int widenAsciiRun(u2* utf16Str, const char* utf8Str)
+{
+#ifdef __SSE2__
+    const u1* start = (const u1*) utf8Str;
+    const u1* ptr = start;
+    const __m128i zero = _mm_setzero_si128();
+
+    while (((uintptr_t) ptr & 15) != 0) {
+        if (*ptr == 0 || *ptr >= 0x80)
+            return ptr - start;
+        *utf16Str++ = *ptr++;
+    }
+    for (;;) {
+        __m128i v = _mm_load_si128((const __m128i*) ptr);
+        int mask = _mm_movemask_epi8(v) |
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        if (mask != 0)
+            break;
+        _mm_storeu_si128((__m128i*) utf16Str, _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i*) (utf16Str + 8),
+            _mm_unpackhi_epi8(v, zero));
+        ptr += 16;
+        utf16Str += 16;
+    }
+    while (*ptr != 0 && *ptr < 0x80)
+        *utf16Str++ = *ptr++;
+    return ptr - start;
+#else
+    int i, len = utf8AsciiRunLen(utf8Str);
+
+    for (i = 0; i < len; i++)
+        utf16Str[i] = (u1) utf8Str[i];
+    return len;
+#endif
+}
+
+/*
+ * Returns "true" if every char of the modified UTF-8 string "utf8Str" is
+ * below 0x100.  Those take one byte, or two with a lead byte of 0xc0-0xc3;
+ * any other lead byte is 0xc4 or above.
+ */
+static bool utf8IsLatin1(const char* utf8Str)
+{
+    for (;;) {
+        utf8Str += utf8AsciiRunLen(utf8Str);
+        if (*utf8Str == '\0')
+            return true;
+        if ((u1) *utf8Str >= 0xc4)
+            return false;
+        utf8Str++;
+    }
+}
+
+/*
+ * Convert a modified UTF-8 string that passed utf8IsLatin1() to Latin-1.
+ */
+static void convertUtf8ToLatin1(u1* latin1Str, const char* utf8Str)
+{
+    for (;;) {
+        int run = utf8AsciiRunLen(utf8Str);
+        memcpy(latin1Str, utf8Str, run);
+        latin1Str += run;
+        utf8Str += run;
+
+        if (*utf8Str == '\0')
+            break;
+        *latin1Str++ = (u1) dexGetUtf16FromUtf8(&utf8Str);
+    }
+}
+
+/*
+ * Returns "true" if all "len" chars of "utf16Str" are below 0x100.
+ */
+static bool utf16IsLatin1(const u2* utf16Str, int len)
+{
+#ifdef __SSE2__
+    for ( ; len >= 8; len -= 8, utf16Str += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) utf16Str);
+        __m128i high = _mm_srli_epi16(v, 8);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128()))
+                != 0xffff)
+            return false;
+    }
+#endif
+    while (len--) {
+        if (*utf16Str++ > 0xff)
+            return false;
+    }
+    return true;
+}
+
 /*
  * Compute a hash code on a UTF-8 string, for use with internal hash tables.
  *
@@ -118,11 +290,22 @@ void dvmStringShutdown()
  * the hash with the result.  That way, if something encoded the same
  * character in two different ways, the hash value would be the same.  For
  * our purposes that isn't necessary.
+ *
+ * We take four bytes per step, using precomputed powers of 31, so the
+ * multiplies don't all wait on each other.  The result is the same as
+ * the one-at-a-time loop, including the sign of "char".
  */
 u4 dvmComputeUtf8Hash(const char* utf8Str)
 {
     u4 hash = 1;
 
+    while (utf8Str[0] != '\0' && utf8Str[1] != '\0' &&
+           utf8Str[2] != '\0' && utf8Str[3] != '\0')
+    {
+        hash = hash * 923521 + utf8Str[0] * 29791 + utf8Str[1] * 961 +
+            utf8Str[2] * 31 + utf8Str[3];
+        utf8Str += 4;
+    }
     while (*utf8Str != '\0')
         hash = hash * 31 + *utf8Str++;
 
@@ -134,23 +317,26 @@ u4 dvmComputeUtf8Hash(const char* utf8Str)
  *
  * The value returned is the number of characters, which may or may not
  * be the same as the number of bytes.
- *
- * (If this needs optimizing, try: mask against 0xa0, shift right 5,
- * get increment {1-3} from table of 8 values.)
  */
 int dvmUtf8Len(const char* utf8Str)
 {
     int ic, len = 0;
 
-    while ((ic = *utf8Str++) != '\0') {
+    for (;;) {
+        int run = utf8AsciiRunLen(utf8Str);
+        len += run;
+        utf8Str += run;
+
+        ic = (u1) *utf8Str++;
+        if (ic == '\0')
+            break;
+
+        /* two- or three-byte encoding */
         len++;
-        if ((ic & 0x80) != 0) {
-            /* two- or three-byte encoding */
+        utf8Str++;
+        if ((ic & 0x20) != 0) {
+            /* three-byte encoding */
             utf8Str++;
-            if ((ic & 0x20) != 0) {
-                /* three-byte encoding */
-                utf8Str++;
-            }
         }
     }
 
@@ -162,18 +348,55 @@ int dvmUtf8Len(const char* utf8Str)
  */
 void dvmConvertUtf8ToUtf16(u2* utf16Str, const char* utf8Str)
 {
-    while (*utf8Str != '\0')
+    for (;;) {
+        int run = widenAsciiRun(utf16Str, utf8Str);
+        utf16Str += run;
+        utf8Str += run;
+
+        if (*utf8Str == '\0')
+            break;
         *utf16Str++ = dexGetUtf16FromUtf8(&utf8Str);
+    }
 }
 
+#ifdef __SSE2__
+/*
+ * Returns a movemask of the chars in "v" that are in [0x01,0x7f], i.e.
+ * the ones that take a single byte in modified UTF-8 (two mask bits per
+ * char).
+ */
+static inline int utf16AsciiMask(__m128i v)
+{
+    __m128i t = _mm_sub_epi16(v, _mm_set1_epi16(1));        /* 0 -> 0xffff */
+    t = _mm_subs_epu16(t, _mm_set1_epi16(0x7e));
+    return _mm_movemask_epi8(_mm_cmpeq_epi16(t, _mm_setzero_si128()));
+}
+#endif
+
 /*
  * Given a UTF-16 string, compute the length of the corresponding UTF-8
  * string in bytes.
  */
-static int utf16_utf8ByteLen(const u2* utf16Str, int len)
+int dvmUtf16Utf8ByteLen(const u2* utf16Str, int len)
 {
     int utf8Len = 0;
 
+#ifdef __SSE2__
+    /*
+     * Each char is one byte, plus one if it's 0 or above 0x7f, plus one
+     * more if it's above 0x7ff.  Count the extras eight chars at a time.
+     */
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; len >= 8; len -= 8, utf16Str += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) utf16Str);
+        int single = utf16AsciiMask(v);
+        int triple = _mm_movemask_epi8(_mm_cmpeq_epi16(
+                _mm_subs_epu16(v, _mm_set1_epi16(0x07ff)), zero)) ^ 0xffff;
+        utf8Len += 8 + (__builtin_popcount(single ^ 0xffff) +
+            __builtin_popcount(triple)) / 2;
+    }
+#endif
+
     while (len--) {
         unsigned int uic = *utf16Str++;
 
@@ -194,15 +417,31 @@ static int utf16_utf8ByteLen(const u2* utf16Str, int len)
 /*
  * Convert a UTF-16 string to UTF-8.
  *
- * Make sure you allocate "utf8Str" with the result of utf16_utf8ByteLen(),
+ * Make sure you allocate "utf8Str" with the result of dvmUtf16Utf8ByteLen(),
  * not just "len".
  */
-static void convertUtf16ToUtf8(char* utf8Str, const u2* utf16Str, int len)
+void dvmConvertUtf16ToUtf8(char* utf8Str, const u2* utf16Str, int len)
 {
     assert(len >= 0);
 
-    while (len--) {
-        unsigned int uic = *utf16Str++;
+    while (len > 0) {
+        unsigned int uic;
+
+#ifdef __SSE2__
+        /* narrow eight ASCII chars at a time; they need exactly 8 bytes */
+        if (len >= 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*) utf16Str);
+            if (utf16AsciiMask(v) == 0xffff) {
+                _mm_storel_epi64((__m128i*) utf8Str, _mm_packus_epi16(v, v));
+                utf8Str += 8;
+                utf16Str += 8;
+                len -= 8;
+                continue;
+            }
+        }
+#endif
+        uic = *utf16Str++;
+        len--;
 
         /*
          * The most common case is (uic > 0 && uic <= 0x7f).
@@ -224,27 +463,142 @@ static void convertUtf16ToUtf8(char* utf8Str, const u2* utf16Str, int len)
     *utf8Str = '\0';
 }
 
+/*
+ * Compute the length in bytes of the modified UTF-8 form of "len" Latin-1
+ * chars: one byte for [0x01,0x7f], two for the rest.
+ */
+static int latin1Utf8ByteLen(const u1* latin1Str, int len)
+{
+    int utf8Len = len;
+
+    while (len--) {
+        u1 ic = *latin1Str++;
+        if (ic == 0 || ic > 0x7f)
+            utf8Len++;
+    }
+    return utf8Len;
+}
+
+/*
+ * Convert Latin-1 to modified UTF-8, adding a terminating null.
+ */
+static void convertLatin1ToUtf8(char* utf8Str, const u1* latin1Str, int len)
+{
+    while (len--) {
+        u1 ic = *latin1Str++;
+
+        if (ic == 0 || ic > 0x7f) {
+            *utf8Str++ = (ic >> 6) | 0xc0;
+            *utf8Str++ = (ic & 0x3f) | 0x80;
+        } else {
+            *utf8Str++ = ic;
+        }
+    }
+
+    *utf8Str = '\0';
+}
+
 /*
  * Use the java/lang/String.computeHashCode() algorithm.
+ *
+ * Eight chars per step with precomputed powers of 31 (mod 2^32), which
+ * keeps the multiplier busy instead of waiting on the previous step.
+ * SSE2 has no 32-bit multiply, so this is as wide as it usefully gets
+ * there.
  */
-static inline u4 dvmComputeUtf16Hash(const u2* utf16Str, int len)
+u4 dvmComputeUtf16Hash(const u2* utf16Str, int len)
 {
     u4 hash = 0;
 
+    for ( ; len >= 8; len -= 8, utf16Str += 8) {
+        hash = hash * 2487512833U +
+            utf16Str[0] * 1742810335U + utf16Str[1] * 887503681U +
+            utf16Str[2] * 28629151U + utf16Str[3] * 923521U +
+            utf16Str[4] * 29791U + utf16Str[5] * 961U +
+            utf16Str[6] * 31U + utf16Str[7];
+    }
     while (len--)
         hash = hash * 31 + *utf16Str++;
 
     return hash;
 }
+
+/*
+ * The same hash over Latin-1 data.
+ */
+u4 dvmComputeLatin1Hash(const u1* latin1Str, int len)
+{
+    u4 hash = 0;
+
+    for ( ; len >= 8; len -= 8, latin1Str += 8) {
+        hash = hash * 2487512833U +
+            latin1Str[0] * 1742810335U + latin1Str[1] * 887503681U +
+            latin1Str[2] * 28629151U + latin1Str[3] * 923521U +
+            latin1Str[4] * 29791U + latin1Str[5] * 961U +
+            latin1Str[6] * 31U + latin1Str[7];
+    }
+    while (len--)
+        hash = hash * 31 + *latin1Str++;
+
+    return hash;
+}
+
 u4 dvmComputeStringHash(StringObject* strObj) {
-    ArrayObject* chars = (ArrayObject*) dvmGetFieldObject((Object*) strObj,
-                                STRING_FIELDOFF_VALUE);
-    int offset, len;
+    int len = dvmGetFieldInt((Object*) strObj, STRING_FIELDOFF_COUNT);
+
+    if (dvmStringIsLatin1(strObj))
+        return dvmComputeLatin1Hash(dvmStringLatin1Chars(strObj), len);
+    return dvmComputeUtf16Hash(dvmStringChars(strObj), len);
+}
+
+/*
+ * Allocate a String of "len" chars and its value array: a byte[] if
+ * "latin1" is set, a char[] otherwise.  The caller fills in the array and
+ * the hash code.
+ *
+ * Returns NULL and throws an exception on failure.
+ */
+static StringObject* allocString(int len, bool latin1, int allocFlags,
+    ArrayObject** pValue)
+{
+    StringObject* newObj;
+    ArrayObject* value;
+
+    if (gDvm.javaLangStringReady <= 0) {
+        if (!stringStartup())
+            return NULL;
+    }
+
+    /* init before alloc */
+    if (!dvmIsClassInitialized(gDvm.classJavaLangString) &&
+        !dvmInitClass(gDvm.classJavaLangString))
+    {
+        return NULL;
+    }
+
+    newObj = (StringObject*) dvmAllocObject(gDvm.classJavaLangString,
+                allocFlags);
+    if (newObj == NULL)
+        return NULL;
 
-    len = dvmGetFieldInt((Object*) strObj, STRING_FIELDOFF_COUNT);
-    offset = dvmGetFieldInt((Object*) strObj, STRING_FIELDOFF_OFFSET);
+    value = dvmAllocPrimitiveArray(latin1 ? 'B' : 'C', len, allocFlags);
+    if (value == NULL) {
+        dvmReleaseTrackedAllocIFN((Object*) newObj, NULL, allocFlags);
+        return NULL;
+    }
+
+    dvmSetFieldObject((Object*)newObj, STRING_FIELDOFF_VALUE,
+        (Object*)value);
+    dvmReleaseTrackedAllocIFN((Object*) value, NULL, allocFlags);
+    dvmSetFieldInt((Object*)newObj, STRING_FIELDOFF_COUNT, len);
+    if (!latin1) {
+        dvmSetFieldInt((Object*)newObj, STRING_FIELDOFF_CODER,
+            STRING_CODER_UTF16);
+    }
+    /* leave offset set to zero */
 
-    return dvmComputeUtf16Hash((u2*) chars->contents + offset, len);
+    *pValue = value;
+    return newObj;
 }
 
 /*
@@ -278,49 +632,30 @@ StringObject* dvmCreateStringFromCstrAndLength(const char* utf8Str,
     u4 utf16Length, int allocFlags)
 {
     StringObject* newObj;
-    ArrayObject* chars;
+    ArrayObject* value;
+    bool latin1;
     u4 hashCode = 0;
 
     //LOGV("Creating String from '%s'\n", utf8Str);
     assert(allocFlags != ALLOC_DONT_TRACK);     /* don't currently need */
     assert(utf8Str != NULL);
 
-    if (gDvm.javaLangStringReady <= 0) {
-        if (!stringStartup())
-            return NULL;
-    }
-
-    /* init before alloc */
-    if (!dvmIsClassInitialized(gDvm.classJavaLangString) &&
-        !dvmInitClass(gDvm.classJavaLangString))
-    {
-        return NULL;
-    }
-
-    newObj = (StringObject*) dvmAllocObject(gDvm.classJavaLangString,
-                allocFlags);
+    latin1 = utf8IsLatin1(utf8Str);
+    newObj = allocString(utf16Length, latin1, allocFlags, &value);
     if (newObj == NULL)
         return NULL;
 
-    chars = dvmAllocPrimitiveArray('C', utf16Length, allocFlags);
-    if (chars == NULL) {
-        dvmReleaseTrackedAllocIFN((Object*) newObj, NULL, allocFlags);
-        return NULL;
+    if (latin1) {
+        convertUtf8ToLatin1((u1*) value->contents, utf8Str);
+        hashCode = dvmComputeLatin1Hash((u1*) value->contents, utf16Length);
+    } else {
+        dvmConvertUtf8ToUtf16((u2*) value->contents, utf8Str);
+        hashCode = dvmComputeUtf16Hash((u2*) value->contents, utf16Length);
     }
-    dvmConvertUtf8ToUtf16((u2*)chars->contents, utf8Str);
-    hashCode = dvmComputeUtf16Hash((u2*) chars->contents, utf16Length);
-
-    dvmSetFieldObject((Object*)newObj, STRING_FIELDOFF_VALUE,
-        (Object*)chars);
-    dvmReleaseTrackedAllocIFN((Object*) chars, NULL, allocFlags);
-    dvmSetFieldInt((Object*)newObj, STRING_FIELDOFF_COUNT, utf16Length);
     dvmSetFieldInt((Object*)newObj, STRING_FIELDOFF_HASHCODE, hashCode);
-    /* leave offset set to zero */
 
     /* debugging stuff */
     //dvmDumpObject((Object*)newObj);
-    //printHexDumpEx(ANDROID_LOG_DEBUG, chars->contents, utf16Length * 2,
-    //    kHexDumpMem);
 
     /* caller may need to dvmReleaseTrackedAlloc(newObj) */
     return newObj;
@@ -332,48 +667,33 @@ StringObject* dvmCreateStringFromCstrAndLength(const char* utf8Str,
 StringObject* dvmCreateStringFromUnicode(const u2* unichars, int len)
 {
     StringObject* newObj;
-    ArrayObject* chars;
+    ArrayObject* value;
+    bool latin1;
     u4 hashCode = 0;
 
     /* we allow a null pointer if the length is zero */
     assert(len == 0 || unichars != NULL);
 
-    if (gDvm.javaLangStringReady <= 0) {
-        if (!stringStartup())
-            return NULL;
-    }
-
-    /* init before alloc */
-    if (!dvmIsClassInitialized(gDvm.classJavaLangString) &&
-        !dvmInitClass(gDvm.classJavaLangString))
-    {
-        return NULL;
-    }
-
-    newObj = (StringObject*) dvmAllocObject(gDvm.classJavaLangString,
-        ALLOC_DEFAULT);
+    latin1 = utf16IsLatin1(unichars, len);
+    newObj = allocString(len, latin1, ALLOC_DEFAULT, &value);
     if (newObj == NULL)
         return NULL;
 
-    chars = dvmAllocPrimitiveArray('C', len, ALLOC_DEFAULT);
-    if (chars == NULL) {
-        dvmReleaseTrackedAlloc((Object*) newObj, NULL);
-        return NULL;
-    }
-    if (len > 0)
-        memcpy(chars->contents, unichars, len * sizeof(u2));
-    hashCode = dvmComputeUtf16Hash((u2*) chars->contents, len);
+    if (latin1) {
+        u1* bytes = (u1*) value->contents;
+        int i;
 
-    dvmSetFieldObject((Object*)newObj, STRING_FIELDOFF_VALUE,
-        (Object*)chars);
-    dvmReleaseTrackedAlloc((Object*) chars, NULL);
-    dvmSetFieldInt((Object*)newObj, STRING_FIELDOFF_COUNT, len);
+        for (i = 0; i < len; i++)
+            bytes[i] = (u1) unichars[i];
+        hashCode = dvmComputeLatin1Hash(bytes, len);
+    } else {
+        memcpy(value->contents, unichars, len * sizeof(u2));
+        hashCode = dvmComputeUtf16Hash((u2*) value->contents, len);
+    }
     dvmSetFieldInt((Object*)newObj, STRING_FIELDOFF_HASHCODE, hashCode);
-    /* leave offset set to zero */
 
     /* debugging stuff */
     //dvmDumpObject((Object*)newObj);
-    //printHexDumpEx(ANDROID_LOG_DEBUG, chars->contents, len*2, kHexDumpMem);
 
     /* caller must dvmReleaseTrackedAlloc(newObj) */
     return newObj;
@@ -387,9 +707,7 @@ StringObject* dvmCreateStringFromUnicode(const u2* unichars, int len)
 char* dvmCreateCstrFromString(StringObject* jstr)
 {
     char* newStr;
-    ArrayObject* chars;
-    int len, byteLen, offset;
-    const u2* data;
+    int len, byteLen;
 
     assert(gDvm.javaLangStringReady > 0);
 
@@ -397,17 +715,23 @@ char* dvmCreateCstrFromString(StringObject* jstr)
         return NULL;
 
     len = dvmGetFieldInt((Object*) jstr, STRING_FIELDOFF_COUNT);
-    offset = dvmGetFieldInt((Object*) jstr, STRING_FIELDOFF_OFFSET);
-    chars = (ArrayObject*) dvmGetFieldObject((Object*) jstr,
-                                STRING_FIELDOFF_VALUE);
-    data = (const u2*) chars->contents + offset;
-    assert(offset + len <= (int) chars->length);
+    if (dvmStringIsLatin1(jstr)) {
+        const u1* data = dvmStringLatin1Chars(jstr);
 
-    byteLen = utf16_utf8ByteLen(data, len);
-    newStr = (char*) malloc(byteLen+1);
-    if (newStr == NULL)
-        return NULL;
-    convertUtf16ToUtf8(newStr, data, len);
+        byteLen = latin1Utf8ByteLen(data, len);
+        newStr = (char*) malloc(byteLen+1);
+        if (newStr == NULL)
+            return NULL;
+        convertLatin1ToUtf8(newStr, data, len);
+    } else {
+        const u2* data = dvmStringChars(jstr);
+
+        byteLen = dvmUtf16Utf8ByteLen(data, len);
+        newStr = (char*) malloc(byteLen+1);
+        if (newStr == NULL)
+            return NULL;
+        dvmConvertUtf16ToUtf8(newStr, data, len);
+    }
 
     return newStr;
 }
@@ -419,10 +743,10 @@ char* dvmCreateCstrFromString(StringObject* jstr)
 void dvmCreateCstrFromStringRegion(StringObject* jstr, int start, int len,
     char* buf)
 {
-    const u2* data;
-
-    data = dvmStringChars(jstr) + start;
-    convertUtf16ToUtf8(buf, data, len);
+    if (dvmStringIsLatin1(jstr))
+        convertLatin1ToUtf8(buf, dvmStringLatin1Chars(jstr) + start, len);
+    else
+        dvmConvertUtf16ToUtf8(buf, dvmStringChars(jstr) + start, len);
 }
 
 /*
@@ -432,9 +756,7 @@ void dvmCreateCstrFromStringRegion(StringObject* jstr, int start, int len,
  */
 int dvmStringUtf8ByteLen(StringObject* jstr)
 {
-    ArrayObject* chars;
-    int len, offset;
-    const u2* data;
+    int len;
 
     assert(gDvm.javaLangStringReady > 0);
 
@@ -442,13 +764,9 @@ int dvmStringUtf8ByteLen(StringObject* jstr)
         return 0;       // should we throw something?  assert?
 
     len = dvmGetFieldInt((Object*) jstr, STRING_FIELDOFF_COUNT);
-    offset = dvmGetFieldInt((Object*) jstr, STRING_FIELDOFF_OFFSET);
-    chars = (ArrayObject*) dvmGetFieldObject((Object*) jstr,
-                                STRING_FIELDOFF_VALUE);
-    data = (const u2*) chars->contents + offset;
-    assert(offset + len <= (int) chars->length);
-
-    return utf16_utf8ByteLen(data, len);
+    if (dvmStringIsLatin1(jstr))
+        return latin1Utf8ByteLen(dvmStringLatin1Chars(jstr), len);
+    return dvmUtf16Utf8ByteLen(dvmStringChars(jstr), len);
 }
 
 /*
@@ -460,7 +778,16 @@ int dvmStringLen(StringObject* jstr)
 }
 
 /*
- * Get the char[] object from the String.
+ * Returns "true" if the string keeps one char per byte.
+ */
+bool dvmStringIsLatin1(StringObject* jstr)
+{
+    return dvmGetFieldInt((Object*) jstr, STRING_FIELDOFF_CODER) ==
+        STRING_CODER_LATIN1;
+}
+
+/*
+ * Get the value array (byte[] or char[]) from the String.
  */
 ArrayObject* dvmStringCharArray(StringObject* jstr)
 {
@@ -469,19 +796,90 @@ ArrayObject* dvmStringCharArray(StringObject* jstr)
 }
 
 /*
- * Get the string's data.
+ * Get a Latin-1 string's data.
+ */
+const u1* dvmStringLatin1Chars(StringObject* jstr)
+{
+    ArrayObject* bytes;
+    int offset;
+
+    assert(dvmStringIsLatin1(jstr));
+    offset = dvmGetFieldInt((Object*) jstr, STRING_FIELDOFF_OFFSET);
+    bytes = (ArrayObject*) dvmGetFieldObject((Object*) jstr,
+                                STRING_FIELDOFF_VALUE);
+    return (const u1*) bytes->contents + offset;
+}
+
+/*
+ * Get a UTF-16 string's data.
  */
 const u2* dvmStringChars(StringObject* jstr)
 {
     ArrayObject* chars;
     int offset;
 
+    assert(!dvmStringIsLatin1(jstr));
     offset = dvmGetFieldInt((Object*) jstr, STRING_FIELDOFF_OFFSET);
     chars = (ArrayObject*) dvmGetFieldObject((Object*) jstr,
                                 STRING_FIELDOFF_VALUE);
     return (const u2*) chars->contents + offset;
 }
 
+/*
+ * Copy a region of the string out as UTF-16, widening Latin-1 data.
+ */
+void dvmStringCopyChars(StringObject* jstr, int start, int len, u2* buf)
+{
+    if (dvmStringIsLatin1(jstr)) {
+        const u1* data = dvmStringLatin1Chars(jstr) + start;
+        int i;
+
+        for (i = 0; i < len; i++)
+            buf[i] = data[i];
+    } else {
+        memcpy(buf, dvmStringChars(jstr) + start, len * sizeof(u2));
+    }
+}
+
+/*
+ * Returns "true" if the two strings hold the same chars.  They have the
+ * same coder unless one is a UTF16 string that happens to hold only
+ * Latin-1 chars.
+ */
+bool dvmStringEquals(StringObject* strObj1, StringObject* strObj2)
+{
+    bool latin1 = dvmStringIsLatin1(strObj1);
+    int len = dvmStringLen(strObj1);
+    const u1* bytes;
+    const u2* chars;
+    int i;
+
+    if (len != dvmStringLen(strObj2))
+        return false;
+
+    if (latin1 == dvmStringIsLatin1(strObj2)) {
+        if (latin1) {
+            return memcmp(dvmStringLatin1Chars(strObj1),
+                          dvmStringLatin1Chars(strObj2), len) == 0;
+        }
+        return memcmp(dvmStringChars(strObj1), dvmStringChars(strObj2),
+                      len * sizeof(u2)) == 0;
+    }
+
+    if (latin1) {
+        bytes = dvmStringLatin1Chars(strObj1);
+        chars = dvmStringChars(strObj2);
+    } else {
+        bytes = dvmStringLatin1Chars(strObj2);
+        chars = dvmStringChars(strObj1);
+    }
+    for (i = 0; i < len; i++) {
+        if (bytes[i] != chars[i])
+            return false;
+    }
+    return true;
+}
+
 
 /*
  * Compare two String objects.
@@ -492,33 +890,16 @@ const u2* dvmStringChars(StringObject* jstr)
  */
 int dvmHashcmpStrings(const void* vstrObj1, const void* vstrObj2)
 {
-    const StringObject* strObj1 = (const StringObject*) vstrObj1;
-    const StringObject* strObj2 = (const StringObject*) vstrObj2;
-    ArrayObject* chars1;
-    ArrayObject* chars2;
-    int len1, len2, offset1, offset2;
+    StringObject* strObj1 = (StringObject*) vstrObj1;
+    StringObject* strObj2 = (StringObject*) vstrObj2;
+    int len1, len2;
 
     assert(gDvm.javaLangStringReady > 0);
 
-    /* get offset and length into char array; all values are in 16-bit units */
-    len1 = dvmGetFieldInt((Object*) strObj1, STRING_FIELDOFF_COUNT);
-    offset1 = dvmGetFieldInt((Object*) strObj1, STRING_FIELDOFF_OFFSET);
-    len2 = dvmGetFieldInt((Object*) strObj2, STRING_FIELDOFF_COUNT);
-    offset2 = dvmGetFieldInt((Object*) strObj2, STRING_FIELDOFF_OFFSET);
+    len1 = dvmStringLen(strObj1);
+    len2 = dvmStringLen(strObj2);
     if (len1 != len2)
         return len1 - len2;
 
-    chars1 = (ArrayObject*) dvmGetFieldObject((Object*) strObj1,
-                                STRING_FIELDOFF_VALUE);
-    chars2 = (ArrayObject*) dvmGetFieldObject((Object*) strObj2,
-                                STRING_FIELDOFF_VALUE);
-
-    /* damage here actually indicates a broken java/lang/String */
-    assert(offset1 + len1 <= (int) chars1->length);
-    assert(offset2 + len2 <= (int) chars2->length);
-
-    return memcmp((const u2*) chars1->contents + offset1,
-                  (const u2*) chars2->contents + offset2,
-                  len1 * sizeof(u2));
+    return dvmStringEquals(strObj1, strObj2) ? 0 : 1;
 }
-
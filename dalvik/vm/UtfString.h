@@ -38,18 +38,43 @@
 # define STRING_FIELDOFF_OFFSET     gDvm.offJavaLangString_offset
 # define STRING_FIELDOFF_COUNT      gDvm.offJavaLangString_count
 # define STRING_FIELDOFF_HASHCODE   gDvm.offJavaLangString_hashCode
+# define STRING_FIELDOFF_CODER      gDvm.offJavaLangString_coder
 #else
 # define STRING_FIELDOFF_VALUE      8
-# define STRING_FIELDOFF_HASHCODE   12
-# define STRING_FIELDOFF_OFFSET     16
-# define STRING_FIELDOFF_COUNT      20
+# define STRING_FIELDOFF_COUNT      12
+# define STRING_FIELDOFF_HASHCODE   16
+# define STRING_FIELDOFF_OFFSET     20
+# define STRING_FIELDOFF_CODER      24
 #endif
 
+/*
+ * Values of String.coder.  A LATIN1 string's "value" is a byte[] holding
+ * one char per byte; a UTF16 string's is a char[].  Only LATIN1 promises
+ * anything about the chars: a UTF16 string may hold nothing but chars
+ * below 0x100 (a substring of one that doesn't, for instance), so code
+ * that compares strings has to cope with mixed coders.
+ *
+ * A freshly allocated String is zeroed, so it starts out LATIN1.
+ */
+#define STRING_CODER_LATIN1         0
+#define STRING_CODER_UTF16          1
+
 /*
  * Hash function for modified UTF-8 strings.
  */
 u4 dvmComputeUtf8Hash(const char* str);
 
+/*
+ * Hash function for UTF-16 data; same as java/lang/String.hashCode().
+ */
+u4 dvmComputeUtf16Hash(const u2* utf16Str, int len);
+
+/*
+ * Hash function for Latin-1 data; same as java/lang/String.hashCode() on
+ * the same chars.
+ */
+u4 dvmComputeLatin1Hash(const u1* latin1Str, int len);
+
 /*
  * Hash function for string objects.
  */
@@ -91,6 +116,18 @@ int dvmUtf8Len(const char* utf8Str);
  */
 void dvmConvertUtf8ToUtf16(u2* utf16Str, const char* utf8Str);
 
+/*
+ * Compute the length in bytes of the modified UTF-8 form of "len" UTF-16
+ * chars.  Does not include the terminating null byte.
+ */
+int dvmUtf16Utf8ByteLen(const u2* utf16Str, int len);
+
+/*
+ * Convert UTF-16 to modified UTF-8, adding a terminating null.  "utf8Str"
+ * must have room for dvmUtf16Utf8ByteLen() + 1 bytes.
+ */
+void dvmConvertUtf16ToUtf8(char* utf8Str, const u2* utf16Str, int len);
+
 /*
  * Create a java/lang/String from a Unicode string.
  *
@@ -125,15 +162,36 @@ int dvmStringUtf8ByteLen(StringObject* jstr);
 int dvmStringLen(StringObject* jstr);
 
 /*
- * Get the char[] object from the String.
+ * Returns "true" if the string is stored one byte per char.
+ */
+bool dvmStringIsLatin1(StringObject* jstr);
+
+/*
+ * Get the value array from the String: a byte[] if it's Latin-1, a char[]
+ * otherwise.
  */
 ArrayObject* dvmStringCharArray(StringObject* jstr);
 
 /*
- * Get a pointer to the Unicode data.
+ * Get a pointer to the data of a Latin-1 string.
+ */
+const u1* dvmStringLatin1Chars(StringObject* jstr);
+
+/*
+ * Get a pointer to the data of a UTF-16 (not Latin-1) string.
  */
 const u2* dvmStringChars(StringObject* jstr);
 
+/*
+ * Copy "len" chars of the string, starting at "start", to "buf" as UTF-16.
+ */
+void dvmStringCopyChars(StringObject* jstr, int start, int len, u2* buf);
+
+/*
+ * Returns "true" if the strings hold the same chars.
+ */
+bool dvmStringEquals(StringObject* strObj1, StringObject* strObj2);
+
 /*
  * Compare two string objects.  (This is a dvmHashTableLookup() callback.)
  */
@@ -131,6 +131,15 @@ void dvmGcScanPrimitiveClasses(void);
  */
 void dvmGcMarkJniGlobalRefs(void);
 
+/*
+ * Collect all JNI-pinned primitive arrays into a set, and test for
+ * membership.  Used by String deduplication.
+ *
+ * Currently implemented in JNI.c.
+ */
+void dvmGcCollectPinnedArrays(HashTable* pSet);
+bool dvmGcIsPinnedArray(HashTable* pSet, const ArrayObject* arrayObj);
+
 /*
  * Mark all debugger references.
  *
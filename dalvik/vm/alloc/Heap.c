@@ -1060,6 +1060,11 @@ void dvmCollectGarbageInternal(bool collectSoftReferences, enum GcReason reason)
         }
     }
     gcElapsedTime = (dvmGetRelativeTimeUsec() - gcHeap->gcStartTime) / 1000;
+    gDvm.gcCount++;
+    gDvm.gcTotalMsec += gcElapsedTime;
+    gDvm.gcLastMsec = (u4) gcElapsedTime;
+    gDvm.gcFreedObjects += numFreed;
+    gDvm.gcFreedBytes += sizeFreed;
     LOGD("%s freed %d objects / %zd bytes in %dms\n",
          GcReasonStr[reason], numFreed, sizeFreed, (int)gcElapsedTime);
     dvmLogGcStats(numFreed, sizeFreed, gcElapsedTime);
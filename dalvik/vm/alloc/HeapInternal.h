@@ -146,6 +146,12 @@ struct GcHeap {
      */
     bool            markAllReferents;
 
+    /* Running totals for -Xgc:dedup: strings pointed at a shared
+     * value array, and the size of the arrays they stopped using.
+     */
+    size_t          stringDedupCount;
+    size_t          stringDedupBytes;
+
 #if DVM_TRACK_HEAP_MARKING
     /* Every time an unmarked object becomes marked, markCount
      * is incremented and markSize increases by the size of
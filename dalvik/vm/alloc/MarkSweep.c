@@ -162,6 +162,15 @@ dvmHeapBeginMarkStep()
     mc->numBitmaps = numBitmaps;
     mc->finger = NULL;
 
+    if (gDvm.stringDedupGc && gDvm.classJavaLangString != NULL) {
+        mc->dedupStrings = dvmHashTableCreate(1024, NULL);
+        mc->dedupPinned = dvmHashTableCreate(16, NULL);
+        if (mc->dedupStrings == NULL || mc->dedupPinned == NULL) {
+            return false;
+        }
+        dvmGcCollectPinnedArrays(mc->dedupPinned);
+    }
+
     return true;
 }
 
@@ -483,6 +492,95 @@ static void scanClassObject(const ClassObject *clazz, GcMarkContext *ctx)
 
     scanStaticFields(clazz, ctx);
     markInterfaces(clazz, ctx);
+
+    /* cached reflection objects; all may be NULL */
+    markObject((Object *)clazz->declaredFields, ctx);
+    markObject((Object *)clazz->declaredMethods, ctx);
+    markObject((Object *)clazz->declaredConstructors, ctx);
+    markObject((Object *)clazz->annotationCache, ctx);
+}
+
+/* Bytes per element of a String value array: a byte[] for a Latin-1
+ * string, a char[] otherwise.
+ */
+static size_t dedupCharWidth(const ArrayObject *chars)
+{
+    return chars->obj.clazz == gDvm.classArrayByte ? 1 : sizeof(u2);
+}
+
+/* Compare the contents of two value arrays that back deduplication
+ * candidates.  Both arrays are exactly as long as their strings.  A
+ * byte[] never matches a char[], even if the chars are the same; the
+ * string's coder has to agree with its array.
+ */
+static int hashcmpDedupChars(const void *vchars1, const void *vchars2)
+{
+    const ArrayObject *chars1 = (const ArrayObject *)vchars1;
+    const ArrayObject *chars2 = (const ArrayObject *)vchars2;
+
+    if (chars1->obj.clazz != chars2->obj.clazz ||
+            chars1->length != chars2->length) {
+        return 1;
+    }
+    return memcmp(chars1->contents, chars2->contents,
+            chars1->length * dedupCharWidth(chars1));
+}
+
+/* Point strObj at a previously-seen value array with the same contents,
+ * if there is one; otherwise make its own array the canonical copy.
+ *
+ * This runs before the string's fields are marked, so if nothing else
+ * refers to the old array it will be swept by this same GC.  The
+ * canonical array is always marked, because the string that donated
+ * it was scanned first.
+ *
+ * Only strings that use all of their array are candidates; substrings
+ * already share storage.  The String constructors set "count" and then
+ * fill the array in a loop that can be interrupted by a GC, so a string
+ * is only touched once it's known to be finished: its hash code has
+ * been set, which Java code does on the first hashCode() call and the
+ * VM does for the strings it creates and interns.  We never compute the
+ * hash here.  The arrays behind finished Strings are never written
+ * (StringBuilder copies before writing to an array it has handed out),
+ * so sharing them is invisible to Java code.  Arrays pinned by JNI are
+ * left alone, since Release*Chars finds the array to unpin through the
+ * string.
+ */
+static void dedupString(DataObject *strObj, GcMarkContext *ctx)
+{
+    ArrayObject *chars;
+    ArrayObject *canonical;
+    int count;
+    u4 hash;
+
+    hash = dvmGetFieldInt((Object *)strObj, STRING_FIELDOFF_HASHCODE);
+    if (hash == 0) {
+        return;     /* not hashed yet, and maybe still being built */
+    }
+    chars = (ArrayObject *)dvmGetFieldObject((Object *)strObj,
+            STRING_FIELDOFF_VALUE);
+    if (chars == NULL) {
+        return;
+    }
+    count = dvmGetFieldInt((Object *)strObj, STRING_FIELDOFF_COUNT);
+    if (count == 0 || chars->length != (u4)count ||
+            dvmGetFieldInt((Object *)strObj, STRING_FIELDOFF_OFFSET) != 0)
+    {
+        return;
+    }
+    if (dvmGcIsPinnedArray(ctx->dedupPinned, chars)) {
+        return;
+    }
+
+    canonical = (ArrayObject *)dvmHashTableLookup(ctx->dedupStrings, hash,
+            chars, hashcmpDedupChars, true);
+    if (canonical != NULL && canonical != chars) {
+        dvmSetFieldObject((Object *)strObj, STRING_FIELDOFF_VALUE,
+                (Object *)canonical);
+        ctx->dedupCount++;
+        ctx->dedupBytes += offsetof(ArrayObject, contents) +
+                count * dedupCharWidth(chars);
+    }
 }
 
 /* Mark all objects that obj refers to.
@@ -540,6 +638,9 @@ static void scanObject(const Object *obj, GcMarkContext *ctx)
     } else {
         /* It's a DataObject-compatible object.
          */
+        if (clazz == gDvm.classJavaLangString && ctx->dedupStrings != NULL) {
+            dedupString((DataObject *)obj, ctx);
+        }
         scanInstanceFields((DataObject *)obj, clazz, ctx);
 
         if (IS_CLASS_FLAG_SET(clazz, CLASS_ISREFERENCE)) {
@@ -1084,6 +1185,19 @@ void dvmHeapFinishMarkStep()
     dvmHeapBitmapDeleteList(markContext->bitmaps, markContext->numBitmaps);
     destroyMarkStack(&markContext->stack);
 
+    if (markContext->dedupStrings != NULL) {
+        gDvm.gcHeap->stringDedupCount += markContext->dedupCount;
+        gDvm.gcHeap->stringDedupBytes += markContext->dedupBytes;
+        LOGD_GC("Deduplicated %zu strings, up to %zu bytes of char data "
+                "(%d distinct); %zu strings, %zuK so far\n",
+                markContext->dedupCount, markContext->dedupBytes,
+                dvmHashTableNumEntries(markContext->dedupStrings),
+                gDvm.gcHeap->stringDedupCount,
+                gDvm.gcHeap->stringDedupBytes / 1024);
+        dvmHashTableFree(markContext->dedupStrings);
+        dvmHashTableFree(markContext->dedupPinned);
+    }
+
     memset(markContext, 0, sizeof(*markContext));
 }
 
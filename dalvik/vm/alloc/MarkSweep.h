@@ -42,6 +42,14 @@ typedef struct {
     size_t numBitmaps;
     GcMarkStack stack;
     const void *finger;   // only used while scanning/recursing.
+
+    /* String deduplication state; dedupStrings is NULL unless
+     * gDvm.stringDedupGc is set.
+     */
+    HashTable *dedupStrings;  // canonical value arrays, keyed by content hash
+    HashTable *dedupPinned;   // JNI-pinned arrays, which must not change
+    size_t dedupCount;
+    size_t dedupBytes;
 } GcMarkContext;
 
 enum RefType {
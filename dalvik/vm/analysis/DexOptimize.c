@@ -51,13 +51,15 @@ typedef struct InlineSub {
 /* fwd */
 static int writeDependencies(int fd, u4 modWhen, u4 crc);
 static bool writeAuxData(int fd, const DexClassLookup* pClassLookup,\
-    const IndexMapSet* pIndexMapSet, const RegisterMapBuilder* pRegMapBuilder);
+    const DexStringHashes* pStringHashes, const IndexMapSet* pIndexMapSet,\
+    const RegisterMapBuilder* pRegMapBuilder);
 static void logFailedWrite(size_t expected, ssize_t actual, const char* msg,
     int err);
 static bool computeFileChecksum(int fd, off_t start, size_t length, u4* pSum);
 
 static bool rewriteDex(u1* addr, int len, bool doVerify, bool doOpt,\
-    u4* pHeaderFlags, DexClassLookup** ppClassLookup);
+    u4* pHeaderFlags, DexClassLookup** ppClassLookup,\
+    DexStringHashes** ppStringHashes);
 static void updateChecksum(u1* addr, int len, DexHeader* pHeader);
 static bool loadAllClasses(DvmDex* pDvmDex);
 static void optimizeLoadedClasses(DexFile* pDexFile);
@@ -512,6 +514,7 @@ bool dvmContinueOptimization(int fd, off_t dexOffset, long dexLength,
     const char* fileName, u4 modWhen, u4 crc, bool isBootstrap)
 {
     DexClassLookup* pClassLookup = NULL;
+    DexStringHashes* pStringHashes = NULL;
     IndexMapSet* pIndexMapSet = NULL;
     RegisterMapBuilder* pRegMapBuilder = NULL;
     bool doVerify, doOpt;
@@ -579,11 +582,12 @@ bool dvmContinueOptimization(int fd, off_t dexOffset, long dexLength,
          * In practice this would be annoying to deal with, so the file
          * layout is designed so that it can always be rewritten in place.
          *
-         * This sets "headerFlags" and creates the class lookup table as
-         * part of doing the processing.
+         * This sets "headerFlags" and creates the class lookup and string
+         * hash tables as part of doing the processing.
          */
         success = rewriteDex(((u1*) mapAddr) + dexOffset, dexLength,
-                    doVerify, doOpt, &headerFlags, &pClassLookup);
+                    doVerify, doOpt, &headerFlags, &pClassLookup,
+                    &pStringHashes);
 
         if (success) {
             DvmDex* pDvmDex = NULL;
@@ -684,7 +688,9 @@ bool dvmContinueOptimization(int fd, off_t dexOffset, long dexLength,
     /*
      * Append any auxillary pre-computed data structures.
      */
-    if (!writeAuxData(fd, pClassLookup, pIndexMapSet, pRegMapBuilder)) {
+    if (!writeAuxData(fd, pClassLookup, pStringHashes, pIndexMapSet,
+            pRegMapBuilder))
+    {
         LOGW("Failed writing aux data\n");
         goto bail;
     }
@@ -734,6 +740,7 @@ bail:
     dvmFreeIndexMapSet(pIndexMapSet);
     dvmFreeRegisterMapBuilder(pRegMapBuilder);
     free(pClassLookup);
+    free(pStringHashes);
     return result;
 }
 
@@ -1125,7 +1132,8 @@ static bool writeChunk(int fd, u4 type, const void* data, size_t size)
  * so it can be used directly when the file is mapped for reading.
  */
 static bool writeAuxData(int fd, const DexClassLookup* pClassLookup,
-    const IndexMapSet* pIndexMapSet, const RegisterMapBuilder* pRegMapBuilder)
+    const DexStringHashes* pStringHashes, const IndexMapSet* pIndexMapSet,
+    const RegisterMapBuilder* pRegMapBuilder)
 {
     /* pre-computed class lookup hash table */
     if (!writeChunk(fd, (u4) kDexChunkClassLookup,
@@ -1134,6 +1142,15 @@ static bool writeAuxData(int fd, const DexClassLookup* pClassLookup,
         return false;
     }
 
+    /* pre-computed string hash codes (optional) */
+    if (pStringHashes != NULL) {
+        if (!writeChunk(fd, (u4) kDexChunkStringHashes,
+                pStringHashes, pStringHashes->size))
+        {
+            return false;
+        }
+    }
+
     /* remapped constants (optional) */
     if (pIndexMapSet != NULL) {
         if (!writeChunk(fd, pIndexMapSet->chunkType,
@@ -1223,7 +1240,8 @@ static bool computeFileChecksum(int fd, off_t start, size_t length, u4* pSum)
  * loading classes and allocating memory.
  */
 static bool rewriteDex(u1* addr, int len, bool doVerify, bool doOpt,
-    u4* pHeaderFlags, DexClassLookup** ppClassLookup)
+    u4* pHeaderFlags, DexClassLookup** ppClassLookup,
+    DexStringHashes** ppStringHashes)
 {
     u8 prepWhen, loadWhen, verifyWhen, optWhen;
     DvmDex* pDvmDex = NULL;
@@ -1254,6 +1272,14 @@ static bool rewriteDex(u1* addr, int len, bool doVerify, bool doOpt,
     if (*ppClassLookup == NULL)
         goto bail;
 
+    /*
+     * Hash the string constants, so resolving one can go straight to the
+     * intern table.
+     */
+    *ppStringHashes = dexCreateStringHashes(pDvmDex->pDexFile);
+    if (*ppStringHashes == NULL)
+        goto bail;
+
     /*
      * Bail out early if they don't want The Works.  The current implementation
      * doesn't fork a new process if this flag isn't set, so we really don't
@@ -1450,7 +1476,10 @@ static InlineSub* createInlineSubsTable(void)
                     ops[i].classDescriptor, ops[i].methodName,
                     ops[i].methodSignature);
             } else {
-                if (!dvmIsFinalClass(clazz) && !dvmIsFinalMethod(method)) {
+                /* static methods can't be overridden, so they're fine */
+                if (!dvmIsFinalClass(clazz) && !dvmIsFinalMethod(method) &&
+                    !dvmIsStaticMethod(method))
+                {
                     LOGW("DexOpt: WARNING: inline op on non-final class/method "
                          "%s.%s\n",
                         clazz->descriptor, method->name);
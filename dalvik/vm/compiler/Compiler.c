@@ -174,6 +174,10 @@ bool dvmCompilerSetupCodeCache(void)
     gDvmJit.templateSize = templateSize;
     gDvmJit.codeCacheByteUsed = templateSize;
 
+#if defined(WITH_PROFILER)
+    dvmPerfMapAddCode(gDvmJit.codeCache, templateSize, "dvmCompilerTemplates");
+#endif
+
     /* Only flush the part in the code cache that is being used now */
     cacheflush((intptr_t) gDvmJit.codeCache,
                (intptr_t) gDvmJit.codeCache + templateSize, 0);
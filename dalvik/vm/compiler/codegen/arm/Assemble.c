@@ -1317,6 +1317,16 @@ void dvmCompilerAssembleLIR(CompilationUnit *cUnit, JitTranslationInfo *info)
     /* If applicable, mark low bit to denote thumb */
     if (info->instructionSet != DALVIK_JIT_ARM)
         info->codeAddress = (char*)info->codeAddress + 1;
+
+#if defined(WITH_PROFILER)
+    /* name the trace for native profilers */
+    if (gDvm.perfCodeFile != NULL) {
+        dvmPerfMapAddCode(cUnit->baseAddr, offset, "jit:%s.%s@%#x",
+            cUnit->method->clazz->descriptor, cUnit->method->name,
+            (cUnit->traceDesc != NULL) ?
+                cUnit->traceDesc->trace[0].frag.startOffset : 0);
+    }
+#endif
 }
 
 /*
@@ -2950,63 +2950,6 @@ static bool handleFmt35ms_3rms(CompilationUnit *cUnit, MIR *mir,
     return false;
 }
 
-/*
- * This operation is complex enough that we'll do it partly inline
- * and partly with a handler.  NOTE: the handler uses hardcoded
- * values for string object offsets and must be revisitied if the
- * layout changes.
- */
-static bool genInlinedCompareTo(CompilationUnit *cUnit, MIR *mir)
-{
-#if defined(USE_GLOBAL_STRING_DEFS)
-    return false;
-#else
-    ArmLIR *rollback;
-    RegLocation rlThis = dvmCompilerGetSrc(cUnit, mir, 0);
-    RegLocation rlComp = dvmCompilerGetSrc(cUnit, mir, 1);
-
-    loadValueDirectFixed(cUnit, rlThis, r0);
-    loadValueDirectFixed(cUnit, rlComp, r1);
-    /* Test objects for NULL */
-    rollback = genNullCheck(cUnit, rlThis.sRegLow, r0, mir->offset, NULL);
-    genNullCheck(cUnit, rlComp.sRegLow, r1, mir->offset, rollback);
-    /*
-     * TUNING: we could check for object pointer equality before invoking
-     * handler. Unclear whether the gain would be worth the added code size
-     * expansion.
-     */
-    genDispatchToHandler(cUnit, TEMPLATE_STRING_COMPARETO);
-    storeValue(cUnit, inlinedTarget(cUnit, mir, false),
-               dvmCompilerGetReturn(cUnit));
-    return true;
-#endif
-}
-
-static bool genInlinedIndexOf(CompilationUnit *cUnit, MIR *mir, bool singleI)
-{
-#if defined(USE_GLOBAL_STRING_DEFS)
-    return false;
-#else
-    RegLocation rlThis = dvmCompilerGetSrc(cUnit, mir, 0);
-    RegLocation rlChar = dvmCompilerGetSrc(cUnit, mir, 1);
-
-    loadValueDirectFixed(cUnit, rlThis, r0);
-    loadValueDirectFixed(cUnit, rlChar, r1);
-    if (!singleI) {
-        RegLocation rlStart = dvmCompilerGetSrc(cUnit, mir, 2);
-        loadValueDirectFixed(cUnit, rlStart, r2);
-    } else {
-        loadConstant(cUnit, r2, 0);
-    }
-    /* Test objects for NULL */
-    genNullCheck(cUnit, rlThis.sRegLow, r0, mir->offset, NULL);
-    genDispatchToHandler(cUnit, TEMPLATE_STRING_INDEXOF);
-    storeValue(cUnit, inlinedTarget(cUnit, mir, false),
-               dvmCompilerGetReturn(cUnit));
-    return true;
-#endif
-}
-
 static bool genInlinedStringLength(CompilationUnit *cUnit, MIR *mir)
 {
     RegLocation rlObj = dvmCompilerGetSrc(cUnit, mir, 0);
@@ -3032,17 +2975,32 @@ static bool genInlinedStringCharAt(CompilationUnit *cUnit, MIR *mir)
     int regMax = dvmCompilerAllocTemp(cUnit);
     int regOff = dvmCompilerAllocTemp(cUnit);
     int regPtr = dvmCompilerAllocTemp(cUnit);
+    int regCoder = dvmCompilerAllocTemp(cUnit);
     ArmLIR *pcrLabel = genNullCheck(cUnit, rlObj.sRegLow, rlObj.lowReg,
                                     mir->offset, NULL);
     loadWordDisp(cUnit, rlObj.lowReg, gDvm.offJavaLangString_count, regMax);
     loadWordDisp(cUnit, rlObj.lowReg, gDvm.offJavaLangString_offset, regOff);
     loadWordDisp(cUnit, rlObj.lowReg, gDvm.offJavaLangString_value, regPtr);
+    loadWordDisp(cUnit, rlObj.lowReg, gDvm.offJavaLangString_coder,
+                 regCoder);
     genBoundsCheck(cUnit, rlIdx.lowReg, regMax, mir->offset, pcrLabel);
     dvmCompilerFreeTemp(cUnit, regMax);
     opRegImm(cUnit, kOpAdd, regPtr, contents);
     opRegReg(cUnit, kOpAdd, regOff, rlIdx.lowReg);
     rlResult = dvmCompilerEvalLoc(cUnit, rlDest, kCoreReg, true);
+    /* a Latin-1 String has a byte[] value, a UTF-16 one a char[] */
+    opRegImm(cUnit, kOpCmp, regCoder, STRING_CODER_LATIN1);
+    ArmLIR *branchUtf16 = opCondBranch(cUnit, kArmCondNe);
+    loadBaseIndexed(cUnit, regPtr, regOff, rlResult.lowReg, 0, kUnsignedByte);
+    ArmLIR *branchDone = genUnconditionalBranch(cUnit, NULL);
+    ArmLIR *utf16Label = newLIR0(cUnit, kArmPseudoTargetLabel);
+    utf16Label->defMask = ENCODE_ALL;
+    branchUtf16->generic.target = (LIR *) utf16Label;
     loadBaseIndexed(cUnit, regPtr, regOff, rlResult.lowReg, 1, kUnsignedHalf);
+    ArmLIR *doneLabel = newLIR0(cUnit, kArmPseudoTargetLabel);
+    doneLabel->defMask = ENCODE_ALL;
+    branchDone->generic.target = (LIR *) doneLabel;
+    dvmCompilerFreeTemp(cUnit, regCoder);
     storeValue(cUnit, rlDest, rlResult);
     return false;
 }
@@ -3134,24 +3092,36 @@ static bool handleExecuteInline(CompilationUnit *cUnit, MIR *mir)
                         return false;
                     else
                         break;
+                /*
+                 * The STRING_COMPARETO and STRING_INDEXOF templates only
+                 * know about char[] values, so these go to the C routines,
+                 * which handle Latin-1 Strings too.
+                 */
                 case INLINE_STRING_COMPARETO:
-                    if (genInlinedCompareTo(cUnit, mir))
-                        return false;
-                    else
-                        break;
                 case INLINE_STRING_INDEXOF_I:
-                    if (genInlinedIndexOf(cUnit, mir, true /* I */))
-                        return false;
-                    else
-                        break;
                 case INLINE_STRING_INDEXOF_II:
-                    if (genInlinedIndexOf(cUnit, mir, false /* I */))
-                        return false;
-                    else
-                        break;
                 case INLINE_STRING_EQUALS:
                 case INLINE_MATH_COS:
                 case INLINE_MATH_SIN:
+                case INLINE_VMSTACK_GETCALLINGCLASSLOADER:
+                case INLINE_VMSTACK_GETCALLINGCLASSLOADER2:
+                case INLINE_VMSTACK_GETSTACKCLASS2:
+                case INLINE_STRING_INDEXOF_STRING:
+                case INLINE_STRING_INDEXOF_STRING_I:
+                case INLINE_STRING_LASTINDEXOF_I:
+                case INLINE_STRING_LASTINDEXOF_II:
+                case INLINE_STRING_HASHCODE:
+                case INLINE_STRING_EQUALSIGNORECASE:
+                case INLINE_OBJECT_GETCLASS:
+                case INLINE_THREAD_CURRENTTHREAD:
+                case INLINE_SYSTEM_IDENTITYHASHCODE:
+                case INLINE_SYSTEM_NANOTIME:
+                case INLINE_FLOAT_FLOATTOINTBITS:
+                case INLINE_FLOAT_FLOATTORAWINTBITS:
+                case INLINE_FLOAT_INTBITSTOFLOAT:
+                case INLINE_DOUBLE_DOUBLETOLONGBITS:
+                case INLINE_DOUBLE_DOUBLETORAWLONGBITS:
+                case INLINE_DOUBLE_LONGBITSTODOUBLE:
                     break;   /* Handle with C routine */
                 default:
                     dvmCompilerAbort(cUnit);
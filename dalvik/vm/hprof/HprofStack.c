@@ -56,28 +56,27 @@ hprofStartup_Stack()
     return 0;
 }
 
+/*
+ * If the 'live' bit is 0, the trace is not in use by any current
+ * heap object and may be destroyed.
+ */
+static int
+removeDeadStackTrace(void *data)
+{
+    StackTraceEntry *stackTraceEntry = (StackTraceEntry *) data;
+
+    if (!stackTraceEntry->live) {
+        free(stackTraceEntry);
+        return 1;
+    }
+    return 0;
+}
+
 int
 hprofShutdown_Stack()
 {
-    HashIter iter;
-
     /* This will be called when a GC has completed. */
-    for (dvmHashIterBegin(gStackTraceHashTable, &iter);
-         !dvmHashIterDone(&iter);
-         dvmHashIterNext(&iter)) {
-        StackTraceEntry *stackTraceEntry;
-
-        /*
-         * If the 'live' bit is 0, the trace is not in use by any current
-         * heap object and may be destroyed.
-         */
-        stackTraceEntry = (StackTraceEntry *) dvmHashIterData(&iter);
-        if (!stackTraceEntry->live) {
-            dvmHashTableRemove(gStackTraceHashTable,
-                    computeStackTraceHash(stackTraceEntry), stackTraceEntry);
-            free(stackTraceEntry);
-        }
-    }
+    dvmHashForeachRemove(gStackTraceHashTable, removeDeadStackTrace);
 
     return 0;
 }
@@ -80,29 +80,27 @@ hprofStartup_StackFrame()
     return 0;
 }
 
+/*
+ * If the 'live' bit is 0, the frame is not in use by any current
+ * heap object and may be destroyed.
+ */
+static int
+removeDeadStackFrame(void *data)
+{
+    StackFrameEntry *stackFrameEntry = (StackFrameEntry *) data;
+
+    if (!stackFrameEntry->live) {
+        free(stackFrameEntry);
+        return 1;
+    }
+    return 0;
+}
+
 int
 hprofShutdown_StackFrame()
 {
-    HashIter iter;
-
     /* This will be called when a GC has completed. */
-    for (dvmHashIterBegin(gStackFrameHashTable, &iter);
-         !dvmHashIterDone(&iter);
-         dvmHashIterNext(&iter)) {
-        const StackFrameEntry *stackFrameEntry;
-
-        /*
-         * If the 'live' bit is 0, the frame is not in use by any current
-         * heap object and may be destroyed.
-         */
-        stackFrameEntry = (const StackFrameEntry *) dvmHashIterData(&iter);
-        if (!stackFrameEntry->live) {
-            dvmHashTableRemove(gStackFrameHashTable,
-                    computeStackFrameHash(stackFrameEntry),
-                    (void*) stackFrameEntry);
-            free((void*) stackFrameEntry);
-        }
-    }
+    dvmHashForeachRemove(gStackFrameHashTable, removeDeadStackFrame);
 
     return 0;
 }
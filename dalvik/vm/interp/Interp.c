@@ -1324,6 +1324,16 @@ void dvmInterpret(Thread* self, const Method* method, JValue* pResult)
     interpState.pc = method->insns;
     interpState.entryPoint = kInterpEntryInstr;
 
+#if defined(WITH_PROFILER)
+    if (gDvm.perfShadow) {
+        interpState.perfShadow.magic = kPerfShadowMagic;
+        interpState.perfShadow.depth = 1;
+        interpState.perfShadow.valid = 1;
+        interpState.perfShadow.method[0] = (uintptr_t) method;
+        interpState.perfShadow.relPc[0] = 0;
+    }
+#endif
+
     if (dvmDebuggerOrProfilerActive())
         interpState.nextMode = INTERP_DBG;
     else
@@ -1381,4 +1391,9 @@ void dvmInterpret(Thread* self, const Method* method, JValue* pResult)
 #if defined(WITH_JIT)
     dvmJitCalleeRestore(interpState.calleeSave);
 #endif
+#if defined(WITH_PROFILER)
+    /* don't leave a stale shadow where a later frame might not overwrite it */
+    if (gDvm.perfShadow)
+        *(volatile uint64_t*) &interpState.perfShadow.magic = 0;
+#endif
 }
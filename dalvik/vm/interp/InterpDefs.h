@@ -182,6 +182,10 @@ typedef struct InterpState {
     double calleeSave[JIT_CALLEE_SAVE_DOUBLE_COUNT];
 #endif
 
+#if defined(WITH_PROFILER)
+    PerfShadow  perfShadow;             // for -Xperfshadow; see PerfMap.h
+#endif
+
 } InterpState;
 
 /*
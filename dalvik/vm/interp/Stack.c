@@ -351,6 +351,19 @@ static bool dvmPopFrame(Thread* self)
     return true;
 }
 
+/*
+ * Check reflective access from "accessFrom" to "method".  The answer never
+ * changes for a given pair, so we remember it.
+ */
+static bool checkReflectMethodAccess(Thread* self,
+    const ClassObject* accessFrom, const Method* method)
+{
+#define ATOMIC_CACHE_CALC dvmCheckMethodAccess(accessFrom, method)
+    return ATOMIC_CACHE_LOOKUP_SELF(self, gDvm.reflectAccessCache,
+                accessFrom, method) != 0;
+#undef ATOMIC_CACHE_CALC
+}
+
 /*
  * Common code for dvmCallMethodV/A and dvmInvokeMethod.
  *
@@ -386,8 +399,8 @@ static ClassObject* callPrep(Thread* self, const Method* method, Object* obj,
 
     if (checkAccess) {
         /* needed for java.lang.reflect.Method.invoke */
-        if (!dvmCheckMethodAccess(dvmGetCaller2Class(self->curFrame),
-                method))
+        if (!checkReflectMethodAccess(self,
+                dvmGetCaller2Class(self->curFrame), method))
         {
             /* note this throws IAException, not IAError */
             dvmThrowException("Ljava/lang/IllegalAccessException;",
@@ -542,6 +542,7 @@ GOTO_TARGET(returnFromMethod)
         /* update thread FP, and reset local variables */
         self->curFrame = fp;
         curMethod = SAVEAREA_FROM_FP(fp)->method;
+        PERF_SHADOW_POP(fp);
         //methodClass = curMethod->clazz;
         methodClassDex = curMethod->clazz->pDvmDex;
         pc = saveArea->savedPc;
@@ -694,6 +695,7 @@ GOTO_TARGET(exceptionThrown)
          */
         //fp = (u4*) self->curFrame;
         curMethod = SAVEAREA_FROM_FP(fp)->method;
+        PERF_SHADOW_RESET(fp);
         //methodClass = curMethod->clazz;
         methodClassDex = curMethod->clazz->pDvmDex;
         pc = curMethod->insns + catchRelPc;
@@ -868,6 +870,7 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
              * "Call" interpreted code.  Reposition the PC, update the
              * frame pointer and other local state, and continue.
              */
+            PERF_SHADOW_PUSH(methodToCall);
             curMethod = methodToCall;
             methodClassDex = curMethod->clazz->pDvmDex;
             pc = methodToCall->insns;
@@ -917,7 +920,9 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
              * space for locals on native calls, "newFp" points directly
              * to the method arguments.
              */
+            PERF_SHADOW_PUSH(methodToCall);
             (*methodToCall->nativeFunc)(newFp, &retval, methodToCall, self);
+            PERF_SHADOW_POP(fp);
 
 #if (INTERP_TYPE == INTERP_DBG) && defined(WITH_DEBUGGER)
             if (gDvm.debuggerActive) {
@@ -31,7 +31,7 @@ INLINE Method* dvmFindInterfaceMethodInCache(ClassObject* thisClass,
     dvmInterpFindInterfaceMethod(thisClass, methodIdx, method, methodClassDex)
 
     return (Method*) ATOMIC_CACHE_LOOKUP(methodClassDex->pInterfaceCache,
-                DEX_INTERFACE_CACHE_SIZE, thisClass, methodIdx);
+                thisClass, methodIdx);
 
 #undef ATOMIC_CACHE_CALC
 }
@@ -189,14 +189,14 @@ MTERP_OFFSET(offShadowSpace_interpState, ShadowSpace, interpState, 24)
 
 /* InstField fields */
 #ifdef PROFILE_FIELD_ACCESS
-MTERP_OFFSET(offInstField_byteOffset,   InstField, byteOffset, 24)
+MTERP_OFFSET(offInstField_byteOffset,   InstField, byteOffset, 32)
 #else
 MTERP_OFFSET(offInstField_byteOffset,   InstField, byteOffset, 16)
 #endif
 
 /* StaticField fields */
 #ifdef PROFILE_FIELD_ACCESS
-MTERP_OFFSET(offStaticField_value,      StaticField, value, 24)
+MTERP_OFFSET(offStaticField_value,      StaticField, value, 32)
 #else
 MTERP_OFFSET(offStaticField_value,      StaticField, value, 16)
 #endif
@@ -256,9 +256,10 @@ MTERP_OFFSET(offArrayObject_contents,   ArrayObject, contents, 12)
 
 /* String fields */
 MTERP_CONSTANT(STRING_FIELDOFF_VALUE,     8)
-MTERP_CONSTANT(STRING_FIELDOFF_HASHCODE, 12)
-MTERP_CONSTANT(STRING_FIELDOFF_OFFSET,   16)
-MTERP_CONSTANT(STRING_FIELDOFF_COUNT,    20)
+MTERP_CONSTANT(STRING_FIELDOFF_COUNT,    12)
+MTERP_CONSTANT(STRING_FIELDOFF_HASHCODE, 16)
+MTERP_CONSTANT(STRING_FIELDOFF_OFFSET,   20)
+MTERP_CONSTANT(STRING_FIELDOFF_CODER,    24)
 
 #if defined(WITH_JIT)
 /*
@@ -36,6 +36,9 @@
 #define self                    glue->self
 #define debugTrackedRefStart    glue->debugTrackedRefStart
 
+/* the activation's frame shadow, for PERF_SHADOW_PUSH and friends */
+#define PERF_SHADOW (&glue->perfShadow)
+
 /* ugh */
 #define STUB_HACK(x) x
 
@@ -83,11 +83,19 @@
 
 /*
  * Keep a tally of accesses to fields.  Currently only works if full DEX
- * optimization is disabled.
+ * optimization is disabled.  For puts we also count changes of writing
+ * thread, which is what the -Xfieldlayout profile uses to spot contended
+ * fields.
  */
 #ifdef PROFILE_FIELD_ACCESS
 # define UPDATE_FIELD_GET(_field) { (_field)->gets++; }
-# define UPDATE_FIELD_PUT(_field) { (_field)->puts++; }
+# define UPDATE_FIELD_PUT(_field) {                                         \
+        (_field)->puts++;                                                   \
+        if ((_field)->lastPutter != self->threadId) {                       \
+            (_field)->lastPutter = self->threadId;                          \
+            (_field)->putSwitches++;                                        \
+        }                                                                   \
+    }
 #else
 # define UPDATE_FIELD_GET(_field) ((void)0)
 # define UPDATE_FIELD_PUT(_field) ((void)0)
@@ -353,6 +361,45 @@ static inline void putDoubleToArray(u4* ptr, int idx, double dval)
 # define NEED_INTERP_SWITCH(_current) (false)
 #endif
 
+/*
+ * Keep the -Xperfshadow copy of this activation's Java frames current
+ * (see PerfMap.h).  "PERF_SHADOW" is defined by the stubs; it's the
+ * activation's PerfShadow.
+ *
+ * Push when "curMethod" calls "_method" at "pc"; pop after returning into
+ * the frame at "_fp".
+ */
+#if defined(WITH_PROFILER)
+# define PERF_SHADOW_PUSH(_method) {                                        \
+        if (gDvm.perfShadow) {                                              \
+            PerfShadow* _shadow = PERF_SHADOW;                              \
+            _shadow->relPc[(_shadow->depth - 1) & (kPerfShadowFrames-1)] =  \
+                pc - curMethod->insns;                                      \
+            _shadow->method[_shadow->depth & (kPerfShadowFrames-1)] =       \
+                (uintptr_t) (_method);                                      \
+            _shadow->depth++;                                               \
+            if (_shadow->valid < kPerfShadowFrames)                         \
+                _shadow->valid++;                                           \
+        }                                                                   \
+    }
+# define PERF_SHADOW_POP(_fp) {                                             \
+        if (gDvm.perfShadow) {                                              \
+            PerfShadow* _shadow = PERF_SHADOW;                              \
+            _shadow->depth--;                                               \
+            if (--_shadow->valid == 0 && _shadow->depth != 0)               \
+                dvmPerfShadowRefill(_shadow, (_fp), false);                 \
+        }                                                                   \
+    }
+# define PERF_SHADOW_RESET(_fp) {                                           \
+        if (gDvm.perfShadow)                                                \
+            dvmPerfShadowRefill(PERF_SHADOW, (_fp), true);                  \
+    }
+#else
+# define PERF_SHADOW_PUSH(_method)  ((void)0)
+# define PERF_SHADOW_POP(_fp)       ((void)0)
+# define PERF_SHADOW_RESET(_fp)     ((void)0)
+#endif
+
 /*
  * Check to see if "obj" is NULL.  If so, throw an exception.  Assumes the
  * pc has already been exported to the stack.
@@ -456,6 +503,9 @@ static inline bool checkForNullExportPC(Object* obj, u4* fp, const u2* pc)
 #define self                    glue->self
 #define debugTrackedRefStart    glue->debugTrackedRefStart
 
+/* the activation's frame shadow, for PERF_SHADOW_PUSH and friends */
+#define PERF_SHADOW (&glue->perfShadow)
+
 /* ugh */
 #define STUB_HACK(x) x
 
@@ -3651,6 +3701,7 @@ GOTO_TARGET(returnFromMethod)
         /* update thread FP, and reset local variables */
         self->curFrame = fp;
         curMethod = SAVEAREA_FROM_FP(fp)->method;
+        PERF_SHADOW_POP(fp);
         //methodClass = curMethod->clazz;
         methodClassDex = curMethod->clazz->pDvmDex;
         pc = saveArea->savedPc;
@@ -3803,6 +3854,7 @@ GOTO_TARGET(exceptionThrown)
          */
         //fp = (u4*) self->curFrame;
         curMethod = SAVEAREA_FROM_FP(fp)->method;
+        PERF_SHADOW_RESET(fp);
         //methodClass = curMethod->clazz;
         methodClassDex = curMethod->clazz->pDvmDex;
         pc = curMethod->insns + catchRelPc;
@@ -3977,6 +4029,7 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
              * "Call" interpreted code.  Reposition the PC, update the
              * frame pointer and other local state, and continue.
              */
+            PERF_SHADOW_PUSH(methodToCall);
             curMethod = methodToCall;
             methodClassDex = curMethod->clazz->pDvmDex;
             pc = methodToCall->insns;
@@ -4026,7 +4079,9 @@ GOTO_TARGET(invokeMethod, bool methodCallRange, const Method* _methodToCall,
              * space for locals on native calls, "newFp" points directly
              * to the method arguments.
              */
+            PERF_SHADOW_PUSH(methodToCall);
             (*methodToCall->nativeFunc)(newFp, &retval, methodToCall, self);
+            PERF_SHADOW_POP(fp);
 
 #if (INTERP_TYPE == INTERP_DBG) && defined(WITH_DEBUGGER)
             if (gDvm.debuggerActive) {
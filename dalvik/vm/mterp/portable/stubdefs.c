@@ -73,6 +73,9 @@
 #define GOTO_bail() goto bail;
 #define GOTO_bail_switch() goto bail_switch;
 
+/* the activation's frame shadow, for PERF_SHADOW_PUSH and friends */
+#define PERF_SHADOW (&interpState->perfShadow)
+
 /*
  * Periodically check for thread suspension.
  *
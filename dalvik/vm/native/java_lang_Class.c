@@ -714,6 +714,20 @@ static void Dalvik_java_lang_Class_getDeclaredAnnotations(const u4* args,
     RETURN_PTR(annos);
 }
 
+/*
+ * private boolean isDeclaredAnnotationPresent(Class annotationClass)
+ *
+ * Returns true if the annotation is declared on this class.
+ */
+static void Dalvik_java_lang_Class_isDeclaredAnnotationPresent(const u4* args,
+    JValue* pResult)
+{
+    ClassObject* clazz = (ClassObject*) args[0];
+    ClassObject* annoClazz = (ClassObject*) args[1];
+
+    RETURN_BOOLEAN(dvmIsClassAnnotationPresent(clazz, annoClazz));
+}
+
 /*
  * public String getInnerClassName()
  *
@@ -804,6 +818,8 @@ const DalvikNativeMethod dvm_java_lang_Class[] = {
         Dalvik_java_lang_Class_isAnonymousClass },
     { "getDeclaredAnnotations", "()[Ljava/lang/annotation/Annotation;",
         Dalvik_java_lang_Class_getDeclaredAnnotations },
+    { "isDeclaredAnnotationPresent", "(Ljava/lang/Class;)Z",
+        Dalvik_java_lang_Class_isDeclaredAnnotationPresent },
     { "getInnerClassName",       "()Ljava/lang/String;",
         Dalvik_java_lang_Class_getInnerClassName },
     { "setAccessibleNoCheck",   "(Ljava/lang/reflect/AccessibleObject;Z)V",
@@ -21,6 +21,71 @@
 #include "native/InternalNativePriv.h"
 
 
+/*
+ * Copies shorter than this many bytes are done with simple loops.  For
+ * those, the call into memmove() costs more than the copy itself, and
+ * ArrayList/StringBuilder do a lot of them.  Longer copies go to the
+ * C library, which already has wide and cache-bypassing loops for big
+ * blocks.
+ */
+#define kShortCopyBytes 64
+
+/*
+ * Copy a short run of "count" elements of the given width.  The regions
+ * may overlap, so we pick the direction that won't smear the data.
+ */
+#define SHORT_COPY(_type, _dst, _src, _count)                               \
+    do {                                                                    \
+        _type* dp = (_type*) (_dst);                                        \
+        const _type* sp = (const _type*) (_src);                            \
+        int n = (_count);                                                   \
+        if (dp <= sp || dp >= sp + n) {                                     \
+            while (n--)                                                     \
+                *dp++ = *sp++;                                              \
+        } else {                                                            \
+            while (n--)                                                     \
+                dp[n] = sp[n];                                              \
+        }                                                                   \
+    } while (false)
+
+/*
+ * Copy "count" elements of "width" bytes from "src" to "dst".  Set
+ * "mayOverlap" if the source and destination are in the same array.
+ */
+static inline void copyElements(void* dst, const void* src, int width,
+    int count, bool mayOverlap)
+{
+    size_t bytes = (size_t) count * width;
+
+    if (bytes < kShortCopyBytes) {
+        switch (width) {
+        case 1:     SHORT_COPY(u1, dst, src, count);   break;
+        case 2:     SHORT_COPY(u2, dst, src, count);   break;
+        case 4:     SHORT_COPY(u4, dst, src, count);   break;
+        case 8:     SHORT_COPY(u8, dst, src, count);   break;
+        default:    memmove(dst, src, bytes);          break;
+        }
+    } else if (mayOverlap) {
+        memmove(dst, src, bytes);
+    } else {
+        memcpy(dst, src, bytes);
+    }
+}
+
+/*
+ * Returns "true" if an object of class "objClass" may be stored in an
+ * array of class "arrayClass".  For the common one-dimensional case this
+ * is a plain instanceof against the element class, which goes through
+ * the instanceof cache, so each class pair is only worked out once.
+ */
+static inline bool canStoreElement(ClassObject* objClass,
+    ClassObject* arrayClass)
+{
+    if (arrayClass->arrayDim == 1)
+        return dvmInstanceof(objClass, arrayClass->elementClass);
+    return dvmCanPutArrayElement(objClass, arrayClass);
+}
+
 /*
  * public static void arraycopy(Object src, int srcPos, Object dest,
  *      int destPos, int length)
@@ -30,7 +95,6 @@
  */
 static void Dalvik_java_lang_System_arraycopy(const u4* args, JValue* pResult)
 {
-    void* (*copyFunc)(void *dest, const void *src, size_t n);
     ArrayObject* srcArray;
     ArrayObject* dstArray;
     ClassObject* srcClass;
@@ -38,6 +102,7 @@ static void Dalvik_java_lang_System_arraycopy(const u4* args, JValue* pResult)
     int srcPos, dstPos, length;
     char srcType, dstType;
     bool srcPrim, dstPrim;
+    bool mayOverlap;
 
     srcArray = (ArrayObject*) args[0];
     srcPos = args[1];
@@ -45,10 +110,7 @@ static void Dalvik_java_lang_System_arraycopy(const u4* args, JValue* pResult)
     dstPos = args[3];
     length = args[4];
 
-    if (srcArray == dstArray)
-        copyFunc = memmove;         /* might overlap */
-    else
-        copyFunc = memcpy;          /* can't overlap, use faster func */
+    mayOverlap = (srcArray == dstArray);
 
     /* check for null or bad pointer */
     if (!dvmValidateObject((Object*)srcArray) ||
@@ -74,23 +136,14 @@ static void Dalvik_java_lang_System_arraycopy(const u4* args, JValue* pResult)
 
     srcClass = srcArray->obj.clazz;
     dstClass = dstArray->obj.clazz;
-    srcType = srcClass->descriptor[1];
-    dstType = dstClass->descriptor[1];
 
     /*
-     * If one of the arrays holds a primitive type, the other array must
-     * hold the same type.
+     * Same array class (this includes copies within one array): no type
+     * checks needed, for primitives or references.
      */
-    srcPrim = (srcType != '[' && srcType != 'L');
-    dstPrim = (dstType != '[' && dstType != 'L');
-    if (srcPrim || dstPrim) {
+    if (srcClass == dstClass) {
         int width;
 
-        if (srcPrim != dstPrim || srcType != dstType) {
-            dvmThrowException("Ljava/lang/ArrayStoreException;", NULL);
-            RETURN_VOID();
-        }
-
         switch (srcClass->descriptor[1]) {
         case 'B':
         case 'Z':
@@ -108,6 +161,10 @@ static void Dalvik_java_lang_System_arraycopy(const u4* args, JValue* pResult)
         case 'J':
             width = 8;
             break;
+        case '[':
+        case 'L':
+            width = sizeof(Object*);
+            break;
         default:        /* 'V' or something weird */
             LOGE("Weird array type '%s'\n", srcClass->descriptor);
             assert(false);
@@ -115,13 +172,28 @@ static void Dalvik_java_lang_System_arraycopy(const u4* args, JValue* pResult)
             break;
         }
 
-        if (false) LOGVV("arraycopy prim dst=%p %d src=%p %d len=%d\n",
+        if (false) LOGVV("arraycopy same dst=%p %d src=%p %d len=%d\n",
                 dstArray->contents, dstPos * width,
                 srcArray->contents, srcPos * width,
                 length * width);
-        (*copyFunc)((u1*)dstArray->contents + dstPos * width,
+        copyElements((u1*)dstArray->contents + dstPos * width,
                 (const u1*)srcArray->contents + srcPos * width,
-                length * width);
+                width, length, mayOverlap);
+        RETURN_VOID();
+    }
+
+    srcType = srcClass->descriptor[1];
+    dstType = dstClass->descriptor[1];
+
+    /*
+     * If one of the arrays holds a primitive type, the other array must
+     * hold the same type.  Since the classes differ, they can't.
+     */
+    srcPrim = (srcType != '[' && srcType != 'L');
+    dstPrim = (dstType != '[' && dstType != 'L');
+    if (srcPrim || dstPrim) {
+        dvmThrowException("Ljava/lang/ArrayStoreException;", NULL);
+        RETURN_VOID();
     } else {
         /*
          * Neither class is primitive.  See if elements in "src" are instances
@@ -140,9 +212,9 @@ static void Dalvik_java_lang_System_arraycopy(const u4* args, JValue* pResult)
                 dstArray->contents, dstPos * width,
                 srcArray->contents, srcPos * width,
                 length * width);
-            (*copyFunc)((u1*)dstArray->contents + dstPos * width,
+            copyElements((u1*)dstArray->contents + dstPos * width,
                     (const u1*)srcArray->contents + srcPos * width,
-                    length * width);
+                    width, length, mayOverlap);
         } else {
             /*
              * The arrays are not fundamentally compatible.  However, we may
@@ -155,40 +227,35 @@ static void Dalvik_java_lang_System_arraycopy(const u4* args, JValue* pResult)
              * compare the types and count up how many we can move, then call
              * memmove() to shift the actual data.  If we just start from the
              * front we could do a smear rather than a move.
+             *
+             * Runs of elements usually share a class, so we remember the
+             * last class that passed and only check again when it changes.
              */
             Object** srcObj;
-            Object** dstObj;
             int copyCount;
-            ClassObject*   clazz = NULL;
+            ClassObject* clazz = NULL;
 
             srcObj = ((Object**) srcArray->contents) + srcPos;
-            dstObj = ((Object**) dstArray->contents) + dstPos;
-
-            if (length > 0 && srcObj[0] != NULL)
-            {
-                clazz = srcObj[0]->clazz;
-                if (!dvmCanPutArrayElement(clazz, dstClass))
-                    clazz = NULL;
-            }
 
             for (copyCount = 0; copyCount < length; copyCount++)
             {
-                if (srcObj[copyCount] != NULL &&
-                    srcObj[copyCount]->clazz != clazz &&
-                    !dvmCanPutArrayElement(srcObj[copyCount]->clazz, dstClass))
-                {
+                Object* elem = srcObj[copyCount];
+                if (elem == NULL || elem->clazz == clazz)
+                    continue;
+                if (!canStoreElement(elem->clazz, dstClass)) {
                     /* can't put this element into the array */
                     break;
                 }
+                clazz = elem->clazz;
             }
 
             if (false) LOGVV("arraycopy iref dst=%p %d src=%p %d count=%d of %d\n",
                 dstArray->contents, dstPos * width,
                 srcArray->contents, srcPos * width,
                 copyCount, length);
-            (*copyFunc)((u1*)dstArray->contents + dstPos * width,
+            copyElements((u1*)dstArray->contents + dstPos * width,
                     (const u1*)srcArray->contents + srcPos * width,
-                    copyCount * width);
+                    width, copyCount, mayOverlap);
 
             if (copyCount != length) {
                 dvmThrowException("Ljava/lang/ArrayStoreException;", NULL);
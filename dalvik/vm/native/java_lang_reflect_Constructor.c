@@ -107,6 +107,27 @@ static void Dalvik_java_lang_reflect_Constructor_getDeclaredAnnotations(
     RETURN_PTR(annos);
 }
 
+/*
+ * private boolean isAnnotationPresent(Class declaringClass, int slot,
+ *     Class annotationType)
+ *
+ * Returns true if the annotation is declared on this constructor.
+ */
+static void Dalvik_java_lang_reflect_Constructor_isAnnotationPresent(
+    const u4* args, JValue* pResult)
+{
+    // ignore thisPtr in args[0]
+    ClassObject* declaringClass = (ClassObject*) args[1];
+    int slot = args[2];
+    ClassObject* annoClazz = (ClassObject*) args[3];
+    Method* meth;
+
+    meth = dvmSlotToMethod(declaringClass, slot);
+    assert(meth != NULL);
+
+    RETURN_BOOLEAN(dvmIsMethodAnnotationPresent(meth, annoClazz));
+}
+
 /*
  * public Annotation[][] getParameterAnnotations(Class declaringClass, int slot)
  *
@@ -156,6 +177,8 @@ const DalvikNativeMethod dvm_java_lang_reflect_Constructor[] = {
         Dalvik_java_lang_reflect_Constructor_getConstructorModifiers },
     { "getDeclaredAnnotations", "(Ljava/lang/Class;I)[Ljava/lang/annotation/Annotation;",
         Dalvik_java_lang_reflect_Constructor_getDeclaredAnnotations },
+    { "isAnnotationPresent", "(Ljava/lang/Class;ILjava/lang/Class;)Z",
+        Dalvik_java_lang_reflect_Constructor_isAnnotationPresent },
     { "getParameterAnnotations", "(Ljava/lang/Class;I)[[Ljava/lang/annotation/Annotation;",
         Dalvik_java_lang_reflect_Constructor_getParameterAnnotations },
     { "getSignatureAnnotation",  "(Ljava/lang/Class;I)[Ljava/lang/Object;",
@@ -379,6 +379,27 @@ static void Dalvik_java_lang_reflect_Field_getDeclaredAnnotations(
     RETURN_PTR(annos);
 }
 
+/*
+ * private boolean isAnnotationPresent(Class declaringClass, int slot,
+ *     Class annotationType)
+ *
+ * Returns true if the annotation is declared on this field.
+ */
+static void Dalvik_java_lang_reflect_Field_isAnnotationPresent(
+    const u4* args, JValue* pResult)
+{
+    // ignore thisPtr in args[0]
+    ClassObject* declaringClass = (ClassObject*) args[1];
+    int slot = args[2];
+    ClassObject* annoClazz = (ClassObject*) args[3];
+    Field* field;
+
+    field = dvmSlotToField(declaringClass, slot);
+    assert(field != NULL);
+
+    RETURN_BOOLEAN(dvmIsFieldAnnotationPresent(field, annoClazz));
+}
+
 /*
  * private Object[] getSignatureAnnotation()
  *
@@ -441,6 +462,8 @@ const DalvikNativeMethod dvm_java_lang_reflect_Field[] = {
         Dalvik_java_lang_reflect_Field_setPrimitiveField },
     { "getDeclaredAnnotations", "(Ljava/lang/Class;I)[Ljava/lang/annotation/Annotation;",
         Dalvik_java_lang_reflect_Field_getDeclaredAnnotations },
+    { "isAnnotationPresent", "(Ljava/lang/Class;ILjava/lang/Class;)Z",
+        Dalvik_java_lang_reflect_Field_isAnnotationPresent },
     { "getSignatureAnnotation",  "(Ljava/lang/Class;I)[Ljava/lang/Object;",
         Dalvik_java_lang_reflect_Field_getSignatureAnnotation },
     { NULL, NULL, NULL },
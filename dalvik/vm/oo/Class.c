@@ -2035,6 +2035,14 @@ static void freeMethodInnards(Method* meth)
         meth->registerMap = NULL;
     }
 
+    /*
+     * The decoded catch table is built lazily on the heap.
+     */
+    if (meth->catchTable != NULL) {
+        dvmFreeCatchTable(meth->catchTable);
+        meth->catchTable = NULL;
+    }
+
     /*
      * We may have copied the instructions.
      */
@@ -2262,6 +2270,7 @@ static void loadSFieldFromDex(ClassObject* clazz,
 
 #ifdef PROFILE_FIELD_ACCESS
     sfield->field.gets = sfield->field.puts = 0;
+    sfield->field.putSwitches = sfield->field.lastPutter = 0;
 #endif
 }
 
@@ -2287,6 +2296,7 @@ static void loadIFieldFromDex(ClassObject* clazz,
 
 #ifdef PROFILE_FIELD_ACCESS
     ifield->field.gets = ifield->field.puts = 0;
+    ifield->field.putSwitches = ifield->field.lastPutter = 0;
 #endif
 }
 
@@ -2826,6 +2836,11 @@ bail_during_resolve:
         dvmDbgPostClassPrepare(clazz);
     }
 
+#ifdef WITH_PROFILER
+    /* tell native profilers where the methods are */
+    dvmPerfMapAddClass(clazz);
+#endif
+
 bail:
     if (!okay) {
         clazz->status = CLASS_ERROR;
@@ -3526,6 +3541,9 @@ static inline void swapField(InstField* pOne, InstField* pTwo)
  * has the property of moving the smallest possible set of fields, which
  * should reduce the time required to load a class.
  *
+ * If a field access profile was loaded with -Xfieldlayout, the class may
+ * be laid out from that instead; see FieldLayout.c.
+ *
  * NOTE: reference fields *must* come first, or precacheReferenceOffsets()
  * will break.
  */
@@ -3548,6 +3566,12 @@ static bool computeFieldOffsets(ClassObject* clazz)
     //LOGI("classobj, access: %d\n", offsetof(ClassObject, accessFlags));
     //LOGI("super=%p, fieldOffset=%d\n", clazz->super, fieldOffset);
 
+    if (gDvm.fieldLayoutProfile != NULL &&
+        dvmLayoutFieldsFromProfile(clazz, &fieldOffset))
+    {
+        goto assigned;
+    }
+
     /*
      * Start by moving all reference fields to the front.
      */
@@ -3699,6 +3723,7 @@ static bool computeFieldOffsets(ClassObject* clazz)
             fieldOffset += sizeof(u4);
     }
 
+assigned:
 #ifndef NDEBUG
     /* Make sure that all reference fields appear before
      * non-reference fields, and all double-wide fields are aligned.
@@ -4825,6 +4850,9 @@ static int dumpAccessCounts(void* vclazz, void* varg)
         if (field->puts != 0)
             printf("PI %d %s.%s\n", field->puts,
                 field->clazz->descriptor, field->name);
+        if (field->putSwitches != 0)
+            printf("SI %d %s.%s\n", field->putSwitches,
+                field->clazz->descriptor, field->name);
     }
     for (i = 0; i < clazz->sfieldCount; i++) {
         Field* field = &clazz->sfields[i].field;
@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Instance field layout driven by a field access profile.
+ *
+ * The profile is the output of dvmDumpFieldAccessCounts() from a VM built
+ * with PROFILE_FIELD_ACCESS, one field per line:
+ *
+ *   GI <count> <class descriptor>.<field name>     instance field gets
+ *   PI <count> ...                                 instance field puts
+ *   SI <count> ...                                 puts by a different
+ *                                                  thread than the last one
+ *
+ * Static field lines (GS, PS) are ignored.
+ *
+ * With a profile loaded, each class's own instance fields are ordered by
+ * how often they were accessed, so the hot ones share the cache lines
+ * nearest the object header.  A field that is written a lot by more than
+ * one thread is moved at least a cache line away from everything before
+ * it, so writers don't keep invalidating the line that readers of the
+ * other fields need.  That costs memory in every instance, so it's only
+ * done when the profile shows real contention.
+ *
+ * Field offsets of classes in an optimized DEX are baked into the
+ * "quickened" instructions, so those classes must keep the default
+ * layout.  Default dexopt optimizes everything it verifies, so in
+ * practice the profile only applies to apps whose DEX was prepared with
+ * -Xdexopt:none (and an existing optimized copy in the dalvik-cache is
+ * still used, so that needs clearing first).  Bootstrap classes keep the
+ * default layout too, since the VM has the offsets of some of their
+ * fields built in.
+ */
+#include "Dalvik.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+/* cache line size we try to keep read-hot and write-hot fields apart by */
+#define kCacheLineBytes     64
+
+/*
+ * A field is "contended" if at least this many of its puts came from a
+ * different thread than the put before, and such puts were at least one
+ * in kContendedShare of all accesses to it.
+ */
+#define kContendedMinSwitches   1000
+#define kContendedShare         16
+
+/*
+ * One field from the profile.
+ */
+typedef struct FieldHeat {
+    u4          gets;
+    u4          puts;
+    u4          putSwitches;
+    char        name[1];            /* "Lfoo/Bar;.baz", allocated with it */
+} FieldHeat;
+
+/*
+ * A field being placed.
+ */
+typedef struct FieldRank {
+    InstField   field;
+    u4          heat;               /* gets + puts */
+    bool        isRef;
+    bool        isWide;
+    bool        contended;
+    bool        placed;
+    int         origIdx;
+} FieldRank;
+
+static int hashcmpFieldHeat(const void* tableItem, const void* looseItem)
+{
+    return strcmp(((const FieldHeat*) tableItem)->name,
+        (const char*) looseItem);
+}
+
+/*
+ * Add the count from one profile line.
+ */
+static bool addProfileLine(HashTable* pTable, const char* kind, u4 count,
+    const char* name)
+{
+    FieldHeat* pHeat;
+    u4 hash;
+
+    if (kind[1] != 'I')
+        return true;        /* static field */
+
+    hash = dvmComputeUtf8Hash(name);
+    pHeat = (FieldHeat*) dvmHashTableLookup(pTable, hash, (void*) name,
+        hashcmpFieldHeat, false);
+    if (pHeat == NULL) {
+        pHeat = (FieldHeat*) calloc(1, sizeof(FieldHeat) + strlen(name));
+        if (pHeat == NULL)
+            return false;
+        strcpy(pHeat->name, name);
+        dvmHashTableLookup(pTable, hash, pHeat, hashcmpFieldHeat, true);
+    }
+
+    switch (kind[0]) {
+    case 'G':   pHeat->gets += count;           break;
+    case 'P':   pHeat->puts += count;           break;
+    case 'S':   pHeat->putSwitches += count;    break;
+    default:    break;
+    }
+    return true;
+}
+
+/*
+ * Add one line of the profile.  Lines we don't understand are skipped.
+ * Returns "false" only if we run out of memory.
+ */
+static bool parseProfileLine(HashTable* pTable, const char* line)
+{
+    char kind[4];
+    char name[1024];
+    unsigned int count;
+
+    if (sscanf(line, "%3s %u %1023s", kind, &count, name) != 3 ||
+        strlen(kind) != 2 || strchr(name, '.') == NULL)
+    {
+        return true;
+    }
+    return addProfileLine(pTable, kind, count, name);
+}
+
+/*
+ * Load the profile named by -Xfieldlayout.  A missing or unreadable file
+ * just means we use the default layout.
+ */
+bool dvmFieldLayoutStartup(void)
+{
+    HashTable* pTable;
+    char line[1024];
+    FILE* fp;
+
+    if (gDvm.fieldLayoutFile == NULL)
+        return true;
+
+    fp = fopen(gDvm.fieldLayoutFile, "r");
+    if (fp == NULL) {
+        LOGW("Unable to open field layout profile '%s': %s\n",
+            gDvm.fieldLayoutFile, strerror(errno));
+        return true;
+    }
+
+    pTable = dvmHashTableCreate(256, free);
+    if (pTable == NULL) {
+        fclose(fp);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (!parseProfileLine(pTable, line)) {
+            dvmHashTableFree(pTable);
+            fclose(fp);
+            return false;
+        }
+    }
+    fclose(fp);
+
+    LOGI("Loaded field layout profile '%s' (%d instance fields)\n",
+        gDvm.fieldLayoutFile, dvmHashTableNumEntries(pTable));
+    gDvm.fieldLayoutProfile = pTable;
+    return true;
+}
+
+/*
+ * Free the profile.
+ */
+void dvmFieldLayoutShutdown(void)
+{
+    dvmHashTableFree(gDvm.fieldLayoutProfile);
+    gDvm.fieldLayoutProfile = NULL;
+}
+
+/*
+ * Find a field's entry in the profile.
+ */
+static const FieldHeat* findFieldHeat(HashTable* pProfile,
+    const InstField* pField)
+{
+    const char* descriptor = pField->field.clazz->descriptor;
+    char buf[512];
+    size_t descLen = strlen(descriptor);
+    size_t nameLen = strlen(pField->field.name);
+
+    if (descLen + 1 + nameLen + 1 > sizeof(buf))
+        return NULL;
+    memcpy(buf, descriptor, descLen);
+    buf[descLen] = '.';
+    memcpy(buf + descLen + 1, pField->field.name, nameLen + 1);
+
+    return (const FieldHeat*) dvmHashTableLookup(pProfile,
+        dvmComputeUtf8Hash(buf), buf, hashcmpFieldHeat, false);
+}
+
+/*
+ * Decide whether we're allowed to move this class's fields around.
+ */
+static bool canUseProfile(const ClassObject* clazz)
+{
+    const DexOptHeader* pOptHeader;
+
+    if (gDvm.optimizing)
+        return false;
+    if (clazz->classLoader == NULL || clazz->pDvmDex == NULL)
+        return false;
+
+    pOptHeader = clazz->pDvmDex->pDexFile->pOptHeader;
+    if (pOptHeader != NULL && (pOptHeader->flags & DEX_OPT_FLAG_FIELDS) != 0)
+    {
+        /* say so once, or it looks like the profile isn't working */
+        static bool warned = false;
+        if (!warned) {
+            LOGW("Field layout: %s is in an optimized DEX, so it keeps the "
+                 "default layout; the profile needs -Xdexopt:none\n",
+                clazz->descriptor);
+            warned = true;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Sort order for placing fields: references, then other fields, then the
+ * contended ones; hottest first within each group, and otherwise in the
+ * order they were declared.
+ */
+static int compareFieldRank(const void* vone, const void* vtwo)
+{
+    const FieldRank* one = (const FieldRank*) vone;
+    const FieldRank* two = (const FieldRank*) vtwo;
+
+    if (one->isRef != two->isRef)
+        return one->isRef ? -1 : 1;
+    if (one->contended != two->contended)
+        return one->contended ? 1 : -1;
+    if (one->heat != two->heat)
+        return (one->heat > two->heat) ? -1 : 1;
+    return one->origIdx - two->origIdx;
+}
+
+static int compareFieldOffset(const void* vone, const void* vtwo)
+{
+    return ((const FieldRank*) vone)->field.byteOffset -
+        ((const FieldRank*) vtwo)->field.byteOffset;
+}
+
+/*
+ * Give "pRank" the next offset.
+ */
+static void placeField(FieldRank* pRank, int* pFieldOffset)
+{
+    pRank->field.byteOffset = *pFieldOffset;
+    pRank->placed = true;
+    *pFieldOffset += pRank->isWide ? sizeof(u8) : sizeof(u4);
+}
+
+/*
+ * Lay out the fields using "pProfile".
+ */
+static bool layoutFields(ClassObject* clazz, int* pFieldOffset,
+    HashTable* pProfile)
+{
+    FieldRank* ranks;
+    int count = clazz->ifieldCount;
+    int fieldOffset = *pFieldOffset;
+    int numProfiled = 0, numContended = 0, padBytes = 0;
+    bool inContended = false;
+    int i, j;
+
+    if (count == 0 || !canUseProfile(clazz))
+        return false;
+
+    ranks = (FieldRank*) calloc(count, sizeof(FieldRank));
+    if (ranks == NULL)
+        return false;
+
+    for (i = 0; i < count; i++) {
+        FieldRank* pRank = &ranks[i];
+        const FieldHeat* pHeat;
+        char c;
+
+        pRank->field = clazz->ifields[i];
+        pRank->origIdx = i;
+        c = pRank->field.field.signature[0];
+        pRank->isRef = (c == 'L' || c == '[');
+        pRank->isWide = (c == 'J' || c == 'D');
+
+        pHeat = findFieldHeat(pProfile, &pRank->field);
+        if (pHeat == NULL)
+            continue;
+        numProfiled++;
+        pRank->heat = pHeat->gets + pHeat->puts;
+
+        /* reference fields must stay together at the front */
+        if (!pRank->isRef &&
+            pHeat->putSwitches >= kContendedMinSwitches &&
+            (u8) pHeat->putSwitches * kContendedShare >= pRank->heat)
+        {
+            pRank->contended = true;
+            numContended++;
+        }
+    }
+
+    if (numProfiled == 0) {
+        free(ranks);
+        return false;
+    }
+
+    qsort(ranks, count, sizeof(FieldRank), compareFieldRank);
+
+    /*
+     * References go first, packed.
+     */
+    clazz->ifieldRefCount = 0;
+    for (i = 0; i < count && ranks[i].isRef; i++) {
+        placeField(&ranks[i], &fieldOffset);
+        clazz->ifieldRefCount++;
+    }
+
+    /*
+     * Then the rest, in order, except that when a 64-bit field comes up
+     * on an odd word we pull the next 32-bit field of the same group in
+     * ahead of it.  If there isn't one, we pad.
+     */
+    for ( ; i < count; i++) {
+        FieldRank* pRank = &ranks[i];
+
+        if (pRank->placed)
+            continue;
+
+        if (pRank->contended && !inContended) {
+            /*
+             * Start the contended fields a full cache line past the last
+             * byte of everything before them, wherever the object lands.
+             */
+            int newOffset = (fieldOffset + kCacheLineBytes - 1 + 7) & ~7;
+            padBytes += newOffset - fieldOffset;
+            fieldOffset = newOffset;
+            inContended = true;
+        }
+
+        if (pRank->isWide && (fieldOffset & 0x04) != 0) {
+            for (j = i + 1; j < count; j++) {
+                if (!ranks[j].placed && !ranks[j].isWide &&
+                    ranks[j].contended == pRank->contended)
+                {
+                    break;
+                }
+            }
+            if (j < count) {
+                placeField(&ranks[j], &fieldOffset);
+            } else {
+                LOGV("  +++ inserting pad field in '%s'\n", clazz->descriptor);
+                fieldOffset += sizeof(u4);
+                padBytes += sizeof(u4);
+            }
+        }
+
+        placeField(pRank, &fieldOffset);
+    }
+
+    /* keep the field table in offset order */
+    qsort(ranks + clazz->ifieldRefCount, count - clazz->ifieldRefCount,
+        sizeof(FieldRank), compareFieldOffset);
+    for (i = 0; i < count; i++)
+        clazz->ifields[i] = ranks[i].field;
+    free(ranks);
+
+    if (numContended != 0) {
+        LOGI("Field layout: %s: %d of %d fields by profile, %d contended "
+             "field(s) moved a cache line away (+%d bytes/object)\n",
+            clazz->descriptor, numProfiled, count, numContended, padBytes);
+    } else {
+        LOGD("Field layout: %s: %d of %d fields by profile\n",
+            clazz->descriptor, numProfiled, count);
+    }
+
+    *pFieldOffset = fieldOffset;
+    return true;
+}
+
+/*
+ * Lay out the fields.  See the header for the contract.
+ */
+bool dvmLayoutFieldsFromProfile(ClassObject* clazz, int* pFieldOffset)
+{
+    if (gDvm.fieldLayoutProfile == NULL)
+        return false;
+    return layoutFields(clazz, pFieldOffset, gDvm.fieldLayoutProfile);
+}
+
+#ifndef NDEBUG
+/*
+ * Build a profile from lines in the file format, for
+ * test/TestFieldLayout.c.  Free it with dvmHashTableFree().
+ */
+HashTable* dvmTestParseFieldLayoutProfile(const char* const* lines,
+    int count)
+{
+    HashTable* pTable;
+    int i;
+
+    pTable = dvmHashTableCreate(16, free);
+    if (pTable == NULL)
+        return NULL;
+    for (i = 0; i < count; i++) {
+        if (!parseProfileLine(pTable, lines[i])) {
+            dvmHashTableFree(pTable);
+            return NULL;
+        }
+    }
+    return pTable;
+}
+
+/*
+ * Lay out "clazz" with "pProfile" instead of the -Xfieldlayout one.
+ */
+bool dvmTestLayoutFields(ClassObject* clazz, int* pFieldOffset,
+    HashTable* pProfile)
+{
+    return layoutFields(clazz, pFieldOffset, pProfile);
+}
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Instance field layout driven by a field access profile.
+ */
+#ifndef _DALVIK_OO_FIELDLAYOUT
+#define _DALVIK_OO_FIELDLAYOUT
+
+/* VM startup/shutdown; loads the file named by -Xfieldlayout, if any */
+bool dvmFieldLayoutStartup(void);
+void dvmFieldLayoutShutdown(void);
+
+/*
+ * Assign offsets to "clazz"'s instance fields using the access profile,
+ * starting at "*pFieldOffset", and advance "*pFieldOffset" past them.
+ * Reference fields still come first, and 64-bit fields are still 64-bit
+ * aligned.
+ *
+ * Returns "false", having changed nothing, if no profile is loaded, if
+ * none of the fields are in it, or if the class can't be laid out freely
+ * (see the comments in FieldLayout.c); the caller then uses the default
+ * layout.
+ */
+bool dvmLayoutFieldsFromProfile(ClassObject* clazz, int* pFieldOffset);
+
+#ifndef NDEBUG
+/*
+ * Parse "count" profile lines into a table, and lay out a class with
+ * that table in place of the -Xfieldlayout profile.  For internal tests.
+ */
+struct HashTable* dvmTestParseFieldLayoutProfile(const char* const* lines,
+    int count);
+bool dvmTestLayoutFields(ClassObject* clazz, int* pFieldOffset,
+    struct HashTable* pProfile);
+#endif
+
+#endif /*_DALVIK_OO_FIELDLAYOUT*/
@@ -467,6 +467,19 @@ struct ClassObject {
 
     /* source file name, if known */
     const char*     sourceFile;
+
+    /*
+     * Reflection objects for the members declared by this class, created
+     * on first use by the dvmGetDeclared* functions.  These are never
+     * handed out directly (AccessibleObject state is mutable), callers
+     * get copies.  Marked by the GC along with the rest of the class.
+     */
+    ArrayObject*    declaredFields;
+    ArrayObject*    declaredMethods;
+    ArrayObject*    declaredConstructors;
+
+    /* decoded runtime-visible annotations, see reflect/Annotation.c */
+    ArrayObject*    annotationCache;
 };
 
 /*
@@ -550,6 +563,13 @@ struct Method {
      */
     const RegisterMap* registerMap;
 
+    /*
+     * Decoded try/catch tables, built the first time an exception is
+     * thrown through this method.  Allocated on the heap; see
+     * dvmFreeCatchTable().
+     */
+    struct CatchTable* catchTable;
+
 #ifdef WITH_PROFILER
     bool            inProfile;
 #endif
@@ -568,6 +588,8 @@ struct Field {
 #ifdef PROFILE_FIELD_ACCESS
     u4              gets;
     u4              puts;
+    u4              putSwitches;    /* puts by a different thread than last */
+    u4              lastPutter;     /* threadId of the last put */
 #endif
 };
 
@@ -502,11 +502,21 @@ StringObject* dvmResolveString(const ClassObject* referrer, u4 stringIdx)
 
     LOGVV("+++ resolving string, referrer is %s\n", referrer->descriptor);
 
+    /*
+     * Most constants are already interned, by another class or another
+     * DEX file.  Look for it by its precomputed hash code before
+     * building a String of our own.
+     */
+    utf8 = dexStringAndSizeById(pDvmDex->pDexFile, stringIdx, &utf16Size);
+    strObj = dvmLookupImmortalInternedUtf8(utf8, utf16Size,
+                dexGetStringHash(pDvmDex->pDexFile, stringIdx));
+    if (strObj != NULL)
+        goto found;
+
     /*
      * Create a UTF-16 version so we can trivially compare it to what's
      * already interned.
      */
-    utf8 = dexStringAndSizeById(pDvmDex->pDexFile, stringIdx, &utf16Size);
     strObj = dvmCreateStringFromCstrAndLength(utf8, utf16Size,
                 ALLOC_DEFAULT);
     if (strObj == NULL) {
@@ -534,6 +544,7 @@ StringObject* dvmResolveString(const ClassObject* referrer, u4 stringIdx)
         goto bail;
     }
 
+found:
     /* save a reference so we can go straight to the object next time */
     dvmDexSetResolvedString(pDvmDex, stringIdx, strObj);
 
@@ -38,7 +38,8 @@
  */
 bool dvmInstanceofStartup(void)
 {
-    gDvm.instanceofCache = dvmAllocAtomicCache(INSTANCEOF_CACHE_SIZE);
+    gDvm.instanceofCache = dvmAllocAtomicCache(INSTANCEOF_CACHE_SIZE,
+        "instanceof");
     if (gDvm.instanceofCache == NULL)
         return false;
     return true;
@@ -242,8 +243,7 @@ int dvmInstanceofNonTrivial(const ClassObject* instance,
     const ClassObject* clazz)
 {
 #define ATOMIC_CACHE_CALC isInstanceof(instance, clazz)
-    return ATOMIC_CACHE_LOOKUP(gDvm.instanceofCache,
-                INSTANCEOF_CACHE_SIZE, instance, clazz);
+    return ATOMIC_CACHE_LOOKUP(gDvm.instanceofCache, instance, clazz);
 #undef ATOMIC_CACHE_CALC
 }
 
@@ -17,7 +17,9 @@
  * Annotations.
  *
  * We're not expecting to make much use of runtime annotations, so speed vs.
- * space choices are weighted heavily toward small size.
+ * space choices are weighted heavily toward small size.  The exception is
+ * the decoded Annotation[] for a class, method, or field, which is kept
+ * once it has been asked for (see "Decoded annotation cache" below).
  *
  * It would have been nice to treat "system" annotations in the same way
  * we do "real" annotations, but that doesn't work.  The chief difficulty
@@ -1205,6 +1207,220 @@ static ArrayObject* getSignatureValue(const ClassObject* clazz,
 }
 
 
+/*
+ * ===========================================================================
+ *      Decoded annotation cache
+ * ===========================================================================
+ */
+
+/*
+ * Decoded runtime-visible Annotation[] arrays are kept in
+ * clazz->annotationCache, an Object[] with one slot for the class itself,
+ * then one for each direct and virtual method, then one for each static
+ * and instance field.  The array is allocated the first time anything in
+ * the class is asked for its annotations.
+ *
+ * Annotation instances are immutable, so they can be shared, but the
+ * arrays handed back to the class libraries are not, so callers always
+ * get a copy of the cached array.
+ *
+ * Slots are filled in without locking.  Two threads racing to decode the
+ * same annotations will produce equivalent arrays, and it doesn't matter
+ * which one survives.
+ */
+#define kAnnoCacheClassIndex    0
+
+/*
+ * Get the cache slot index for a method.
+ */
+static int methodAnnoCacheIndex(const Method* method)
+{
+    const ClassObject* clazz = method->clazz;
+
+    if (dvmIsDirectMethod(method)) {
+        assert(method >= clazz->directMethods &&
+               method < clazz->directMethods + clazz->directMethodCount);
+        return 1 + (method - clazz->directMethods);
+    } else {
+        assert(method >= clazz->virtualMethods &&
+               method < clazz->virtualMethods + clazz->virtualMethodCount);
+        return 1 + clazz->directMethodCount +
+                (method - clazz->virtualMethods);
+    }
+}
+
+/*
+ * Get the cache slot index for a field.
+ */
+static int fieldAnnoCacheIndex(const Field* field)
+{
+    const ClassObject* clazz = field->clazz;
+    int base = 1 + clazz->directMethodCount + clazz->virtualMethodCount;
+
+    if (dvmIsStaticField(field)) {
+        const StaticField* sfield = (const StaticField*) field;
+        assert(sfield >= clazz->sfields &&
+               sfield < clazz->sfields + clazz->sfieldCount);
+        return base + (sfield - clazz->sfields);
+    } else {
+        const InstField* ifield = (const InstField*) field;
+        assert(ifield >= clazz->ifields &&
+               ifield < clazz->ifields + clazz->ifieldCount);
+        return base + clazz->sfieldCount + (ifield - clazz->ifields);
+    }
+}
+
+/*
+ * Return the cached Annotation[] for the specified slot, or NULL if it
+ * hasn't been decoded yet.  The result is shared; don't hand it out.
+ */
+static ArrayObject* lookupCachedAnnotations(const ClassObject* clazz,
+    int index)
+{
+    ArrayObject* cache = clazz->annotationCache;
+
+    if (cache == NULL)
+        return NULL;
+    assert(index < (int) cache->length);
+    return ((ArrayObject**) cache->contents)[index];
+}
+
+/*
+ * Store a freshly-decoded Annotation[] in the cache.  "annoArray" must
+ * be in the tracked allocation table (it's released here); if it's NULL
+ * we just return NULL.
+ *
+ * Returns "annoArray", which is now reachable through the class, or NULL
+ * with an exception raised if we couldn't allocate the cache.
+ */
+static ArrayObject* cacheAnnotations(ClassObject* clazz, int index,
+    ArrayObject* annoArray)
+{
+    ArrayObject* cache;
+
+    if (annoArray == NULL)
+        return NULL;
+
+    cache = clazz->annotationCache;
+    if (cache == NULL) {
+        int size = 1 + clazz->directMethodCount + clazz->virtualMethodCount +
+                    clazz->sfieldCount + clazz->ifieldCount;
+
+        cache = dvmAllocArrayByClass(gDvm.classJavaLangObjectArray, size,
+                    ALLOC_DEFAULT);
+        if (cache == NULL) {
+            dvmReleaseTrackedAlloc((Object*) annoArray, NULL);
+            return NULL;
+        }
+        if (!ATOMIC_CMP_SWAP((int32_t*)(void*) &clazz->annotationCache,
+                0, (int32_t)(intptr_t) cache))
+        {
+            /* somebody else got there first; use theirs */
+            dvmReleaseTrackedAlloc((Object*) cache, NULL);
+            cache = clazz->annotationCache;
+        } else {
+            dvmReleaseTrackedAlloc((Object*) cache, NULL);
+        }
+    }
+
+    assert(index < (int) cache->length);
+    ((ArrayObject**) cache->contents)[index] = annoArray;
+    dvmReleaseTrackedAlloc((Object*) annoArray, NULL);
+
+    return annoArray;
+}
+
+/*
+ * Decode the runtime-visible annotations in "pAnnoSet" (which may be NULL)
+ * and cache the result.  Returns a copy of the cached array.
+ *
+ * Caller must call dvmReleaseTrackedAlloc().
+ *
+ * On allocation failure, this returns NULL with an exception raised.
+ */
+static ArrayObject* decodeAndCacheAnnotations(ClassObject* clazz, int index,
+    const DexAnnotationSetItem* pAnnoSet)
+{
+    ArrayObject* annoArray;
+
+    if (pAnnoSet == NULL) {
+        /* no annotations for anything in class, or none for this item */
+        annoArray = emptyAnnoArray();
+    } else {
+        annoArray = processAnnotationSet(clazz, pAnnoSet,
+                        kDexVisibilityRuntime);
+    }
+
+    annoArray = cacheAnnotations(clazz, index, annoArray);
+    if (annoArray == NULL)
+        return NULL;
+
+    return (ArrayObject*) dvmCloneObject((Object*) annoArray);
+}
+
+/*
+ * Determine whether an annotation of class "annoClazz" is present, without
+ * creating any objects.
+ *
+ * If the annotations for this slot have already been decoded we scan the
+ * cached array.  Each element is a proxy created by AnnotationFactory
+ * that implements exactly one interface, its annotation type, and we
+ * compare that with "annoClazz" itself (not instanceof), so the answer is
+ * the same as from the DEX.  Otherwise we search the DEX annotation set by descriptor
+ * and confirm the match by resolving the type index, which is normally
+ * just a table lookup.
+ *
+ * Returns "false" with an exception raised if the annotation class can't
+ * be resolved.
+ */
+static bool isAnnotationPresent(const ClassObject* clazz, int index,
+    const DexAnnotationSetItem* pAnnoSet, const ClassObject* annoClazz)
+{
+    ArrayObject* annoArray = lookupCachedAnnotations(clazz, index);
+    const DexAnnotationItem* pAnnoItem;
+    const ClassObject* resClass;
+    const u1* ptr;
+    u4 typeIdx;
+
+    if (annoArray != NULL) {
+        Object** pContents = (Object**) annoArray->contents;
+        int i;
+
+        for (i = 0; i < (int) annoArray->length; i++) {
+            const ClassObject* annoProxy = pContents[i]->clazz;
+
+            if (annoProxy->interfaceCount == 1 &&
+                annoProxy->interfaces[0] == annoClazz)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (pAnnoSet == NULL)
+        return false;
+
+    pAnnoItem = searchAnnotationSet(clazz, pAnnoSet, annoClazz->descriptor,
+                    kDexVisibilityRuntime);
+    if (pAnnoItem == NULL)
+        return false;
+
+    ptr = pAnnoItem->annotation;
+    typeIdx = readUleb128(&ptr);
+    resClass = dvmDexGetResolvedClass(clazz->pDvmDex, typeIdx);
+    if (resClass == NULL) {
+        resClass = dvmResolveClass(clazz, typeIdx, true);
+        if (resClass == NULL) {
+            assert(dvmCheckException(dvmThreadSelf()));
+            return false;
+        }
+    }
+
+    return resClass == annoClazz;
+}
+
+
 /*
  * ===========================================================================
  *      Class
@@ -1242,18 +1458,30 @@ static const DexAnnotationSetItem* findAnnotationSetForClass(
 ArrayObject* dvmGetClassAnnotations(const ClassObject* clazz)
 {
     ArrayObject* annoArray;
-    const DexAnnotationSetItem* pAnnoSet = NULL;
 
-    pAnnoSet = findAnnotationSetForClass(clazz);
-    if (pAnnoSet == NULL) {
-        /* no annotations for anything in class, or no class annotations */
-        annoArray = emptyAnnoArray();
-    } else {
-        annoArray = processAnnotationSet(clazz, pAnnoSet,
-                        kDexVisibilityRuntime);
-    }
+    annoArray = lookupCachedAnnotations(clazz, kAnnoCacheClassIndex);
+    if (annoArray != NULL)
+        return (ArrayObject*) dvmCloneObject((Object*) annoArray);
 
-    return annoArray;
+    return decodeAndCacheAnnotations((ClassObject*) clazz,
+            kAnnoCacheClassIndex, findAnnotationSetForClass(clazz));
+}
+
+/*
+ * Determine whether the class is annotated with "annoClazz".  Inherited
+ * annotations are not considered.
+ *
+ * Returns "false" with an exception raised on failure.
+ */
+bool dvmIsClassAnnotationPresent(const ClassObject* clazz,
+    const ClassObject* annoClazz)
+{
+    const DexAnnotationSetItem* pAnnoSet = NULL;
+
+    if (lookupCachedAnnotations(clazz, kAnnoCacheClassIndex) == NULL)
+        pAnnoSet = findAnnotationSetForClass(clazz);
+    return isAnnotationPresent(clazz, kAnnoCacheClassIndex, pAnnoSet,
+            annoClazz);
 }
 
 /*
@@ -1666,18 +1894,32 @@ static const DexAnnotationSetItem* findAnnotationSetForMethod(
 ArrayObject* dvmGetMethodAnnotations(const Method* method)
 {
     ClassObject* clazz = method->clazz;
-    const DexAnnotationSetItem* pAnnoSet;
-    ArrayObject* annoArray = NULL;
+    int index = methodAnnoCacheIndex(method);
+    ArrayObject* annoArray;
 
-    pAnnoSet = findAnnotationSetForMethod(method);
-    if (pAnnoSet == NULL) {
-        /* no matching annotations found */
-        annoArray = emptyAnnoArray();
-    } else {
-        annoArray = processAnnotationSet(clazz, pAnnoSet,kDexVisibilityRuntime);
-    }
+    annoArray = lookupCachedAnnotations(clazz, index);
+    if (annoArray != NULL)
+        return (ArrayObject*) dvmCloneObject((Object*) annoArray);
 
-    return annoArray;
+    return decodeAndCacheAnnotations(clazz, index,
+            findAnnotationSetForMethod(method));
+}
+
+/*
+ * Determine whether the method is annotated with "annoClazz".
+ *
+ * Returns "false" with an exception raised on failure.
+ */
+bool dvmIsMethodAnnotationPresent(const Method* method,
+    const ClassObject* annoClazz)
+{
+    ClassObject* clazz = method->clazz;
+    int index = methodAnnoCacheIndex(method);
+    const DexAnnotationSetItem* pAnnoSet = NULL;
+
+    if (lookupCachedAnnotations(clazz, index) == NULL)
+        pAnnoSet = findAnnotationSetForMethod(method);
+    return isAnnotationPresent(clazz, index, pAnnoSet, annoClazz);
 }
 
 /*
@@ -1940,21 +2182,32 @@ static const DexAnnotationSetItem* findAnnotationSetForField(const Field* field)
 ArrayObject* dvmGetFieldAnnotations(const Field* field)
 {
     ClassObject* clazz = field->clazz;
-    ArrayObject* annoArray = NULL;
-    DexFile* pDexFile = clazz->pDvmDex->pDexFile;
-    const DexAnnotationsDirectoryItem* pAnnoDir;
-    const DexAnnotationSetItem* pAnnoSet = NULL;
+    int index = fieldAnnoCacheIndex(field);
+    ArrayObject* annoArray;
 
-    pAnnoSet = findAnnotationSetForField(field);
-    if (pAnnoSet == NULL) {
-        /* no matching annotations found */
-        annoArray = emptyAnnoArray();
-    } else {
-        annoArray = processAnnotationSet(clazz, pAnnoSet,
-                        kDexVisibilityRuntime);
-    }
+    annoArray = lookupCachedAnnotations(clazz, index);
+    if (annoArray != NULL)
+        return (ArrayObject*) dvmCloneObject((Object*) annoArray);
 
-    return annoArray;
+    return decodeAndCacheAnnotations(clazz, index,
+            findAnnotationSetForField(field));
+}
+
+/*
+ * Determine whether the field is annotated with "annoClazz".
+ *
+ * Returns "false" with an exception raised on failure.
+ */
+bool dvmIsFieldAnnotationPresent(const Field* field,
+    const ClassObject* annoClazz)
+{
+    ClassObject* clazz = field->clazz;
+    int index = fieldAnnoCacheIndex(field);
+    const DexAnnotationSetItem* pAnnoSet = NULL;
+
+    if (lookupCachedAnnotations(clazz, index) == NULL)
+        pAnnoSet = findAnnotationSetForField(field);
+    return isAnnotationPresent(clazz, index, pAnnoSet, annoClazz);
 }
 
 /*
@@ -116,6 +116,11 @@ bool dvmReflectStartup(void)
         return false;
     }
 
+    gDvm.reflectAccessCache = dvmAllocAtomicCache(REFLECT_ACCESS_CACHE_SIZE,
+        "reflect access");
+    if (gDvm.reflectAccessCache == NULL)
+        return false;
+
     if (!dvmReflectProxyStartup())
         return false;
     if (!dvmReflectAnnotationStartup())
@@ -129,7 +134,8 @@ bool dvmReflectStartup(void)
  */
 void dvmReflectShutdown(void)
 {
-    // nothing to do
+    dvmFreeAtomicCache(gDvm.reflectAccessCache);
+    gDvm.reflectAccessCache = NULL;
 }
 
 /*
@@ -143,7 +149,7 @@ void dvmReflectShutdown(void)
  */
 bool dvmValidateBoxClasses()
 {
-    static const char* classes[] = {
+    static const char* classes[] = {        // order from enum PrimitiveType
         "Ljava/lang/Boolean;",
         "Ljava/lang/Character;",
         "Ljava/lang/Float;",
@@ -170,6 +176,8 @@ bool dvmValidateBoxClasses()
                 clazz->ifieldCount, *ccp);
             return false;
         }
+
+        gDvm.boxClasses[ccp - classes] = clazz;
     }
 
     return true;
@@ -387,12 +395,118 @@ bail:
 }
 
 /*
+ * Return true if the member described by reflection object "obj" (a
+ * Field, Method, or Constructor declared by "clazz") is public.
+ */
+static bool isPublicMember(ClassObject* clazz, const Object* obj)
+{
+    u4 accessFlags;
+    int slot;
+
+    if (obj->clazz == gDvm.classJavaLangReflectField) {
+        slot = dvmGetFieldInt(obj, gDvm.offJavaLangReflectField_slot);
+        accessFlags = dvmSlotToField(clazz, slot)->accessFlags;
+    } else if (obj->clazz == gDvm.classJavaLangReflectConstructor) {
+        slot = dvmGetFieldInt(obj, gDvm.offJavaLangReflectConstructor_slot);
+        accessFlags = dvmSlotToMethod(clazz, slot)->accessFlags;
+    } else {
+        assert(obj->clazz == gDvm.classJavaLangReflectMethod);
+        slot = dvmGetFieldInt(obj, gDvm.offJavaLangReflectMethod_slot);
+        accessFlags = dvmSlotToMethod(clazz, slot)->accessFlags;
+    }
+
+    return (accessFlags & ACC_PUBLIC) != 0;
+}
+
+/*
+ * Copy the cached reflection objects in "cached" into a new array of
+ * class "arrayClass", keeping only public members if "publicOnly" is set.
  *
- * Get an array with all fields declared by a class.
+ * Each element is cloned, so the caller is free to call setAccessible()
+ * on the results without affecting the cache.  The parameter and
+ * exception type arrays are shared, but the class libraries only ever
+ * hand out copies of those.
+ *
+ * The caller must call dvmReleaseTrackedAlloc() on the result.
+ */
+static ArrayObject* copyDeclaredMembers(ClassObject* clazz,
+    ArrayObject* cached, ClassObject* arrayClass, bool publicOnly)
+{
+    ArrayObject* memberArray;
+    Object** src;
+    Object** dst;
+    int i, count;
+
+    src = (Object**) cached->contents;
+    if (!publicOnly) {
+        count = cached->length;
+    } else {
+        count = 0;
+        for (i = 0; i < (int) cached->length; i++) {
+            if (isPublicMember(clazz, src[i]))
+                count++;
+        }
+    }
+
+    memberArray = dvmAllocArray(arrayClass, count, kObjectArrayRefWidth,
+                    ALLOC_DEFAULT);
+    if (memberArray == NULL)
+        return NULL;
+
+    /* "cached" is reachable through clazz, so allocating here is safe */
+    dst = (Object**) memberArray->contents;
+    for (i = 0; i < (int) cached->length; i++) {
+        if (publicOnly && !isPublicMember(clazz, src[i]))
+            continue;
+
+        *dst = dvmCloneObject(src[i]);
+        if (*dst == NULL) {
+            dvmReleaseTrackedAlloc((Object*) memberArray, NULL);
+            return NULL;
+        }
+        dvmReleaseTrackedAlloc(*dst, NULL);
+        dst++;
+    }
+
+    assert(dst - (Object**) memberArray->contents == count);
+
+    /* caller must call dvmReleaseTrackedAlloc */
+    return memberArray;
+}
+
+/*
+ * Store a freshly-built array of reflection objects in one of the
+ * ClassObject cache slots.  If another thread got there first we just
+ * use its array; the contents are equivalent.
+ *
+ * Releases the tracked allocation of "built".  Returns the array that
+ * ended up in the cache.
+ */
+static ArrayObject* installDeclaredMembers(ArrayObject** pSlot,
+    ArrayObject* built)
+{
+    ArrayObject* result;
+
+    if (ATOMIC_CMP_SWAP((int32_t*)(void*) pSlot, 0,
+            (int32_t)(intptr_t) built))
+    {
+        result = built;
+    } else {
+        result = *pSlot;
+    }
+
+    /* now reachable through the class object (or discarded) */
+    dvmReleaseTrackedAlloc((Object*) built, NULL);
+    return result;
+}
+
+/*
+ *
+ * Build an array with all fields declared by a class.
  *
  * This includes both static and instance fields.
  */
-ArrayObject* dvmGetDeclaredFields(ClassObject* clazz, bool publicOnly)
+static ArrayObject* createDeclaredFields(ClassObject* clazz, bool publicOnly)
 {
     ArrayObject* fieldArray = NULL;
     Object** fields;
@@ -457,6 +571,27 @@ fail:
     return NULL;
 }
 
+/*
+ * Get an array with all fields declared by a class.
+ *
+ * The Field objects are created once per class and cached; we return
+ * a copy.
+ */
+ArrayObject* dvmGetDeclaredFields(ClassObject* clazz, bool publicOnly)
+{
+    ArrayObject* cached = clazz->declaredFields;
+
+    if (cached == NULL) {
+        cached = createDeclaredFields(clazz, false);
+        if (cached == NULL)
+            return NULL;
+        cached = installDeclaredMembers(&clazz->declaredFields, cached);
+    }
+
+    return copyDeclaredMembers(clazz, cached,
+            gDvm.classJavaLangReflectFieldArray, publicOnly);
+}
+
 
 /*
  * Convert a method pointer to a slot number.
@@ -570,9 +705,10 @@ bail:
 }
 
 /*
- * Get an array with all constructors declared by a class.
+ * Build an array with all constructors declared by a class.
  */
-ArrayObject* dvmGetDeclaredConstructors(ClassObject* clazz, bool publicOnly)
+static ArrayObject* createDeclaredConstructors(ClassObject* clazz,
+    bool publicOnly)
 {
     ArrayObject* consArray;
     Object** consObjPtr;
@@ -638,6 +774,30 @@ fail:
     return NULL;
 }
 
+/*
+ * Get an array with all constructors declared by a class.
+ *
+ * The Constructor objects are created once per class and cached; we
+ * return a copy.
+ */
+ArrayObject* dvmGetDeclaredConstructors(ClassObject* clazz, bool publicOnly)
+{
+    ArrayObject* cached = clazz->declaredConstructors;
+
+    if (cached == NULL) {
+        cached = createDeclaredConstructors(clazz, false);
+        if (cached == NULL)
+            return NULL;
+        cached = installDeclaredMembers(&clazz->declaredConstructors, cached);
+    } else if (!dvmIsClassInitialized(clazz)) {
+        /* same side effect as the uncached path */
+        dvmInitClass(clazz);
+    }
+
+    return copyDeclaredMembers(clazz, cached,
+            gDvm.classJavaLangReflectConstructorArray, publicOnly);
+}
+
 /*
  * Create a new java/lang/reflect/Method object, using the contents of
  * "meth" to construct it.
@@ -731,13 +891,13 @@ bail:
 }
 
 /*
- * Get an array with all methods declared by a class.
+ * Build an array with all methods declared by a class.
  *
  * This includes both static and virtual methods, and can include private
  * members if "publicOnly" is false.  It does not include Miranda methods,
  * since those weren't declared in the class, or constructors.
  */
-ArrayObject* dvmGetDeclaredMethods(ClassObject* clazz, bool publicOnly)
+static ArrayObject* createDeclaredMethods(ClassObject* clazz, bool publicOnly)
 {
     ArrayObject* methodArray;
     Object** methObjPtr;
@@ -818,6 +978,27 @@ fail:
     return NULL;
 }
 
+/*
+ * Get an array with all methods declared by a class.
+ *
+ * The Method objects are created once per class and cached; we return
+ * a copy.
+ */
+ArrayObject* dvmGetDeclaredMethods(ClassObject* clazz, bool publicOnly)
+{
+    ArrayObject* cached = clazz->declaredMethods;
+
+    if (cached == NULL) {
+        cached = createDeclaredMethods(clazz, false);
+        if (cached == NULL)
+            return NULL;
+        cached = installDeclaredMembers(&clazz->declaredMethods, cached);
+    }
+
+    return copyDeclaredMembers(clazz, cached,
+            gDvm.classJavaLangReflectMethodArray, publicOnly);
+}
+
 /*
  * Get all interfaces a class implements. If this is unable to allocate
  * the result array, this raises an OutOfMemoryError and returns NULL.
@@ -859,33 +1040,21 @@ ArrayObject* dvmGetInterfaces(ClassObject* clazz)
  */
 static PrimitiveType getBoxedType(DataObject* arg)
 {
-    static const int kJavaLangLen = 11;     // strlen("Ljava/lang/")
-    const char* name;
+    const ClassObject* clazz;
+    int type;
 
     if (arg == NULL)
         return PRIM_NOT;
 
-    name = arg->obj.clazz->descriptor;
-
-    if (strncmp(name, "Ljava/lang/", kJavaLangLen) != 0)
-        return PRIM_NOT;
-
-    if (strcmp(name + kJavaLangLen, "Boolean;") == 0)
-        return PRIM_BOOLEAN;
-    if (strcmp(name + kJavaLangLen, "Character;") == 0)
-        return PRIM_CHAR;
-    if (strcmp(name + kJavaLangLen, "Float;") == 0)
-        return PRIM_FLOAT;
-    if (strcmp(name + kJavaLangLen, "Double;") == 0)
-        return PRIM_DOUBLE;
-    if (strcmp(name + kJavaLangLen, "Byte;") == 0)
-        return PRIM_BYTE;
-    if (strcmp(name + kJavaLangLen, "Short;") == 0)
-        return PRIM_SHORT;
-    if (strcmp(name + kJavaLangLen, "Integer;") == 0)
-        return PRIM_INT;
-    if (strcmp(name + kJavaLangLen, "Long;") == 0)
-        return PRIM_LONG;
+    /*
+     * The box classes all come from the bootstrap class loader, so we can
+     * compare pointers instead of descriptors.
+     */
+    clazz = arg->obj.clazz;
+    for (type = 0; type < PRIM_VOID; type++) {
+        if (gDvm.boxClasses[type] == clazz)
+            return (PrimitiveType) type;
+    }
     return PRIM_NOT;
 }
 
@@ -1028,21 +1197,10 @@ int dvmConvertArgument(DataObject* arg, ClassObject* type, s4* destPtr)
  */
 DataObject* dvmWrapPrimitive(JValue value, ClassObject* returnType)
 {
-    static const char* boxTypes[] = {       // order from enum PrimitiveType
-        "Ljava/lang/Boolean;", 
-        "Ljava/lang/Character;",
-        "Ljava/lang/Float;",
-        "Ljava/lang/Double;",
-        "Ljava/lang/Byte;",
-        "Ljava/lang/Short;",
-        "Ljava/lang/Integer;",
-        "Ljava/lang/Long;"
-    };
     ClassObject* wrapperClass;
     DataObject* wrapperObj;
     s4* dataPtr;
     PrimitiveType typeIndex = returnType->primitiveType;
-    const char* classDescriptor;
 
     if (typeIndex == PRIM_NOT) {
         /* add to tracking table so return value is always in table */
@@ -1055,11 +1213,11 @@ DataObject* dvmWrapPrimitive(JValue value, ClassObject* returnType)
     if (typeIndex == PRIM_VOID)
         return NULL;
 
-    classDescriptor = boxTypes[typeIndex];
-
-    wrapperClass = dvmFindSystemClass(classDescriptor);
-    if (wrapperClass == NULL) {
-        LOGW("Unable to find '%s'\n", classDescriptor);
+    /* found by dvmValidateBoxClasses, but possibly not yet initialized */
+    wrapperClass = gDvm.boxClasses[typeIndex];
+    assert(wrapperClass != NULL);
+    if (!dvmIsClassInitialized(wrapperClass) && !dvmInitClass(wrapperClass)) {
+        LOGW("Unable to initialize '%s'\n", wrapperClass->descriptor);
         assert(dvmCheckException(dvmThreadSelf()));
         return NULL;
     }
@@ -19,13 +19,20 @@
 #ifndef _DALVIK_REFLECT_REFLECT
 #define _DALVIK_REFLECT_REFLECT
 
+/*
+ * Number of entries in the reflective access check cache.  MUST be a
+ * power of 2.
+ */
+#define REFLECT_ACCESS_CACHE_SIZE   256
+
 bool dvmReflectStartup(void);
 bool dvmReflectProxyStartup(void);
 bool dvmReflectAnnotationStartup(void);
 void dvmReflectShutdown(void);
 
 /*
- * During startup, validate the "box" classes, e.g. java/lang/Integer.
+ * During startup, validate the "box" classes, e.g. java/lang/Integer, and
+ * save pointers to them in gDvm.boxClasses.
  */
 bool dvmValidateBoxClasses();
 
@@ -135,6 +142,18 @@ ArrayObject* dvmGetMethodAnnotations(const Method* method);
 ArrayObject* dvmGetFieldAnnotations(const Field* field);
 ArrayObject* dvmGetParameterAnnotations(const Method* method);
 
+/*
+ * Determine whether a runtime-visible annotation of the specified type is
+ * present, without creating any Annotation objects.  For classes this
+ * does not include inherited annotations.
+ */
+bool dvmIsClassAnnotationPresent(const ClassObject* clazz,
+    const ClassObject* annoClazz);
+bool dvmIsMethodAnnotationPresent(const Method* method,
+    const ClassObject* annoClazz);
+bool dvmIsFieldAnnotationPresent(const Field* field,
+    const ClassObject* annoClazz);
+
 /*
  * Find the default value for an annotation member.
  */
@@ -20,8 +20,14 @@
 #ifndef _DALVIK_TEST_TEST
 #define _DALVIK_TEST_TEST
 
+bool dvmTestFieldLayout(void);
 bool dvmTestHash(void);
+bool dvmTestHashSpeed(void);
 bool dvmTestAtomicSpeed(void);
 bool dvmTestIndirectRefTable(void);
+bool dvmTestJniPin(void);
+bool dvmTestNativeLookup(void);
+bool dvmTestUtfString(void);
+bool dvmTestUtfStringSpeed(void);
 
 #endif /*_DALVIK_TEST_TEST*/
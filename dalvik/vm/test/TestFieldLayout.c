@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test instance field layout from an access profile.
+ */
+#include "Dalvik.h"
+
+#include <stdlib.h>
+
+#ifndef NDEBUG
+
+#define DBUG_MSG    LOGV
+
+#define kMaxTestFields  8
+#define kStartOffset    8       /* first offset after the object header */
+
+/*
+ * A class that looks like it came from an unoptimized DEX in an app's
+ * class loader.  Only what the layout code looks at is filled in.
+ */
+typedef struct TestClass {
+    ClassObject clazz;
+    DvmDex      dvmDex;
+    DexFile     dexFile;
+    InstField   ifields[kMaxTestFields];
+} TestClass;
+
+static void makeClass(TestClass* pTest, const char* const* fields, int count)
+{
+    int i;
+
+    memset(pTest, 0, sizeof(*pTest));
+    pTest->clazz.descriptor = "Ldalvik/test/FieldLayout;";
+    pTest->clazz.classLoader = (Object*) gDvm.classJavaLangObject;
+    pTest->clazz.pDvmDex = &pTest->dvmDex;
+    pTest->dvmDex.pDexFile = &pTest->dexFile;
+    pTest->clazz.ifields = pTest->ifields;
+    pTest->clazz.ifieldCount = count;
+
+    /* each entry is "<signature> <name>" */
+    for (i = 0; i < count; i++) {
+        pTest->ifields[i].field.clazz = &pTest->clazz;
+        pTest->ifields[i].field.signature = fields[i];
+        pTest->ifields[i].field.name = strchr(fields[i], ' ') + 1;
+    }
+}
+
+static int offsetOf(const TestClass* pTest, const char* name)
+{
+    int i;
+
+    for (i = 0; i < pTest->clazz.ifieldCount; i++) {
+        if (strcmp(pTest->ifields[i].field.name, name) == 0)
+            return pTest->ifields[i].byteOffset;
+    }
+    return -1;
+}
+
+static bool expectOffset(const TestClass* pTest, const char* name,
+    int expected)
+{
+    int offset = offsetOf(pTest, name);
+
+    if (offset != expected) {
+        LOGE("field layout: '%s' at %d, expected %d\n", name, offset,
+            expected);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Hot fields move to the front, and a 64-bit field still ends up 64-bit
+ * aligned.
+ */
+static bool hotFieldTest(void)
+{
+    static const char* const kFields[] = {
+        "I cold", "I warm", "I hot", "J wide", "Ljava/lang/Object; ref",
+        "I hot2",
+    };
+    static const char* const kProfile[] = {
+        "GI 1000 Ldalvik/test/FieldLayout;.hot",
+        "GI 800 Ldalvik/test/FieldLayout;.hot2",
+        "GI 400 Ldalvik/test/FieldLayout;.wide",
+        "PI 100 Ldalvik/test/FieldLayout;.wide",
+        "GI 10 Ldalvik/test/FieldLayout;.warm",
+        "GS 5000 Ldalvik/test/FieldLayout;.cold",   /* static; ignored */
+        "junk",
+    };
+    HashTable* pProfile;
+    TestClass test;
+    int fieldOffset = kStartOffset;
+    bool result = false;
+
+    pProfile = dvmTestParseFieldLayoutProfile(kProfile, NELEM(kProfile));
+    if (pProfile == NULL)
+        return false;
+
+    makeClass(&test, kFields, NELEM(kFields));
+    if (!dvmTestLayoutFields(&test.clazz, &fieldOffset, pProfile)) {
+        LOGE("field layout: profile not used\n");
+        goto bail;
+    }
+
+    /* the reference, the hot ones, warm pulled in to align wide, then
+     * wide, then cold */
+    if (!expectOffset(&test, "ref", 8) ||
+        !expectOffset(&test, "hot", 12) ||
+        !expectOffset(&test, "hot2", 16) ||
+        !expectOffset(&test, "warm", 20) ||
+        !expectOffset(&test, "wide", 24) ||
+        !expectOffset(&test, "cold", 32))
+    {
+        goto bail;
+    }
+    if (fieldOffset != 36 || test.clazz.ifieldRefCount != 1) {
+        LOGE("field layout: end %d, %d refs\n", fieldOffset,
+            test.clazz.ifieldRefCount);
+        goto bail;
+    }
+    if (strcmp(test.ifields[0].field.name, "ref") != 0 ||
+        strcmp(test.ifields[1].field.name, "hot") != 0)
+    {
+        LOGE("field layout: ifields not in offset order\n");
+        goto bail;
+    }
+
+    result = true;
+
+bail:
+    dvmHashTableFree(pProfile);
+    return result;
+}
+
+/*
+ * A field written by many threads goes at least a cache line past the
+ * end of the ones before it.
+ */
+static bool contendedFieldTest(void)
+{
+    static const char* const kFields[] = { "I counter", "I config" };
+    static const char* const kProfile[] = {
+        "GI 100 Ldalvik/test/FieldLayout;.config",
+        "PI 5000 Ldalvik/test/FieldLayout;.counter",
+        "SI 2000 Ldalvik/test/FieldLayout;.counter",
+    };
+    HashTable* pProfile;
+    TestClass test;
+    int fieldOffset = kStartOffset;
+    int configEnd, counter;
+    bool result = false;
+
+    pProfile = dvmTestParseFieldLayoutProfile(kProfile, NELEM(kProfile));
+    if (pProfile == NULL)
+        return false;
+
+    makeClass(&test, kFields, NELEM(kFields));
+    if (!dvmTestLayoutFields(&test.clazz, &fieldOffset, pProfile)) {
+        LOGE("field layout: profile not used\n");
+        goto bail;
+    }
+
+    if (!expectOffset(&test, "config", kStartOffset))
+        goto bail;
+    configEnd = kStartOffset + sizeof(u4);
+    counter = offsetOf(&test, "counter");
+    if (counter - configEnd < 64) {
+        LOGE("field layout: contended field at %d, only %d bytes past "
+             "the others\n", counter, counter - configEnd);
+        goto bail;
+    }
+
+    result = true;
+
+bail:
+    dvmHashTableFree(pProfile);
+    return result;
+}
+
+/*
+ * Classes the profile doesn't mention, and bootstrap classes, are left
+ * alone.
+ */
+static bool unchangedTest(void)
+{
+    static const char* const kFields[] = { "I a", "I b" };
+    static const char* const kProfile[] = {
+        "GI 1000 Ldalvik/test/Other;.b",
+        "GI 1000 Ldalvik/test/FieldLayout;.c",
+    };
+    static const char* const kOwnProfile[] = {
+        "GI 1000 Ldalvik/test/FieldLayout;.b",
+    };
+    HashTable* pProfile;
+    HashTable* pOwnProfile;
+    TestClass test;
+    int fieldOffset = kStartOffset;
+    bool result = false;
+
+    pProfile = dvmTestParseFieldLayoutProfile(kProfile, NELEM(kProfile));
+    pOwnProfile = dvmTestParseFieldLayoutProfile(kOwnProfile,
+                    NELEM(kOwnProfile));
+    if (pProfile == NULL || pOwnProfile == NULL)
+        goto bail;
+
+    makeClass(&test, kFields, NELEM(kFields));
+    if (dvmTestLayoutFields(&test.clazz, &fieldOffset, pProfile) ||
+        fieldOffset != kStartOffset)
+    {
+        LOGE("field layout: used a profile that doesn't list the class\n");
+        goto bail;
+    }
+
+    test.clazz.classLoader = NULL;
+    if (dvmTestLayoutFields(&test.clazz, &fieldOffset, pOwnProfile) ||
+        fieldOffset != kStartOffset)
+    {
+        LOGE("field layout: moved the fields of a bootstrap class\n");
+        goto bail;
+    }
+
+    result = true;
+
+bail:
+    dvmHashTableFree(pProfile);
+    dvmHashTableFree(pOwnProfile);
+    return result;
+}
+
+/*
+ * Some quick tests.
+ */
+bool dvmTestFieldLayout(void)
+{
+    if (!hotFieldTest() || !contendedFieldTest() || !unchangedTest()) {
+        LOGE("field layout test failed\n");
+        return false;
+    }
+
+    DBUG_MSG("+++ field layout test complete\n");
+    return true;
+}
+
+#endif /*NDEBUG*/
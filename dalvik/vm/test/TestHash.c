@@ -24,6 +24,11 @@
 #ifndef NDEBUG
 
 #define kNumTestEntries 14
+#define kChurnKeys      512
+#define kChurnOps       40000
+#define kSpeedEntries   100000
+#define kSpeedRepeat    10
+#define kSpeedStrLen    16
 
 /*
  * Test foreach.
@@ -72,6 +77,122 @@ static void dumpIterator(HashTable* pTab)
     }
 }
 
+/*
+ * Cheap deterministic generator, so failures are repeatable.
+ */
+static u4 nextRandom(u4* pSeed)
+{
+    *pSeed = *pSeed * 1103515245 + 12345;
+    return *pSeed >> 8;
+}
+
+static int cmpInt(const void* tableItem, const void* looseItem)
+{
+    return *(const int*) tableItem - *(const int*) looseItem;
+}
+
+/*
+ * Four keys share each hash value, and neighbouring hash values land in
+ * neighbouring slots, so the table gets long runs to shift around.
+ */
+static u4 churnHash(int key)
+{
+    return (u4) key >> 2;
+}
+
+static int removeOddFunc(void* data)
+{
+    return *(const int*) data & 1;
+}
+
+/*
+ * Make sure the table holds exactly the keys marked in "present".
+ */
+static bool checkChurn(HashTable* pTab, int* keys, const bool* present)
+{
+    int i, count = 0;
+
+    for (i = 0; i < kChurnKeys; i++) {
+        void* found = dvmHashTableLookup(pTab, churnHash(i), &keys[i],
+            cmpInt, false);
+        if (found != (present[i] ? &keys[i] : NULL)) {
+            LOGE("TestHash churn: key %d %s\n", i,
+                present[i] ? "missing" : "should be gone");
+            return false;
+        }
+        if (present[i])
+            count++;
+    }
+    if (dvmHashTableNumEntries(pTab) != count) {
+        LOGE("TestHash churn: %d entries, expected %d\n",
+            dvmHashTableNumEntries(pTab), count);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Random adds and removes on a small key space with lots of collisions,
+ * checked against a flag array.  Then remove half with the foreach call.
+ */
+static bool testChurn(void)
+{
+    static int keys[kChurnKeys];
+    bool present[kChurnKeys];
+    HashTable* pTab;
+    u4 seed = 1;
+    int i, op;
+    bool result = false;
+
+    pTab = dvmHashTableCreate(4, NULL);
+    if (pTab == NULL)
+        return false;
+
+    for (i = 0; i < kChurnKeys; i++) {
+        keys[i] = i;
+        present[i] = false;
+    }
+
+    for (op = 0; op < kChurnOps; op++) {
+        u4 r = nextRandom(&seed);
+        int key = r % kChurnKeys;
+
+        if ((r >> 12) % 3 != 0) {
+            if (dvmHashTableLookup(pTab, churnHash(key), &keys[key], cmpInt,
+                    true) != &keys[key])
+            {
+                LOGE("TestHash churn: add of %d failed\n", key);
+                goto bail;
+            }
+            present[key] = true;
+        } else {
+            if (dvmHashTableRemove(pTab, churnHash(key), &keys[key])
+                != present[key])
+            {
+                LOGE("TestHash churn: remove of %d returned %d\n",
+                    key, !present[key]);
+                goto bail;
+            }
+            present[key] = false;
+        }
+
+        if ((op % 1000) == 999 && !checkChurn(pTab, keys, present))
+            goto bail;
+    }
+
+    dvmHashForeachRemove(pTab, removeOddFunc);
+    for (i = 1; i < kChurnKeys; i += 2)
+        present[i] = false;
+    if (!checkChurn(pTab, keys, present))
+        goto bail;
+
+    result = true;
+
+bail:
+    dvmHashTableFree(pTab);
+    return result;
+}
+
 /*
  * Some quick hash table tests.
  */
@@ -132,7 +253,7 @@ bool dvmTestHash(void)
 
 
     /*
-     * Round 2: verify probing & tombstones.
+     * Round 2: verify probing & removal.
      */
     pTab = dvmHashTableCreate(dvmHashSize(2), free);
     if (pTab == NULL)
@@ -174,7 +295,7 @@ bool dvmTestHash(void)
     if (str == NULL)
         LOGE("TestHash entry vanished\n");
 
-    /* force a table realloc to exercise tombstone removal */
+    /* force a table realloc with colliding entries */
     for (i = 0; i < 20; i++) {
         sprintf(tmpStr, "entry %d", i);
         str = (const char*) dvmHashTableLookup(pTab, hash, strdup(tmpStr),
@@ -183,9 +304,101 @@ bool dvmTestHash(void)
     }
 
     dvmHashTableFree(pTab);
+
+    /*
+     * Round 3: random adds and removes, with displacement and shifting.
+     */
+    if (!testChurn())
+        return false;
+
     LOGV("TestHash END\n");
 
     return true;
 }
 
+/*
+ * Time adds, hits, misses and removes on a table of strings that grows
+ * from its minimum size.  Results go to stdout, as with the atomic speed
+ * test.
+ */
+bool dvmTestHashSpeed(void)
+{
+    char* strs = (char*) malloc(kSpeedEntries * kSpeedStrLen * 2);
+    u4* hashes = (u4*) malloc(kSpeedEntries * sizeof(u4) * 2);
+    char* missStrs = strs + kSpeedEntries * kSpeedStrLen;
+    u4* missHashes = hashes + kSpeedEntries;
+    u8 addTime = 0, hitTime = 0, missTime = 0, removeTime = 0;
+    int pass, i, hits = 0, misses = 0;
+
+    if (strs == NULL || hashes == NULL) {
+        free(strs);
+        free(hashes);
+        return false;
+    }
+
+    for (i = 0; i < kSpeedEntries; i++) {
+        char* str = strs + i * kSpeedStrLen;
+        char* missStr = missStrs + i * kSpeedStrLen;
+
+        sprintf(str, "entry %d", i);
+        sprintf(missStr, "missing %d", i);
+        hashes[i] = dvmComputeUtf8Hash(str);
+        missHashes[i] = dvmComputeUtf8Hash(missStr);
+    }
+
+    for (pass = 0; pass < kSpeedRepeat; pass++) {
+        HashTable* pTab = dvmHashTableCreate(16, NULL);
+        u8 t0, t1, t2, t3, t4;
+
+        if (pTab == NULL)
+            break;
+
+        t0 = dvmGetRelativeTimeNsec();
+        for (i = 0; i < kSpeedEntries; i++) {
+            dvmHashTableLookup(pTab, hashes[i], strs + i * kSpeedStrLen,
+                (HashCompareFunc) strcmp, true);
+        }
+        t1 = dvmGetRelativeTimeNsec();
+        for (i = 0; i < kSpeedEntries; i++) {
+            if (dvmHashTableLookup(pTab, hashes[i], strs + i * kSpeedStrLen,
+                    (HashCompareFunc) strcmp, false) != NULL)
+                hits++;
+        }
+        t2 = dvmGetRelativeTimeNsec();
+        for (i = 0; i < kSpeedEntries; i++) {
+            if (dvmHashTableLookup(pTab, missHashes[i],
+                    missStrs + i * kSpeedStrLen,
+                    (HashCompareFunc) strcmp, false) == NULL)
+                misses++;
+        }
+        t3 = dvmGetRelativeTimeNsec();
+        if (pass == 0) {
+            dvmHashTableProbeCount(pTab, (HashCalcFunc) dvmComputeUtf8Hash,
+                (HashCompareFunc) strcmp);
+        }
+        for (i = 0; i < kSpeedEntries; i++)
+            dvmHashTableRemove(pTab, hashes[i], strs + i * kSpeedStrLen);
+        t4 = dvmGetRelativeTimeNsec();
+
+        addTime += t1 - t0;
+        hitTime += t2 - t1;
+        missTime += t3 - t2;
+        removeTime += t4 - t3;
+
+        dvmHashTableFree(pTab);
+    }
+
+#define PER_OP(_t)  ((double) (_t) / ((double) kSpeedEntries * kSpeedRepeat))
+    dvmFprintf(stdout, "Hash speed (%d strings, ns/op):\n", kSpeedEntries);
+    dvmFprintf(stdout, "  add     %.1f\n", PER_OP(addTime));
+    dvmFprintf(stdout, "  hit     %.1f\n", PER_OP(hitTime));
+    dvmFprintf(stdout, "  miss    %.1f\n", PER_OP(missTime));
+    dvmFprintf(stdout, "  remove  %.1f\n", PER_OP(removeTime));
+#undef PER_OP
+
+    free(strs);
+    free(hashes);
+    return (hits == misses && hits == kSpeedEntries * pass);
+}
+
 #endif /*NDEBUG*/
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test the per-thread tables used for JNI "critical" pins.
+ */
+#include "Dalvik.h"
+
+#include <pthread.h>
+
+#ifndef NDEBUG
+
+#define DBUG_MSG    LOGV
+
+/*
+ * State shared by the two test threads.  "step" says how far along we
+ * are; everything is guarded by "lock".
+ */
+typedef struct PinTestState {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int         step;
+
+    jintArray   array;              /* global ref */
+    void*       elems;
+    Thread*     pinner;
+
+    int         sameThreadPins;     /* pins left after a matched pair */
+    int         pinsBefore;         /* pins held before the release */
+    int         pinsAfter;          /* ...and after */
+    int         pinsOwnRelease;     /* after the pinner releases it */
+    u4          unpinCount;         /* pinner's unpin count at the end */
+    bool        attachFailed;
+} PinTestState;
+
+static void setStep(PinTestState* pState, int step)
+{
+    pthread_mutex_lock(&pState->lock);
+    pState->step = step;
+    pthread_cond_broadcast(&pState->cond);
+    pthread_mutex_unlock(&pState->lock);
+}
+
+static void waitForStep(PinTestState* pState, int step)
+{
+    pthread_mutex_lock(&pState->lock);
+    while (pState->step < step)
+        pthread_cond_wait(&pState->cond, &pState->lock);
+    pthread_mutex_unlock(&pState->lock);
+}
+
+static int criticalPinCount(Thread* thread)
+{
+    if (thread->jniCriticalPinTable.table == NULL)
+        return 0;
+    return dvmReferenceTableEntries(&thread->jniCriticalPinTable);
+}
+
+/*
+ * Pin an array, then wait while the other thread releases it.
+ */
+static void* pinnerThread(void* arg)
+{
+    PinTestState* pState = (PinTestState*) arg;
+    JavaVM* vm = gDvm.vmList;
+    JNIEnv* env;
+    jintArray localArray;
+    void* elems;
+
+    if ((*vm)->AttachCurrentThread(vm, &env, NULL) != JNI_OK) {
+        pState->attachFailed = true;
+        setStep(pState, 3);
+        return NULL;
+    }
+    pState->pinner = dvmThreadSelf();
+
+    localArray = (*env)->NewIntArray(env, 16);
+    pState->array = (jintArray) (*env)->NewGlobalRef(env, localArray);
+    (*env)->DeleteLocalRef(env, localArray);
+
+    /* a matched pair on one thread */
+    elems = (*env)->GetPrimitiveArrayCritical(env, pState->array, NULL);
+    (*env)->ReleasePrimitiveArrayCritical(env, pState->array, elems, 0);
+    pState->sameThreadPins = criticalPinCount(pState->pinner);
+
+    /* pin it here, try to release it on the other thread */
+    pState->elems =
+        (*env)->GetPrimitiveArrayCritical(env, pState->array, NULL);
+    pState->pinsBefore = criticalPinCount(pState->pinner);
+    setStep(pState, 1);
+
+    waitForStep(pState, 2);
+    pState->pinsAfter = criticalPinCount(pState->pinner);
+
+    /* the foreign release was rejected, so it's still ours to release */
+    (*env)->ReleasePrimitiveArrayCritical(env, pState->array,
+        pState->elems, 0);
+    pState->pinsOwnRelease = criticalPinCount(pState->pinner);
+    pState->unpinCount = pState->pinner->jniCriticalUnpinCount;
+
+    (*env)->DeleteGlobalRef(env, pState->array);
+    (*vm)->DetachCurrentThread(vm);
+    setStep(pState, 3);
+    return NULL;
+}
+
+/*
+ * Try to release the array pinned by pinnerThread.
+ */
+static void* releaserThread(void* arg)
+{
+    PinTestState* pState = (PinTestState*) arg;
+    JavaVM* vm = gDvm.vmList;
+    JNIEnv* env;
+
+    if ((*vm)->AttachCurrentThread(vm, &env, NULL) != JNI_OK) {
+        pState->attachFailed = true;
+        setStep(pState, 2);
+        return NULL;
+    }
+
+    waitForStep(pState, 1);
+    if (pState->elems != NULL) {
+        (*env)->ReleasePrimitiveArrayCritical(env, pState->array,
+            pState->elems, 0);
+    }
+    (*vm)->DetachCurrentThread(vm);
+
+    setStep(pState, 2);
+    return NULL;
+}
+
+/*
+ * An array pinned on one thread and released on another must stay in the
+ * first thread's table until that thread releases it.
+ */
+static bool crossThreadTest(void)
+{
+    Thread* self = dvmThreadSelf();
+    PinTestState state;
+    pthread_t pinner, releaser;
+    ThreadStatus oldStatus;
+    bool result = false;
+
+    memset(&state, 0, sizeof(state));
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.cond, NULL);
+
+    /* the test threads may need to suspend us (e.g. for a GC) */
+    oldStatus = dvmChangeStatus(self, THREAD_VMWAIT);
+    pthread_create(&pinner, NULL, pinnerThread, &state);
+    pthread_create(&releaser, NULL, releaserThread, &state);
+    pthread_join(pinner, NULL);
+    pthread_join(releaser, NULL);
+    dvmChangeStatus(self, oldStatus);
+
+    if (state.attachFailed) {
+        LOGE("unable to attach test threads\n");
+        goto bail;
+    }
+    if (state.sameThreadPins != 0) {
+        LOGE("same-thread release left %d pins\n", state.sameThreadPins);
+        goto bail;
+    }
+    if (state.pinsBefore != 1 || state.pinsAfter != 1 ||
+        state.pinsOwnRelease != 0)
+    {
+        LOGE("cross-thread release: %d pins before, %d after, %d after "
+             "own release\n",
+            state.pinsBefore, state.pinsAfter, state.pinsOwnRelease);
+        goto bail;
+    }
+    if (state.unpinCount != 2) {
+        LOGE("cross-thread release: unpin count is %d\n", state.unpinCount);
+        goto bail;
+    }
+
+    DBUG_MSG("+++ cross-thread critical pin test complete\n");
+    result = true;
+
+bail:
+    pthread_cond_destroy(&state.cond);
+    pthread_mutex_destroy(&state.lock);
+    return result;
+}
+
+/*
+ * Some quick tests.
+ */
+bool dvmTestJniPin(void)
+{
+    /* the zygote must not start any threads */
+    if (gDvm.zygote)
+        return true;
+
+    if (!crossThreadTest()) {
+        LOGE("JNI critical pin cross-thread test failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+#endif /*NDEBUG*/
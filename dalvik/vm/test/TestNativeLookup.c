@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test JNI function lookup with and without a library's symbol index.
+ */
+#include "Dalvik.h"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+
+#ifndef NDEBUG
+
+#define DBUG_MSG    LOGV
+
+/*
+ * The functions we look for.  The indexes we pass in don't list them,
+ * which is how a JNI library looks when its functions come from one of
+ * its dependencies: dlsym() finds them but the index doesn't.
+ */
+JNIEXPORT jint JNICALL Java_dalvik_test_NativeLookup_fromDependency(
+    JNIEnv* env, jclass clazz)
+{
+    return 1;
+}
+JNIEXPORT jint JNICALL Java_dalvik_test_NativeLookup_overloaded__(
+    JNIEnv* env, jclass clazz)
+{
+    return 2;
+}
+
+static int hashcmpName(const void* ventry, const void* vname)
+{
+    return strcmp((const char*) ventry, (const char*) vname);
+}
+
+/*
+ * Make a Method with the given name in class "dalvik.test.NativeLookup",
+ * taking no arguments.  Only the fields used to build JNI names are
+ * filled in.
+ */
+static void makeMethod(Method* pMeth, ClassObject* pClazz, const char* name)
+{
+    ClassObject* objectClass = gDvm.classJavaLangObject;
+    Method* init = dvmFindDirectMethodByDescriptor(objectClass, "<init>",
+                    "()V");
+
+    memset(pClazz, 0, sizeof(*pClazz));
+    pClazz->descriptor = "Ldalvik/test/NativeLookup;";
+
+    *pMeth = *init;         /* borrow its "()V" prototype */
+    pMeth->clazz = pClazz;
+    pMeth->name = name;
+}
+
+static bool expectFunction(void* handle, HashTable* pIndex,
+    const char* methodName, void* expected, const char* what)
+{
+    ClassObject clazz;
+    Method meth;
+    void* func;
+
+    makeMethod(&meth, &clazz, methodName);
+    func = dvmTestFindJniFunction(handle, pIndex, &meth);
+    if (func != expected) {
+        LOGE("JNI lookup of %s (%s): got %p, expected %p\n",
+            methodName, what, func, expected);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Look up functions that aren't in the library's index, that are, and
+ * that don't exist at all.
+ */
+static bool lookupTest(void* handle)
+{
+    HashTable* pIndex;
+    bool result = false;
+    char* name;
+
+    pIndex = dvmHashTableCreate(8, free);
+    if (pIndex == NULL)
+        return false;
+
+    /* no index at all */
+    if (!expectFunction(handle, NULL, "fromDependency",
+            (void*) Java_dalvik_test_NativeLookup_fromDependency, "no index"))
+        goto bail;
+
+    /* an index that doesn't list them, like a library that gets them
+     * from a dependency */
+    if (!expectFunction(handle, pIndex, "fromDependency",
+            (void*) Java_dalvik_test_NativeLookup_fromDependency,
+            "not indexed"))
+        goto bail;
+    if (!expectFunction(handle, pIndex, "overloaded",
+            (void*) Java_dalvik_test_NativeLookup_overloaded__,
+            "long name, not indexed"))
+        goto bail;
+
+    /* an index that does */
+    name = strdup("Java_dalvik_test_NativeLookup_fromDependency");
+    dvmHashTableLookup(pIndex, dvmComputeUtf8Hash(name), name,
+        hashcmpName, true);
+    if (!expectFunction(handle, pIndex, "fromDependency",
+            (void*) Java_dalvik_test_NativeLookup_fromDependency, "indexed"))
+        goto bail;
+
+    /* nothing to find */
+    if (!expectFunction(handle, pIndex, "missing", NULL, "missing"))
+        goto bail;
+
+    DBUG_MSG("+++ JNI lookup test complete\n");
+    result = true;
+
+bail:
+    dvmHashTableFree(pIndex);
+    return result;
+}
+
+/*
+ * Some quick tests.
+ */
+bool dvmTestNativeLookup(void)
+{
+    void* handle;
+    bool result;
+
+    /* the VM library these functions are in, or the whole process if
+     * the VM is linked statically */
+    handle = dlopen("libdvm.so", RTLD_LAZY);
+    if (handle == NULL)
+        handle = dlopen(NULL, RTLD_LAZY);
+    if (handle == NULL) {
+        LOGE("JNI lookup test: dlopen failed: %s\n", dlerror());
+        return false;
+    }
+
+    /* a static dalvikvm only exports its symbols if linked -rdynamic */
+    if (dlsym(handle, "Java_dalvik_test_NativeLookup_fromDependency") == NULL)
+    {
+        LOGW("JNI lookup test: VM symbols not exported, skipping\n");
+        dlclose(handle);
+        return true;
+    }
+
+    result = lookupTest(handle);
+    if (!result)
+        LOGE("JNI lookup test failed\n");
+
+    dlclose(handle);
+    return result;
+}
+
+#endif /*NDEBUG*/
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test the UTF-8/UTF-16 conversion and hash functions (and the Latin-1
+ * hash) against simple one-char-at-a-time versions, and time them.
+ */
+#include "Dalvik.h"
+
+#include <stdlib.h>
+
+#ifndef NDEBUG
+
+#define kMaxTestLen     96
+#define kSpeedLen       4096
+#define kSpeedRepeat    2000
+
+/*
+ * Reference implementations.
+ */
+static int refUtf8Len(const char* utf8Str)
+{
+    int len = 0;
+
+    while (*utf8Str != '\0') {
+        dexGetUtf16FromUtf8(&utf8Str);
+        len++;
+    }
+    return len;
+}
+
+static int refUtf16Utf8ByteLen(const u2* utf16Str, int len)
+{
+    int utf8Len = 0;
+
+    while (len--) {
+        unsigned int uic = *utf16Str++;
+        if (uic == 0 || uic > 0x7f)
+            utf8Len += (uic > 0x07ff) ? 3 : 2;
+        else
+            utf8Len++;
+    }
+    return utf8Len;
+}
+
+static void refConvertUtf16ToUtf8(char* utf8Str, const u2* utf16Str, int len)
+{
+    while (len--) {
+        unsigned int uic = *utf16Str++;
+        if (uic > 0x07ff) {
+            *utf8Str++ = (uic >> 12) | 0xe0;
+            *utf8Str++ = ((uic >> 6) & 0x3f) | 0x80;
+            *utf8Str++ = (uic & 0x3f) | 0x80;
+        } else if (uic == 0 || uic > 0x7f) {
+            *utf8Str++ = (uic >> 6) | 0xc0;
+            *utf8Str++ = (uic & 0x3f) | 0x80;
+        } else {
+            *utf8Str++ = uic;
+        }
+    }
+    *utf8Str = '\0';
+}
+
+static u4 refUtf8Hash(const char* utf8Str)
+{
+    u4 hash = 1;
+
+    while (*utf8Str != '\0')
+        hash = hash * 31 + *utf8Str++;
+    return hash;
+}
+
+static u4 refUtf16Hash(const u2* utf16Str, int len)
+{
+    u4 hash = 0;
+
+    while (len--)
+        hash = hash * 31 + *utf16Str++;
+    return hash;
+}
+
+/*
+ * Cheap deterministic generator, so failures are repeatable.
+ */
+static u4 nextRandom(u4* pSeed)
+{
+    *pSeed = *pSeed * 1103515245 + 12345;
+    return *pSeed >> 8;
+}
+
+/*
+ * Fill "chars" with printable ASCII, with an occasional char that needs
+ * two or three bytes in modified UTF-8 (including U+0000) if "mixed".
+ */
+static void fillChars(u2* chars, int len, bool mixed, u4* pSeed)
+{
+    static const u2 kOddChars[] = { 0x0000, 0x007f, 0x0080, 0x00e9, 0x03b1,
+        0x07ff, 0x0800, 0x20ac, 0xd800, 0xffff };
+    int i;
+
+    for (i = 0; i < len; i++) {
+        u4 r = nextRandom(pSeed);
+        if (mixed && (r & 0x0f) == 0)
+            chars[i] = kOddChars[(r >> 4) % NELEM(kOddChars)];
+        else
+            chars[i] = 0x20 + (r >> 4) % 0x5f;
+    }
+}
+
+/*
+ * Check every function on one string, starting "align" bytes into the
+ * UTF-8 buffer so the aligned and unaligned paths both get used.
+ */
+static bool checkOne(const u2* chars, int len, int align)
+{
+    char utf8Buf[kMaxTestLen * 3 + 16 + 1];
+    char outBuf[kMaxTestLen * 3 + 1];
+    u2 utf16Buf[kMaxTestLen + 1];
+    u1 latin1Buf[kMaxTestLen];
+    char* utf8Str = utf8Buf + align;
+    int byteLen, i;
+
+    refConvertUtf16ToUtf8(utf8Str, chars, len);
+
+    byteLen = dvmUtf16Utf8ByteLen(chars, len);
+    if (byteLen != refUtf16Utf8ByteLen(chars, len) ||
+        byteLen != (int) strlen(utf8Str))
+    {
+        LOGE("TestUtfString: byte length %d, expected %d (len=%d)\n",
+            byteLen, refUtf16Utf8ByteLen(chars, len), len);
+        return false;
+    }
+
+    memset(outBuf, 0x55, sizeof(outBuf));
+    dvmConvertUtf16ToUtf8(outBuf, chars, len);
+    if (strcmp(outBuf, utf8Str) != 0 || outBuf[byteLen] != '\0') {
+        LOGE("TestUtfString: UTF-16 to UTF-8 mismatch (len=%d)\n", len);
+        return false;
+    }
+
+    if (dvmUtf8Len(utf8Str) != len || refUtf8Len(utf8Str) != len) {
+        LOGE("TestUtfString: UTF-8 length %d, expected %d (align=%d)\n",
+            dvmUtf8Len(utf8Str), len, align);
+        return false;
+    }
+
+    utf16Buf[len] = 0x5555;
+    dvmConvertUtf8ToUtf16(utf16Buf, utf8Str);
+    if (memcmp(utf16Buf, chars, len * sizeof(u2)) != 0 ||
+        utf16Buf[len] != 0x5555)
+    {
+        LOGE("TestUtfString: UTF-8 to UTF-16 mismatch (len=%d align=%d)\n",
+            len, align);
+        return false;
+    }
+
+    if (dvmComputeUtf16Hash(chars, len) != refUtf16Hash(chars, len) ||
+        dvmComputeUtf8Hash(utf8Str) != refUtf8Hash(utf8Str))
+    {
+        LOGE("TestUtfString: hash mismatch (len=%d)\n", len);
+        return false;
+    }
+
+    /* a Latin-1 String must hash the same as its UTF-16 twin */
+    for (i = 0; i < len && chars[i] <= 0xff; i++)
+        latin1Buf[i] = (u1) chars[i];
+    if (i == len &&
+        dvmComputeLatin1Hash(latin1Buf, len) != refUtf16Hash(chars, len))
+    {
+        LOGE("TestUtfString: Latin-1 hash mismatch (len=%d)\n", len);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Check the fast paths against the reference versions.
+ */
+bool dvmTestUtfString(void)
+{
+    u2 chars[kMaxTestLen];
+    u4 seed = 1;
+    int len, align, pass;
+
+    LOGV("TestUtfString BEGIN\n");
+
+    for (len = 0; len <= kMaxTestLen; len++) {
+        for (align = 0; align < 16; align++) {
+            for (pass = 0; pass < 2; pass++) {
+                fillChars(chars, len, pass != 0, &seed);
+                if (!checkOne(chars, len, align))
+                    return false;
+            }
+        }
+    }
+
+    LOGV("TestUtfString END\n");
+    return true;
+}
+
+/*
+ * Time the conversions on a long ASCII string and on a mixed one.
+ * Results go to stdout, as with the atomic speed test.
+ */
+bool dvmTestUtfStringSpeed(void)
+{
+    u2* chars = (u2*) malloc(kSpeedLen * sizeof(u2));
+    u2* utf16Buf = (u2*) malloc(kSpeedLen * sizeof(u2));
+    char* utf8Str = (char*) malloc(kSpeedLen * 3 + 1);
+    u4 seed = 1;
+    int pass, i;
+
+    if (chars == NULL || utf16Buf == NULL || utf8Str == NULL) {
+        free(chars);
+        free(utf16Buf);
+        free(utf8Str);
+        return false;
+    }
+
+    for (pass = 0; pass < 2; pass++) {
+        u4 sink = 0;
+        u8 start, t0, t1, t2, t3, t4;
+
+        fillChars(chars, kSpeedLen, pass != 0, &seed);
+        refConvertUtf16ToUtf8(utf8Str, chars, kSpeedLen);
+
+        start = dvmGetRelativeTimeNsec();
+        for (i = 0; i < kSpeedRepeat; i++)
+            sink += dvmUtf8Len(utf8Str);
+        t0 = dvmGetRelativeTimeNsec();
+        for (i = 0; i < kSpeedRepeat; i++)
+            dvmConvertUtf8ToUtf16(utf16Buf, utf8Str);
+        t1 = dvmGetRelativeTimeNsec();
+        for (i = 0; i < kSpeedRepeat; i++)
+            sink += dvmUtf16Utf8ByteLen(chars, kSpeedLen);
+        t2 = dvmGetRelativeTimeNsec();
+        for (i = 0; i < kSpeedRepeat; i++)
+            dvmConvertUtf16ToUtf8(utf8Str, chars, kSpeedLen);
+        t3 = dvmGetRelativeTimeNsec();
+        for (i = 0; i < kSpeedRepeat; i++)
+            sink += dvmComputeUtf16Hash(chars, kSpeedLen);
+        t4 = dvmGetRelativeTimeNsec();
+
+#define PER_CHAR(_t)    ((double) (_t) / ((double) kSpeedLen * kSpeedRepeat))
+        dvmFprintf(stdout, "UTF speed (%s, %d chars, ns/char):\n",
+            pass == 0 ? "ASCII" : "mixed", kSpeedLen);
+        dvmFprintf(stdout, "  dvmUtf8Len            %.3f\n",
+            PER_CHAR(t0 - start));
+        dvmFprintf(stdout, "  dvmConvertUtf8ToUtf16 %.3f\n", PER_CHAR(t1 - t0));
+        dvmFprintf(stdout, "  dvmUtf16Utf8ByteLen   %.3f\n", PER_CHAR(t2 - t1));
+        dvmFprintf(stdout, "  dvmConvertUtf16ToUtf8 %.3f\n", PER_CHAR(t3 - t2));
+        dvmFprintf(stdout, "  dvmComputeUtf16Hash   %.3f  (%08x)\n",
+            PER_CHAR(t4 - t3), sink);
+#undef PER_CHAR
+    }
+
+    free(chars);
+    free(utf16Buf);
+    free(utf8Str);
+    return true;
+}
+
+#endif /*NDEBUG*/